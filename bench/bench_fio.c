@@ -0,0 +1,747 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : bench_fio.c
+ * Description  : fio style sweep of block size, queue depth, file count, read/write mix,
+                  access pattern and backend, reporting IOPS, MB/s and latency as JSON.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include <sys/utsname.h>
+#include "async_file_accessor.h"
+#include "io_stats.h"
+
+#ifndef OUTPUT_DIR
+#define OUTPUT_DIR "."
+#endif
+
+#define BENCH_SYNC                      ASYNC_FILE_ACCESSOR_MAX /// engine of the pread/pwrite baseline, after accessor types
+#define BENCH_ENGINES                   (BENCH_SYNC + 1)
+#define BENCH_LIST_MAX                  16                      /// values of one sweep dimension
+#define BENCH_MAX_FILES                 256                     /// files one job may spread over
+#define BENCH_MAX_DEPTH                 1024                    /// requests one job may keep in flight
+#define BENCH_DEFAULT_FILE_SIZE         (32ULL << 20)
+#define BENCH_DEFAULT_RUNTIME_MS        500
+#define BENCH_FILL_CHUNK                (1U << 20)              /// dataset is written in chunks of this
+#define BENCH_REAP_TIMEOUT_MS           1000
+#define BENCH_REAP_TIMEOUTS             10                      /// reaps in a row finding nothing before a job gives up
+#define BENCH_MB                        (1024.0 * 1024.0)
+#define BENCH_DIR_LEN                   (MAX_FILE_NAME_LEN - (sizeof("/bench_fio_4294967295.dat") - 1)) /// dataset names always fit
+
+static const char8 *g_engineName[BENCH_ENGINES] =
+{
+    [ASYNC_FILE_ACCESSOR_AIO]           = "aio",
+    [ASYNC_FILE_ACCESSOR_MMAP]          = "mmap",
+    [ASYNC_FILE_ACCESSOR_URING]         = "io_uring",
+    [ASYNC_FILE_ACCESSOR_AIO_NATIVE]    = "aio_native",
+    [BENCH_SYNC]                        = "sync",
+};
+
+/// struct define values of one sweep dimension
+typedef struct __bench_list
+{
+    u32                             count;                  /// values given
+    u64                             values[BENCH_LIST_MAX];
+
+} bench_list_t;
+
+/// struct define what the sweep covers
+typedef struct __bench_config
+{
+    bench_list_t                    engines;                /// accessor types and BENCH_SYNC
+    bench_list_t                    blockSizes;             /// bytes per request
+    bench_list_t                    queueDepths;            /// requests kept in flight, sync runs as many threads
+    bench_list_t                    fileCounts;             /// files requests are spread over
+    bench_list_t                    readPcts;               /// share of reads in percent
+    bench_list_t                    patterns;               /// 0 sequential, 1 random
+    u64                             fileSize;               /// bytes of each dataset file
+    u32                             runtimeMs;              /// time each job issues requests for
+    bool                            isWarmCache;            /// keep page cache between jobs
+    bool                            isKeepData;             /// leave dataset behind
+    char8                           dir[BENCH_DIR_LEN];     /// dataset directory
+    const char8                    *output;                 /// JSON path, NULL for stdout
+
+} bench_config_t;
+
+/// struct define one point of the sweep
+typedef struct __bench_job
+{
+    u32                             engine;                 /// accessor type or BENCH_SYNC
+    u32                             blockSize;              /// bytes per request
+    u32                             queueDepth;             /// requests kept in flight
+    u32                             fileCount;              /// files in use
+    u32                             readPct;                /// share of reads in percent
+    bool                            isRandom;               /// random or sequential offsets
+
+} bench_job_t;
+
+/// struct define state shared by everything issuing requests of a job
+typedef struct __bench_run
+{
+    const bench_config_t           *pConfig;
+    const bench_job_t              *pJob;
+    u64                             blocksPerFile;          /// blocks of blockSize in a file
+    u64                             sequence;               /// next sequential request, shared by sync threads
+    u64                             deadlineNs;             /// no request is issued after this
+    io_stats_t                     *pStats;                 /// completed requests and their latency
+
+} bench_run_t;
+
+/// struct define an in-flight slot of an accessor job
+typedef struct __bench_slot
+{
+    async_file_access_request_t    *pRequest;               /// request in flight, NULL when idle
+    void                           *buf;                    /// data of the request
+    u64                             putNs;                  /// CLOCK_MONOTONIC time of put
+    async_file_access_direction_t   direction;              /// read or write
+
+} bench_slot_t;
+
+/// struct define a pread/pwrite thread of the sync baseline
+typedef struct __bench_worker
+{
+    bench_run_t                    *pRun;
+    const s32                      *fds;                    /// descriptor of each file
+    void                           *buf;                    /// data of the thread's requests
+    u64                             rng;                    /// random offsets and mix of the thread
+
+} bench_worker_t;
+
+static u64 get_time_in_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static u64 bench_rand(u64 *pState)
+{
+    *pState ^= *pState << 13;
+    *pState ^= *pState >> 7;
+    *pState ^= *pState << 17;
+    return *pState;
+}
+
+static void bench_file_name(const bench_config_t *pConfig, u32 idx, char8 *fn)
+{
+    snprintf(fn, MAX_FILE_NAME_LEN, "%s/bench_fio_%u.dat", pConfig->dir, idx);
+}
+
+/// Pick file, offset and direction of the next request
+static void bench_next(bench_run_t *pRun, u64 *pRng, u32 *pFile, u64 *pOffset, async_file_access_direction_t *pDirection)
+{
+    const bench_job_t  *pJob    = pRun->pJob;
+    u64                 block   = 0;
+
+    if (pJob->isRandom)
+    {
+        *pFile  = (u32)(bench_rand(pRng) % pJob->fileCount);
+        block   = bench_rand(pRng) % pRun->blocksPerFile;
+    }
+    else
+    {
+        /// Files are walked round robin, each from its start
+        u64 n   = __atomic_fetch_add(&(pRun->sequence), 1, __ATOMIC_RELAXED);
+        *pFile  = (u32)(n % pJob->fileCount);
+        block   = (n / pJob->fileCount) % pRun->blocksPerFile;
+    }
+
+    *pOffset    = block * pJob->blockSize;
+    *pDirection = (100 == pJob->readPct) ? ASYNC_FILE_ACCESS_READ
+                : (0 == pJob->readPct) ? ASYNC_FILE_ACCESS_WRITE
+                : (bench_rand(pRng) % 100 < pJob->readPct) ? ASYNC_FILE_ACCESS_READ : ASYNC_FILE_ACCESS_WRITE;
+}
+
+/// Write dataset files that are missing or of another size
+static ret_t bench_create_dataset(const bench_config_t *pConfig, u32 fileCount)
+{
+    ret_t   res = RET_OK;
+    u64     rng = 0x9e3779b97f4a7c15ULL;
+    u64    *buf = (u64 *)malloc(BENCH_FILL_CHUNK);
+    char8   fn[MAX_FILE_NAME_LEN];
+
+    for (u32 i = 0; RET_OK == res && NULL != buf && i < fileCount; i++)
+    {
+        struct stat st;
+        s32         fd = -1;
+
+        bench_file_name(pConfig, i, fn);
+        if (0 == stat(fn, &st) && (u64)st.st_size == pConfig->fileSize)
+        {
+            continue;
+        }
+
+        fprintf(stderr, "- Create %s, %llu bytes.\n", fn, (unsigned long long)pConfig->fileSize);
+        fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        res = (fd >= 0) ? RET_OK : -errno;
+
+        /// Random content so compressing or deduplicating storage does not flatter the numbers
+        for (u64 done = 0; RET_OK == res && done < pConfig->fileSize; done += BENCH_FILL_CHUNK)
+        {
+            u64 length = (pConfig->fileSize - done < BENCH_FILL_CHUNK) ? pConfig->fileSize - done : BENCH_FILL_CHUNK;
+
+            for (u32 w = 0; w < BENCH_FILL_CHUNK / sizeof(u64); w++)
+            {
+                buf[w] = bench_rand(&rng);
+            }
+            res = (write(fd, buf, length) == (ssize_t)length) ? RET_OK : -errno;
+        }
+
+        res = (RET_OK == res && fsync(fd) != 0) ? -errno : res;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (RET_OK != res)
+        {
+            fprintf(stderr, "Error: create dataset file [%s] fail! res = %d.\n", fn, res);
+        }
+    }
+
+    free(buf);
+
+    return (NULL == buf) ? RET_NO_MEMORY : res;
+}
+
+/// Flush writes of earlier jobs and drop dataset from page cache, like fio invalidate
+static void bench_invalidate(const bench_config_t *pConfig, u32 fileCount)
+{
+    char8 fn[MAX_FILE_NAME_LEN];
+
+    for (u32 i = 0; i < fileCount; i++)
+    {
+        s32 fd = -1;
+
+        bench_file_name(pConfig, i, fn);
+        fd = open(fn, O_RDWR);
+        if (fd >= 0)
+        {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+}
+
+/// Issue requests with pread/pwrite until the deadline
+static void *bench_sync_worker(void *arg)
+{
+    bench_worker_t     *pWorker = (bench_worker_t *)arg;
+    bench_run_t        *pRun    = pWorker->pRun;
+    u32                 size    = pRun->pJob->blockSize;
+
+    while (get_time_in_nanoseconds() < __atomic_load_n(&(pRun->deadlineNs), __ATOMIC_RELAXED))
+    {
+        async_file_access_direction_t   direction;
+        u32                             file    = 0;
+        u64                             offset  = 0;
+        u64                             putNs   = 0;
+        ssize_t                         done    = 0;
+
+        bench_next(pRun, &(pWorker->rng), &file, &offset, &direction);
+        putNs   = get_time_in_nanoseconds();
+        done    = (ASYNC_FILE_ACCESS_READ == direction) ? pread(pWorker->fds[file], pWorker->buf, size, (off_t)offset)
+                                                        : pwrite(pWorker->fds[file], pWorker->buf, size, (off_t)offset);
+        io_stats_record(pRun->pStats, direction, done == (ssize_t)size, size, 0, putNs, 0);
+    }
+
+    return NULL;
+}
+
+/// Sync baseline, one thread per queue depth slot
+static ret_t bench_run_sync(bench_run_t *pRun)
+{
+    const bench_job_t  *pJob        = pRun->pJob;
+    ret_t               res         = RET_OK;
+    s32                 fds[BENCH_MAX_FILES];
+    bench_worker_t     *pWorkers    = (bench_worker_t *)calloc(pJob->queueDepth, sizeof(bench_worker_t));
+    pthread_t          *pThreads    = (pthread_t *)calloc(pJob->queueDepth, sizeof(pthread_t));
+    u32                 opened      = 0;
+    u32                 started     = 0;
+    char8               fn[MAX_FILE_NAME_LEN];
+
+    res = (NULL == pWorkers || NULL == pThreads) ? RET_NO_MEMORY : res;
+    while (RET_OK == res && opened < pJob->fileCount)
+    {
+        bench_file_name(pRun->pConfig, opened, fn);
+        fds[opened] = open(fn, (100 == pJob->readPct) ? O_RDONLY : O_RDWR);
+        res         = (fds[opened] >= 0) ? RET_OK : -errno;
+        opened     += (RET_OK == res) ? 1 : 0;
+    }
+
+    pRun->deadlineNs = get_time_in_nanoseconds() + (u64)pRun->pConfig->runtimeMs * 1000000;
+    while (RET_OK == res && started < pJob->queueDepth)
+    {
+        bench_worker_t *pWorker = &(pWorkers[started]);
+
+        pWorker->pRun   = pRun;
+        pWorker->fds    = fds;
+        pWorker->rng    = 0x2545f4914f6cdd1dULL * (started + 1);
+        pWorker->buf    = Async_File_Buffer_Alloc(pJob->blockSize);
+        if (NULL != pWorker->buf)
+        {
+            memset(pWorker->buf, 0x5a, pJob->blockSize);
+        }
+        res             = (NULL != pWorker->buf) ? -pthread_create(&(pThreads[started]), NULL, bench_sync_worker, pWorker)
+                                                 : RET_NO_MEMORY;
+        started        += (RET_OK == res) ? 1 : 0;
+    }
+
+    /// A failed start still lets the threads already running finish
+    if (RET_OK != res)
+    {
+        __atomic_store_n(&(pRun->deadlineNs), 0, __ATOMIC_RELAXED);
+    }
+    for (u32 i = 0; i < started; i++)
+    {
+        pthread_join(pThreads[i], NULL);
+    }
+    for (u32 i = 0; NULL != pWorkers && i < pJob->queueDepth; i++)
+    {
+        if (NULL != pWorkers[i].buf)
+        {
+            Async_File_Buffer_Free(pWorkers[i].buf, pJob->blockSize);
+        }
+    }
+    for (u32 i = 0; i < opened; i++)
+    {
+        close(fds[i]);
+    }
+    free(pWorkers);
+    free(pThreads);
+
+    return res;
+}
+
+/// Get and put a request of the next offset into an idle slot
+static ret_t bench_submit(async_file_accessor_t *pFileAccessor, bench_run_t *pRun, const u32 *pHandles,
+                          u64 *pRng, bench_slot_t *pSlot)
+{
+    ret_t                               res         = RET_OK;
+    u32                                 file        = 0;
+    struct iovec                        iov         = { .iov_base = pSlot->buf, .iov_len = pRun->pJob->blockSize };
+    async_file_access_request_info_t    createInfo  =
+    {
+        .size       = pRun->pJob->blockSize,
+    };
+
+    bench_next(pRun, pRng, &file, &(createInfo.offset), &(createInfo.direction));
+    createInfo.fileHandle   = pHandles[file];
+    pSlot->pRequest         = NULL;
+
+    res = pFileAccessor->getRequest(pFileAccessor, &(pSlot->pRequest), &createInfo);
+    if (RET_OK == res)
+    {
+        /// Writes go out of the slot buffer as well, allocWriteBuf would add a copy per request
+        res = (ASYNC_FILE_ACCESS_READ == createInfo.direction)
+            ? pFileAccessor->importReadBuf(pFileAccessor, pSlot->pRequest, pSlot->buf)
+            : pFileAccessor->importIovec(pFileAccessor, pSlot->pRequest, &iov, 1);
+    }
+    if (RET_OK == res)
+    {
+        pSlot->direction    = createInfo.direction;
+        pSlot->putNs        = get_time_in_nanoseconds();
+        res                 = pFileAccessor->putRequest(pFileAccessor, pSlot->pRequest);
+    }
+
+    if (RET_OK != res && NULL != pSlot->pRequest)
+    {
+        pFileAccessor->releaseRequest(pFileAccessor, pSlot->pRequest);
+    }
+    pSlot->pRequest = (RET_OK == res) ? pSlot->pRequest : NULL;
+
+    return res;
+}
+
+/// Keep queue depth requests in flight through an accessor, refilling a slot on each reaped completion
+static ret_t bench_run_accessor(bench_run_t *pRun)
+{
+    const bench_job_t              *pJob            = pRun->pJob;
+    async_file_accessor_t          *pFileAccessor   = Async_File_Accessor_Get_Instance((async_file_accessor_type_t)pJob->engine);
+    bench_slot_t                   *pSlots          = (bench_slot_t *)calloc(pJob->queueDepth, sizeof(bench_slot_t));
+    async_file_access_request_t   **ppDone          = (async_file_access_request_t **)calloc(pJob->queueDepth,
+                                                                                             sizeof(void *));
+    u32                             handles[BENCH_MAX_FILES];
+    u32                             opened          = 0;
+    u32                             inflight        = 0;
+    u32                             idleReaps       = 0;
+    u64                             rng             = 0x2545f4914f6cdd1dULL;
+    ret_t                           res             = RET_OK;
+    char8                           fn[MAX_FILE_NAME_LEN];
+
+    res = (NULL == pFileAccessor) ? RET_NO_INIT
+        : (NULL == pSlots || NULL == ppDone) ? RET_NO_MEMORY : RET_OK;
+
+    while (RET_OK == res && opened < pJob->fileCount)
+    {
+        bench_file_name(pRun->pConfig, opened, fn);
+        res     = pFileAccessor->openFile(pFileAccessor, fn,
+                                          (100 == pJob->readPct) ? ASYNC_FILE_ACCESS_READ : ASYNC_FILE_ACCESS_WRITE,
+                                          &(handles[opened]));
+        opened += (RET_OK == res) ? 1 : 0;
+    }
+
+    for (u32 i = 0; RET_OK == res && i < pJob->queueDepth; i++)
+    {
+        pSlots[i].buf = Async_File_Buffer_Alloc(pJob->blockSize);
+        res = (NULL != pSlots[i].buf) ? RET_OK : RET_NO_MEMORY;
+        if (RET_OK == res)
+        {
+            memset(pSlots[i].buf, 0x5a, pJob->blockSize);
+        }
+    }
+
+    pRun->deadlineNs = get_time_in_nanoseconds() + (u64)pRun->pConfig->runtimeMs * 1000000;
+    for (u32 i = 0; RET_OK == res && i < pJob->queueDepth; i++)
+    {
+        res         = bench_submit(pFileAccessor, pRun, handles, &rng, &(pSlots[i]));
+        inflight   += (RET_OK == res) ? 1 : 0;
+    }
+
+    /// Requests in flight are always reaped, a failure only stops new puts
+    while (inflight > 0)
+    {
+        ret_t count = pFileAccessor->reapCompletions(pFileAccessor, ppDone, pJob->queueDepth, BENCH_REAP_TIMEOUT_MS);
+
+        if (count <= 0)
+        {
+            idleReaps++;
+            if (count < 0 || idleReaps >= BENCH_REAP_TIMEOUTS)
+            {
+                res = (count < 0) ? count : RET_TIMED_OUT;
+                fprintf(stderr, "Error: %u requests never completed! res = %d.\n", inflight, res);
+                break;
+            }
+            continue;
+        }
+        idleReaps = 0;
+
+        for (s32 d = 0; d < count; d++)
+        {
+            bench_slot_t   *pSlot   = NULL;
+            ret_t           status  = RET_OK;
+
+            /// Slots are few, a scan finds the owner faster than any lookup structure would pay off
+            for (u32 i = 0; i < pJob->queueDepth && NULL == pSlot; i++)
+            {
+                pSlot = (pSlots[i].pRequest == ppDone[d]) ? &(pSlots[i]) : NULL;
+            }
+            if (NULL == pSlot)
+            {
+                continue;
+            }
+
+            status = pFileAccessor->waitRequest(pFileAccessor, pSlot->pRequest, 0);
+            io_stats_record(pRun->pStats, pSlot->direction, RET_OK == status, pJob->blockSize, 0, pSlot->putNs, 0);
+            pFileAccessor->releaseRequest(pFileAccessor, pSlot->pRequest);
+            pSlot->pRequest = NULL;
+            inflight--;
+
+            if (RET_OK == res && get_time_in_nanoseconds() < pRun->deadlineNs)
+            {
+                res         = bench_submit(pFileAccessor, pRun, handles, &rng, pSlot);
+                inflight   += (RET_OK == res) ? 1 : 0;
+            }
+        }
+    }
+
+    for (u32 i = 0; NULL != pSlots && i < pJob->queueDepth; i++)
+    {
+        /// Slot of a request that never completed stays with it
+        if (NULL != pSlots[i].buf && NULL == pSlots[i].pRequest)
+        {
+            Async_File_Buffer_Free(pSlots[i].buf, pJob->blockSize);
+        }
+    }
+    for (u32 i = 0; i < opened; i++)
+    {
+        pFileAccessor->closeFile(pFileAccessor, handles[i]);
+    }
+    free(pSlots);
+    free(ppDone);
+
+    return res;
+}
+
+/// Write latency of a direction as a JSON object
+static void bench_print_direction(FILE *fp, const char8 *name, const async_file_direction_stats_t *pDir, f64 seconds)
+{
+    const async_file_latency_stats_t *pLat = &(pDir->stages[ASYNC_FILE_STAGE_TOTAL]);
+
+    fprintf(fp, "\"%s\": {\"ops\": %llu, \"errors\": %llu, \"iops\": %.1f, \"mbps\": %.2f, "
+                "\"lat_ns\": {\"mean\": %llu, \"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}}",
+            name, (unsigned long long)pDir->ops, (unsigned long long)pDir->errors, (f64)pDir->ops / seconds,
+            (f64)pDir->bytes / BENCH_MB / seconds, (unsigned long long)pLat->meanNs, (unsigned long long)pLat->p50Ns,
+            (unsigned long long)pLat->p99Ns, (unsigned long long)pLat->p999Ns, (unsigned long long)pLat->maxNs);
+}
+
+/// Run one job and write its JSON object
+static ret_t bench_job(FILE *fp, const bench_config_t *pConfig, const bench_job_t *pJob, bool isFirst, io_stats_t *pStats)
+{
+    bench_run_t         run;
+    async_file_stats_t  stats;
+    u64                 startNs = 0;
+    u64                 elapsed = 0;
+    f64                 seconds = 0;
+    u64                 ops     = 0;
+    u64                 bytes   = 0;
+    ret_t               res     = RET_OK;
+
+    if (!pConfig->isWarmCache)
+    {
+        bench_invalidate(pConfig, pJob->fileCount);
+    }
+
+    /// Statistics keep their shards across jobs, each job starts them over
+    run.pConfig         = pConfig;
+    run.pJob            = pJob;
+    run.blocksPerFile   = pConfig->fileSize / pJob->blockSize;
+    run.sequence        = 0;
+    run.pStats          = pStats;
+    io_stats_reset(pStats);
+
+    startNs = get_time_in_nanoseconds();
+    res     = (BENCH_SYNC == pJob->engine) ? bench_run_sync(&run) : bench_run_accessor(&run);
+    elapsed = get_time_in_nanoseconds() - startNs;
+    seconds = (f64)elapsed / 1000000000.0;
+
+    io_stats_get(pStats, &stats);
+    for (u32 d = 0; d < ASYNC_FILE_ACCESS_MAX; d++)
+    {
+        ops     += stats.directions[d].ops;
+        bytes   += stats.directions[d].bytes;
+    }
+
+    fprintf(fp, "%s    {\"engine\": \"%s\", \"block_size\": %u, \"queue_depth\": %u, \"files\": %u, "
+                "\"read_pct\": %u, \"pattern\": \"%s\", \"result\": %d, \"elapsed_ns\": %llu, "
+                "\"iops\": %.1f, \"mbps\": %.2f,\n     ",
+            isFirst ? "" : ",\n", g_engineName[pJob->engine], pJob->blockSize, pJob->queueDepth, pJob->fileCount,
+            pJob->readPct, pJob->isRandom ? "rand" : "seq", res, (unsigned long long)elapsed,
+            (f64)ops / seconds, (f64)bytes / BENCH_MB / seconds);
+    bench_print_direction(fp, "read", &(stats.directions[ASYNC_FILE_ACCESS_READ]), seconds);
+    fprintf(fp, ",\n     ");
+    bench_print_direction(fp, "write", &(stats.directions[ASYNC_FILE_ACCESS_WRITE]), seconds);
+    fprintf(fp, "}");
+    fflush(fp);
+
+    fprintf(stderr, "%-10s %-4s r%3u%% bs %7u qd %3u files %2u: %10.1f IOPS %9.2f MB/s%s\n",
+            g_engineName[pJob->engine], pJob->isRandom ? "rand" : "seq", pJob->readPct, pJob->blockSize,
+            pJob->queueDepth, pJob->fileCount, (f64)ops / seconds, (f64)bytes / BENCH_MB / seconds,
+            (RET_OK == res) ? "" : "  (failed)");
+
+    return res;
+}
+
+/// Parse a comma separated list, sizes take k, m and g suffixes
+static bool bench_parse_list(const char8 *arg, bench_list_t *pList)
+{
+    char8   copy[256];
+    char8  *pSave   = NULL;
+
+    snprintf(copy, sizeof(copy), "%s", arg);
+    pList->count = 0;
+
+    for (char8 *pToken = strtok_r(copy, ",", &pSave); NULL != pToken; pToken = strtok_r(NULL, ",", &pSave))
+    {
+        char8  *pEnd    = NULL;
+        u64     value   = 0;
+        s32     engine  = -1;
+
+        for (s32 e = 0; e < BENCH_ENGINES; e++)
+        {
+            engine = (strcmp(pToken, g_engineName[e]) == 0) ? e : engine;
+        }
+
+        if (engine >= 0 || strcmp(pToken, "seq") == 0 || strcmp(pToken, "rand") == 0)
+        {
+            value = (engine >= 0) ? (u64)engine : (strcmp(pToken, "rand") == 0) ? 1 : 0;
+        }
+        else
+        {
+            value = strtoull(pToken, &pEnd, 0);
+            value <<= ('k' == *pEnd || 'K' == *pEnd) ? 10 : ('m' == *pEnd || 'M' == *pEnd) ? 20
+                    : ('g' == *pEnd || 'G' == *pEnd) ? 30 : 0;
+            if (pEnd == pToken || ('\0' != *pEnd && '\0' != pEnd[1]))
+            {
+                return FALSE;
+            }
+        }
+
+        if (pList->count >= BENCH_LIST_MAX)
+        {
+            return FALSE;
+        }
+        pList->values[pList->count++] = value;
+    }
+
+    return pList->count > 0;
+}
+
+static void bench_usage(const char8 *program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -e LIST   engines: sync,aio,mmap,io_uring,aio_native  (sync,aio,mmap)\n"
+            "  -b LIST   block sizes                                 (4k,64k,1m)\n"
+            "  -q LIST   queue depths, sync runs one thread each     (1,32)\n"
+            "  -f LIST   file counts                                 (1,8)\n"
+            "  -m LIST   read share in percent                       (100,70,0)\n"
+            "  -p LIST   patterns: seq,rand                          (seq,rand)\n"
+            "  -s SIZE   bytes of each dataset file                  (32m)\n"
+            "  -r MS     runtime of each job                         (%u)\n"
+            "  -d DIR    dataset directory                           (%s)\n"
+            "  -o FILE   JSON output                                 (stdout)\n"
+            "  -c        keep page cache warm between jobs\n"
+            "  -k        keep dataset files\n",
+            program, BENCH_DEFAULT_RUNTIME_MS, OUTPUT_DIR);
+}
+
+/// Defaults, then command line
+static bool bench_parse_args(int argc, char *argv[], bench_config_t *pConfig)
+{
+    bool    isValid = TRUE;
+    s32     opt     = 0;
+
+    memset(pConfig, 0, sizeof(bench_config_t));
+    bench_parse_list("sync,aio,mmap", &(pConfig->engines));
+    bench_parse_list("4k,64k,1m", &(pConfig->blockSizes));
+    bench_parse_list("1,32", &(pConfig->queueDepths));
+    bench_parse_list("1,8", &(pConfig->fileCounts));
+    bench_parse_list("100,70,0", &(pConfig->readPcts));
+    bench_parse_list("seq,rand", &(pConfig->patterns));
+    pConfig->fileSize   = BENCH_DEFAULT_FILE_SIZE;
+    pConfig->runtimeMs  = BENCH_DEFAULT_RUNTIME_MS;
+    snprintf(pConfig->dir, sizeof(pConfig->dir), "%s", OUTPUT_DIR);
+
+    while (isValid && (opt = getopt(argc, argv, "e:b:q:f:m:p:s:r:d:o:ckh")) != -1)
+    {
+        bench_list_t size = { 0 };
+
+        switch (opt)
+        {
+            case 'e':   isValid = bench_parse_list(optarg, &(pConfig->engines));        break;
+            case 'b':   isValid = bench_parse_list(optarg, &(pConfig->blockSizes));     break;
+            case 'q':   isValid = bench_parse_list(optarg, &(pConfig->queueDepths));    break;
+            case 'f':   isValid = bench_parse_list(optarg, &(pConfig->fileCounts));     break;
+            case 'm':   isValid = bench_parse_list(optarg, &(pConfig->readPcts));       break;
+            case 'p':   isValid = bench_parse_list(optarg, &(pConfig->patterns));       break;
+            case 's':   isValid = bench_parse_list(optarg, &size) && 1 == size.count;
+                        pConfig->fileSize = size.values[0];                             break;
+            case 'r':   pConfig->runtimeMs = (u32)atoi(optarg);                         break;
+            case 'd':   isValid = strlen(optarg) < sizeof(pConfig->dir);
+                        snprintf(pConfig->dir, sizeof(pConfig->dir), "%s", optarg);     break;
+            case 'o':   pConfig->output = optarg;                                       break;
+            case 'c':   pConfig->isWarmCache = TRUE;                                    break;
+            case 'k':   pConfig->isKeepData = TRUE;                                     break;
+            default:    isValid = FALSE;                                                break;
+        }
+    }
+
+    /// Every block size must fit a file, every dimension must make sense
+    for (u32 i = 0; isValid && i < pConfig->engines.count; i++)
+    {
+        isValid = pConfig->engines.values[i] < BENCH_ENGINES;
+    }
+    for (u32 i = 0; isValid && i < pConfig->patterns.count; i++)
+    {
+        isValid = pConfig->patterns.values[i] <= 1;
+    }
+    for (u32 i = 0; isValid && i < pConfig->blockSizes.count; i++)
+    {
+        isValid = pConfig->blockSizes.values[i] > 0 && pConfig->blockSizes.values[i] <= pConfig->fileSize &&
+                  pConfig->blockSizes.values[i] <= UINT32_MAX;
+    }
+    for (u32 i = 0; isValid && i < pConfig->queueDepths.count; i++)
+    {
+        isValid = pConfig->queueDepths.values[i] > 0 && pConfig->queueDepths.values[i] <= BENCH_MAX_DEPTH;
+    }
+    for (u32 i = 0; isValid && i < pConfig->fileCounts.count; i++)
+    {
+        isValid = pConfig->fileCounts.values[i] > 0 && pConfig->fileCounts.values[i] <= BENCH_MAX_FILES;
+    }
+    for (u32 i = 0; isValid && i < pConfig->readPcts.count; i++)
+    {
+        isValid = pConfig->readPcts.values[i] <= 100;
+    }
+
+    return isValid && pConfig->runtimeMs > 0 && optind == argc;
+}
+
+int main(int argc, char *argv[])
+{
+    bench_config_t      config;
+    bench_job_t         job;
+    io_stats_t          stats;
+    struct utsname      host;
+    FILE               *fp          = stdout;
+    u32                 maxFiles    = 0;
+    u32                 failed      = 0;
+    bool                isFirst     = TRUE;
+    char8               fn[MAX_FILE_NAME_LEN];
+
+    if (!bench_parse_args(argc, argv, &config))
+    {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    for (u32 i = 0; i < config.fileCounts.count; i++)
+    {
+        maxFiles = (config.fileCounts.values[i] > maxFiles) ? (u32)config.fileCounts.values[i] : maxFiles;
+    }
+    if (bench_create_dataset(&config, maxFiles) != RET_OK)
+    {
+        return 1;
+    }
+
+    fp = (NULL != config.output) ? fopen(config.output, "w") : stdout;
+    if (NULL == fp)
+    {
+        fprintf(stderr, "Error: open [%s] fail! error: %d - %s.\n", config.output, errno, strerror(errno));
+        return 1;
+    }
+
+    memset(&stats, 0, sizeof(io_stats_t));
+    io_stats_init(&stats);
+    uname(&host);
+    fprintf(fp, "{\n  \"benchmark\": \"bench_fio\",\n"
+                "  \"host\": {\"system\": \"%s\", \"release\": \"%s\", \"machine\": \"%s\", \"cpus\": %ld},\n"
+                "  \"dataset\": {\"dir\": \"%s\", \"file_size\": %llu, \"files\": %u},\n"
+                "  \"runtime_ms\": %u,\n  \"invalidate\": %s,\n  \"jobs\": [\n",
+            host.sysname, host.release, host.machine, sysconf(_SC_NPROCESSORS_ONLN), config.dir,
+            (unsigned long long)config.fileSize, maxFiles, config.runtimeMs, config.isWarmCache ? "false" : "true");
+
+    for (u32 e = 0; e < config.engines.count; e++)
+    for (u32 p = 0; p < config.patterns.count; p++)
+    for (u32 m = 0; m < config.readPcts.count; m++)
+    for (u32 b = 0; b < config.blockSizes.count; b++)
+    for (u32 q = 0; q < config.queueDepths.count; q++)
+    for (u32 f = 0; f < config.fileCounts.count; f++)
+    {
+        job.engine      = (u32)config.engines.values[e];
+        job.isRandom    = (0 != config.patterns.values[p]);
+        job.readPct     = (u32)config.readPcts.values[m];
+        job.blockSize   = (u32)config.blockSizes.values[b];
+        job.queueDepth  = (u32)config.queueDepths.values[q];
+        job.fileCount   = (u32)config.fileCounts.values[f];
+
+        failed     += (bench_job(fp, &config, &job, isFirst, &stats) != RET_OK) ? 1 : 0;
+        isFirst     = FALSE;
+    }
+
+    fprintf(fp, "\n  ]\n}\n");
+    if (stdout != fp)
+    {
+        fclose(fp);
+    }
+
+    for (u32 i = 0; !config.isKeepData && i < maxFiles; i++)
+    {
+        bench_file_name(&config, i, fn);
+        unlink(fn);
+    }
+
+    return (0 == failed) ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : bench_submit.c
+ * Description  : Measure per-request submission cost of putRequest vs putRequests.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "async_file_accessor.h"
+
+#ifndef OUTPUT_DIR
+#define OUTPUT_DIR "."
+#endif
+
+#define BENCH_DEFAULT_REQ_COUNT         512
+#define BENCH_DEFAULT_BLOCK_SIZE        4096
+#define BENCH_ROUNDS                    5
+
+static const char8 *g_typeName[ASYNC_FILE_ACCESSOR_MAX] =
+{
+    [ASYNC_FILE_ACCESSOR_AIO]           = "aio",
+    [ASYNC_FILE_ACCESSOR_MMAP]          = "mmap",
+    [ASYNC_FILE_ACCESSOR_URING]         = "io_uring",
+    [ASYNC_FILE_ACCESSOR_AIO_NATIVE]    = "aio_native",
+};
+
+static long long get_time_in_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((long long)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Create data file big enough for count blocks
+static ret_t create_bench_file(char8 *filename, u32 count, u32 blockSize)
+{
+    ret_t   res = RET_OK;
+    s32     fd  = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    char8  *buf = (char8 *)malloc(blockSize);
+
+    if (fd < 0 || NULL == buf)
+    {
+        res = RET_BAD_VALUE;
+        printf("Error: create bench file [%s] fail! error: %d - %s.\n", filename, errno, strerror(errno));
+    }
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        memset(buf, (s32)i, blockSize);
+        res = (write(fd, buf, blockSize) == (ssize_t)blockSize) ? RET_OK : RET_BAD_VALUE;
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    free(buf);
+
+    return res;
+}
+
+/// Prepare count read requests, one block each
+static ret_t prepare_requests(async_file_accessor_t        *pFileAccessor,
+                              async_file_access_request_t **ppRequests,
+                              void                         *buffer,
+                              char8                        *filename,
+                              u32                           count,
+                              u32                           blockSize)
+{
+    ret_t res = RET_OK;
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        async_file_access_request_info_t createInfo =
+        {
+            .direction  = ASYNC_FILE_ACCESS_READ,
+            .size       = blockSize,
+            .offset     = i * blockSize,
+        };
+        strncpy(createInfo.fn, filename, MAX_FILE_NAME_LEN - 1);
+
+        res = pFileAccessor->getRequest(pFileAccessor, &ppRequests[i], &createInfo);
+        res = (RET_OK == res) ? pFileAccessor->importReadBuf(pFileAccessor, ppRequests[i],
+                                                             (char8 *)buffer + (size_t)i * blockSize)
+                              : res;
+    }
+
+    return res;
+}
+
+/// Run one backend, return average submission cost in ns per request for single and batch put
+static ret_t bench_backend(async_file_accessor_type_t type, char8 *filename, u32 count, u32 blockSize)
+{
+    ret_t                           res             = RET_OK;
+    async_file_accessor_t          *pFileAccessor   = Async_File_Accessor_Get_Instance(type);
+    async_file_access_request_t   **ppRequests      = (async_file_access_request_t **)
+                                                      malloc(sizeof(async_file_access_request_t *) * count);
+    void                           *buffer          = NULL;
+    double                          singleNs        = 0;
+    double                          batchNs         = 0;
+
+    if (NULL == pFileAccessor || NULL == ppRequests ||
+        posix_memalign(&buffer, 4096, (size_t)count * blockSize) != 0)
+    {
+        printf("%-12s unavailable\n", g_typeName[type]);
+        free(ppRequests);
+        return RET_NO_INIT;
+    }
+
+    for (u32 round = 0; RET_OK == res && round < BENCH_ROUNDS; round++)
+    {
+        res = prepare_requests(pFileAccessor, ppRequests, buffer, filename, count, blockSize);
+
+        long long start = get_time_in_nanoseconds();
+        for (u32 i = 0; RET_OK == res && i < count; i++)
+        {
+            res = pFileAccessor->putRequest(pFileAccessor, ppRequests[i]);
+        }
+        singleNs += (double)(get_time_in_nanoseconds() - start) / count;
+        pFileAccessor->waitAll(pFileAccessor);
+
+        res = (RET_OK == res) ? prepare_requests(pFileAccessor, ppRequests, buffer, filename, count, blockSize)
+                              : res;
+
+        start = get_time_in_nanoseconds();
+        res = (RET_OK == res) ? pFileAccessor->putRequests(pFileAccessor, ppRequests, count) : res;
+        batchNs += (double)(get_time_in_nanoseconds() - start) / count;
+        pFileAccessor->waitAll(pFileAccessor);
+    }
+
+    if (RET_OK == res)
+    {
+        singleNs /= BENCH_ROUNDS;
+        batchNs  /= BENCH_ROUNDS;
+        printf("%-12s putRequest: %10.1f ns/req   putRequests: %10.1f ns/req   (%.2fx)\n",
+               g_typeName[type], singleNs, batchNs, batchNs > 0 ? singleNs / batchNs : 0);
+    }
+    else
+    {
+        printf("%-12s fail, res = %d\n", g_typeName[type], res);
+    }
+
+    pFileAccessor->releaseAll(pFileAccessor);
+    free(ppRequests);
+    free(buffer);
+
+    return res;
+}
+
+int main(int argc, char *argv[])
+{
+    u32     count       = (argc > 1) ? (u32)atoi(argv[1]) : BENCH_DEFAULT_REQ_COUNT;
+    u32     blockSize   = (argc > 2) ? (u32)atoi(argv[2]) : BENCH_DEFAULT_BLOCK_SIZE;
+    char8   filename[MAX_FILE_NAME_LEN];
+
+    if (0 == count || 0 == blockSize)
+    {
+        printf("Usage: %s [REQUEST_COUNT] [BLOCK_SIZE]\n", argv[0]);
+        return 1;
+    }
+
+    snprintf(filename, sizeof(filename), "%s/bench_submit.dat", OUTPUT_DIR);
+    if (create_bench_file(filename, count, blockSize) != RET_OK)
+    {
+        return 1;
+    }
+
+    printf("- Submission cost, %u requests x %u bytes, %d rounds.\n", count, blockSize, BENCH_ROUNDS);
+    for (s32 type = 0; type < ASYNC_FILE_ACCESSOR_MAX; type++)
+    {
+        bench_backend((async_file_accessor_type_t)type, filename, count, blockSize);
+    }
+
+    unlink(filename);
+
+    return 0;
+}
@@ -22,12 +22,15 @@ extern "C" {
 #define MAX_RETRY_TIMES                 2
 #define STR_NAME_MAX_LEN                64
 #define MAX_FILE_NAME_LEN               511
+#define ASYNC_FILE_MAX_IOVEC            64                      /// segments of one vectored request
 
 
 typedef enum __async_file_accessor_type
 {
     ASYNC_FILE_ACCESSOR_AIO             = 0,
     ASYNC_FILE_ACCESSOR_MMAP,
+    ASYNC_FILE_ACCESSOR_URING,
+    ASYNC_FILE_ACCESSOR_AIO_NATIVE,
     ASYNC_FILE_ACCESSOR_MAX,
 
 } async_file_accessor_type_t;
@@ -51,20 +54,198 @@ typedef enum __request_stat
 
 } request_stat_t;
 
+/// Access pattern hint of a request, each backend maps it to fadvise/madvise
+typedef enum __async_file_access_hint
+{
+    ASYNC_FILE_HINT_NORMAL              = 0,                    /// no advice, readahead detection decides
+    ASYNC_FILE_HINT_SEQUENTIAL,                                 /// more reads follow, prefetch from the first one
+    ASYNC_FILE_HINT_RANDOM,                                     /// no prefetch, kernel readahead off for the fd
+    ASYNC_FILE_HINT_WILLNEED,                                   /// start loading range into page cache on put
+    ASYNC_FILE_HINT_DONTNEED,                                   /// drop range from page cache once done
+    ASYNC_FILE_HINT_MAX,
+
+} async_file_access_hint_t;
+
+/// Durability a write needs before it completes, writes of a file finishing close in time share one flush
+typedef enum __async_file_durability
+{
+    ASYNC_FILE_DURABLE_NONE             = 0,                    /// done once data reached page cache or device
+    ASYNC_FILE_DURABLE_DATA,                                    /// data and size on stable storage, fdatasync
+    ASYNC_FILE_DURABLE_FULL,                                    /// data and all metadata on stable storage, fsync
+    ASYNC_FILE_DURABLE_MAX,
+
+} async_file_durability_t;
+
+/// Scheduling class of a request, higher classes are served first without starving lower ones
+typedef enum __async_file_priority
+{
+    ASYNC_FILE_PRIO_NORMAL              = 0,                    /// default class
+    ASYNC_FILE_PRIO_HIGH,                                       /// latency critical, e.g. metadata reads
+    ASYNC_FILE_PRIO_LOW,                                        /// bulk transfers, e.g. raw frame writes
+    ASYNC_FILE_PRIO_MAX,
+
+} async_file_priority_t;
+
+/// Decision of the adaptive depth controller on an epoch
+typedef enum __async_file_depth_decision
+{
+    ASYNC_FILE_DEPTH_HOLD               = 0,                    /// depth kept
+    ASYNC_FILE_DEPTH_GROW,                                      /// throughput still improving, depth raised
+    ASYNC_FILE_DEPTH_BACKOFF,                                   /// tail latency inflated, depth cut
+    ASYNC_FILE_DEPTH_MAX,
+
+} async_file_depth_decision_t;
+
+/// Latency stage of a request, each is timed between two of its timestamps, see getStats
+typedef enum __async_file_stage
+{
+    ASYNC_FILE_STAGE_SETUP              = 0,                    /// getRequest to put, file open included
+    ASYNC_FILE_STAGE_QUEUE,                                     /// put to start of service, admission wait included
+    ASYNC_FILE_STAGE_SERVICE,                                   /// start of service to completion
+    ASYNC_FILE_STAGE_TOTAL,                                     /// put to completion
+    ASYNC_FILE_STAGE_WAKEUP,                                    /// completion to return of wait or reap
+    ASYNC_FILE_STAGE_MAX,
+
+} async_file_stage_t;
+
 /// Async file accessor request info struct
 typedef struct __async_file_access_request_info
 {
     async_file_access_direction_t       direction;              /// read or write
     char8                               fn[MAX_FILE_NAME_LEN];  /// file name
-    u32                                 size;                   /// size of data
-    u32                                 offset;                 /// file access offset
+    u64                                 size;                   /// size of data
+    u64                                 offset;                 /// file access offset
+    u32                                 deadline_ms;            /// cancel if unfinished this long after put, 0 none
+    u32                                 fileHandle;             /// file from openFile, fn is ignored; NONE opens fn
+    async_file_access_hint_t            hint;                   /// access pattern advice, NORMAL if unset
+    async_file_durability_t             durability;             /// write: flush before completing, NONE if unset
+    bool                                isBarrier;              /// durable write: flush its group now, not after window
+    async_file_priority_t               priority;               /// scheduling class, NORMAL if unset
 
 } async_file_access_request_info_t;
 
+/// I/O buffer pool backing flags
+typedef enum
+{
+    ASYNC_FILE_BUFFER_HUGETLB           = 1 << 0,               /// back slabs with reserved huge pages if available
+    ASYNC_FILE_BUFFER_THP               = 1 << 1,               /// advise transparent huge pages for slabs
+    ASYNC_FILE_BUFFER_MLOCK             = 1 << 2,               /// lock slabs in memory
+
+} async_file_buffer_flag_t;
+
+/// Called on the accessor's capacity thread, never a completion thread, once requests fit again
+/// after a non-blocking put was refused with RET_WOULD_BLOCK for the in-flight limits. It should put
+/// in non-blocking mode, a put waiting there holds back later callbacks
+typedef void (*async_file_capacity_func)(void *arg);
+
+/// Async file accessor creation config, zero fields take backend defaults
+typedef struct __async_file_accessor_config
+{
+    u32                                 minThreads;             /// MMAP: workers kept alive while idle
+    u32                                 maxThreads;             /// MMAP: workers the pool may grow to under load
+    u32                                 idleTimeoutMs;          /// MMAP: idle time before a worker above min exits
+    u32                                 bufferFlags;            /// ASYNC_FILE_BUFFER_* flags of shared buffer pool
+    u64                                 stripeThreshold;        /// requests larger than this run as parallel chunks
+    u32                                 stripeChunks;           /// chunk count of a striped request
+    u64                                 mergeWindow;            /// max span of one merged I/O, see ASYNC_FILE_MERGE_OFF
+    u32                                 mergeGap;               /// batched reads this close still merge, hole is dropped
+    u64                                 cacheBytes;             /// block cache budget for repeated reads, 0 disables it
+    u64                                 readaheadMax;           /// max prefetch ahead of a read stream, see ASYNC_FILE_READAHEAD_OFF
+    u32                                 commitWindowUs;         /// durable writes finishing this close share one flush
+    u32                                 maxInflight;            /// requests put and not finished yet at most, 0 is unlimited
+    u64                                 maxInflightBytes;       /// data bytes of those requests at most, 0 is unlimited
+    bool                                isPutNonBlocking;       /// put over a limit returns RET_WOULD_BLOCK instead of waiting
+    async_file_capacity_func            capacityCallback;       /// optional, room freed after a put was refused
+    void                               *capacityArg;            /// capacityCallback argument
+    bool                                isAdaptiveDepth;        /// in-flight depth follows latency, maxInflight bounds it
+
+} async_file_accessor_config_t;
+
+/// Block cache counters, see getCacheStats
+typedef struct __async_file_cache_stats
+{
+    u64                                 hits;                   /// reads served from cache without I/O
+    u64                                 misses;                 /// cacheable reads that went to the backend
+    u64                                 fills;                  /// blocks cached or extended
+    u64                                 evictions;              /// blocks dropped for room
+    u64                                 invalidations;          /// blocks dropped by writes
+    u64                                 capacity;               /// bytes the cache may hold, budget rounded to blocks
+    u64                                 used;                   /// bytes held by cached blocks
+
+} async_file_cache_stats_t;
+
+/// Per priority class latency counters, see getPrioStats
+typedef struct __async_file_prio_stats
+{
+    u64                                 completed;              /// requests of the class finished
+    u64                                 totalNs;                /// summed latency from put to completion
+    u64                                 maxNs;                  /// worst latency from put to completion
+
+} async_file_prio_stats_t;
+
+/// Adaptive depth controller state, see getDepthStats
+typedef struct __async_file_depth_stats
+{
+    bool                                isAdaptive;             /// controller is on, depth fields are 0 otherwise
+    u32                                 depth;                  /// requests allowed in flight now
+    u32                                 minDepth;               /// lower bound of depth
+    u32                                 maxDepth;               /// upper bound of depth
+    u32                                 inflight;               /// requests in flight now
+    u64                                 epochs;                 /// epochs decided so far
+    u64                                 increases;              /// epochs that raised depth
+    u64                                 decreases;              /// epochs that cut depth
+    u64                                 holds;                  /// epochs that kept depth
+    u64                                 lastChangeEpoch;        /// epoch depth last moved in, converged since
+    async_file_depth_decision_t         lastDecision;           /// decision of last epoch
+    u64                                 throughput;             /// bytes per second of last epoch
+    u64                                 tailNs;                 /// 95th percentile latency of last epoch
+    u64                                 baselineNs;             /// lowest recent tail, inflation is measured on it
+
+} async_file_depth_stats_t;
+
+/// Latency distribution of a stage, percentiles are histogram bucket bounds within 1/8 of real value
+typedef struct __async_file_latency_stats
+{
+    u64                                 count;                  /// requests timed
+    u64                                 meanNs;                 /// average latency
+    u64                                 p50Ns;                  /// median latency
+    u64                                 p99Ns;                  /// 99th percentile latency
+    u64                                 p999Ns;                 /// 99.9th percentile latency
+    u64                                 maxNs;                  /// worst latency
+
+} async_file_latency_stats_t;
+
+/// Counters and latencies of one direction, see getStats
+typedef struct __async_file_direction_stats
+{
+    u64                                 ops;                    /// requests finished
+    u64                                 errors;                 /// requests failed or canceled
+    u64                                 bytes;                  /// data bytes of successful requests
+    u64                                 bytesPerSec;            /// bytes over the time since reset
+    async_file_latency_stats_t          stages[ASYNC_FILE_STAGE_MAX];
+                                                                /// latency per stage
+
+} async_file_direction_stats_t;
+
+/// Accessor I/O statistics since creation or last resetStats
+typedef struct __async_file_stats
+{
+    u64                                 elapsedNs;              /// time covered by counters
+    async_file_direction_stats_t        directions[ASYNC_FILE_ACCESS_MAX];
+                                                                /// read and write counters
+
+} async_file_stats_t;
+
+#define REQUEST_HANDLE_NONE             0                       /// handle of a released request
+#define ASYNC_FILE_HANDLE_NONE          0                       /// request opens info.fn by itself
+#define ASYNC_FILE_MERGE_OFF            1                       /// mergeWindow that keeps every request apart
+#define ASYNC_FILE_READAHEAD_OFF        1                       /// readaheadMax that turns stream prefetch off
+
 /// Async file accessor request struct
 typedef struct __async_file_access_request
 {
     async_file_access_request_info_t    info;                   /// request info
+    u32                                 handle;                 /// slot index and generation, see lookupRequest
 
 } async_file_access_request_t;
 
@@ -83,9 +264,20 @@ typedef ret_t (*async_file_access_import_read_buffer_func)(async_file_accessor_t
                                                            async_file_access_request_t* pRequest,
                                                            void* buf);
 
+/// Scatter read into / gather write from iovcnt caller buffers, their lengths must sum up to info.size.
+/// Segments are copied, buffers must stay valid until the request finishes
+typedef ret_t (*async_file_access_import_iovec_func)(async_file_accessor_t* thiz,
+                                                     async_file_access_request_t* pRequest,
+                                                     const struct iovec* iov,
+                                                     u32 iovcnt);
+
 typedef ret_t (*async_file_access_put_request_func)(async_file_accessor_t* thiz,
                                                     async_file_access_request_t* pRequest);
 
+typedef ret_t (*async_file_access_put_requests_func)(async_file_accessor_t* thiz,
+                                                     async_file_access_request_t** pRequests,
+                                                     u32 count);
+
 typedef ret_t (*async_file_access_wait_request_func)(async_file_accessor_t* thiz,
                                                      async_file_access_request_t* pRequest,
                                                      u32 timeout_ms);
@@ -99,6 +291,68 @@ typedef ret_t (*async_file_access_cancel_all_requests_func)(async_file_accessor_
 
 typedef ret_t (*async_file_access_release_all_requests_func)(async_file_accessor_t* thiz);
 
+/// Read request in place: no copy into a caller buffer, data is leased from a read-only mapping
+typedef ret_t (*async_file_access_lease_read_buffer_func)(async_file_accessor_t* thiz,
+                                                          async_file_access_request_t* pRequest,
+                                                          bool isPopulate);
+
+/// Get read-only data of a finished leased request, valid until releaseReadLease
+typedef ret_t (*async_file_access_get_read_lease_func)(async_file_accessor_t* thiz,
+                                                       async_file_access_request_t* pRequest,
+                                                       const void** buf);
+
+typedef ret_t (*async_file_access_release_read_lease_func)(async_file_accessor_t* thiz,
+                                                           async_file_access_request_t* pRequest);
+
+/// Return a finished or never put request to the accessor pool, its handle and pointer go stale
+typedef ret_t (*async_file_access_release_request_func)(async_file_accessor_t* thiz,
+                                                        async_file_access_request_t* pRequest);
+
+/// Resolve a request handle, RET_NAME_NOT_FOUND if the request was released since
+typedef ret_t (*async_file_access_lookup_request_func)(async_file_accessor_t* thiz,
+                                                       u32 handle,
+                                                       async_file_access_request_t** pRequest);
+
+/// Open and stat a file once, requests carrying the handle share its descriptor
+typedef ret_t (*async_file_access_open_file_func)(async_file_accessor_t* thiz,
+                                                  const char8* fn,
+                                                  async_file_access_direction_t direction,
+                                                  u32* pFileHandle);
+
+/// Unregister a file, descriptor closes once requests still using it are released
+typedef ret_t (*async_file_access_close_file_func)(async_file_accessor_t* thiz,
+                                                   u32 fileHandle);
+
+/// Reap up to max finished requests, ones already waited or released are skipped;
+/// timeout_ms < 0 blocks, 0 polls. Return count or error
+typedef ret_t (*async_file_access_reap_completions_func)(async_file_accessor_t* thiz,
+                                                         async_file_access_request_t** pRequests,
+                                                         u32 max,
+                                                         s32 timeout_ms);
+
+/// Eventfd readable while finished requests are waiting to be reaped
+typedef s32 (*async_file_access_get_event_fd_func)(async_file_accessor_t* thiz);
+
+/// Snapshot of block cache counters, all zero while cache is off
+typedef ret_t (*async_file_access_get_cache_stats_func)(async_file_accessor_t* thiz,
+                                                        async_file_cache_stats_t* pStats);
+
+/// Snapshot of latency counters of a priority class
+typedef ret_t (*async_file_access_get_prio_stats_func)(async_file_accessor_t* thiz,
+                                                       async_file_priority_t priority,
+                                                       async_file_prio_stats_t* pStats);
+
+/// Snapshot of adaptive depth controller state and decisions
+typedef ret_t (*async_file_access_get_depth_stats_func)(async_file_accessor_t* thiz,
+                                                        async_file_depth_stats_t* pStats);
+
+/// Snapshot of per direction op, byte and latency counters since last reset
+typedef ret_t (*async_file_access_get_stats_func)(async_file_accessor_t* thiz,
+                                                  async_file_stats_t* pStats);
+
+/// Start counters over, requests in flight are counted when they finish
+typedef ret_t (*async_file_access_reset_stats_func)(async_file_accessor_t* thiz);
+
 struct __async_file_accessor
 {
     async_file_accessor_type_t                      type;
@@ -107,16 +361,60 @@ struct __async_file_accessor
     async_file_access_alloc_write_buffer_func       allocWriteBuf;
     async_file_access_import_read_buffer_func       importReadBuf;
     async_file_access_put_request_func              putRequest;
+    async_file_access_put_requests_func             putRequests;
     async_file_access_wait_request_func             waitRequest;
     async_file_access_cancel_request_func           cancelRequest;
     async_file_access_wait_all_request_func         waitAll;
     async_file_access_cancel_all_requests_func      cancelAll;
     async_file_access_release_all_requests_func     releaseAll;
+    async_file_access_reap_completions_func         reapCompletions;
+    async_file_access_get_event_fd_func             getEventFd;
+    async_file_access_lease_read_buffer_func        leaseReadBuf;
+    async_file_access_get_read_lease_func           getReadLease;
+    async_file_access_release_read_lease_func       releaseReadLease;
+    async_file_access_release_request_func          releaseRequest;
+    async_file_access_lookup_request_func           lookupRequest;
+    async_file_access_open_file_func                openFile;
+    async_file_access_close_file_func               closeFile;
+    async_file_access_import_iovec_func             importIovec;
+    async_file_access_get_cache_stats_func          getCacheStats;
+    async_file_access_get_prio_stats_func           getPrioStats;
+    async_file_access_get_depth_stats_func          getDepthStats;
+    async_file_access_get_stats_func                getStats;
+    async_file_access_reset_stats_func              resetStats;
 };
 
 
 async_file_accessor_t* Async_File_Accessor_Get_Instance(async_file_accessor_type_t type);
 
+/// Same as Async_File_Accessor_Get_Instance, pConfig applies when the instance is (re)created.
+/// Stripe, merge, readahead, cache, commit and in-flight settings apply on every call with a config
+async_file_accessor_t* Async_File_Accessor_Get_Instance_Ex(async_file_accessor_type_t          type,
+                                                           const async_file_accessor_config_t *pConfig);
+
+/// Get a 4 KiB aligned buffer from the shared I/O buffer pool, NULL on failure
+void* Async_File_Buffer_Alloc(u64 size);
+
+/// Return a buffer from Async_File_Buffer_Alloc, size must match
+void Async_File_Buffer_Free(void *buf, u64 size);
+
+/// Drop earlier trace events and record request lifecycles of all accessors. Each thread logs into
+/// its own ring of eventsPerThread events, 0 takes the default, and overwrites its oldest events
+ret_t Async_File_Trace_Start(u32 eventsPerThread);
+
+/// Stop recording trace events, recorded ones are kept
+void Async_File_Trace_Stop();
+
+/// Write recorded trace events to path as Chrome trace_event JSON, for chrome://tracing or Perfetto
+ret_t Async_File_Trace_Dump(const char8 *path);
+
+/// Publish live counters of all accessors into POSIX shared memory segment name for async_file_top,
+/// NULL names it "/async_file_accessor.<pid>". Counters refresh every intervalMs, 0 takes the default
+ret_t Async_File_Live_Stats_Start(const char8 *name, u32 intervalMs);
+
+/// Stop publishing live counters and remove the segment
+void Async_File_Live_Stats_Stop();
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
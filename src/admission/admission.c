@@ -0,0 +1,228 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : admission.c
+ * Description  : Bound requests and data bytes an accessor has in flight, puts over
+                  the limits wait or are refused until completions free room.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "admission.h"
+
+/// Whether any limit is set, unlimited accessors only count
+static bool admission_is_limited(admission_t *pAdmission)
+{
+    return 0 != __atomic_load_n(&(pAdmission->maxRequests), __ATOMIC_RELAXED) ||
+           0 != __atomic_load_n(&(pAdmission->maxBytes), __ATOMIC_RELAXED);
+}
+
+/// Whether count requests of bytes data fit now, an idle accessor takes anything
+static bool admission_has_room(admission_t *pAdmission, u32 count, u64 bytes)
+{
+    u32 requests    = __atomic_load_n(&(pAdmission->requests), __ATOMIC_SEQ_CST);
+    u64 inflight    = __atomic_load_n(&(pAdmission->bytes), __ATOMIC_SEQ_CST);
+    u32 maxRequests = __atomic_load_n(&(pAdmission->maxRequests), __ATOMIC_RELAXED);
+
+    return 0 == requests ||
+           ((0 == maxRequests || requests + count <= maxRequests) &&
+            (0 == pAdmission->maxBytes || inflight + bytes <= pAdmission->maxBytes));
+}
+
+/// Capacity thread function. Callback runs off completion threads, a put it makes may wait on
+/// ring room or workers that only those threads free
+static void *admission_callback_thread(void *arg)
+{
+    admission_t *pAdmission = (admission_t *)arg;
+
+    pthread_mutex_lock(&(pAdmission->lock));
+    while (true)
+    {
+        async_file_capacity_func    callback    = NULL;
+        void                       *cbArg       = NULL;
+
+        while (!pAdmission->isCallbackPending)
+        {
+            pthread_cond_wait(&(pAdmission->callbackReady), &(pAdmission->lock));
+        }
+
+        pAdmission->isCallbackPending   = FALSE;
+        callback                        = pAdmission->callback;
+        cbArg                           = pAdmission->arg;
+        pthread_mutex_unlock(&(pAdmission->lock));
+
+        if (NULL != callback)
+        {
+            callback(cbArg);
+        }
+
+        pthread_mutex_lock(&(pAdmission->lock));
+    }
+    pthread_mutex_unlock(&(pAdmission->lock));
+
+    pthread_exit(NULL);
+}
+
+/// Initialize unlimited admission once
+void admission_init(admission_t *pAdmission)
+{
+    if (!pAdmission->isInitialized)
+    {
+        memset(pAdmission, 0, sizeof(admission_t));
+        pthread_mutex_init(&(pAdmission->lock), NULL);
+        pthread_cond_init(&(pAdmission->freed), NULL);
+        pthread_cond_init(&(pAdmission->callbackReady), NULL);
+        depth_control_init(&(pAdmission->control));
+        pAdmission->isInitialized = TRUE;
+    }
+}
+
+/// Take limits, mode, callback and adaptive depth from accessor config, NULL config lifts the limits.
+/// Requests already in flight keep counting against the new limits
+void admission_config_init(admission_t *pAdmission, const async_file_accessor_config_t *pConfig)
+{
+    /// Adaptive depth replaces maxInflight as request limit, maxInflight only bounds it then
+    u32 depth = depth_control_config_init(&(pAdmission->control), pConfig);
+
+    pthread_mutex_lock(&(pAdmission->lock));
+    __atomic_store_n(&(pAdmission->maxRequests), (depth > 0) ? depth : (NULL != pConfig) ? pConfig->maxInflight : 0,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&(pAdmission->maxBytes), (NULL != pConfig) ? pConfig->maxInflightBytes : 0, __ATOMIC_RELAXED);
+    pAdmission->isNonBlocking   = (NULL != pConfig) && pConfig->isPutNonBlocking;
+    pAdmission->callback        = (NULL != pConfig) ? pConfig->capacityCallback : NULL;
+    pAdmission->arg             = (NULL != pConfig) ? pConfig->capacityArg : NULL;
+
+    /// Raised limits may let sleeping puts go
+    pthread_cond_broadcast(&(pAdmission->freed));
+    pthread_mutex_unlock(&(pAdmission->lock));
+}
+
+/// Admit count requests of bytes data as a whole. Waits for room, or returns RET_WOULD_BLOCK in
+/// non-blocking mode. A batch over the limits by itself is admitted once nothing else is in flight
+ret_t admission_acquire(admission_t *pAdmission, u32 count, u64 bytes)
+{
+    ret_t res = RET_OK;
+
+    if (admission_is_limited(pAdmission))
+    {
+        pthread_mutex_lock(&(pAdmission->lock));
+        while (RET_OK == res && !admission_has_room(pAdmission, count, bytes))
+        {
+            if (pAdmission->isNonBlocking)
+            {
+                /// Flag before the last look, pairs with the counter drop in admission_release so
+                /// a refused put is never left without its callback. A put admitted by that look
+                /// takes back a flag it raised, one raised by an earlier refusal stays
+                bool wasHeldBack = __atomic_exchange_n(&(pAdmission->isHeldBack), TRUE, __ATOMIC_SEQ_CST);
+
+                res = admission_has_room(pAdmission, count, bytes) ? RET_OK : RET_WOULD_BLOCK;
+                if (RET_OK == res && !wasHeldBack)
+                {
+                    __atomic_store_n(&(pAdmission->isHeldBack), FALSE, __ATOMIC_SEQ_CST);
+                }
+                break;
+            }
+
+            /// Register before the last look, pairs with the counter drop in admission_release
+            __atomic_add_fetch(&(pAdmission->waiters), 1, __ATOMIC_SEQ_CST);
+            if (!admission_has_room(pAdmission, count, bytes))
+            {
+                pthread_cond_wait(&(pAdmission->freed), &(pAdmission->lock));
+            }
+            __atomic_sub_fetch(&(pAdmission->waiters), 1, __ATOMIC_SEQ_CST);
+        }
+
+        if (RET_OK == res)
+        {
+            __atomic_add_fetch(&(pAdmission->requests), count, __ATOMIC_SEQ_CST);
+            __atomic_add_fetch(&(pAdmission->bytes), bytes, __ATOMIC_SEQ_CST);
+        }
+        pthread_mutex_unlock(&(pAdmission->lock));
+    }
+    else
+    {
+        __atomic_add_fetch(&(pAdmission->requests), count, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&(pAdmission->bytes), bytes, __ATOMIC_SEQ_CST);
+    }
+
+    return res;
+}
+
+/// Return room of finished requests, wakes waiting puts and may hand callback to the capacity thread.
+/// A single request admitted at admitNs feeds the depth controller, 0 for requests that never went out
+void admission_release(admission_t *pAdmission, u32 count, u64 bytes, u64 admitNs)
+{
+    /// Latency counts from admission, time a put waited for room is the controller's own doing
+    if (1 == count && 0 != admitNs)
+    {
+        struct timespec ts;
+        u64             now     = 0;
+        u32             depth   = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now     = ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+        depth   = depth_control_sample(&(pAdmission->control), (now > admitNs) ? now - admitNs : 0, bytes);
+
+        /// A raised depth lets sleeping puts go through the broadcast below
+        if (depth > 0)
+        {
+            __atomic_store_n(&(pAdmission->maxRequests), depth, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_sub_fetch(&(pAdmission->requests), count, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&(pAdmission->bytes), bytes, __ATOMIC_SEQ_CST);
+
+    /// Lock is only taken while someone waits for room or should hear about it
+    if (__atomic_load_n(&(pAdmission->waiters), __ATOMIC_SEQ_CST) > 0 ||
+        __atomic_load_n(&(pAdmission->isHeldBack), __ATOMIC_SEQ_CST))
+    {
+        async_file_capacity_func    callback    = NULL;
+        void                       *arg         = NULL;
+
+        pthread_mutex_lock(&(pAdmission->lock));
+        pthread_cond_broadcast(&(pAdmission->freed));
+
+        /// Callback fires once per hold back, when at least one more request fits
+        if (pAdmission->isHeldBack && admission_has_room(pAdmission, 1, 0))
+        {
+            __atomic_store_n(&(pAdmission->isHeldBack), FALSE, __ATOMIC_RELAXED);
+            callback    = pAdmission->callback;
+            arg         = pAdmission->arg;
+        }
+
+        /// Capacity thread is started lazily, accessors without a callback do not pay for it
+        if (NULL != callback && !pAdmission->isStarted)
+        {
+            s32 res = pthread_create(&(pAdmission->thread), NULL, admission_callback_thread, pAdmission);
+
+            pAdmission->isStarted = (0 == res);
+            if (!pAdmission->isStarted)
+            {
+                printf("Error: capacity thread create fail, calling back in place! error: %d - %s.\n",
+                       res, strerror(res));
+            }
+        }
+
+        if (NULL != callback && pAdmission->isStarted)
+        {
+            pAdmission->isCallbackPending = TRUE;
+            pthread_cond_signal(&(pAdmission->callbackReady));
+            callback = NULL;
+        }
+        pthread_mutex_unlock(&(pAdmission->lock));
+
+        if (NULL != callback)
+        {
+            callback(arg);
+        }
+    }
+}
+
+/// Snapshot of depth controller state and current in-flight count
+void admission_get_depth_stats(admission_t *pAdmission, async_file_depth_stats_t *pStats)
+{
+    depth_control_get_stats(&(pAdmission->control), pStats);
+    pStats->inflight = __atomic_load_n(&(pAdmission->requests), __ATOMIC_RELAXED);
+}
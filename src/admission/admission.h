@@ -0,0 +1,71 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : admission.h
+ * Description  : Bound requests and data bytes an accessor has in flight, puts over
+                  the limits wait or are refused until completions free room.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __ADMISSION_H__
+#define __ADMISSION_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+#include "depth_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// struct define per accessor in-flight limits and counters
+typedef struct __admission
+{
+    u32                             maxRequests;            /// requests in flight at most, 0 is unlimited
+    u64                             maxBytes;               /// data bytes in flight at most, 0 is unlimited
+    bool                            isNonBlocking;          /// refuse a put over the limits instead of waiting
+    async_file_capacity_func        callback;               /// room freed after a put was held back, optional
+    void                           *arg;                    /// callback argument
+    u32                             requests __attribute__((aligned(64)));
+                                                            /// requests admitted and not finished
+    u64                             bytes;                  /// data bytes of those requests
+    u32                             waiters;                /// puts sleeping for room
+    bool                            isHeldBack;             /// a put was refused since last callback
+    pthread_mutex_t                 lock;                   /// sleep lock, only taken when limits are set
+    pthread_cond_t                  freed;                  /// completions freed room
+    pthread_cond_t                  callbackReady;          /// callback is due on capacity thread
+    pthread_t                       thread;                 /// capacity thread, started by first callback
+    bool                            isCallbackPending;      /// callback is due and has not run yet
+    bool                            isStarted;              /// whether capacity thread runs
+    depth_control_t                 control;                /// moves maxRequests when depth is adaptive
+    bool                            isInitialized;          /// whether lock is set up
+
+} admission_t;
+
+
+/// Initialize unlimited admission once
+void admission_init(admission_t *pAdmission);
+
+/// Take limits, mode, callback and adaptive depth from accessor config, NULL config lifts the limits.
+/// Requests already in flight keep counting against the new limits
+void admission_config_init(admission_t *pAdmission, const async_file_accessor_config_t *pConfig);
+
+/// Admit count requests of bytes data as a whole. Waits for room, or returns RET_WOULD_BLOCK in
+/// non-blocking mode. A batch over the limits by itself is admitted once nothing else is in flight
+ret_t admission_acquire(admission_t *pAdmission, u32 count, u64 bytes);
+
+/// Return room of finished requests, wakes waiting puts and may hand callback to the capacity thread.
+/// A single request admitted at admitNs feeds the depth controller, 0 for requests that never went out
+void admission_release(admission_t *pAdmission, u32 count, u64 bytes, u64 admitNs);
+
+/// Snapshot of depth controller state and current in-flight count
+void admission_get_depth_stats(admission_t *pAdmission, async_file_depth_stats_t *pStats);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __ADMISSION_H__ */
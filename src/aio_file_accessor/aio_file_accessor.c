@@ -8,47 +8,328 @@
  * All rights reserved.
  ***************************************************************************************/
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "aio_file_accessor.h"
 #include "async_file_accessor.h"
 
-// Called when AIO operation is done, check result and free control block
-static void aio_callback(sigval_t sv)
+/// Raw kernel native aio syscalls
+static s32 sys_io_setup(u32 nr_events, aio_context_t *ctx)
+{
+    return (s32)syscall(__NR_io_setup, nr_events, ctx);
+}
+
+static s32 sys_io_submit(aio_context_t ctx, long nr, struct iocb **iocbpp)
+{
+    return (s32)syscall(__NR_io_submit, ctx, nr, iocbpp);
+}
+
+static s32 sys_io_getevents(aio_context_t ctx, long min_nr, long nr, struct io_event *events)
+{
+    return (s32)syscall(__NR_io_getevents, ctx, min_nr, nr, events, NULL);
+}
+
+static s32 sys_io_cancel(aio_context_t ctx, struct iocb *iocb, struct io_event *result)
+{
+    return (s32)syscall(__NR_io_cancel, ctx, iocb, result);
+}
+
+/// Close request fd, chunks only borrow the fd of their striped request
+static void aio_request_close_fd(aio_request_t *pRequest)
+{
+    if (pRequest->fd > 0 && NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
+    {
+        file_registry_close_fd(&(pRequest->pAccessor->files), pRequest->parent.info.fileHandle, pRequest->fd);
+    }
+    pRequest->fd            = -1;
+    pRequest->cb.aio_fildes = -1;
+}
+
+/// Write drops cached blocks it overlapped, even a failed one may have changed them; read caches what it got
+static void aio_cache_complete(aio_request_t *pRequest, s64 result)
+{
+    block_cache_t *pCache = &(pRequest->pAccessor->cache);
+
+    if (ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction)
+    {
+        block_cache_invalidate(pCache, &(pRequest->fsb), pRequest->parent.info.offset, pRequest->parent.info.size);
+    }
+    else if (result > 0 && REQUEST_STAT_IOSUCCESS == pRequest->status)
+    {
+        block_cache_fill(pCache, &(pRequest->fsb), pRequest->parent.info.offset, (u64)result,
+                         pRequest->buf, pRequest->cacheEpoch);
+    }
+}
+
+static void aio_request_finish(aio_request_t *pRequest, s64 result);
+
+/// Update status of a request whose I/O and flush are done, release buffer and fd.
+/// A chunk reports to its striped request instead, the last one finishes it.
+/// A merged request finishes each member with its part of the result
+static void aio_request_settle(aio_request_t *pRequest, s64 result)
 {
-    aio_request_t* pRequest = (aio_request_t *)sv.sival_ptr;
+    aio_request_t                  *pParent     = (aio_request_t *)pRequest->stripe.pParent;
+    async_file_access_request_t   **ppMembers   = pRequest->merge.ppMembers;
+    u32                             memberCount = pRequest->merge.count;
+    u64                             size        = pRequest->parent.info.size;
+    admission_t                    *pAdmission  = NULL;
+    u64                             admitNs     = 0;
+    u64                             offset      = pRequest->cb.aio_offset;
+    io_stats_t                     *pIoStats    = &(pRequest->pAccessor->ioStats);
+
     pthread_mutex_lock(&(pRequest->lock));
 
-    if (aio_error(&pRequest->cb) == 0)
+    pRequest->result        = result;
+    pRequest->isInflight    = FALSE;
+
+    if (REQUEST_STAT_CANCEL != pRequest->status)
     {
-        pRequest->status = REQUEST_STAT_IOSUCCESS;
+        pRequest->status    = (result >= 0) ? REQUEST_STAT_IOSUCCESS
+                            : (-ECANCELED == result) ? REQUEST_STAT_CANCEL : REQUEST_STAT_IOFAIL;
         // printf("Request to file '%s' done. req_addr = %p, buf_addr = %p\n",
         //        pRequest->parent.info.fn, pRequest, pRequest->buf);
     }
-    else
+
+    if (result < 0 && -ECANCELED != result && 0 == pRequest->stripe.count && 0 == memberCount)
     {
-        printf("Error: async IO operation fail! error: %d - %s.\n", errno, strerror(errno));
+        printf("Error: async IO operation fail! error: %d - %s.\n", (s32)-result, strerror((s32)-result));
     }
 
     if (TRUE == pRequest->isAlloced && pRequest->buf != NULL)
     {
-        free((void*)pRequest->cb.aio_buf);
+        buffer_pool_free(Buffer_Pool_Get_Instance(), pRequest->buf, pRequest->cb.aio_nbytes);
         pRequest->buf           = NULL;
         pRequest->cb.aio_buf    = NULL;
     }
 
-    if (pRequest->fd > 0)
+    if (NULL == pParent && 0 == memberCount)
     {
-        close(pRequest->fd);
-        pRequest->fd = -1;
+        aio_cache_complete(pRequest, result);
     }
-    
-    if (pRequest->cb.aio_fildes > 0)
+
+    if (result >= 0 && NULL == pParent && 0 == memberCount && !pRequest->isDirect)
+    {
+        readahead_release(pRequest->fd, pRequest->parent.info.offset, pRequest->parent.info.size,
+                          pRequest->parent.info.hint);
+    }
+    aio_request_close_fd(pRequest);
+
+    /// Posix mode read the merged range into one bounce buffer, hand it out to the members
+    if (result > 0 && NULL != pRequest->merge.bounce && ASYNC_FILE_ACCESS_READ == pRequest->parent.info.direction)
     {
-        close(pRequest->cb.aio_fildes);
-        pRequest->cb.aio_fildes = -1;
+        io_vector_scatter(&(pRequest->iov), pRequest->merge.bounce);
     }
 
-    pthread_cond_signal(&(pRequest->isFinished));
+    if (NULL == pParent && 0 == memberCount)
+    {
+        prio_stats_record(&(pRequest->pAccessor->prioStats), pRequest->parent.info.priority, pRequest->putNs);
+        pRequest->doneNs        = io_stats_record(pIoStats, pRequest->parent.info.direction,
+                                                  REQUEST_STAT_IOSUCCESS == pRequest->status, (result > 0) ? result : 0,
+                                                  pRequest->getNs, pRequest->putNs, pRequest->startNs);
+        pRequest->getNs         = 0;
+        IO_TRACE(IO_TRACE_COMPLETE, pRequest->pAccessor->parent.type, pRequest->parent.handle);
+        pAdmission              = pRequest->isAdmitted ? &(pRequest->pAccessor->admission) : NULL;
+        admitNs                 = pRequest->admitNs;
+        pRequest->isAdmitted    = FALSE;
+        completion_queue_push(&(pRequest->pAccessor->completions), &(pRequest->parent));
+    }
+    pthread_cond_broadcast(&(pRequest->isFinished));
     pthread_mutex_unlock(&(pRequest->lock));
+
+    /// Room is returned once the request is done with, capacity callback may put again
+    if (NULL != pAdmission)
+    {
+        admission_release(pAdmission, 1, size, admitNs);
+    }
+
+    if (NULL != pParent && stripe_group_chunk_done(&(pParent->stripe), result))
+    {
+        aio_request_finish(pParent, stripe_group_result(&(pParent->stripe)));
+    }
+
+    /// Merged request is not touched again, the last member released returns it to pool
+    for (u32 i = 0; i < memberCount; i++)
+    {
+        aio_request_t *pMember = (aio_request_t *)ppMembers[i];
+
+        aio_request_finish(pMember, io_sched_share(result, offset, pMember->cb.aio_offset, pMember->cb.aio_nbytes));
+    }
+}
+
+/// Group commit callback, durable write is on stable storage or its flush failed
+static void aio_request_committed(void *arg, s64 result)
+{
+    aio_request_settle((aio_request_t *)arg, result);
+}
+
+/// Called when AIO operation is done. A durable write joins the group commit of its file
+/// and settles from the flush thread once the group is flushed
+static void aio_request_finish(aio_request_t *pRequest, s64 result)
+{
+    if (result >= 0 && group_commit_is_durable(&(pRequest->parent.info)) && REQUEST_STAT_CANCEL != pRequest->status &&
+        NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
+    {
+        /// Traced before the call, a write that cannot be queued is flushed in place and completes right away
+        IO_TRACE(IO_TRACE_COMMIT, pRequest->pAccessor->parent.type, pRequest->parent.handle);
+        group_commit_join(&(pRequest->pAccessor->commits), &(pRequest->commit), pRequest->fd, &(pRequest->fsb),
+                          pRequest->parent.info.offset, pRequest->parent.info.size, &(pRequest->parent.info),
+                          aio_request_committed, pRequest, result);
+    }
+    else
+    {
+        aio_request_settle(pRequest, result);
+    }
+}
+
+// Called when posix AIO operation is done, check result and free control block
+static void aio_callback(sigval_t sv)
+{
+    aio_request_t  *pRequest    = (aio_request_t *)sv.sival_ptr;
+    s32             error       = aio_error(&pRequest->cb);
+
+    aio_request_finish(pRequest, (0 == error) ? (s64)aio_return(&pRequest->cb) : -(s64)error);
+}
+
+/// Native aio reaper thread funtion, drain kernel completion events
+static void *aio_native_reaper_thread(void *arg)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)arg;
+    struct io_event      events[AIO_NATIVE_REAP_BATCH];
+
+    while (true)
+    {
+        s32 count = sys_io_getevents(pAioAccessor->ctx, 1, AIO_NATIVE_REAP_BATCH, events);
+
+        if (count < 0)
+        {
+            if (errno != EINTR)
+            {
+                printf("Error: native aio wait fail! error: %d - %s.\n", errno, strerror(errno));
+            }
+            continue;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            aio_request_finish((aio_request_t *)(uintptr_t)events[i].data, events[i].res);
+        }
+
+        pthread_mutex_lock(&(pAioAccessor->lock));
+        pAioAccessor->inflight -= count;
+        pthread_cond_broadcast(&(pAioAccessor->not_full));
+        pthread_mutex_unlock(&(pAioAccessor->lock));
+    }
+
+    pthread_exit(NULL);
+}
+
+/// Switch request fd to O_DIRECT if buffers, offset and size all meet the alignment
+static void aio_native_try_direct(aio_request_t *pRequest)
+{
+    u32     fileHandle  = pRequest->parent.info.fileHandle;
+    bool    isAligned   = (pRequest->iov.count > 0) ? io_vector_is_aligned(&(pRequest->iov), AIO_DIRECT_ALIGN)
+                                                    : (uintptr_t)pRequest->buf % AIO_DIRECT_ALIGN == 0;
+
+    if (isAligned &&
+        pRequest->cb.aio_offset     % AIO_DIRECT_ALIGN == 0 &&
+        pRequest->cb.aio_nbytes     % AIO_DIRECT_ALIGN == 0)
+    {
+        if (ASYNC_FILE_HANDLE_NONE != fileHandle)
+        {
+            /// Registered fd is shared, switch to the file's own O_DIRECT descriptor instead
+            s32 directFd = file_registry_direct_fd(&(pRequest->pAccessor->files), fileHandle);
+
+            pRequest->isDirect  = (directFd >= 0);
+            pRequest->fd        = (directFd >= 0) ? directFd : pRequest->fd;
+        }
+        else
+        {
+            s32 flags = fcntl(pRequest->fd, F_GETFL);
+
+            /// Filesystems without direct IO (e.g. tmpfs) reject it, request stays buffered then
+            if (flags >= 0)
+            {
+                pRequest->isDirect = (fcntl(pRequest->fd, F_SETFL, flags | O_DIRECT) == 0);
+            }
+        }
+    }
+}
+
+/// Submit requests to kernel native aio context
+static void aio_request_expire(void *arg);
+
+/// Arm request deadline before submission, the request itself stays tracked by its pool slot.
+/// Once submitted it may finish and be released and reused before put returns
+static ret_t aio_track_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
+{
+    if (pRequest->parent.info.deadline_ms > 0)
+    {
+        timer_service_arm(&(pAioAccessor->timers), &(pRequest->deadline),
+                          pRequest->parent.info.deadline_ms, aio_request_expire, pRequest);
+    }
+
+    return RET_OK;
+}
+
+/// Disarm deadline of a request aio never took, before it finishes and may be released.
+/// Chunks and merged I/O leave deadlines to the requests they serve
+static void aio_untrack_request(aio_request_t *pRequest)
+{
+    if (pRequest->parent.info.deadline_ms > 0 && NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
+    {
+        timer_service_cancel(&(pRequest->pAccessor->timers), &(pRequest->deadline));
+    }
+}
+
+static ret_t aio_native_submit(aio_file_accessor_t *pAioAccessor, aio_request_t **ppRequests, u32 count)
+{
+    ret_t           res         = RET_OK;
+    u32             submitted   = 0;
+    struct iocb    *iocbs[AIO_NATIVE_QUEUE_DEPTH];
+
+    pthread_mutex_lock(&(pAioAccessor->lock));
+
+    while (RET_OK == res && submitted < count)
+    {
+        u32 batch = count - submitted;
+        batch = (batch > AIO_NATIVE_QUEUE_DEPTH) ? AIO_NATIVE_QUEUE_DEPTH : batch;
+
+        while (pAioAccessor->inflight + batch > AIO_NATIVE_QUEUE_DEPTH)
+        {
+            pthread_cond_wait(&(pAioAccessor->not_full), &(pAioAccessor->lock));
+        }
+
+        for (u32 i = 0; i < batch; i++)
+        {
+            iocbs[i] = &(ppRequests[submitted + i]->iocb);
+        }
+
+        s32 done = sys_io_submit(pAioAccessor->ctx, batch, iocbs);
+
+        if (done < 0 && EAGAIN != errno && EINTR != errno)
+        {
+            res = -errno;
+            printf("Error: native aio submit fail! error: %d - %s.\n", errno, strerror(errno));
+        }
+        else if (done > 0)
+        {
+            pAioAccessor->inflight += done;
+            submitted += done;
+        }
+    }
+
+    pthread_mutex_unlock(&(pAioAccessor->lock));
+
+    /// Requests kernel never accepted will not complete through the reaper
+    for (u32 i = submitted; i < count; i++)
+    {
+        aio_untrack_request(ppRequests[i]);
+        aio_request_finish(ppRequests[i], res);
+    }
+
+    return res;
 }
 
 /// Ckeck whether aio request valid
@@ -62,57 +343,88 @@ static ret_t aio_check_request_valid(aio_request_t *pRequest)
         printf("Error: invalid request detected: empty request! res = %d.\n", res);
     }
 
+    else if (REQUEST_HANDLE_NONE == __atomic_load_n(&(pRequest->parent.handle), __ATOMIC_ACQUIRE))
+    {
+        res = RET_DEAD_OBJECT;
+        printf("Error: invalid request detected: request already released! res = %d.\n", res);
+    }
+
     else if (RET_OK == res && !pRequest->isValid)
     {
         async_file_access_request_info_t *pCreateInfo = &(pRequest->parent.info);
 
         if (NULL == pCreateInfo || pCreateInfo->size <= 0||
-            (pCreateInfo->direction < 0 || pCreateInfo->direction >= ASYNC_FILE_ACCESS_MAX))
+            (pCreateInfo->direction < 0 || pCreateInfo->direction >= ASYNC_FILE_ACCESS_MAX) ||
+            (pCreateInfo->hint < 0 || pCreateInfo->hint >= ASYNC_FILE_HINT_MAX) ||
+            (pCreateInfo->durability < 0 || pCreateInfo->durability >= ASYNC_FILE_DURABLE_MAX) ||
+            (pCreateInfo->priority < 0 || pCreateInfo->priority >= ASYNC_FILE_PRIO_MAX))
         {
             res = RET_BAD_VALUE;
             printf("Error: invalid request detected: invalid info! res = %d.\n", res);
         }
         else
         {
-            s32 fd = pCreateInfo->direction == ASYNC_FILE_ACCESS_READ
-                         ? open((char8 *)(pCreateInfo->fn), O_RDONLY, 0666)
-                         : open((char8 *)(pCreateInfo->fn), O_WRONLY | O_CREAT, 0666);
-            if (fd < 0)
-            {
-                res = RET_BAD_VALUE;
-                printf("Error: invalid request detected: file [%s] not exist! res = %d.\n",
-                       pCreateInfo->fn, res);
-            }
-            else
-            {
-                close(fd);
-                pRequest->isValid = TRUE;
-            }
+            /// File is checked when request takes its fd, from registry or by opening its path
+            pRequest->isValid = TRUE;
         }
     }
 
     return res;
 }
 
-/// Get aio request
+/// One-time aio request slot setup, locks live as long as the pool
+static void aio_request_slot_init(async_file_access_request_t *pAsyncRequest)
+{
+    aio_request_t *pRequest = (aio_request_t *)pAsyncRequest;
+
+    pRequest->fd = -1;
+    pthread_mutex_init(&(pRequest->lock), NULL);
+    pthread_cond_init(&(pRequest->isFinished), NULL);
+}
+
+/// Get aio request from accessor request pool
 static ret_t aio_get_request(async_file_accessor_t            *thiz,
                              async_file_access_request_t     **pAsyncRequest,
                              async_file_access_request_info_t *pCreateInfo)
 {
     aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
     aio_request_t      **pRequest       = (aio_request_t **)pAsyncRequest;
+    u64                  getNs          = prio_class_now_ns();
 
-    ret_t res = RET_OK;
-    *pRequest = (aio_request_t *)malloc(sizeof(aio_request_t));
-    memset(*pRequest, 0, sizeof(aio_request_t));
+    ret_t res = request_pool_acquire(&(pAioAccessor->requests), pAsyncRequest);
+    if (RET_OK != res)
+    {
+        *pRequest = NULL;
+        return res;
+    }
 
+    /// Slot is recycled, reset everything validation and submission read
+    (*pRequest)->fd                     = -1;
+    (*pRequest)->isValid                = FALSE;
+    memset(&((*pRequest)->cb), 0, sizeof(struct aiocb));
+    memset(&((*pRequest)->iocb), 0, sizeof(struct iocb));
+    memset(&((*pRequest)->stripe), 0, sizeof(stripe_group_t));
+    memset(&((*pRequest)->merge), 0, sizeof(io_merge_t));
+
+    (*pRequest)->pAccessor              = pAioAccessor;
     (*pRequest)->parent.info.direction  = pCreateInfo->direction;
     (*pRequest)->parent.info.size       = pCreateInfo->size;
     (*pRequest)->parent.info.offset     = pCreateInfo->offset;
+    (*pRequest)->parent.info.deadline_ms= pCreateInfo->deadline_ms;
+    (*pRequest)->parent.info.fileHandle = pCreateInfo->fileHandle;
+    (*pRequest)->parent.info.hint       = pCreateInfo->hint;
+    (*pRequest)->parent.info.durability = pCreateInfo->durability;
+    (*pRequest)->parent.info.isBarrier  = pCreateInfo->isBarrier;
+    (*pRequest)->parent.info.priority   = pCreateInfo->priority;
     memcpy((*pRequest)->parent.info.fn, pCreateInfo->fn, MAX_FILE_NAME_LEN);
     res = aio_check_request_valid(*pRequest);
 
-    if (RET_OK == res)
+    if (RET_OK == res && ASYNC_FILE_HANDLE_NONE != pCreateInfo->fileHandle)
+    {
+        res = file_registry_get(&(pAioAccessor->files), pCreateInfo->fileHandle, pCreateInfo->direction,
+                                &((*pRequest)->fd), &((*pRequest)->fsb));
+    }
+    else if (RET_OK == res)
     {
         (*pRequest)->fd = pCreateInfo->direction == ASYNC_FILE_ACCESS_READ
                               ? open((char8 *)(pCreateInfo->fn), O_RDONLY, 0666)
@@ -126,16 +438,38 @@ static ret_t aio_get_request(async_file_accessor_t            *thiz,
                               : open((char8 *)(pCreateInfo->fn), O_WRONLY | O_CREAT, 0666);
         }
 
+        if ((*pRequest)->fd >= 0)
+        {
+            fstat((*pRequest)->fd, &(*pRequest)->fsb);
+        }
+        else
+        {
+            res = RET_BAD_VALUE;
+            printf("Error: file [%s] open fail! error: %d - %s.\n",
+                   (*pRequest)->parent.info.fn, errno, strerror(errno));
+        }
+    }
+
+    if (RET_OK == res)
+    {
         (*pRequest)->buf            = NULL;
+        (*pRequest)->result         = 0;
         (*pRequest)->isAlloced      = FALSE;
+        (*pRequest)->isInflight     = FALSE;
+        (*pRequest)->isDirect       = FALSE;
+        (*pRequest)->cacheEpoch     = BLOCK_CACHE_NO_FILL;
         (*pRequest)->status         = REQUEST_STAT_INIT;
         (*pRequest)->cb.aio_buf     = NULL;
         (*pRequest)->cb.aio_fildes  = (*pRequest)->fd;
         (*pRequest)->cb.aio_nbytes  = pCreateInfo->size;
-        (*pRequest)->cb.aio_offset  = lseek((*pRequest)->fd, pCreateInfo->offset, SEEK_CUR);
-        fstat((*pRequest)->fd, &(*pRequest)->fsb);
-        pthread_mutex_init(&((*pRequest)->lock), NULL);
-        pthread_cond_init(&((*pRequest)->isFinished), NULL);
+        (*pRequest)->cb.aio_offset  = pCreateInfo->offset;
+        (*pRequest)->getNs          = getNs;
+        IO_TRACE(IO_TRACE_GET, thiz->type, (*pRequest)->parent.handle);
+    }
+    else
+    {
+        request_pool_release(&(pAioAccessor->requests), &((*pRequest)->parent));
+        *pRequest = NULL;
     }
 
     // printf("file = %s: req_addr = %p.\n", (*pRequest)->parent.info.fn, (*pRequest));
@@ -148,7 +482,6 @@ static ret_t aio_request_alloc_write_buffer(async_file_accessor_t       *thiz,
                                             async_file_access_request_t *pAsyncRequest,
                                             void                       **buffer)
 {
-    aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
     aio_request_t       *pRequest       = (aio_request_t *)pAsyncRequest;
 
     ret_t res = aio_check_request_valid(pRequest);
@@ -157,15 +490,17 @@ static ret_t aio_request_alloc_write_buffer(async_file_accessor_t       *thiz,
     {
         if (pRequest->cb.aio_nbytes > 0)
         {
-            (*buffer)                   = malloc(pRequest->cb.aio_nbytes);
+            /// Pool buffers are BUFFER_POOL_ALIGN aligned, O_DIRECT capable for native mode
+            (*buffer)                   = buffer_pool_alloc(Buffer_Pool_Get_Instance(), pRequest->cb.aio_nbytes);
             for (int i=0; NULL==(*buffer) && i<MAX_RETRY_TIMES; i++)
             {
                 printf("Error: file [%s] buffer malloc fail! Retrying[%d] ...\n", pRequest->parent.info.fn, i);
-                (*buffer)               = malloc(pRequest->cb.aio_nbytes);
+                (*buffer)               = buffer_pool_alloc(Buffer_Pool_Get_Instance(), pRequest->cb.aio_nbytes);
             }
             pRequest->buf               = *buffer;
             pRequest->cb.aio_buf        = *buffer;
             pRequest->isAlloced         = TRUE;
+            io_vector_reset(&(pRequest->iov));
 
             // printf("file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
         }
@@ -195,6 +530,7 @@ static ret_t aio_request_import_read_buffer(async_file_accessor_t       *thiz,
         {
             pRequest->buf               = buffer;
             pRequest->cb.aio_buf        = buffer;
+            io_vector_reset(&(pRequest->iov));
 
             // printf("file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
         }
@@ -208,152 +544,879 @@ static ret_t aio_request_import_read_buffer(async_file_accessor_t       *thiz,
     return res;
 }
 
-/// Put aio request
-static ret_t aio_put_request(async_file_accessor_t       *thiz,
-                             async_file_access_request_t *pAsyncRequest)
+/// Import segments of a vectored aio request, native aio takes them as one preadv/pwritev iocb
+static ret_t aio_request_import_iovec(async_file_accessor_t       *thiz,
+                                      async_file_access_request_t *pAsyncRequest,
+                                      const struct iovec          *iov,
+                                      u32                          iovcnt)
 {
-    aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
-    aio_request_t       *pRequest       = (aio_request_t *)pAsyncRequest;
+    aio_request_t *pRequest = (aio_request_t *)pAsyncRequest;
 
     ret_t res = aio_check_request_valid(pRequest);
 
+    if (RET_OK == res && TRUE == pRequest->isAlloced)
+    {
+        res = RET_INVALID_OPERATION;
+        printf("Error: request [%s] already owns a write buffer! res = %d.\n", pRequest->parent.info.fn, res);
+    }
+
     if (RET_OK == res)
     {
-        pRequest->cb.aio_sigevent.sigev_notify              = SIGEV_THREAD;
-        pRequest->cb.aio_sigevent.sigev_notify_function     = aio_callback;
-        pRequest->cb.aio_sigevent.sigev_notify_attributes   = NULL;
-        pRequest->cb.aio_sigevent.sigev_value.sival_ptr     = pRequest;
+        res = io_vector_import(&(pRequest->iov), iov, iovcnt, pRequest->cb.aio_nbytes);
+    }
+
+    if (RET_OK == res)
+    {
+        pRequest->buf           = NULL;
+        pRequest->cb.aio_buf    = NULL;
+    }
 
-        res = ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction ? aio_write(&pRequest->cb)
-                                                                         : aio_read(&pRequest->cb);
+    return res;
+}
 
-        if (res != RET_OK)
+/// Fill aio control block and mark request submitted, before handing it to aio
+static void aio_prepare_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
+{
+    if (AIO_MODE_NATIVE == pAioAccessor->mode)
+    {
+        /// Chunks share the fd of their striped request, it was switched once for all of them
+        if (NULL == pRequest->stripe.pParent)
         {
-            if (TRUE == pRequest->isAlloced)
-            {
-                free((void*)pRequest->cb.aio_buf);
-                pRequest->buf           = NULL;
-                pRequest->cb.aio_buf    = NULL;
-            }
-            printf("Error: failed to initiate the async IO operation! error: %d - %s.\n", errno, strerror(errno));
+            aio_native_try_direct(pRequest);
         }
-        pRequest->status = REQUEST_STAT_SUBMITTED;
-    }
 
-    if (RET_OK == res && pAioAccessor->req_count % REQ_LIST_BUFSIZE == 0)
-    {
-        u32 newListBufSize = ((pAioAccessor->req_count + REQ_LIST_BUFSIZE) / REQ_LIST_BUFSIZE)
-                                * REQ_LIST_BUFSIZE * sizeof(aio_request_t *);
-        aio_request_t **new_list = (aio_request_t **)realloc(pAioAccessor->req_list, newListBufSize);
+        bool isWrite = (ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction);
 
-        if (NULL == new_list)
+        memset(&(pRequest->iocb), 0, sizeof(pRequest->iocb));
+        pRequest->iocb.aio_data         = (u64)(uintptr_t)pRequest;
+        pRequest->iocb.aio_fildes       = pRequest->fd;
+        pRequest->iocb.aio_offset       = pRequest->cb.aio_offset;
+
+        /// Vectored iocb carries the segment table and its length instead of one buffer
+        if (pRequest->iov.count > 0)
         {
-            res = RET_NO_MEMORY;
-            printf("Error: fail to realloc request list! res = %d.\n", res);
+            pRequest->iocb.aio_lio_opcode   = isWrite ? IOCB_CMD_PWRITEV : IOCB_CMD_PREADV;
+            pRequest->iocb.aio_buf          = (u64)(uintptr_t)pRequest->iov.iov;
+            pRequest->iocb.aio_nbytes       = pRequest->iov.count;
         }
         else
         {
-            pAioAccessor->req_list = new_list;
+            pRequest->iocb.aio_lio_opcode   = isWrite ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+            pRequest->iocb.aio_buf          = (u64)(uintptr_t)pRequest->buf;
+            pRequest->iocb.aio_nbytes       = pRequest->cb.aio_nbytes;
         }
-    }
 
-    if (RET_OK == res)
+#ifdef IOCB_FLAG_IOPRIO
+        /// Kernel without per iocb priority rejects the flag, so only classes other than NORMAL set it
+        pRequest->iocb.aio_reqprio      = prio_class_ioprio(pRequest->parent.info.priority);
+        pRequest->iocb.aio_flags       |= (0 != pRequest->iocb.aio_reqprio) ? IOCB_FLAG_IOPRIO : 0;
+#endif
+    }
+    else
     {
-        pAioAccessor->req_list[pAioAccessor->req_count] = pRequest;
-        pAioAccessor->req_count++;
+        pRequest->cb.aio_lio_opcode                         = ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction
+                                                              ? LIO_WRITE : LIO_READ;
+        pRequest->cb.aio_sigevent.sigev_notify              = SIGEV_THREAD;
+        pRequest->cb.aio_sigevent.sigev_notify_function     = aio_callback;
+        pRequest->cb.aio_sigevent.sigev_notify_attributes   = NULL;
+        pRequest->cb.aio_sigevent.sigev_value.sival_ptr     = pRequest;
+        pRequest->cb.aio_reqprio                            = prio_class_reqprio(pRequest->parent.info.priority);
     }
 
-    // printf("put request: file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
-
-    return res;
+    /// Mark submitted first so a fast completion cannot be overwritten
+    pRequest->status        = REQUEST_STAT_SUBMITTED;
+    pRequest->isInflight    = TRUE;
 }
 
-/// Wait for an aio request finish
-static ret_t aio_wait_request(async_file_accessor_t       *thiz,
-                              async_file_access_request_t *pAsyncRequest,
-                              u32                          timeout_ms)
+/// Return chunk slots of a striped request to pool, chunks must be finished
+static void aio_unstripe_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
 {
-    aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
-    aio_request_t       *pRequest       = (aio_request_t *)pAsyncRequest;
-
-    ret_t res = aio_check_request_valid(pRequest);
-
-    if (RET_OK != res                           ||
-        pRequest->status <= REQUEST_STAT_INIT   ||
-        pRequest->status >= REQUEST_STAT_CANCEL)
-    {
-        res = RET_INVALID_OPERATION;
-        printf("Error: invalid request! res = %d.\n", res);
-    }
-    else if (REQUEST_STAT_SUBMITTED == pRequest->status)
+    for (u32 i = 0; i < pRequest->stripe.count; i++)
     {
-        struct aiocb   *aiocb_list[1];
-        struct timespec timeout =
+        if (NULL != pRequest->stripe.ppChunks[i])
         {
-            .tv_sec     = timeout_ms / 1000,
-            .tv_nsec    = (timeout_ms % 1000) * 1000000,
-        };
-
-        aiocb_list[0] = &(pRequest->cb);
-        res = aio_suspend((const struct aiocb *const *)aiocb_list, 1, (timeout_ms > 0) ? &timeout : NULL);
-        res = (RET_OK == res) ? aio_error(&(pRequest->cb)) : res;
+            request_pool_release(&(pAioAccessor->requests), pRequest->stripe.ppChunks[i]);
+        }
     }
-
-    return res;
+    stripe_group_reset(&(pRequest->stripe));
 }
 
-/// Cancel an aio request
-static ret_t aio_cancel_request(async_file_accessor_t       *thiz,
-                                async_file_access_request_t *pAsyncRequest)
+/// Whether request goes to aio as chunks: striped above threshold, or vectored in posix mode where
+/// glibc has no vectored ops and each segment runs as a chunk instead
+static bool aio_is_split(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
 {
-    aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
-    aio_request_t       *pRequest       = (aio_request_t *)pAsyncRequest;
+    u64 chunkSize = 0;
 
-    ret_t res = aio_check_request_valid(pRequest);
-    pthread_mutex_lock(&(pRequest->lock));
+    return (pRequest->iov.count > 0) ? AIO_MODE_POSIX == pAioAccessor->mode
+                                     : stripe_plan(&(pAioAccessor->stripeConfig), pRequest->cb.aio_nbytes,
+                                                   &chunkSize) > 1;
+}
 
-    if (RET_OK != res                           ||
-        pRequest->status <= REQUEST_STAT_INIT   ||
-        pRequest->status >= REQUEST_STAT_CANCEL)
+/// Split a request above stripe threshold into chunks, they share its fd and buffer and own nothing.
+/// A vectored request is split per segment in posix mode and stays whole in native mode
+static ret_t aio_stripe_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
+{
+    bool    isSegmented = (pRequest->iov.count > 0 && AIO_MODE_POSIX == pAioAccessor->mode);
+    u64     chunkSize   = 0;
+    u64     delta       = 0;
+    u32     count       = isSegmented ? pRequest->iov.count
+                        : (pRequest->iov.count > 0) ? 1
+                        : stripe_plan(&(pAioAccessor->stripeConfig), pRequest->cb.aio_nbytes, &chunkSize);
+    ret_t   res         = RET_OK;
+
+    aio_unstripe_request(pAioAccessor, pRequest);
+    res = (count > 1 || isSegmented) ? stripe_group_init(&(pRequest->stripe), count) : RET_OK;
+
+    /// Chunk boundaries keep the alignment of the whole request, decide O_DIRECT once for all chunks
+    if (RET_OK == res && count > 1 && AIO_MODE_NATIVE == pAioAccessor->mode)
     {
-        printf("Warning: cannot cancel a finished request!\n");
+        aio_native_try_direct(pRequest);
     }
-    else if (RET_OK == res)
+
+    for (u32 i = 0; RET_OK == res && i < pRequest->stripe.count; i++)
     {
-        res = aio_cancel(pRequest->fd, &pRequest->cb);
+        aio_request_t  *pChunk  = NULL;
 
-        if (TRUE == pRequest->isAlloced)
+        res = request_pool_acquire(&(pAioAccessor->requests), (async_file_access_request_t **)&pChunk);
+        if (RET_OK == res)
         {
-            free((void*)pRequest->cb.aio_buf);
-            pRequest->buf           = NULL;
-            pRequest->cb.aio_buf    = NULL;
+            pChunk->parent.info             = pRequest->parent.info;
+            pChunk->parent.info.size        = isSegmented ? pRequest->iov.iov[i].iov_len
+                                            : (pRequest->cb.aio_nbytes - delta < chunkSize)
+                                              ? pRequest->cb.aio_nbytes - delta : chunkSize;
+            pChunk->parent.info.offset      = pRequest->cb.aio_offset + delta;
+            pChunk->parent.info.deadline_ms = 0;
+            pChunk->pAccessor               = pAioAccessor;
+            pChunk->fd                      = pRequest->fd;
+            pChunk->buf                     = isSegmented ? pRequest->iov.iov[i].iov_base
+                                                          : (char8 *)pRequest->buf + delta;
+            pChunk->result                  = 0;
+            pChunk->isValid                 = TRUE;
+            pChunk->isAlloced               = FALSE;
+            pChunk->isInflight              = FALSE;
+            pChunk->isDirect                = FALSE;
+            pChunk->status                  = REQUEST_STAT_INIT;
+            memset(&(pChunk->cb), 0, sizeof(struct aiocb));
+            memset(&(pChunk->iocb), 0, sizeof(struct iocb));
+            pChunk->cb.aio_fildes           = pChunk->fd;
+            pChunk->cb.aio_buf              = pChunk->buf;
+            pChunk->cb.aio_nbytes           = pChunk->parent.info.size;
+            pChunk->cb.aio_offset           = pChunk->parent.info.offset;
+            memset(&(pChunk->stripe), 0, sizeof(stripe_group_t));
+            pChunk->stripe.pParent          = &(pRequest->parent);
+            pRequest->stripe.ppChunks[i]    = &(pChunk->parent);
+            delta                          += pChunk->parent.info.size;
         }
-        pRequest->status = REQUEST_STAT_CANCEL;
     }
 
-    pthread_mutex_unlock(&(pRequest->lock));
+    if (RET_OK != res)
+    {
+        aio_unstripe_request(pAioAccessor, pRequest);
+    }
 
     return res;
 }
 
-/// Wait for all aio request finish, after this func release all requests
-static ret_t aio_wait_all_requests(async_file_accessor_t *thiz)
+/// Return a merged request and its segments to pool, it borrowed fd and buffers of its members
+static void aio_drop_merged_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pCarrier)
 {
-    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+    io_vector_reset(&(pCarrier->iov));
+    io_merge_reset(&(pCarrier->merge));
+    pCarrier->fd            = -1;
+    pCarrier->cb.aio_fildes = -1;
+    request_pool_release(&(pAioAccessor->requests), &(pCarrier->parent));
+}
 
-    ret_t res = RET_OK;
+/// Detach a released member from its merged request, the last one drops it
+static void aio_unmerge_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
+{
+    aio_request_t *pCarrier = (aio_request_t *)pRequest->merge.pCarrier;
 
-    if (NULL == pAioAccessor || NULL == pAioAccessor->req_list || 0 == pAioAccessor->req_count)
+    pRequest->merge.pCarrier = NULL;
+    if (NULL != pCarrier && io_merge_member_done(&(pCarrier->merge)))
     {
-        printf("Empty aio accessor, no need to wait.\n");
+        aio_drop_merged_request(pAioAccessor, pCarrier);
     }
-    else
-    {
-        struct aiocb   *aiocb_list[1];
+}
 
-        for (int i = 0; i < pAioAccessor->req_count; i++)
-        {
-            aio_request_t *pRequest = pAioAccessor->req_list[i];
+/// Carry a run of contiguous requests in one request, members stay in flight until it finishes.
+/// Native mode submits it as one vectored iocb, posix mode as one aiocb over a bounce buffer
+static ret_t aio_merge_requests(aio_file_accessor_t    *pAioAccessor,
+                                const io_sched_entry_t *pRun,
+                                u32                     count,
+                                aio_request_t         **ppCarrier)
+{
+    aio_request_t  *pFirst      = (aio_request_t *)pRun[0].pRequest;
+    aio_request_t  *pCarrier    = NULL;
+    u64             span        = pRun[count - 1].offset + pRun[count - 1].size - pRun[0].offset;
+
+    ret_t res = request_pool_acquire(&(pAioAccessor->requests), (async_file_access_request_t **)&pCarrier);
+
+    if (RET_OK == res)
+    {
+        pCarrier->parent.info               = pFirst->parent.info;
+        pCarrier->parent.info.size          = span;
+        pCarrier->parent.info.deadline_ms   = 0;
+        pCarrier->pAccessor                 = pAioAccessor;
+        pCarrier->fd                        = pFirst->fd;
+        pCarrier->buf                       = NULL;
+        pCarrier->result                    = 0;
+        pCarrier->isValid                   = TRUE;
+        pCarrier->isAlloced                 = FALSE;
+        pCarrier->isInflight                = FALSE;
+        pCarrier->isDirect                  = FALSE;
+        pCarrier->status                    = REQUEST_STAT_INIT;
+        memset(&(pCarrier->cb), 0, sizeof(struct aiocb));
+        memset(&(pCarrier->iocb), 0, sizeof(struct iocb));
+        memset(&(pCarrier->stripe), 0, sizeof(stripe_group_t));
+        pCarrier->cb.aio_fildes             = pCarrier->fd;
+        pCarrier->cb.aio_nbytes             = span;
+        pCarrier->cb.aio_offset             = pFirst->cb.aio_offset;
+
+        res = io_sched_merge(pRun, count, &(pCarrier->merge), &(pCarrier->iov));
+    }
+
+    if (RET_OK == res && AIO_MODE_POSIX == pAioAccessor->mode)
+    {
+        pCarrier->merge.bounce = malloc(span);
+        res = (NULL == pCarrier->merge.bounce) ? RET_NO_MEMORY : RET_OK;
+        if (RET_OK == res)
+        {
+            if (ASYNC_FILE_ACCESS_WRITE == pCarrier->parent.info.direction)
+            {
+                io_vector_gather(&(pCarrier->iov), pCarrier->merge.bounce);
+            }
+            pCarrier->buf           = pCarrier->merge.bounce;
+            pCarrier->cb.aio_buf    = pCarrier->merge.bounce;
+        }
+    }
+
+    if (RET_OK == res)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            aio_request_t *pMember = (aio_request_t *)pRun[i].pRequest;
+
+            pMember->merge.pCarrier = &(pCarrier->parent);
+            pMember->status         = REQUEST_STAT_SUBMITTED;
+            pMember->isInflight     = TRUE;
+        }
+        *ppCarrier = pCarrier;
+    }
+    else if (NULL != pCarrier)
+    {
+        aio_drop_merged_request(pAioAccessor, pCarrier);
+    }
+
+    return res;
+}
+
+/// Order entries by file and offset and replace contiguous runs with merged requests.
+/// Caller's request table is never reordered, a new entry table is made instead
+static void aio_schedule_requests(aio_file_accessor_t    *pAioAccessor,
+                                  aio_request_t         **ppRequests,
+                                  aio_request_t        ***pppEntries,
+                                  u32                    *pEntryCount)
+{
+    u32                 count       = *pEntryCount;
+    aio_request_t     **ppEntries   = *pppEntries;
+    aio_request_t     **ppOrdered   = (ppEntries == ppRequests)
+                                      ? (aio_request_t **)malloc(sizeof(aio_request_t *) * count) : ppEntries;
+    io_sched_entry_t   *pSched      = (io_sched_entry_t *)malloc(sizeof(io_sched_entry_t) * count);
+    u32                 n           = 0;
+
+    /// Ordering is only an optimization, batch goes out as is without memory for it
+    if (NULL == ppOrdered || NULL == pSched)
+    {
+        if (ppOrdered != ppEntries)
+        {
+            free(ppOrdered);
+        }
+        free(pSched);
+        return;
+    }
+
+    for (u32 i = 0; i < count; i++)
+    {
+        aio_request_t *pRequest = ppEntries[i];
+
+        pSched[i].pRequest      = pRequest;
+        pSched[i].buf           = pRequest->buf;
+        pSched[i].dev           = (u64)pRequest->fsb.st_dev;
+        pSched[i].ino           = (u64)pRequest->fsb.st_ino;
+        pSched[i].offset        = pRequest->cb.aio_offset;
+        pSched[i].size          = pRequest->cb.aio_nbytes;
+        pSched[i].direction     = pRequest->parent.info.direction;
+        pSched[i].index         = i;
+        pSched[i].rank          = prio_class_rank(pRequest->parent.info.priority);
+        pSched[i].isMergeable   = (NULL != pRequest->buf && 0 == pRequest->iov.count &&
+                                   0 == pRequest->stripe.count && NULL == pRequest->stripe.pParent);
+    }
+
+    io_sched_sort(pSched, count);
+
+    for (u32 i = 0, run = 1; i < count; i += run)
+    {
+        aio_request_t *pCarrier = NULL;
+
+        run = io_sched_run(&(pAioAccessor->schedConfig), &(pSched[i]), count - i);
+        if (run > 1 && RET_OK == aio_merge_requests(pAioAccessor, &(pSched[i]), run, &pCarrier))
+        {
+            ppOrdered[n++] = pCarrier;
+            continue;
+        }
+
+        for (u32 j = 0; j < run; j++)
+        {
+            ppOrdered[n++] = (aio_request_t *)pSched[i + j].pRequest;
+        }
+    }
+
+    free(pSched);
+    *pppEntries     = ppOrdered;
+    *pEntryCount    = n;
+}
+
+/// Stripe requests above threshold, their chunks go to aio in place of them, then order and merge.
+/// *pppEntries is ppRequests itself when nothing changed, else a table the caller frees
+static ret_t aio_expand_requests(aio_file_accessor_t    *pAioAccessor,
+                                 aio_request_t         **ppRequests,
+                                 u32                     count,
+                                 aio_request_t        ***pppEntries,
+                                 u32                    *pEntryCount)
+{
+    ret_t               res         = RET_OK;
+    u32                 entryCount  = 0;
+    bool                isSplit     = FALSE;
+    aio_request_t     **ppEntries   = NULL;
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        /// Request put again lets go of the merged request that carried its previous run
+        aio_unmerge_request(pAioAccessor, ppRequests[i]);
+        res = aio_stripe_request(pAioAccessor, ppRequests[i]);
+        entryCount += (ppRequests[i]->stripe.count > 0) ? ppRequests[i]->stripe.count : 1;
+        isSplit     = isSplit || ppRequests[i]->stripe.count > 0;
+    }
+
+    *pppEntries     = ppRequests;
+    *pEntryCount    = count;
+
+    /// Single segment chunk keeps the count but still replaces its request
+    if (RET_OK == res && isSplit)
+    {
+        ppEntries   = (aio_request_t **)malloc(sizeof(aio_request_t *) * entryCount);
+        res         = (NULL == ppEntries) ? RET_NO_MEMORY : RET_OK;
+    }
+
+    if (NULL != ppEntries)
+    {
+        for (u32 i = 0, n = 0; i < count; i++)
+        {
+            aio_request_t *pRequest = ppRequests[i];
+
+            if (0 == pRequest->stripe.count)
+            {
+                ppEntries[n++] = pRequest;
+                continue;
+            }
+
+            /// Striped request stays in flight until its last chunk finishes it
+            pRequest->status        = REQUEST_STAT_SUBMITTED;
+            pRequest->isInflight    = TRUE;
+            for (u32 j = 0; j < pRequest->stripe.count; j++)
+            {
+                ppEntries[n++] = (aio_request_t *)pRequest->stripe.ppChunks[j];
+            }
+        }
+
+        *pppEntries     = ppEntries;
+        *pEntryCount    = entryCount;
+    }
+
+    if (RET_OK == res && *pEntryCount > 1)
+    {
+        aio_schedule_requests(pAioAccessor, ppRequests, pppEntries, pEntryCount);
+    }
+
+    return res;
+}
+
+/// Serve a read from block cache, or drop blocks a write overlaps. TRUE if read was served,
+/// it then completes in caller's thread without I/O
+static bool aio_cache_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest, bool canServe)
+{
+    block_cache_t  *pCache  = &(pAioAccessor->cache);
+    bool            isHit   = FALSE;
+
+    pRequest->cacheEpoch = BLOCK_CACHE_NO_FILL;
+    if (ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction)
+    {
+        block_cache_invalidate(pCache, &(pRequest->fsb), pRequest->parent.info.offset, pRequest->parent.info.size);
+    }
+    else if (NULL != pRequest->buf)
+    {
+        /// Vectored reads go to backend and are not cached
+        pRequest->cacheEpoch    = block_cache_epoch(pCache, &(pRequest->fsb));
+        isHit                   = canServe && block_cache_read(pCache, &(pRequest->fsb), pRequest->parent.info.offset,
+                                                               pRequest->parent.info.size, pRequest->buf);
+    }
+
+    if (isHit)
+    {
+        pRequest->cacheEpoch    = BLOCK_CACHE_NO_FILL;
+        pRequest->status        = REQUEST_STAT_SUBMITTED;
+        pRequest->isInflight    = TRUE;
+        aio_request_finish(pRequest, (s64)pRequest->parent.info.size);
+    }
+
+    return isHit;
+}
+
+/// Pass a batch through block cache, requests it served are left out.
+/// *pppMisses is ppRequests itself when none was served, else a table the caller frees
+static void aio_cache_requests(aio_file_accessor_t    *pAioAccessor,
+                               aio_request_t         **ppRequests,
+                               u32                     count,
+                               aio_request_t        ***pppMisses,
+                               u32                    *pMissCount)
+{
+    aio_request_t     **ppMisses    = ppRequests;
+    u32                 missCount   = 0;
+
+    if (!block_cache_is_enabled(&(pAioAccessor->cache)))
+    {
+        *pppMisses  = ppRequests;
+        *pMissCount = count;
+        return;
+    }
+
+    /// Caller's table is never reordered, without room for another one the batch only invalidates
+    if (count > 1)
+    {
+        ppMisses = (aio_request_t **)malloc(sizeof(aio_request_t *) * count);
+    }
+
+    for (u32 i = 0; i < count; i++)
+    {
+        if (!aio_cache_request(pAioAccessor, ppRequests[i], NULL != ppMisses) && NULL != ppMisses)
+        {
+            ppMisses[missCount++] = ppRequests[i];
+        }
+    }
+
+    if (NULL == ppMisses)
+    {
+        ppMisses    = ppRequests;
+        missCount   = count;
+    }
+    else if (ppMisses != ppRequests && (0 == missCount || missCount == count))
+    {
+        free(ppMisses);
+        ppMisses    = ppRequests;
+    }
+
+    *pppMisses  = ppMisses;
+    *pMissCount = missCount;
+}
+
+/// Advise kernel of request access hint, reads also feed sequential stream detection.
+/// Direct requests bypass page cache, nothing to advise
+static void aio_hint_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
+{
+    async_file_access_hint_t hint = pRequest->parent.info.hint;
+
+    if (pRequest->isDirect)
+    {
+        return;
+    }
+
+    readahead_advise(pRequest->fd, pRequest->parent.info.offset, pRequest->parent.info.size, hint);
+    if (ASYNC_FILE_ACCESS_READ == pRequest->parent.info.direction)
+    {
+        readahead_observe(&(pAioAccessor->readahead), pRequest->fd, &(pRequest->fsb),
+                          pRequest->parent.info.offset, pRequest->parent.info.size, hint);
+    }
+}
+
+/// Hold in-flight room for a batch, it waits or is refused as a whole
+static ret_t aio_admit_requests(aio_file_accessor_t *pAioAccessor, aio_request_t **ppRequests, u32 count)
+{
+    u64     bytes   = 0;
+    ret_t   res     = RET_OK;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        bytes += ppRequests[i]->parent.info.size;
+    }
+
+    res = admission_acquire(&(pAioAccessor->admission), count, bytes);
+    for (u64 i = 0, now = prio_class_now_ns(); RET_OK == res && i < count; i++)
+    {
+        ppRequests[i]->isAdmitted   = TRUE;
+        ppRequests[i]->admitNs      = now;
+        IO_TRACE(IO_TRACE_ADMIT, pAioAccessor->parent.type, ppRequests[i]->parent.handle);
+    }
+
+    return res;
+}
+
+/// Give back room of requests that never went out, they will not finish to return it
+static void aio_unadmit_requests(aio_file_accessor_t *pAioAccessor, aio_request_t **ppRequests, u32 count)
+{
+    u32 admitted    = 0;
+    u64 bytes       = 0;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        if (ppRequests[i]->isAdmitted)
+        {
+            ppRequests[i]->isAdmitted   = FALSE;
+            bytes                      += ppRequests[i]->parent.info.size;
+            admitted++;
+        }
+    }
+
+    if (admitted > 0)
+    {
+        admission_release(&(pAioAccessor->admission), admitted, bytes, 0);
+    }
+}
+
+static ret_t aio_put_requests(async_file_accessor_t        *thiz,
+                              async_file_access_request_t **pAsyncRequests,
+                              u32                           count);
+
+/// Put aio request
+static ret_t aio_put_request(async_file_accessor_t       *thiz,
+                             async_file_access_request_t *pAsyncRequest)
+{
+    aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
+    aio_request_t       *pRequest       = (aio_request_t *)pAsyncRequest;
+
+    ret_t res = aio_check_request_valid(pRequest);
+
+    /// Striped request goes out as a batch of its chunks
+    if (RET_OK == res && aio_is_split(pAioAccessor, pRequest))
+    {
+        return aio_put_requests(thiz, &pAsyncRequest, 1);
+    }
+
+    /// Latency of a class counts from here, cache hit included. Backpressure, a hit holds
+    /// room too as it finishes through the same path
+    if (RET_OK == res)
+    {
+        pRequest->putNs     = prio_class_now_ns();
+        pRequest->startNs   = 0;
+        pRequest->doneNs    = 0;
+        IO_TRACE(IO_TRACE_PUT, thiz->type, pRequest->parent.handle);
+
+        res = aio_admit_requests(pAioAccessor, &pRequest, 1);
+    }
+
+    /// Cache hit is done already
+    if (RET_OK == res && block_cache_is_enabled(&(pAioAccessor->cache)) &&
+        aio_cache_request(pAioAccessor, pRequest, TRUE))
+    {
+        return RET_OK;
+    }
+
+    if (RET_OK == res)
+    {
+        aio_prepare_request(pAioAccessor, pRequest);
+        aio_hint_request(pAioAccessor, pRequest);
+
+        /// Service starts on submission, aio does not tell when a worker or the device picks it up
+        pRequest->startNs = prio_class_now_ns();
+        IO_TRACE(IO_TRACE_DISPATCH, thiz->type, pRequest->parent.handle);
+        aio_track_request(pAioAccessor, pRequest);
+
+        if (AIO_MODE_NATIVE == pAioAccessor->mode)
+        {
+            res = aio_native_submit(pAioAccessor, &pRequest, 1);
+        }
+        else if ((ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction ? aio_write(&pRequest->cb)
+                                                                             : aio_read(&pRequest->cb)) != RET_OK)
+        {
+            res = -errno;
+            printf("Error: failed to initiate the async IO operation! error: %d - %s.\n", errno, strerror(errno));
+            aio_untrack_request(pRequest);
+            aio_request_finish(pRequest, res);
+        }
+    }
+
+    // printf("put request: file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
+
+    return res;
+}
+
+/// Put a batch of aio requests, one lio_listio / io_submit call for the whole batch
+static ret_t aio_put_requests(async_file_accessor_t        *thiz,
+                              async_file_access_request_t **pAsyncRequests,
+                              u32                           count)
+{
+    aio_file_accessor_t  *pAioAccessor  = (aio_file_accessor_t *)thiz;
+    aio_request_t       **ppBatch       = (aio_request_t **)pAsyncRequests;
+    aio_request_t       **ppRequests    = ppBatch;
+    aio_request_t       **ppEntries     = ppBatch;
+    u32                   entryCount    = count;
+
+    ret_t res = (NULL == ppBatch || 0 == count) ? RET_BAD_VALUE : RET_OK;
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        res = aio_check_request_valid(ppBatch[i]);
+    }
+
+    /// Latency of a class counts from here, cache hits included
+    for (u64 i = 0, now = prio_class_now_ns(); RET_OK == res && i < count; i++)
+    {
+        ppBatch[i]->putNs   = now;
+        ppBatch[i]->startNs = 0;
+        ppBatch[i]->doneNs  = 0;
+        IO_TRACE(IO_TRACE_PUT, thiz->type, ppBatch[i]->parent.handle);
+    }
+
+    /// Backpressure, hits hold room too as they finish through the same path
+    if (RET_OK == res)
+    {
+        res = aio_admit_requests(pAioAccessor, ppBatch, count);
+    }
+
+    /// Cache hits are done already, only misses go on
+    if (RET_OK == res)
+    {
+        aio_cache_requests(pAioAccessor, ppBatch, count, &ppRequests, &count);
+        ppEntries   = ppRequests;
+        entryCount  = count;
+    }
+
+    if (0 == count)
+    {
+        return res;
+    }
+
+    if (RET_OK == res)
+    {
+        res = aio_expand_requests(pAioAccessor, ppRequests, count, &ppEntries, &entryCount);
+        if (RET_OK != res)
+        {
+            aio_unadmit_requests(pAioAccessor, ppRequests, count);
+        }
+    }
+
+    bool isPrepared = (RET_OK == res);
+
+    for (u32 i = 0; isPrepared && i < entryCount; i++)
+    {
+        aio_prepare_request(pAioAccessor, ppEntries[i]);
+    }
+
+    /// After prepare has picked O_DIRECT, before submission as a finished request may have closed its fd
+    for (u32 i = 0; isPrepared && i < count; i++)
+    {
+        aio_hint_request(pAioAccessor, ppRequests[i]);
+    }
+
+    /// Service starts on submission, aio does not tell when a worker or the device picks it up
+    for (u64 i = 0, now = prio_class_now_ns(); isPrepared && i < count; i++)
+    {
+        ppRequests[i]->startNs = now;
+        IO_TRACE(IO_TRACE_DISPATCH, thiz->type, ppRequests[i]->parent.handle);
+        aio_track_request(pAioAccessor, ppRequests[i]);
+    }
+
+    if (RET_OK == res && AIO_MODE_NATIVE == pAioAccessor->mode)
+    {
+        res = aio_native_submit(pAioAccessor, ppEntries, entryCount);
+    }
+    else if (RET_OK == res)
+    {
+        struct aiocb **aiocb_list = (struct aiocb **)malloc(sizeof(struct aiocb *) * entryCount);
+
+        for (u32 i = 0; NULL != aiocb_list && i < entryCount; i++)
+        {
+            aiocb_list[i] = &(ppEntries[i]->cb);
+        }
+
+        if (NULL == aiocb_list || lio_listio(LIO_NOWAIT, aiocb_list, entryCount, NULL) != RET_OK)
+        {
+            res = (NULL == aiocb_list) ? RET_NO_MEMORY : -errno;
+            printf("Error: failed to initiate the async IO batch! error: %d - %s.\n", -res, strerror(-res));
+
+            /// Entries aio did not queue will never notify, finish them here
+            for (u32 i = 0; i < entryCount; i++)
+            {
+                s32 error = (NULL == aiocb_list) ? -res : aio_error(&(ppEntries[i]->cb));
+                if (error != EINPROGRESS && error != 0)
+                {
+                    aio_untrack_request(ppEntries[i]);
+                    aio_request_finish(ppEntries[i], -(s64)error);
+                }
+            }
+        }
+        free(aiocb_list);
+    }
+
+    if (ppEntries != ppRequests)
+    {
+        free(ppEntries);
+    }
+
+    if (ppRequests != ppBatch)
+    {
+        free(ppRequests);
+    }
+
+    return res;
+}
+
+/// Wait for an aio request finish
+static ret_t aio_wait_request(async_file_accessor_t       *thiz,
+                              async_file_access_request_t *pAsyncRequest,
+                              u32                          timeout_ms)
+{
+    aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
+    aio_request_t       *pRequest       = (aio_request_t *)pAsyncRequest;
+
+    ret_t res = aio_check_request_valid(pRequest);
+
+    if (RET_OK != res                           ||
+        pRequest->status <= REQUEST_STAT_INIT   ||
+        pRequest->status >= REQUEST_STAT_CANCEL)
+    {
+        res = RET_INVALID_OPERATION;
+        printf("Error: invalid request! res = %d.\n", res);
+    }
+    else
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec  += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        /// Wait for the completion handler rather than aio_suspend, it owns buffer and fd release
+        pthread_mutex_lock(&(pRequest->lock));
+        while (RET_OK == res && REQUEST_STAT_SUBMITTED == pRequest->status)
+        {
+            res = (timeout_ms > 0) ? -pthread_cond_timedwait(&(pRequest->isFinished), &(pRequest->lock), &deadline)
+                                   : -pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
+        }
+        res = (RET_OK == res && REQUEST_STAT_IOFAIL == pRequest->status) ? (ret_t)pRequest->result : res;
+        if (REQUEST_STAT_SUBMITTED != pRequest->status)
+        {
+            io_stats_wakeup(&(pAioAccessor->ioStats), pRequest->parent.info.direction, &(pRequest->doneNs));
+            IO_TRACE(IO_TRACE_WAKEUP, thiz->type, pRequest->parent.handle);
+            /// Waited requests are not reaped too, else callers that never reap pile them up
+            completion_queue_remove(&(pAioAccessor->completions), &(pRequest->parent));
+        }
+        pthread_mutex_unlock(&(pRequest->lock));
+    }
+
+    return res;
+}
+
+/// Mark a submitted aio request canceled and ask aio to abort it, must hold request lock
+static ret_t aio_abort_locked(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
+{
+    ret_t res = RET_OK;
+
+    /// Buffer and fd stay owned by aio until the completion handler runs
+    pRequest->status = REQUEST_STAT_CANCEL;
+    if (NULL != pRequest->merge.pCarrier)
+    {
+        /// Merged member shares its I/O with others, it is only marked
+    }
+    else if (pRequest->stripe.count > 0)
+    {
+        /// Striped request is aborted through its chunks, request lock is always taken before chunk lock
+        for (u32 i = 0; i < pRequest->stripe.count; i++)
+        {
+            aio_request_t *pChunk = (aio_request_t *)pRequest->stripe.ppChunks[i];
+
+            pthread_mutex_lock(&(pChunk->lock));
+            if (REQUEST_STAT_SUBMITTED == pChunk->status)
+            {
+                aio_abort_locked(pAioAccessor, pChunk);
+            }
+            pthread_mutex_unlock(&(pChunk->lock));
+        }
+    }
+    else if (AIO_MODE_NATIVE == pAioAccessor->mode)
+    {
+        struct io_event event;
+        sys_io_cancel(pAioAccessor->ctx, &(pRequest->iocb), &event);
+    }
+    else
+    {
+        res = aio_cancel(pRequest->fd, &pRequest->cb);
+        res = (AIO_CANCELED == res || AIO_ALLDONE == res || AIO_NOTCANCELED == res) ? RET_OK : -errno;
+    }
+    pthread_cond_broadcast(&(pRequest->isFinished));
+
+    return res;
+}
+
+/// Deadline timer callback, abort request still not finished
+static void aio_request_expire(void *arg)
+{
+    aio_request_t *pRequest = (aio_request_t *)arg;
+
+    pthread_mutex_lock(&(pRequest->lock));
+    if (REQUEST_STAT_SUBMITTED == pRequest->status)
+    {
+        aio_abort_locked(pRequest->pAccessor, pRequest);
+    }
+    pthread_mutex_unlock(&(pRequest->lock));
+}
+
+/// Cancel an aio request
+static ret_t aio_cancel_request(async_file_accessor_t       *thiz,
+                                async_file_access_request_t *pAsyncRequest)
+{
+    aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
+    aio_request_t       *pRequest       = (aio_request_t *)pAsyncRequest;
+
+    ret_t res = aio_check_request_valid(pRequest);
+    pthread_mutex_lock(&(pRequest->lock));
+
+    if (RET_OK != res                           ||
+        pRequest->status <= REQUEST_STAT_INIT   ||
+        pRequest->status >= REQUEST_STAT_CANCEL)
+    {
+        printf("Warning: cannot cancel a finished request!\n");
+    }
+    else if (RET_OK == res)
+    {
+        res = aio_abort_locked(pAioAccessor, pRequest);
+    }
+
+    pthread_mutex_unlock(&(pRequest->lock));
+
+    return res;
+}
+
+/// Wait for all aio request finish, after this func release all requests
+static ret_t aio_wait_all_requests(async_file_accessor_t *thiz)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    ret_t res = RET_OK;
+
+    if (NULL == pAioAccessor || 0 == request_pool_count(&(pAioAccessor->requests)))
+    {
+        printf("Empty aio accessor, no need to wait.\n");
+    }
+    else
+    {
+        for (u32 i = 0; i < request_pool_count(&(pAioAccessor->requests)); i++)
+        {
+            aio_request_t *pRequest = (aio_request_t *)request_pool_get(&(pAioAccessor->requests), i);
             if (pRequest)
             {
                 // while (pRequest->submitted && !pRequest->canceled && !pRequest->accessDone ||
@@ -373,8 +1436,8 @@ static ret_t aio_wait_all_requests(async_file_accessor_t *thiz)
                 {
                     pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
                 }
+                res = (REQUEST_STAT_IOFAIL == pRequest->status) ? (ret_t)pRequest->result : res;
                 pthread_mutex_unlock(&(pRequest->lock));
-                res |= aio_error(&(pRequest->cb));
             }
         }
         printf("Wait all request done.\n");
@@ -390,16 +1453,24 @@ static ret_t aio_cancel_all_requests(async_file_accessor_t *thiz)
 
     ret_t res = RET_OK;
 
-    if (NULL == pAioAccessor || NULL == pAioAccessor->req_list || 0 == pAioAccessor->req_count)
+    if (NULL == pAioAccessor || 0 == request_pool_count(&(pAioAccessor->requests)))
     {
         printf("Empty aio accessor, no need to cancel.\n");
     }
     else
     {
-        for (int i = 0; i < pAioAccessor->req_count; i++)
+        for (u32 i = 0; i < request_pool_count(&(pAioAccessor->requests)); i++)
         {
-            aio_request_t *pRequest = pAioAccessor->req_list[i];
-            aio_cancel(pRequest->fd, &pRequest->cb);
+            aio_request_t *pRequest = (aio_request_t *)request_pool_get(&(pAioAccessor->requests), i);
+            if (pRequest)
+            {
+                pthread_mutex_lock(&(pRequest->lock));
+                if (REQUEST_STAT_SUBMITTED == pRequest->status)
+                {
+                    aio_abort_locked(pAioAccessor, pRequest);
+                }
+                pthread_mutex_unlock(&(pRequest->lock));
+            }
             // printf("cancel request: file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
         }
     }
@@ -407,6 +1478,89 @@ static ret_t aio_cancel_all_requests(async_file_accessor_t *thiz)
     return res;
 }
 
+/// Close fd, free owned buffer and segments and return slot and chunks to pool, request must not be in flight.
+/// Last member released also returns its merged request
+static void aio_recycle_request(aio_file_accessor_t *pAioAccessor, aio_request_t *pRequest)
+{
+    pthread_mutex_lock(&(pRequest->lock));
+    aio_request_close_fd(pRequest);
+    if (TRUE == pRequest->isAlloced && pRequest->buf != NULL)
+    {
+        buffer_pool_free(Buffer_Pool_Get_Instance(), pRequest->buf, pRequest->cb.aio_nbytes);
+        pRequest->buf = NULL;
+    }
+    io_vector_reset(&(pRequest->iov));
+    pthread_mutex_unlock(&(pRequest->lock));
+
+    aio_unmerge_request(pAioAccessor, pRequest);
+    aio_unstripe_request(pAioAccessor, pRequest);
+    request_pool_release(&(pAioAccessor->requests), &(pRequest->parent));
+}
+
+/// Release a finished or never put aio request back to pool
+static ret_t aio_release_request(async_file_accessor_t       *thiz,
+                                 async_file_access_request_t *pAsyncRequest)
+{
+    aio_file_accessor_t *pAioAccessor   = (aio_file_accessor_t *)thiz;
+    aio_request_t       *pRequest       = (aio_request_t *)pAsyncRequest;
+
+    ret_t res = (NULL == pRequest) ? RET_BAD_VALUE : RET_OK;
+
+    if (RET_OK == res && REQUEST_HANDLE_NONE == __atomic_load_n(&(pRequest->parent.handle), __ATOMIC_ACQUIRE))
+    {
+        res = RET_DEAD_OBJECT;
+        printf("Error: request already released! res = %d.\n", res);
+    }
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(pRequest->lock));
+        res = (REQUEST_STAT_SUBMITTED == pRequest->status || pRequest->isInflight) ? RET_BUSY : RET_OK;
+        pthread_mutex_unlock(&(pRequest->lock));
+    }
+
+    if (RET_OK == res)
+    {
+        timer_service_cancel(&(pAioAccessor->timers), &(pRequest->deadline));
+        aio_recycle_request(pAioAccessor, pRequest);
+    }
+    else if (RET_BUSY == res)
+    {
+        printf("Error: cannot release a request still in flight! res = %d.\n", res);
+    }
+
+    return res;
+}
+
+/// Register a file once for many aio requests
+static ret_t aio_open_file(async_file_accessor_t        *thiz,
+                           const char8                  *fn,
+                           async_file_access_direction_t direction,
+                           u32                          *pFileHandle)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    return file_registry_open(&(pAioAccessor->files), fn, direction, pFileHandle);
+}
+
+/// Unregister an aio file
+static ret_t aio_close_file(async_file_accessor_t *thiz, u32 fileHandle)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    return file_registry_close(&(pAioAccessor->files), fileHandle);
+}
+
+/// Resolve aio request handle
+static ret_t aio_lookup_request(async_file_accessor_t        *thiz,
+                                u32                           handle,
+                                async_file_access_request_t **pAsyncRequest)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    return request_pool_lookup(&(pAioAccessor->requests), handle, pAsyncRequest);
+}
+
 // Cancel all AIO operations and release resources
 static ret_t aio_release_all_resources(async_file_accessor_t *thiz)
 {
@@ -414,51 +1568,176 @@ static ret_t aio_release_all_resources(async_file_accessor_t *thiz)
 
     ret_t res = RET_OK;
 
-    if (NULL == pAioAccessor || NULL == pAioAccessor->req_list || 0 == pAioAccessor->req_count)
+    if (NULL == pAioAccessor || 0 == request_pool_count(&(pAioAccessor->requests)))
     {
         printf("Empty aio accessor, no need to release.\n");
     }
     else
     {
-        for (int i = 0; i < pAioAccessor->req_count; i++)
+        for (u32 i = 0; i < request_pool_count(&(pAioAccessor->requests)); i++)
         {
-            aio_request_t *pRequest = pAioAccessor->req_list[i];
-            if (pRequest)
+            aio_request_t *pRequest = (aio_request_t *)request_pool_get(&(pAioAccessor->requests), i);
+
+            /// Chunks go back to pool with their striped request, merged requests with their last member
+            if (pRequest && NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
             {
+                /// Timer thread must be done with request before it is freed
+                timer_service_cancel(&(pAioAccessor->timers), &(pRequest->deadline));
+
                 pthread_mutex_lock(&(pRequest->lock));
                 if (REQUEST_STAT_SUBMITTED == pRequest->status)
                 {
-                    aio_cancel(pRequest->fd, &pRequest->cb);
+                    aio_abort_locked(pAioAccessor, pRequest);
                     printf("cancel request: file = %s: req_addr = %p, buf_addr = %p.\n",
                            pRequest->parent.info.fn, pRequest, pRequest->buf);
                 }
-                if (pRequest->cb.aio_fildes != -1)
-                {
-                    printf("close request fd: file = %s: req_addr = %p, buf_addr = %p.\n",
-                           pRequest->parent.info.fn, pRequest, pRequest->buf);
-                    close(pRequest->cb.aio_fildes);
-                    pRequest->cb.aio_fildes = -1;
-                }
-                if (TRUE == pRequest->isAlloced && pRequest->buf != NULL)
+                /// Completion handler still owns the request until aio hands it back
+                while (pRequest->isInflight)
                 {
-                    printf("free request buffer: file = %s: req_addr = %p, buf_addr = %p.\n",
-                           pRequest->parent.info.fn, pRequest, pRequest->buf);
-                    free(pRequest->buf);
-                    pRequest->buf = NULL;
+                    pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
                 }
-
                 pthread_mutex_unlock(&(pRequest->lock));
-                pthread_mutex_destroy(&(pRequest->lock));
-                free(pRequest);
 
-                pAioAccessor->req_list[i] = NULL;
+                aio_recycle_request(pAioAccessor, pRequest);
             }
         }
+        completion_queue_reset(&(pAioAccessor->completions));
+    }
+
+    return res;
+}
+
+/// Reap finished aio requests in one batch
+static ret_t aio_reap_completions(async_file_accessor_t        *thiz,
+                                  async_file_access_request_t **pAsyncRequests,
+                                  u32                           max,
+                                  s32                           timeout_ms)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    ret_t res = completion_queue_reap(&(pAioAccessor->completions), pAsyncRequests, max, timeout_ms);
+
+    for (s32 i = 0; i < res; i++)
+    {
+        aio_request_t *pRequest = (aio_request_t *)pAsyncRequests[i];
+        io_stats_wakeup(&(pAioAccessor->ioStats), pRequest->parent.info.direction, &(pRequest->doneNs));
+        IO_TRACE(IO_TRACE_WAKEUP, thiz->type, pRequest->parent.handle);
     }
 
     return res;
 }
 
+/// Get eventfd readable while aio completions are pending
+static s32 aio_get_event_fd(async_file_accessor_t *thiz)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    return pAioAccessor->completions.eventFd;
+}
+
+/// Read leases need a file mapping, aio reads always land in a request buffer
+static ret_t aio_request_lease_read_buffer(async_file_accessor_t       *thiz,
+                                         async_file_access_request_t *pAsyncRequest,
+                                         bool                         isPopulate)
+{
+    printf("Error: read lease is only supported by mmap accessor! res = %d.\n", RET_INVALID_OPERATION);
+    return RET_INVALID_OPERATION;
+}
+
+static ret_t aio_get_read_lease(async_file_accessor_t       *thiz,
+                             async_file_access_request_t *pAsyncRequest,
+                             const void                 **buffer)
+{
+    return RET_INVALID_OPERATION;
+}
+
+static ret_t aio_release_read_lease(async_file_accessor_t       *thiz,
+                                 async_file_access_request_t *pAsyncRequest)
+{
+    return RET_INVALID_OPERATION;
+}
+
+/// Snapshot of aio block cache counters
+static ret_t aio_get_cache_stats(async_file_accessor_t *thiz, async_file_cache_stats_t *pStats)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    block_cache_get_stats(&(pAioAccessor->cache), pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of aio latency counters of a priority class
+static ret_t aio_get_prio_stats(async_file_accessor_t   *thiz,
+                                async_file_priority_t    priority,
+                                async_file_prio_stats_t *pStats)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    if (NULL == pStats || priority < 0 || priority >= ASYNC_FILE_PRIO_MAX)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    prio_stats_get(&(pAioAccessor->prioStats), priority, pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of aio adaptive depth controller
+static ret_t aio_get_depth_stats(async_file_accessor_t    *thiz,
+                                 async_file_depth_stats_t *pStats)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    admission_get_depth_stats(&(pAioAccessor->admission), pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of aio op, byte and latency counters
+static ret_t aio_get_stats(async_file_accessor_t *thiz, async_file_stats_t *pStats)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    io_stats_get(&(pAioAccessor->ioStats), pStats);
+
+    return RET_OK;
+}
+
+/// Start aio op, byte and latency counters over
+static ret_t aio_reset_stats(async_file_accessor_t *thiz)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)thiz;
+
+    io_stats_reset(&(pAioAccessor->ioStats));
+
+    return RET_OK;
+}
+
+/// Publish aio counters, runs on live stats publisher thread
+static void aio_live_stats_fill(void *arg, live_stats_slot_t *pSlot)
+{
+    aio_file_accessor_t *pAioAccessor = (aio_file_accessor_t *)arg;
+
+    live_stats_fill_common(pSlot, &(pAioAccessor->ioStats), &(pAioAccessor->admission), &(pAioAccessor->completions));
+}
+
 /// Singleton static aio accessor
 static aio_file_accessor_t g_aioFileAccessor =
 {
@@ -470,19 +1749,152 @@ static aio_file_accessor_t g_aioFileAccessor =
         .allocWriteBuf      = aio_request_alloc_write_buffer,
         .importReadBuf      = aio_request_import_read_buffer,
         .putRequest         = aio_put_request,
+        .putRequests        = aio_put_requests,
+        .waitRequest        = aio_wait_request,
+        .cancelRequest      = aio_cancel_request,
+        .waitAll            = aio_wait_all_requests,
+        .cancelAll          = aio_cancel_all_requests,
+        .releaseAll         = aio_release_all_resources,
+        .reapCompletions    = aio_reap_completions,
+        .getEventFd         = aio_get_event_fd,
+        .leaseReadBuf       = aio_request_lease_read_buffer,
+        .getReadLease       = aio_get_read_lease,
+        .releaseReadLease   = aio_release_read_lease,
+        .releaseRequest     = aio_release_request,
+        .lookupRequest      = aio_lookup_request,
+        .openFile           = aio_open_file,
+        .closeFile          = aio_close_file,
+        .importIovec        = aio_request_import_iovec,
+        .getCacheStats      = aio_get_cache_stats,
+        .getPrioStats       = aio_get_prio_stats,
+        .getDepthStats      = aio_get_depth_stats,
+        .getStats           = aio_get_stats,
+        .resetStats         = aio_reset_stats,
+    },
+
+    .mode = AIO_MODE_POSIX,
+    .isInitialized = false,
+};
+
+/// Singleton static kernel native aio accessor
+static aio_file_accessor_t g_aioNativeFileAccessor =
+{
+    .parent =
+    {
+        .type               = ASYNC_FILE_ACCESSOR_AIO_NATIVE,
+
+        .getRequest         = aio_get_request,
+        .allocWriteBuf      = aio_request_alloc_write_buffer,
+        .importReadBuf      = aio_request_import_read_buffer,
+        .putRequest         = aio_put_request,
+        .putRequests        = aio_put_requests,
         .waitRequest        = aio_wait_request,
         .cancelRequest      = aio_cancel_request,
         .waitAll            = aio_wait_all_requests,
         .cancelAll          = aio_cancel_all_requests,
         .releaseAll         = aio_release_all_resources,
+        .reapCompletions    = aio_reap_completions,
+        .getEventFd         = aio_get_event_fd,
+        .leaseReadBuf       = aio_request_lease_read_buffer,
+        .getReadLease       = aio_get_read_lease,
+        .releaseReadLease   = aio_release_read_lease,
+        .releaseRequest     = aio_release_request,
+        .lookupRequest      = aio_lookup_request,
+        .openFile           = aio_open_file,
+        .closeFile          = aio_close_file,
+        .importIovec        = aio_request_import_iovec,
+        .getCacheStats      = aio_get_cache_stats,
+        .getPrioStats       = aio_get_prio_stats,
+        .getDepthStats      = aio_get_depth_stats,
+        .getStats           = aio_get_stats,
+        .resetStats         = aio_reset_stats,
     },
 
-    .req_list = NULL,
-    .req_count = 0,
+    .mode = AIO_MODE_NATIVE,
+    .ctx = 0,
+    .inflight = 0,
+    .isInitialized = false,
 };
 
-/// Acqiure single static aio accessor
-aio_file_accessor_t* AIO_File_Accessor_Get_Instance()
+/// Acqiure single static aio accessor, pConfig updates stripe settings, NULL keeps them
+aio_file_accessor_t* AIO_File_Accessor_Get_Instance(const async_file_accessor_config_t *pConfig)
 {
+    if (!g_aioFileAccessor.isInitialized)
+    {
+        stripe_config_init(&(g_aioFileAccessor.stripeConfig), pConfig);
+        io_sched_config_init(&(g_aioFileAccessor.schedConfig), pConfig);
+        readahead_tracker_init(&(g_aioFileAccessor.readahead));
+        block_cache_init(&(g_aioFileAccessor.cache));
+        group_commit_init(&(g_aioFileAccessor.commits));
+        admission_init(&(g_aioFileAccessor.admission));
+        io_stats_init(&(g_aioFileAccessor.ioStats));
+        readahead_config_init(&(g_aioFileAccessor.readahead), pConfig);
+        block_cache_config_init(&(g_aioFileAccessor.cache), pConfig);
+        group_commit_config_init(&(g_aioFileAccessor.commits), pConfig);
+        admission_config_init(&(g_aioFileAccessor.admission), pConfig);
+        request_pool_init(&(g_aioFileAccessor.requests), sizeof(aio_request_t), aio_request_slot_init);
+        file_registry_init(&(g_aioFileAccessor.files));
+        completion_queue_init(&(g_aioFileAccessor.completions));
+        timer_service_init(&(g_aioFileAccessor.timers));
+        live_stats_register(ASYNC_FILE_ACCESSOR_AIO, aio_live_stats_fill, &g_aioFileAccessor);
+        g_aioFileAccessor.isInitialized = TRUE;
+    }
+    else if (NULL != pConfig)
+    {
+        stripe_config_init(&(g_aioFileAccessor.stripeConfig), pConfig);
+        io_sched_config_init(&(g_aioFileAccessor.schedConfig), pConfig);
+        readahead_config_init(&(g_aioFileAccessor.readahead), pConfig);
+        block_cache_config_init(&(g_aioFileAccessor.cache), pConfig);
+        group_commit_config_init(&(g_aioFileAccessor.commits), pConfig);
+        admission_config_init(&(g_aioFileAccessor.admission), pConfig);
+    }
+
     return &g_aioFileAccessor;
 }
+
+/// Acqiure single static kernel native aio accessor, NULL if kernel lacks aio
+aio_file_accessor_t* AIO_Native_File_Accessor_Get_Instance(const async_file_accessor_config_t *pConfig)
+{
+    if (!g_aioNativeFileAccessor.isInitialized)
+    {
+        if (sys_io_setup(AIO_NATIVE_QUEUE_DEPTH, &(g_aioNativeFileAccessor.ctx)) == 0)
+        {
+            stripe_config_init(&(g_aioNativeFileAccessor.stripeConfig), pConfig);
+            io_sched_config_init(&(g_aioNativeFileAccessor.schedConfig), pConfig);
+            readahead_tracker_init(&(g_aioNativeFileAccessor.readahead));
+            block_cache_init(&(g_aioNativeFileAccessor.cache));
+            group_commit_init(&(g_aioNativeFileAccessor.commits));
+            admission_init(&(g_aioNativeFileAccessor.admission));
+            io_stats_init(&(g_aioNativeFileAccessor.ioStats));
+            readahead_config_init(&(g_aioNativeFileAccessor.readahead), pConfig);
+            block_cache_config_init(&(g_aioNativeFileAccessor.cache), pConfig);
+            group_commit_config_init(&(g_aioNativeFileAccessor.commits), pConfig);
+            admission_config_init(&(g_aioNativeFileAccessor.admission), pConfig);
+            request_pool_init(&(g_aioNativeFileAccessor.requests), sizeof(aio_request_t), aio_request_slot_init);
+            file_registry_init(&(g_aioNativeFileAccessor.files));
+            completion_queue_init(&(g_aioNativeFileAccessor.completions));
+            timer_service_init(&(g_aioNativeFileAccessor.timers));
+            pthread_mutex_init(&(g_aioNativeFileAccessor.lock), NULL);
+            pthread_cond_init(&(g_aioNativeFileAccessor.not_full), NULL);
+            pthread_create(&(g_aioNativeFileAccessor.reaper), NULL,
+                           aio_native_reaper_thread, &g_aioNativeFileAccessor);
+            live_stats_register(ASYNC_FILE_ACCESSOR_AIO_NATIVE, aio_live_stats_fill, &g_aioNativeFileAccessor);
+            g_aioNativeFileAccessor.isInitialized = TRUE;
+        }
+        else
+        {
+            printf("Error: native aio setup fail! error: %d - %s.\n", errno, strerror(errno));
+        }
+    }
+    else if (NULL != pConfig)
+    {
+        stripe_config_init(&(g_aioNativeFileAccessor.stripeConfig), pConfig);
+        io_sched_config_init(&(g_aioNativeFileAccessor.schedConfig), pConfig);
+        readahead_config_init(&(g_aioNativeFileAccessor.readahead), pConfig);
+        block_cache_config_init(&(g_aioNativeFileAccessor.cache), pConfig);
+        group_commit_config_init(&(g_aioNativeFileAccessor.commits), pConfig);
+        admission_config_init(&(g_aioNativeFileAccessor.admission), pConfig);
+    }
+
+    return g_aioNativeFileAccessor.isInitialized ? &g_aioNativeFileAccessor : NULL;
+}
\ No newline at end of file
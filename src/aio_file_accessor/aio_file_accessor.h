@@ -12,25 +12,73 @@
 #define __AIO_FILE_ACCESSOR_H__
 
 #include <aio.h>
+#include <linux/aio_abi.h>
+#include <sys/syscall.h>
 #include "common_types.h"
 #include "async_file_accessor.h"
+#include "completion_queue.h"
+#include "timer_service.h"
+#include "buffer_pool.h"
+#include "request_pool.h"
+#include "file_registry.h"
+#include "stripe_group.h"
+#include "io_vector.h"
+#include "io_scheduler.h"
+#include "readahead.h"
+#include "block_cache.h"
+#include "group_commit.h"
+#include "prio_class.h"
+#include "admission.h"
+#include "io_stats.h"
+#include "io_trace.h"
+#include "live_stats.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define AIO_NATIVE_QUEUE_DEPTH          256
+#define AIO_NATIVE_REAP_BATCH           64
+#define AIO_DIRECT_ALIGN                4096                    /// O_DIRECT buffer/offset/size alignment
+
+/// aio accessor working mode
+typedef enum __aio_mode
+{
+    AIO_MODE_POSIX                  = 0,                        /// glibc aio_read/aio_write
+    AIO_MODE_NATIVE,                                            /// kernel io_submit/io_getevents
+    AIO_MODE_MAX,
+
+} aio_mode_t;
+
 /// aio request struct (inherited from __async_file_access_request)
 typedef struct __aio_request
 {
     async_file_access_request_t     parent;
 
+    struct __aio_file_accessor     *pAccessor;  /// accessor owns this request
     s32                             fd;         /// file descriptor
     struct stat                     fsb;        /// file state block
     struct aiocb                    cb;         /// AIO control block
+    struct iocb                     iocb;       /// native AIO control block
     void                           *buf;        /// data buffer
+    s64                             result;     /// bytes transferred or -errno
+    timer_node_t                    deadline;   /// deadline timer, cancels request on expire
+    stripe_group_t                  stripe;     /// chunks of a striped request, or parent of a chunk
+    io_vector_t                     iov;        /// segments of a vectored request
+    io_merge_t                      merge;      /// members of a merged request, or carrier of a member
+    u64                             cacheEpoch; /// write epoch at put, read fills cache unless NO_FILL
+    group_commit_node_t             commit;     /// durable write waiting for its group flush
+    u64                             putNs;      /// put time, latency of its class counts from it
+    bool                            isAdmitted; /// holds in-flight room until it finishes
+    u64                             admitNs;    /// admission time, depth controller measures from it
+    u64                             getNs;      /// getRequest time, setup stage counts from it
+    u64                             startNs;    /// start of service, 0 until backend takes it up
+    u64                             doneNs;     /// completion time until a wait or reap returns it
 
     bool                            isValid;    /// check whether request valid
     bool                            isAlloced;  /// whether buffer is alloced by aio
+    bool                            isInflight; /// owned by aio, completion not handled yet
+    bool                            isDirect;   /// fd switched to O_DIRECT, page cache hints are moot
     request_stat_t                  status;     /// request status
     pthread_mutex_t                 lock;       /// accessDone status lock
     pthread_cond_t                  isFinished; /// request done or timeout
@@ -43,14 +91,35 @@ typedef struct __aio_file_accessor
 {
     async_file_accessor_t           parent;
 
-    aio_request_t                 **req_list;   /// aio request list
-    u32                             req_count;  /// accumulative requests count
+    aio_mode_t                      mode;       /// posix or kernel native aio
+    request_pool_t                  requests;   /// preinitialized request slots
+    file_registry_t                 files;      /// files opened once through openFile
+    stripe_config_t                 stripeConfig; /// when requests are split into chunks
+    io_sched_config_t               schedConfig;/// how batched requests are merged
+    readahead_tracker_t             readahead;  /// sequential read streams prefetched ahead
+    block_cache_t                   cache;      /// blocks of repeated reads, off unless configured
+    group_commit_t                  commits;    /// shared flushes of durable writes
+    prio_stats_t                    prioStats;  /// completion latency of each priority class
+    admission_t                     admission;  /// in-flight limits, backpressure on put
+    io_stats_t                      ioStats;    /// op, byte and latency counters per direction
+    completion_queue_t              completions;/// finished requests waiting to be reaped
+    timer_service_t                 timers;     /// request deadline timers
+
+    aio_context_t                   ctx;        /// native aio context
+    u32                             inflight;   /// native iocbs submitted but not reaped
+    pthread_mutex_t                 lock;       /// native submission lock
+    pthread_cond_t                  not_full;   /// native inflight below queue depth
+    pthread_t                       reaper;     /// native completion reaping thread
+    bool                            isInitialized; /// whether accessor is set up
 
 } aio_file_accessor_t;
 
 
-/// Acqiure single static aio accessor
-aio_file_accessor_t* AIO_File_Accessor_Get_Instance();
+/// Acqiure single static aio accessor, pConfig updates stripe, merge, readahead, cache and commit settings, NULL keeps them
+aio_file_accessor_t* AIO_File_Accessor_Get_Instance(const async_file_accessor_config_t *pConfig);
+
+/// Acqiure single static kernel native aio accessor, NULL if kernel lacks aio
+aio_file_accessor_t* AIO_Native_File_Accessor_Get_Instance(const async_file_accessor_config_t *pConfig);
 
 
 #ifdef __cplusplus
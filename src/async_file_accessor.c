@@ -12,22 +12,46 @@
 #include "async_file_accessor.h"
 #include "aio_file_accessor.h"
 #include "mmap_file_accessor.h"
-// #include "mmap_file_accessor.h"
+#include "uring_file_accessor.h"
+#include "buffer_pool.h"
+#include "io_trace.h"
+#include "live_stats.h"
 
 async_file_accessor_t* Async_File_Accessor_Get_Instance(async_file_accessor_type_t type)
+{
+    return Async_File_Accessor_Get_Instance_Ex(type, NULL);
+}
+
+async_file_accessor_t* Async_File_Accessor_Get_Instance_Ex(async_file_accessor_type_t          type,
+                                                           const async_file_accessor_config_t *pConfig)
 {
     async_file_accessor_t* pFileAcessor = NULL;
 
+    if (pConfig != NULL && pConfig->bufferFlags != 0)
+    {
+        buffer_pool_set_flags(Buffer_Pool_Get_Instance(), pConfig->bufferFlags);
+    }
+
     switch (type)
     {
         case ASYNC_FILE_ACCESSOR_AIO:
         {
-            pFileAcessor = (async_file_accessor_t *)AIO_File_Accessor_Get_Instance();
+            pFileAcessor = (async_file_accessor_t *)AIO_File_Accessor_Get_Instance(pConfig);
             break;
         }
         case ASYNC_FILE_ACCESSOR_MMAP:
         {
-            pFileAcessor = (async_file_accessor_t *)MMAP_File_Accessor_Get_Instance();
+            pFileAcessor = (async_file_accessor_t *)MMAP_File_Accessor_Get_Instance(pConfig);
+            break;
+        }
+        case ASYNC_FILE_ACCESSOR_URING:
+        {
+            pFileAcessor = (async_file_accessor_t *)URING_File_Accessor_Get_Instance(pConfig);
+            break;
+        }
+        case ASYNC_FILE_ACCESSOR_AIO_NATIVE:
+        {
+            pFileAcessor = (async_file_accessor_t *)AIO_Native_File_Accessor_Get_Instance(pConfig);
             break;
         }
         default:
@@ -37,4 +61,39 @@ async_file_accessor_t* Async_File_Accessor_Get_Instance(async_file_accessor_type
     }
 
     return pFileAcessor;
+}
+
+void* Async_File_Buffer_Alloc(u64 size)
+{
+    return buffer_pool_alloc(Buffer_Pool_Get_Instance(), size);
+}
+
+void Async_File_Buffer_Free(void *buf, u64 size)
+{
+    buffer_pool_free(Buffer_Pool_Get_Instance(), buf, size);
+}
+
+ret_t Async_File_Trace_Start(u32 eventsPerThread)
+{
+    return io_trace_start(eventsPerThread);
+}
+
+void Async_File_Trace_Stop()
+{
+    io_trace_stop();
+}
+
+ret_t Async_File_Trace_Dump(const char8 *path)
+{
+    return io_trace_dump(path);
+}
+
+ret_t Async_File_Live_Stats_Start(const char8 *name, u32 intervalMs)
+{
+    return live_stats_start(name, intervalMs);
+}
+
+void Async_File_Live_Stats_Stop()
+{
+    live_stats_stop();
 }
\ No newline at end of file
@@ -0,0 +1,389 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : block_cache.c
+ * Description  : Sharded CLOCK cache of file blocks in front of the backends, serves
+                  repeated reads without I/O and is invalidated by writes.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "block_cache.h"
+
+/// Mix file and block into a hash, low bits pick shard, high bits bucket
+static u64 block_cache_hash(u64 dev, u64 ino, u64 block)
+{
+    u64 h = (dev * 0x9E3779B97F4A7C15ULL) ^ (ino * 0xC2B2AE3D27D4EB4FULL) ^ (block * 0x165667B19E3779F9ULL);
+
+    return h ^ (h >> 29);
+}
+
+/// Write epoch slot of a file
+static u64 *block_cache_epoch_slot(block_cache_t *pCache, const struct stat *pFsb)
+{
+    return &(pCache->epochs[block_cache_hash((u64)pFsb->st_dev, (u64)pFsb->st_ino, 0) % BLOCK_CACHE_EPOCHS]);
+}
+
+/// Initialize an empty cache once, it stays off until a budget is configured
+void block_cache_init(block_cache_t *pCache)
+{
+    if (!pCache->isInitialized)
+    {
+        memset(pCache, 0, sizeof(block_cache_t));
+        for (u32 i = 0; i < BLOCK_CACHE_SHARDS; i++)
+        {
+            pthread_mutex_init(&(pCache->shards[i].lock), NULL);
+        }
+
+        /// Epoch 0 is BLOCK_CACHE_NO_FILL
+        for (u32 i = 0; i < BLOCK_CACHE_EPOCHS; i++)
+        {
+            pCache->epochs[i] = 1;
+        }
+        pCache->isInitialized = TRUE;
+    }
+}
+
+/// Free shard memory and size it for capacity entries, 0 leaves shard empty
+static ret_t block_cache_shard_resize(block_cache_shard_t *pShard, u32 capacity)
+{
+    u32 buckets = 1;
+
+    free(pShard->entries);
+    free(pShard->buckets);
+    free(pShard->slab);
+    pShard->entries     = NULL;
+    pShard->buckets     = NULL;
+    pShard->slab        = NULL;
+    pShard->capacity    = 0;
+    pShard->bucketMask  = 0;
+    pShard->hand        = 0;
+
+    if (0 == capacity)
+    {
+        return RET_OK;
+    }
+
+    while (buckets < capacity)
+    {
+        buckets <<= 1;
+    }
+
+    pShard->entries = (block_cache_entry_t *)calloc(capacity, sizeof(block_cache_entry_t));
+    pShard->buckets = (block_cache_entry_t **)calloc(buckets, sizeof(block_cache_entry_t *));
+    pShard->slab    = (char8 *)malloc((size_t)capacity * BLOCK_CACHE_BLOCK_SIZE);
+
+    if (NULL == pShard->entries || NULL == pShard->buckets || NULL == pShard->slab)
+    {
+        block_cache_shard_resize(pShard, 0);
+        return RET_NO_MEMORY;
+    }
+
+    for (u32 i = 0; i < capacity; i++)
+    {
+        pShard->entries[i].data = pShard->slab + (size_t)i * BLOCK_CACHE_BLOCK_SIZE;
+    }
+    pShard->capacity    = capacity;
+    pShard->bucketMask  = buckets - 1;
+
+    return RET_OK;
+}
+
+/// Take budget from accessor config, cache is emptied and resized when it changes, 0 turns it off
+void block_cache_config_init(block_cache_t *pCache, const async_file_accessor_config_t *pConfig)
+{
+    u64 budget      = (NULL != pConfig) ? pConfig->cacheBytes : 0;
+    u64 perShard    = budget / BLOCK_CACHE_SHARDS / BLOCK_CACHE_BLOCK_SIZE;
+    u32 capacity    = (budget > 0 && 0 == perShard) ? 1 : (perShard > UINT32_MAX) ? UINT32_MAX : (u32)perShard;
+    ret_t res       = RET_OK;
+
+    if (budget == __atomic_load_n(&(pCache->budget), __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    /// Readers see budget 0 and skip the cache while shards are rebuilt
+    __atomic_store_n(&(pCache->budget), 0, __ATOMIC_RELEASE);
+
+    for (u32 i = 0; i < BLOCK_CACHE_SHARDS; i++)
+    {
+        pthread_mutex_lock(&(pCache->shards[i].lock));
+        res = (RET_OK == res) ? block_cache_shard_resize(&(pCache->shards[i]), capacity)
+                              : block_cache_shard_resize(&(pCache->shards[i]), 0);
+        pthread_mutex_unlock(&(pCache->shards[i].lock));
+    }
+
+    /// Shards that did get memory are freed too, a partly sized cache would skew hashing
+    if (RET_OK != res)
+    {
+        for (u32 i = 0; i < BLOCK_CACHE_SHARDS; i++)
+        {
+            pthread_mutex_lock(&(pCache->shards[i].lock));
+            block_cache_shard_resize(&(pCache->shards[i]), 0);
+            pthread_mutex_unlock(&(pCache->shards[i].lock));
+        }
+        printf("Error: block cache of %llu bytes alloc fail, cache is off! res = %d.\n",
+               (unsigned long long)budget, res);
+    }
+
+    __atomic_store_n(&(pCache->stats.used), 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(pCache->stats.capacity),
+                     (RET_OK == res) ? (u64)capacity * BLOCK_CACHE_SHARDS * BLOCK_CACHE_BLOCK_SIZE : 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(pCache->budget), (RET_OK == res) ? budget : 0, __ATOMIC_RELEASE);
+}
+
+/// Shard a block hashes onto, *pHash keeps the hash for its bucket
+static block_cache_shard_t *block_cache_shard(block_cache_t *pCache, u64 dev, u64 ino, u64 block, u64 *pHash)
+{
+    *pHash = block_cache_hash(dev, ino, block);
+
+    return &(pCache->shards[*pHash % BLOCK_CACHE_SHARDS]);
+}
+
+/// Link that points at the block's entry, or at NULL ending its bucket; shard lock must be held
+static block_cache_entry_t **block_cache_find(block_cache_shard_t *pShard, u64 hash, u64 dev, u64 ino, u64 block)
+{
+    block_cache_entry_t **ppEntry = &(pShard->buckets[(hash / BLOCK_CACHE_SHARDS) & pShard->bucketMask]);
+
+    while (NULL != *ppEntry &&
+           ((*ppEntry)->dev != dev || (*ppEntry)->ino != ino || (*ppEntry)->block != block))
+    {
+        ppEntry = &((*ppEntry)->pNext);
+    }
+
+    return ppEntry;
+}
+
+/// Unlink entry from its bucket and mark it free
+static void block_cache_drop(block_cache_t *pCache, block_cache_shard_t *pShard, block_cache_entry_t *pEntry)
+{
+    u64                     hash    = block_cache_hash(pEntry->dev, pEntry->ino, pEntry->block);
+    block_cache_entry_t   **ppEntry = block_cache_find(pShard, hash, pEntry->dev, pEntry->ino, pEntry->block);
+
+    *ppEntry                = pEntry->pNext;
+    pEntry->pNext           = NULL;
+    pEntry->isUsed          = FALSE;
+    pEntry->isReferenced    = FALSE;
+    __atomic_fetch_sub(&(pCache->stats.used), pEntry->length, __ATOMIC_RELAXED);
+}
+
+/// Whether a budget is set, lookups and invalidations are skipped otherwise
+bool block_cache_is_enabled(block_cache_t *pCache)
+{
+    return 0 != __atomic_load_n(&(pCache->budget), __ATOMIC_ACQUIRE);
+}
+
+/// Epoch a read of the file takes at put, BLOCK_CACHE_NO_FILL when cache is off
+u64 block_cache_epoch(block_cache_t *pCache, const struct stat *pFsb)
+{
+    if (0 == __atomic_load_n(&(pCache->budget), __ATOMIC_ACQUIRE))
+    {
+        return BLOCK_CACHE_NO_FILL;
+    }
+
+    return __atomic_load_n(block_cache_epoch_slot(pCache, pFsb), __ATOMIC_ACQUIRE);
+}
+
+/// Copy [offset, offset + size) into buf if every block of it is cached, count a hit or a miss
+bool block_cache_read(block_cache_t *pCache, const struct stat *pFsb, u64 offset, u64 size, void *buf)
+{
+    u64     budget  = __atomic_load_n(&(pCache->budget), __ATOMIC_ACQUIRE);
+    u64     end     = offset + size;
+    bool    isHit   = (size > 0);
+
+    /// Reads beyond a quarter of the budget would only churn it
+    if (0 == budget || size > budget / 4)
+    {
+        return FALSE;
+    }
+
+    for (u64 block = offset / BLOCK_CACHE_BLOCK_SIZE; isHit && block * BLOCK_CACHE_BLOCK_SIZE < end; block++)
+    {
+        u64                     hash;
+        u64                     start   = block * BLOCK_CACHE_BLOCK_SIZE;
+        u64                     from    = (offset > start) ? offset - start : 0;
+        u64                     to      = (end - start < BLOCK_CACHE_BLOCK_SIZE) ? end - start : BLOCK_CACHE_BLOCK_SIZE;
+        block_cache_shard_t    *pShard  = block_cache_shard(pCache, (u64)pFsb->st_dev, (u64)pFsb->st_ino, block, &hash);
+
+        pthread_mutex_lock(&(pShard->lock));
+
+        block_cache_entry_t *pEntry = (pShard->capacity > 0)
+                                      ? *block_cache_find(pShard, hash, (u64)pFsb->st_dev, (u64)pFsb->st_ino, block)
+                                      : NULL;
+
+        /// Block must hold every byte asked of it, a short tail block only serves reads within it
+        isHit = (NULL != pEntry && pEntry->length >= to);
+        if (isHit)
+        {
+            memcpy((char8 *)buf + (start + from - offset), pEntry->data + from, to - from);
+            pEntry->isReferenced = TRUE;
+        }
+
+        pthread_mutex_unlock(&(pShard->lock));
+    }
+
+    __atomic_fetch_add(isHit ? &(pCache->stats.hits) : &(pCache->stats.misses), 1, __ATOMIC_RELAXED);
+
+    return isHit;
+}
+
+/// Free an entry by CLOCK: referenced entries get a second chance, the first unreferenced one goes
+static block_cache_entry_t *block_cache_evict(block_cache_t *pCache, block_cache_shard_t *pShard)
+{
+    while (TRUE)
+    {
+        block_cache_entry_t *pEntry = &(pShard->entries[pShard->hand]);
+
+        pShard->hand = (pShard->hand + 1) % pShard->capacity;
+        if (!pEntry->isUsed)
+        {
+            return pEntry;
+        }
+
+        if (pEntry->isReferenced)
+        {
+            pEntry->isReferenced = FALSE;
+            continue;
+        }
+
+        block_cache_drop(pCache, pShard, pEntry);
+        __atomic_fetch_add(&(pCache->stats.evictions), 1, __ATOMIC_RELAXED);
+
+        return pEntry;
+    }
+}
+
+/// Cache blocks starting inside [offset, offset + size) read into buf, dropped if a write came since epoch
+void block_cache_fill(block_cache_t *pCache, const struct stat *pFsb, u64 offset, u64 size, const void *buf, u64 epoch)
+{
+    u64 budget  = __atomic_load_n(&(pCache->budget), __ATOMIC_ACQUIRE);
+    u64 end     = offset + size;
+    u64 dev     = (u64)pFsb->st_dev;
+    u64 ino     = (u64)pFsb->st_ino;
+
+    if (BLOCK_CACHE_NO_FILL == epoch || 0 == budget || size > budget / 4)
+    {
+        return;
+    }
+
+    /// Partial leading block is skipped, a partial trailing one is kept as a valid prefix
+    for (u64 block = (offset + BLOCK_CACHE_BLOCK_SIZE - 1) / BLOCK_CACHE_BLOCK_SIZE;
+         block * BLOCK_CACHE_BLOCK_SIZE < end; block++)
+    {
+        u64                     hash;
+        u64                     start   = block * BLOCK_CACHE_BLOCK_SIZE;
+        u64                     length  = (end - start < BLOCK_CACHE_BLOCK_SIZE) ? end - start : BLOCK_CACHE_BLOCK_SIZE;
+        block_cache_shard_t    *pShard  = block_cache_shard(pCache, dev, ino, block, &hash);
+
+        pthread_mutex_lock(&(pShard->lock));
+
+        /// Epoch is checked under shard lock, invalidation bumps it before taking the lock
+        if (pShard->capacity > 0 && epoch == __atomic_load_n(block_cache_epoch_slot(pCache, pFsb), __ATOMIC_ACQUIRE))
+        {
+            block_cache_entry_t *pEntry = *block_cache_find(pShard, hash, dev, ino, block);
+
+            if (NULL == pEntry)
+            {
+                block_cache_entry_t **ppBucket = &(pShard->buckets[(hash / BLOCK_CACHE_SHARDS) & pShard->bucketMask]);
+
+                pEntry                  = block_cache_evict(pCache, pShard);
+                pEntry->dev             = dev;
+                pEntry->ino             = ino;
+                pEntry->block           = block;
+                pEntry->length          = 0;
+                pEntry->isUsed          = TRUE;
+                pEntry->isReferenced    = FALSE;
+                pEntry->pNext           = *ppBucket;
+                *ppBucket               = pEntry;
+            }
+
+            /// Longer prefix of the same block replaces a shorter one
+            if (length > pEntry->length)
+            {
+                memcpy(pEntry->data, (const char8 *)buf + (start - offset), length);
+                __atomic_fetch_add(&(pCache->stats.used), length - pEntry->length, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&(pCache->stats.fills), 1, __ATOMIC_RELAXED);
+                pEntry->length = length;
+            }
+        }
+
+        pthread_mutex_unlock(&(pShard->lock));
+    }
+}
+
+/// Drop every cached block of a file with index in [first, last]
+static void block_cache_sweep(block_cache_t *pCache, u64 dev, u64 ino, u64 first, u64 last)
+{
+    for (u32 i = 0; i < BLOCK_CACHE_SHARDS; i++)
+    {
+        block_cache_shard_t *pShard = &(pCache->shards[i]);
+
+        pthread_mutex_lock(&(pShard->lock));
+        for (u32 j = 0; j < pShard->capacity; j++)
+        {
+            block_cache_entry_t *pEntry = &(pShard->entries[j]);
+
+            if (pEntry->isUsed && pEntry->dev == dev && pEntry->ino == ino &&
+                pEntry->block >= first && pEntry->block <= last)
+            {
+                block_cache_drop(pCache, pShard, pEntry);
+                __atomic_fetch_add(&(pCache->stats.invalidations), 1, __ATOMIC_RELAXED);
+            }
+        }
+        pthread_mutex_unlock(&(pShard->lock));
+    }
+}
+
+/// Drop cached blocks overlapping a write and fence off fills of reads put before it
+void block_cache_invalidate(block_cache_t *pCache, const struct stat *pFsb, u64 offset, u64 size)
+{
+    u64 budget  = __atomic_load_n(&(pCache->budget), __ATOMIC_ACQUIRE);
+    u64 end     = (size > UINT64_MAX - offset) ? UINT64_MAX : offset + size;
+    u64 dev     = (u64)pFsb->st_dev;
+    u64 ino     = (u64)pFsb->st_ino;
+
+    if (0 == budget)
+    {
+        return;
+    }
+
+    __atomic_fetch_add(block_cache_epoch_slot(pCache, pFsb), 1, __ATOMIC_ACQ_REL);
+
+    /// Range wider than the whole cache, sweeping every entry once is cheaper than looking up each block
+    if ((end - offset) / BLOCK_CACHE_BLOCK_SIZE > budget / BLOCK_CACHE_BLOCK_SIZE)
+    {
+        block_cache_sweep(pCache, dev, ino, offset / BLOCK_CACHE_BLOCK_SIZE, (end - 1) / BLOCK_CACHE_BLOCK_SIZE);
+        return;
+    }
+
+    for (u64 block = offset / BLOCK_CACHE_BLOCK_SIZE; block * BLOCK_CACHE_BLOCK_SIZE < end; block++)
+    {
+        u64                     hash;
+        block_cache_shard_t    *pShard  = block_cache_shard(pCache, dev, ino, block, &hash);
+
+        pthread_mutex_lock(&(pShard->lock));
+
+        block_cache_entry_t *pEntry = (pShard->capacity > 0) ? *block_cache_find(pShard, hash, dev, ino, block) : NULL;
+
+        if (NULL != pEntry)
+        {
+            block_cache_drop(pCache, pShard, pEntry);
+            __atomic_fetch_add(&(pCache->stats.invalidations), 1, __ATOMIC_RELAXED);
+        }
+
+        pthread_mutex_unlock(&(pShard->lock));
+    }
+}
+
+/// Snapshot of counters and usage
+void block_cache_get_stats(block_cache_t *pCache, async_file_cache_stats_t *pStats)
+{
+    pStats->hits            = __atomic_load_n(&(pCache->stats.hits), __ATOMIC_RELAXED);
+    pStats->misses          = __atomic_load_n(&(pCache->stats.misses), __ATOMIC_RELAXED);
+    pStats->fills           = __atomic_load_n(&(pCache->stats.fills), __ATOMIC_RELAXED);
+    pStats->evictions       = __atomic_load_n(&(pCache->stats.evictions), __ATOMIC_RELAXED);
+    pStats->invalidations   = __atomic_load_n(&(pCache->stats.invalidations), __ATOMIC_RELAXED);
+    pStats->capacity        = __atomic_load_n(&(pCache->stats.capacity), __ATOMIC_RELAXED);
+    pStats->used            = __atomic_load_n(&(pCache->stats.used), __ATOMIC_RELAXED);
+}
@@ -0,0 +1,96 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : block_cache.h
+ * Description  : Sharded CLOCK cache of file blocks in front of the backends, serves
+                  repeated reads without I/O and is invalidated by writes.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __BLOCK_CACHE_H__
+#define __BLOCK_CACHE_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLOCK_CACHE_BLOCK_SIZE          (64ULL << 10)           /// cached unit, blocks start at multiples of it
+#define BLOCK_CACHE_SHARDS              16                      /// independently locked parts of the cache
+#define BLOCK_CACHE_EPOCHS              64                      /// write epochs, files hash onto them
+#define BLOCK_CACHE_NO_FILL             0                       /// epoch of a read that must not fill
+
+/// struct define a cached block, data holds its first length bytes
+typedef struct __block_cache_entry
+{
+    struct __block_cache_entry     *pNext;                  /// next entry of hash bucket
+    u64                             dev;                    /// device of the file
+    u64                             ino;                    /// inode of the file
+    u64                             block;                  /// block index in file
+    u64                             length;                 /// valid bytes from block start
+    char8                          *data;                   /// BLOCK_CACHE_BLOCK_SIZE bytes in shard slab
+    bool                            isUsed;                 /// entry holds a block
+    bool                            isReferenced;           /// hit since clock hand last passed
+
+} block_cache_entry_t;
+
+/// struct define a cache shard, blocks hash onto shards
+typedef struct __block_cache_shard
+{
+    block_cache_entry_t            *entries;                /// capacity entries, clock hand sweeps them
+    block_cache_entry_t           **buckets;                /// hash buckets, power of 2 count
+    char8                          *slab;                   /// data of all entries
+    u32                             capacity;               /// entries of shard
+    u32                             bucketMask;             /// bucket index mask
+    u32                             hand;                   /// next entry clock looks at
+    pthread_mutex_t                 lock;                   /// shard lock
+
+} __attribute__((aligned(64))) block_cache_shard_t;
+
+/// struct define a block cache
+typedef struct __block_cache
+{
+    block_cache_shard_t             shards[BLOCK_CACHE_SHARDS];
+    u64                             epochs[BLOCK_CACHE_EPOCHS];
+                                                            /// bumped by writes, fills of older reads are dropped
+    u64                             budget;                 /// bytes of block data, 0 when cache is off
+    async_file_cache_stats_t        stats;                  /// counters, updated atomically
+    bool                            isInitialized;          /// whether locks are set up
+
+} block_cache_t;
+
+
+/// Initialize an empty cache once, it stays off until a budget is configured
+void block_cache_init(block_cache_t *pCache);
+
+/// Take budget from accessor config, cache is emptied and resized when it changes, 0 turns it off
+void block_cache_config_init(block_cache_t *pCache, const async_file_accessor_config_t *pConfig);
+
+/// Whether a budget is set, lookups and invalidations are skipped otherwise
+bool block_cache_is_enabled(block_cache_t *pCache);
+
+/// Epoch a read of the file takes at put, BLOCK_CACHE_NO_FILL when cache is off
+u64 block_cache_epoch(block_cache_t *pCache, const struct stat *pFsb);
+
+/// Copy [offset, offset + size) into buf if every block of it is cached, count a hit or a miss
+bool block_cache_read(block_cache_t *pCache, const struct stat *pFsb, u64 offset, u64 size, void *buf);
+
+/// Cache blocks starting inside [offset, offset + size) read into buf, dropped if a write came since epoch
+void block_cache_fill(block_cache_t *pCache, const struct stat *pFsb, u64 offset, u64 size, const void *buf, u64 epoch);
+
+/// Drop cached blocks overlapping a write and fence off fills of reads put before it, UINT64_MAX size to file end
+void block_cache_invalidate(block_cache_t *pCache, const struct stat *pFsb, u64 offset, u64 size);
+
+/// Snapshot of counters and usage
+void block_cache_get_stats(block_cache_t *pCache, async_file_cache_stats_t *pStats);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __BLOCK_CACHE_H__ */
@@ -0,0 +1,211 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : buffer_pool.c
+ * Description  : Process-wide pool of page aligned I/O buffers in power-of-two size
+                  classes, carved from optionally huge page backed and locked slabs.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "buffer_pool.h"
+#include "async_file_accessor.h"
+
+static buffer_pool_t    g_bufferPool;
+static pthread_once_t   g_bufferPoolOnce = PTHREAD_ONCE_INIT;
+
+static void buffer_pool_init()
+{
+    memset(&g_bufferPool, 0, sizeof(g_bufferPool));
+    for (u32 i = 0; i < BUFFER_POOL_CLASS_COUNT; i++)
+    {
+        pthread_mutex_init(&(g_bufferPool.classes[i].lock), NULL);
+    }
+    pthread_mutex_init(&(g_bufferPool.lock), NULL);
+}
+
+buffer_pool_t* Buffer_Pool_Get_Instance()
+{
+    pthread_once(&g_bufferPoolOnce, buffer_pool_init);
+
+    return &g_bufferPool;
+}
+
+void buffer_pool_set_flags(buffer_pool_t *pool, u32 flags)
+{
+    __atomic_store_n(&(pool->flags), flags, __ATOMIC_RELAXED);
+}
+
+/// Index of smallest class holding size, -1 if larger than every class
+static s32 buffer_pool_class_index(size_t size)
+{
+    s32 shift = BUFFER_POOL_MIN_SHIFT;
+
+    while (shift <= BUFFER_POOL_MAX_SHIFT && ((size_t)1 << shift) < size)
+    {
+        shift++;
+    }
+
+    return (shift <= BUFFER_POOL_MAX_SHIFT) ? shift - BUFFER_POOL_MIN_SHIFT : -1;
+}
+
+/// Round oversized request up to whole slabs so huge pages can back it
+static size_t buffer_pool_oversize(size_t size)
+{
+    return (size + BUFFER_POOL_SLAB_SIZE - 1) & ~(BUFFER_POOL_SLAB_SIZE - 1);
+}
+
+/// Map anonymous pre-faulted memory honoring pool flags, MAP_FAILED on failure
+static void* buffer_pool_map(buffer_pool_t *pool, size_t length)
+{
+    u32     flags   = __atomic_load_n(&(pool->flags), __ATOMIC_RELAXED);
+    void   *addr    = MAP_FAILED;
+
+    if ((flags & ASYNC_FILE_BUFFER_HUGETLB) && 0 == length % BUFFER_POOL_SLAB_SIZE)
+    {
+        addr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    }
+
+    if (MAP_FAILED == addr)
+    {
+        /// No reserved huge pages, fall back to normal pages
+        addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED != addr && (flags & ASYNC_FILE_BUFFER_THP))
+        {
+            madvise(addr, length, MADV_HUGEPAGE);
+        }
+        if (MAP_FAILED != addr && !(flags & ASYNC_FILE_BUFFER_MLOCK))
+        {
+            /// Fault pages in once here, buffers are reused afterwards
+            for (size_t off = 0; off < length; off += BUFFER_POOL_ALIGN)
+            {
+                ((volatile char8 *)addr)[off] = 0;
+            }
+        }
+    }
+
+    if (MAP_FAILED != addr && (flags & ASYNC_FILE_BUFFER_MLOCK) && mlock(addr, length) != 0)
+    {
+        printf("Warning: buffer pool mlock fail! error: %d - %s.\n", errno, strerror(errno));
+    }
+
+    if (MAP_FAILED == addr)
+    {
+        printf("Error: buffer pool map %zu bytes fail! error: %d - %s.\n", length, errno, strerror(errno));
+    }
+
+    return addr;
+}
+
+/// Map a new slab, keep first buffer and put the rest on class free list
+static void* buffer_pool_grow(buffer_pool_t *pool, buffer_class_t *cls, size_t classSize)
+{
+    buffer_slab_t  *slab    = (buffer_slab_t *)malloc(sizeof(buffer_slab_t));
+    void           *addr    = (slab != NULL) ? buffer_pool_map(pool, BUFFER_POOL_SLAB_SIZE) : MAP_FAILED;
+
+    if (MAP_FAILED == addr)
+    {
+        free(slab);
+        return NULL;
+    }
+
+    slab->addr = addr;
+    pthread_mutex_lock(&(pool->lock));
+    slab->next  = pool->slabs;
+    pool->slabs = slab;
+    pthread_mutex_unlock(&(pool->lock));
+
+    pthread_mutex_lock(&(cls->lock));
+    for (size_t off = classSize; off < BUFFER_POOL_SLAB_SIZE; off += classSize)
+    {
+        void *buf       = (char8 *)addr + off;
+        *(void **)buf   = cls->freeList;
+        cls->freeList   = buf;
+        cls->freeCount++;
+    }
+    pthread_mutex_unlock(&(cls->lock));
+
+    return addr;
+}
+
+void* buffer_pool_alloc(buffer_pool_t *pool, size_t size)
+{
+    s32     idx = buffer_pool_class_index(size);
+    void   *buf = NULL;
+
+    if (0 == size)
+    {
+        return NULL;
+    }
+
+    if (idx < 0)
+    {
+        buf = buffer_pool_map(pool, buffer_pool_oversize(size));
+        return (MAP_FAILED != buf) ? buf : NULL;
+    }
+
+    buffer_class_t *cls         = &(pool->classes[idx]);
+    size_t          classSize   = (size_t)1 << (idx + BUFFER_POOL_MIN_SHIFT);
+
+    pthread_mutex_lock(&(cls->lock));
+    buf = cls->freeList;
+    if (buf != NULL)
+    {
+        cls->freeList = *(void **)buf;
+        cls->freeCount--;
+    }
+    pthread_mutex_unlock(&(cls->lock));
+
+    if (NULL == buf && classSize < BUFFER_POOL_SLAB_SIZE)
+    {
+        buf = buffer_pool_grow(pool, cls, classSize);
+    }
+    else if (NULL == buf)
+    {
+        buf = buffer_pool_map(pool, classSize);
+        buf = (MAP_FAILED != buf) ? buf : NULL;
+    }
+
+    return buf;
+}
+
+void buffer_pool_free(buffer_pool_t *pool, void *buf, size_t size)
+{
+    s32 idx = buffer_pool_class_index(size);
+
+    if (NULL == buf)
+    {
+        return;
+    }
+
+    if (idx < 0)
+    {
+        munmap(buf, buffer_pool_oversize(size));
+        return;
+    }
+
+    buffer_class_t *cls         = &(pool->classes[idx]);
+    size_t          classSize   = (size_t)1 << (idx + BUFFER_POOL_MIN_SHIFT);
+    bool            isCached    = TRUE;
+
+    pthread_mutex_lock(&(cls->lock));
+    /// Slab-sized buffers own their mapping, unmap beyond cache limit
+    if (classSize >= BUFFER_POOL_SLAB_SIZE && (size_t)cls->freeCount * classSize >= BUFFER_POOL_CACHE_LIMIT)
+    {
+        isCached = FALSE;
+    }
+    else
+    {
+        *(void **)buf   = cls->freeList;
+        cls->freeList   = buf;
+        cls->freeCount++;
+    }
+    pthread_mutex_unlock(&(cls->lock));
+
+    if (!isCached)
+    {
+        munmap(buf, classSize);
+    }
+}
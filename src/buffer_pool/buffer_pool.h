@@ -0,0 +1,72 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : buffer_pool.h
+ * Description  : Process-wide pool of page aligned I/O buffers in power-of-two size
+                  classes, carved from optionally huge page backed and locked slabs.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include "common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUFFER_POOL_ALIGN               4096                    /// page size, also O_DIRECT alignment
+#define BUFFER_POOL_MIN_SHIFT           12                      /// smallest size class, 4 KiB
+#define BUFFER_POOL_MAX_SHIFT           26                      /// largest size class, 64 MiB
+#define BUFFER_POOL_CLASS_COUNT         (BUFFER_POOL_MAX_SHIFT - BUFFER_POOL_MIN_SHIFT + 1)
+#define BUFFER_POOL_SLAB_SIZE           (2UL << 20)             /// one huge page, small classes share a slab
+#define BUFFER_POOL_CACHE_LIMIT         (256UL << 20)           /// free bytes a slab-sized class keeps mapped
+
+/// struct define free buffers of one size class
+typedef struct __buffer_class
+{
+    void                           *freeList;               /// free buffers, next link in first word
+    u32                             freeCount;              /// count of buffers on free list
+    pthread_mutex_t                 lock;                   /// free list lock
+
+} __attribute__((aligned(64))) buffer_class_t;
+
+/// struct define a small-class slab, unmapped only with the pool
+typedef struct __buffer_slab
+{
+    struct __buffer_slab           *next;                   /// next slab of pool
+    void                           *addr;                   /// slab mapping
+
+} buffer_slab_t;
+
+/// struct define a buffer pool
+typedef struct __buffer_pool
+{
+    buffer_class_t                  classes[BUFFER_POOL_CLASS_COUNT];
+    buffer_slab_t                  *slabs;                  /// slabs carved into small buffers
+    u32                             flags;                  /// ASYNC_FILE_BUFFER_* backing flags
+    pthread_mutex_t                 lock;                   /// slab list lock
+
+} buffer_pool_t;
+
+/// Acquire process-wide buffer pool shared by all accessors
+buffer_pool_t* Buffer_Pool_Get_Instance();
+
+/// Set backing flags, applies to slabs mapped afterwards
+void buffer_pool_set_flags(buffer_pool_t *pool, u32 flags);
+
+/// Get a BUFFER_POOL_ALIGN aligned buffer of at least size bytes, NULL on failure
+void* buffer_pool_alloc(buffer_pool_t *pool, size_t size);
+
+/// Return a buffer, size must be the one passed to buffer_pool_alloc
+void buffer_pool_free(buffer_pool_t *pool, void *buf, size_t size);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __BUFFER_POOL_H__ */
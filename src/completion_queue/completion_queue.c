@@ -0,0 +1,226 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : completion_queue.c
+ * Description  : Per-accessor ring of finished requests, reaped in batches or polled
+                  through an eventfd.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include <sys/eventfd.h>
+#include "completion_queue.h"
+
+/// Initialize completion queue and its eventfd
+ret_t completion_queue_init(completion_queue_t *cq)
+{
+    ret_t res = RET_OK;
+
+    cq->ring        = NULL;
+    cq->capacity    = 0;
+    cq->head        = 0;
+    cq->count       = 0;
+    cq->eventFd     = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (cq->eventFd < 0)
+    {
+        res = -errno;
+        printf("Error: completion eventfd create fail! error: %d - %s.\n", errno, strerror(errno));
+    }
+
+    pthread_mutex_init(&(cq->lock), NULL);
+    pthread_cond_init(&(cq->not_empty), NULL);
+    cq->isInitialized = TRUE;
+
+    return res;
+}
+
+/// Double ring size keeping entries in order, must hold queue lock
+static ret_t completion_queue_grow(completion_queue_t *cq)
+{
+    ret_t                           res         = RET_OK;
+    u32                             newCapacity = cq->capacity + REQ_LIST_BUFSIZE;
+    completion_entry_t             *newRing     = (completion_entry_t *)
+                                                  malloc(sizeof(completion_entry_t) * newCapacity);
+
+    if (NULL == newRing)
+    {
+        res = RET_NO_MEMORY;
+        printf("Error: fail to grow completion queue! res = %d.\n", res);
+    }
+    else
+    {
+        for (u32 i = 0; i < cq->count; i++)
+        {
+            newRing[i] = cq->ring[(cq->head + i) % cq->capacity];
+        }
+        free(cq->ring);
+        cq->ring        = newRing;
+        cq->capacity    = newCapacity;
+        cq->head        = 0;
+    }
+
+    return res;
+}
+
+/// Keep entries in order dropping released requests and pRequest, must hold queue lock
+static void completion_queue_compact(completion_queue_t *cq, async_file_access_request_t *pRequest)
+{
+    u32 kept = 0;
+
+    for (u32 i = 0; i < cq->count; i++)
+    {
+        completion_entry_t *entry = &(cq->ring[(cq->head + i) % cq->capacity]);
+
+        if (entry->pRequest != pRequest &&
+            __atomic_load_n(&(entry->pRequest->handle), __ATOMIC_ACQUIRE) == entry->handle)
+        {
+            cq->ring[(cq->head + kept) % cq->capacity] = *entry;
+            kept++;
+        }
+    }
+
+    if (kept != cq->count && 0 == kept && cq->eventFd >= 0)
+    {
+        eventfd_t value;
+        eventfd_read(cq->eventFd, &value);
+    }
+    cq->count = kept;
+}
+
+/// Append a finished request, ring grows in REQ_LIST_BUFSIZE steps
+ret_t completion_queue_push(completion_queue_t *cq, async_file_access_request_t *pRequest)
+{
+    ret_t res = cq->isInitialized ? RET_OK : RET_NO_INIT;
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(cq->lock));
+
+        /// Callers that never reap leave released requests behind, drop those before growing
+        if (cq->count == cq->capacity)
+        {
+            completion_queue_compact(cq, NULL);
+            res = (cq->count * 2 >= cq->capacity) ? completion_queue_grow(cq) : RET_OK;
+        }
+
+        if (RET_OK == res)
+        {
+            completion_entry_t *entry = &(cq->ring[(cq->head + cq->count) % cq->capacity]);
+
+            entry->pRequest = pRequest;
+            entry->handle   = __atomic_load_n(&(pRequest->handle), __ATOMIC_ACQUIRE);
+            cq->count++;
+
+            /// Level triggered: eventfd is readable exactly while entries are pending
+            if (1 == cq->count && cq->eventFd >= 0)
+            {
+                eventfd_write(cq->eventFd, 1);
+            }
+            pthread_cond_signal(&(cq->not_empty));
+        }
+
+        pthread_mutex_unlock(&(cq->lock));
+    }
+
+    return res;
+}
+
+/// Pop up to max finished requests, skipping released ones; timeout_ms < 0 blocks, 0 polls.
+/// Return count or error
+ret_t completion_queue_reap(completion_queue_t           *cq,
+                            async_file_access_request_t **pRequests,
+                            u32                           max,
+                            s32                           timeout_ms)
+{
+    ret_t res = (!cq->isInitialized) ? RET_NO_INIT : (NULL == pRequests || 0 == max) ? RET_BAD_VALUE : RET_OK;
+    u32   reaped = 0;
+    bool  popped = FALSE;
+
+    if (RET_OK == res)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        if (timeout_ms > 0)
+        {
+            deadline.tv_sec  += timeout_ms / 1000;
+            deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+        }
+
+        pthread_mutex_lock(&(cq->lock));
+
+        do
+        {
+            while (0 == cq->count && timeout_ms != 0 && RET_OK == res)
+            {
+                res = (timeout_ms > 0) ? -pthread_cond_timedwait(&(cq->not_empty), &(cq->lock), &deadline)
+                                       : -pthread_cond_wait(&(cq->not_empty), &(cq->lock));
+            }
+
+            while (reaped < max && cq->count > 0)
+            {
+                completion_entry_t *entry = &(cq->ring[cq->head]);
+
+                cq->head    = (cq->head + 1) % cq->capacity;
+                cq->count--;
+                popped      = TRUE;
+
+                /// Request released before it was reaped, its slot may serve another request now
+                if (__atomic_load_n(&(entry->pRequest->handle), __ATOMIC_ACQUIRE) == entry->handle)
+                {
+                    pRequests[reaped++] = entry->pRequest;
+                }
+            }
+        }
+        while (0 == reaped && timeout_ms != 0 && RET_OK == res);
+
+        if (popped && 0 == cq->count && cq->eventFd >= 0)
+        {
+            eventfd_t value;
+            eventfd_read(cq->eventFd, &value);
+        }
+
+        pthread_mutex_unlock(&(cq->lock));
+
+        res = (RET_TIMED_OUT == res || RET_OK == res) ? (ret_t)reaped : res;
+    }
+
+    return res;
+}
+
+/// Drop entries of a request, used when it is consumed by waitRequest instead of a reap
+void completion_queue_remove(completion_queue_t *cq, async_file_access_request_t *pRequest)
+{
+    if (cq->isInitialized)
+    {
+        pthread_mutex_lock(&(cq->lock));
+        if (cq->count > 0)
+        {
+            completion_queue_compact(cq, pRequest);
+        }
+        pthread_mutex_unlock(&(cq->lock));
+    }
+}
+
+/// Drop all pending entries, used when requests are released
+void completion_queue_reset(completion_queue_t *cq)
+{
+    if (cq->isInitialized)
+    {
+        pthread_mutex_lock(&(cq->lock));
+        if (cq->count > 0 && cq->eventFd >= 0)
+        {
+            eventfd_t value;
+            eventfd_read(cq->eventFd, &value);
+        }
+        cq->head    = 0;
+        cq->count   = 0;
+        pthread_mutex_unlock(&(cq->lock));
+    }
+}
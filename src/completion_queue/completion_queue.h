@@ -0,0 +1,69 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : completion_queue.h
+ * Description  : Per-accessor ring of finished requests, reaped in batches or polled
+                  through an eventfd.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __COMPLETION_QUEUE_H__
+#define __COMPLETION_QUEUE_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// struct define a finished request entry
+typedef struct __completion_entry
+{
+    async_file_access_request_t    *pRequest;               /// finished request
+    u32                             handle;                 /// request handle when it finished
+
+} completion_entry_t;
+
+/// struct define a completion queue
+typedef struct __completion_queue
+{
+    completion_entry_t             *ring;                   /// finished requests ring
+    u32                             capacity;               /// count of ring slots
+    u32                             head;                   /// index of oldest finished request
+    u32                             count;                  /// count of finished requests not reaped
+    s32                             eventFd;                /// readable while count > 0
+    pthread_mutex_t                 lock;                   /// completion queue lock
+    pthread_cond_t                  not_empty;              /// completion queue not empty condition
+    bool                            isInitialized;          /// whether completion queue is initialized
+
+} completion_queue_t;
+
+/// Initialize completion queue and its eventfd
+ret_t completion_queue_init(completion_queue_t *cq);
+
+/// Append a finished request, released requests are dropped when the ring is full, else it
+/// grows in REQ_LIST_BUFSIZE steps
+ret_t completion_queue_push(completion_queue_t *cq, async_file_access_request_t *pRequest);
+
+/// Pop up to max finished requests, skipping released ones; timeout_ms < 0 blocks, 0 polls.
+/// Return count or error
+ret_t completion_queue_reap(completion_queue_t           *cq,
+                            async_file_access_request_t **pRequests,
+                            u32                           max,
+                            s32                           timeout_ms);
+
+/// Drop entries of a request, used when it is consumed by waitRequest instead of a reap
+void completion_queue_remove(completion_queue_t *cq, async_file_access_request_t *pRequest);
+
+/// Drop all pending entries, used when requests are released
+void completion_queue_reset(completion_queue_t *cq);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __COMPLETION_QUEUE_H__ */
@@ -0,0 +1,216 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : depth_control.c
+ * Description  : AIMD controller of the in-flight depth, grows it while throughput
+                  improves and backs it off when tail latency inflates.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "depth_control.h"
+
+static u64 depth_control_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Histogram bucket of a latency, microseconds below 4 get one bucket each, then 4 per power of 2
+static u32 depth_control_bucket(u64 latencyNs)
+{
+    u64 us      = latencyNs >> 10;
+    u32 log     = (us < 4) ? 0 : 63 - __builtin_clzll(us);
+    u32 bucket  = (us < 4) ? (u32)us : (log - 1) * 4 + (u32)((us >> (log - 2)) & 3);
+
+    return (bucket < DEPTH_CONTROL_BUCKETS) ? bucket : DEPTH_CONTROL_BUCKETS - 1;
+}
+
+/// Upper bound in ns of a histogram bucket
+static u64 depth_control_bucket_ns(u32 bucket)
+{
+    u32 log = bucket / 4 + 1;
+
+    return ((bucket < 4) ? (u64)(bucket + 1) : (u64)(5 + bucket % 4) << (log - 2)) << 10;
+}
+
+/// 95th percentile latency of current epoch, must hold controller lock
+static u64 depth_control_tail(depth_control_t *pControl, u64 samples)
+{
+    u64 target  = samples - samples / 20;
+    u64 seen    = 0;
+
+    for (u32 i = 0; i < DEPTH_CONTROL_BUCKETS; i++)
+    {
+        seen += __atomic_load_n(&(pControl->histogram[i]), __ATOMIC_RELAXED);
+        if (seen >= target)
+        {
+            return depth_control_bucket_ns(i);
+        }
+    }
+
+    return depth_control_bucket_ns(DEPTH_CONTROL_BUCKETS - 1);
+}
+
+/// Decide depth of next epoch from the one that ended, must hold controller lock
+static async_file_depth_decision_t depth_control_decide(depth_control_t *pControl, u64 samples, u64 elapsedNs)
+{
+    async_file_depth_decision_t decision    = ASYNC_FILE_DEPTH_HOLD;
+    u64                         bytes       = __atomic_load_n(&(pControl->bytes), __ATOMIC_RELAXED);
+    u64                         throughput  = (u64)((double)bytes * 1000000000.0 / (double)elapsedNs);
+    u64                         tailNs      = (samples > 0) ? depth_control_tail(pControl, samples) : 0;
+    u32                         depth       = pControl->depth;
+
+    /// Too few completions say nothing about the device, an idle epoch keeps depth
+    if (samples >= DEPTH_CONTROL_MIN_SAMPLES)
+    {
+        if (0 != pControl->baselineNs && tailNs > pControl->baselineNs * DEPTH_CONTROL_INFLATE)
+        {
+            /// Multiplicative decrease, queueing in the device shows up as inflated tail first
+            decision    = ASYNC_FILE_DEPTH_BACKOFF;
+            depth       = depth - ((depth / 4 > 0) ? depth / 4 : 1);
+        }
+        else if (throughput > pControl->throughput + pControl->throughput / 16)
+        {
+            /// Additive increase while more depth still buys throughput
+            decision    = ASYNC_FILE_DEPTH_GROW;
+            depth       = depth + DEPTH_CONTROL_STEP;
+        }
+
+        /// Baseline follows the lowest tail and drifts up slowly so a slower device is relearned
+        pControl->baselineNs = (0 == pControl->baselineNs) ? tailNs
+                             : (tailNs < pControl->baselineNs + pControl->baselineNs / 128) ? tailNs
+                             : pControl->baselineNs + pControl->baselineNs / 128;
+        pControl->throughput = throughput;
+        pControl->tailNs     = tailNs;
+    }
+
+    depth = (depth < pControl->minDepth) ? pControl->minDepth
+          : (depth > pControl->maxDepth) ? pControl->maxDepth : depth;
+    decision = (depth == pControl->depth) ? ASYNC_FILE_DEPTH_HOLD : decision;
+
+    pControl->epochs++;
+    pControl->increases        += (ASYNC_FILE_DEPTH_GROW == decision) ? 1 : 0;
+    pControl->decreases        += (ASYNC_FILE_DEPTH_BACKOFF == decision) ? 1 : 0;
+    pControl->holds            += (ASYNC_FILE_DEPTH_HOLD == decision) ? 1 : 0;
+    pControl->lastChangeEpoch   = (ASYNC_FILE_DEPTH_HOLD == decision) ? pControl->lastChangeEpoch : pControl->epochs;
+    pControl->lastDecision      = decision;
+    __atomic_store_n(&(pControl->depth), depth, __ATOMIC_RELAXED);
+
+    return decision;
+}
+
+/// Initialize a disabled controller once
+void depth_control_init(depth_control_t *pControl)
+{
+    if (!pControl->isInitialized)
+    {
+        memset(pControl, 0, sizeof(depth_control_t));
+        pthread_mutex_init(&(pControl->lock), NULL);
+        pControl->isInitialized = TRUE;
+    }
+}
+
+/// Take adaptive mode and bounds from accessor config, depth in force is kept within new bounds.
+/// Return depth to enforce, 0 when controller is off
+u32 depth_control_config_init(depth_control_t *pControl, const async_file_accessor_config_t *pConfig)
+{
+    bool    isEnabled   = (NULL != pConfig) && pConfig->isAdaptiveDepth;
+    u32     maxDepth    = (isEnabled && pConfig->maxInflight > 0) ? pConfig->maxInflight : DEPTH_CONTROL_MAX_DEPTH;
+    u32     minDepth    = (maxDepth < DEPTH_CONTROL_MIN_DEPTH) ? maxDepth : DEPTH_CONTROL_MIN_DEPTH;
+    u32     depth       = 0;
+
+    pthread_mutex_lock(&(pControl->lock));
+
+    /// A newly enabled controller starts over, a running one keeps what it learned
+    if (isEnabled && !pControl->isEnabled)
+    {
+        memset(pControl->histogram, 0, sizeof(pControl->histogram));
+        pControl->samples       = 0;
+        pControl->bytes         = 0;
+        pControl->epochStartNs  = depth_control_now_ns();
+        pControl->throughput    = 0;
+        pControl->baselineNs    = 0;
+        pControl->depth         = DEPTH_CONTROL_START_DEPTH;
+    }
+
+    depth = (pControl->depth < minDepth) ? minDepth
+          : (pControl->depth > maxDepth) ? maxDepth : pControl->depth;
+
+    pControl->minDepth  = minDepth;
+    pControl->maxDepth  = maxDepth;
+    __atomic_store_n(&(pControl->depth), depth, __ATOMIC_RELAXED);
+    __atomic_store_n(&(pControl->isEnabled), isEnabled, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&(pControl->lock));
+
+    return isEnabled ? depth : 0;
+}
+
+/// Count a finished request admitted latencyNs ago. Return the new depth when this sample closed
+/// an epoch that moved it, 0 otherwise
+u32 depth_control_sample(depth_control_t *pControl, u64 latencyNs, u64 bytes)
+{
+    u32 newDepth    = 0;
+    u64 samples     = 0;
+    u64 now         = 0;
+    u64 start       = 0;
+
+    if (!__atomic_load_n(&(pControl->isEnabled), __ATOMIC_ACQUIRE))
+    {
+        return 0;
+    }
+
+    __atomic_add_fetch(&(pControl->histogram[depth_control_bucket(latencyNs)]), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(pControl->bytes), bytes, __ATOMIC_RELAXED);
+    samples = __atomic_add_fetch(&(pControl->samples), 1, __ATOMIC_RELAXED);
+
+    now     = depth_control_now_ns();
+    start   = __atomic_load_n(&(pControl->epochStartNs), __ATOMIC_RELAXED);
+
+    /// Only one completion closes an epoch, the others go on counting into the next
+    if (now - start >= DEPTH_CONTROL_EPOCH_NS &&
+        (samples >= DEPTH_CONTROL_MIN_SAMPLES || now - start >= DEPTH_CONTROL_IDLE_NS) &&
+        0 == pthread_mutex_trylock(&(pControl->lock)))
+    {
+        if (pControl->isEnabled && start == pControl->epochStartNs)
+        {
+            samples = __atomic_load_n(&(pControl->samples), __ATOMIC_RELAXED);
+            if (ASYNC_FILE_DEPTH_HOLD != depth_control_decide(pControl, samples, now - start))
+            {
+                newDepth = pControl->depth;
+            }
+
+            /// Samples racing with the reset land in either epoch, the histogram is an estimate anyway
+            memset(pControl->histogram, 0, sizeof(pControl->histogram));
+            __atomic_store_n(&(pControl->samples), 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&(pControl->bytes), 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&(pControl->epochStartNs), now, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&(pControl->lock));
+    }
+
+    return newDepth;
+}
+
+/// Snapshot of controller state and decisions, inflight is left to the caller
+void depth_control_get_stats(depth_control_t *pControl, async_file_depth_stats_t *pStats)
+{
+    pthread_mutex_lock(&(pControl->lock));
+    pStats->isAdaptive      = pControl->isEnabled;
+    pStats->depth           = pControl->isEnabled ? pControl->depth : 0;
+    pStats->minDepth        = pControl->isEnabled ? pControl->minDepth : 0;
+    pStats->maxDepth        = pControl->isEnabled ? pControl->maxDepth : 0;
+    pStats->epochs          = pControl->epochs;
+    pStats->increases       = pControl->increases;
+    pStats->decreases       = pControl->decreases;
+    pStats->holds           = pControl->holds;
+    pStats->lastChangeEpoch = pControl->lastChangeEpoch;
+    pStats->lastDecision    = pControl->lastDecision;
+    pStats->throughput      = pControl->throughput;
+    pStats->tailNs          = pControl->tailNs;
+    pStats->baselineNs      = pControl->baselineNs;
+    pthread_mutex_unlock(&(pControl->lock));
+}
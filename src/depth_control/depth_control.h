@@ -0,0 +1,80 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : depth_control.h
+ * Description  : AIMD controller of the in-flight depth, grows it while throughput
+                  improves and backs it off when tail latency inflates.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __DEPTH_CONTROL_H__
+#define __DEPTH_CONTROL_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEPTH_CONTROL_MIN_DEPTH         2                       /// depth never backs off below this
+#define DEPTH_CONTROL_MAX_DEPTH         1024                    /// depth bound when maxInflight is not set
+#define DEPTH_CONTROL_START_DEPTH       16                      /// depth of a newly enabled controller
+#define DEPTH_CONTROL_STEP              4                       /// additive increase per epoch
+#define DEPTH_CONTROL_EPOCH_NS          (50ULL * 1000000)       /// shortest epoch, decisions are made per epoch
+#define DEPTH_CONTROL_IDLE_NS           (1000ULL * 1000000)     /// epoch with too few samples ends here
+#define DEPTH_CONTROL_MIN_SAMPLES       16                      /// completions an epoch needs for a decision
+#define DEPTH_CONTROL_INFLATE           2                       /// tail over baseline by this much backs off
+#define DEPTH_CONTROL_BUCKETS           128                     /// latency histogram, 4 buckets per power of 2
+
+/// struct define per accessor depth controller
+typedef struct __depth_control
+{
+    bool                            isEnabled;              /// adaptive depth is configured
+    u32                             minDepth;               /// lower bound of depth
+    u32                             maxDepth;               /// upper bound of depth
+    u32                             depth;                  /// depth in force
+    u64                             samples __attribute__((aligned(64)));
+                                                            /// completions of current epoch
+    u64                             bytes;                  /// data bytes of those completions
+    u32                             histogram[DEPTH_CONTROL_BUCKETS];
+                                                            /// latency of those completions
+    u64                             epochStartNs __attribute__((aligned(64)));
+                                                            /// CLOCK_MONOTONIC start of current epoch
+    u64                             throughput;             /// bytes per second of last decided epoch
+    u64                             tailNs;                 /// p95 latency of last decided epoch
+    u64                             baselineNs;             /// lowest recent tail, inflation is measured on it
+    u64                             epochs;                 /// epochs decided
+    u64                             increases;              /// epochs that grew depth
+    u64                             decreases;              /// epochs that backed depth off
+    u64                             holds;                  /// epochs that kept depth
+    u64                             lastChangeEpoch;        /// epoch depth last moved in
+    async_file_depth_decision_t     lastDecision;           /// decision of last epoch
+    pthread_mutex_t                 lock;                   /// taken by the sample that closes an epoch
+    bool                            isInitialized;          /// whether lock is set up
+
+} depth_control_t;
+
+
+/// Initialize a disabled controller once
+void depth_control_init(depth_control_t *pControl);
+
+/// Take adaptive mode and bounds from accessor config, depth in force is kept within new bounds.
+/// Return depth to enforce, 0 when controller is off
+u32 depth_control_config_init(depth_control_t *pControl, const async_file_accessor_config_t *pConfig);
+
+/// Count a finished request admitted latencyNs ago. Return the new depth when this sample closed
+/// an epoch that moved it, 0 otherwise
+u32 depth_control_sample(depth_control_t *pControl, u64 latencyNs, u64 bytes);
+
+/// Snapshot of controller state and decisions, inflight is left to the caller
+void depth_control_get_stats(depth_control_t *pControl, async_file_depth_stats_t *pStats);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __DEPTH_CONTROL_H__ */
@@ -0,0 +1,293 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : file_registry.c
+ * Description  : Per-accessor table of files opened and stat'd once, shared by any
+                  number of ranged requests through generation-checked handles.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "file_registry.h"
+
+/// Initialize an empty registry
+ret_t file_registry_init(file_registry_t *reg)
+{
+    reg->entries        = NULL;
+    reg->count          = 0;
+    pthread_mutex_init(&(reg->lock), NULL);
+    reg->isInitialized  = TRUE;
+
+    return RET_OK;
+}
+
+/// Resolve live entry of handle, must hold registry lock
+static file_entry_t* file_registry_entry(file_registry_t *reg, u32 handle)
+{
+    u32           idx   = handle & FILE_HANDLE_INDEX_MASK;
+    file_entry_t *entry = (ASYNC_FILE_HANDLE_NONE != handle && idx < reg->count) ? reg->entries[idx] : NULL;
+
+    return (entry != NULL && entry->refCount > 0 &&
+            entry->generation == (handle >> FILE_HANDLE_INDEX_BITS)) ? entry : NULL;
+}
+
+/// Drop one reference, close fds and free entry with the last one, must hold registry lock
+static void file_registry_unref(file_entry_t *entry)
+{
+    if (--entry->refCount > 0)
+    {
+        return;
+    }
+
+    close(entry->fd);
+    if (entry->directFd >= 0)
+    {
+        close(entry->directFd);
+    }
+    entry->fd               = -1;
+    entry->directFd         = -1;
+    entry->isDirectTried    = FALSE;
+
+    /// Generation is never 0 so a live handle never equals ASYNC_FILE_HANDLE_NONE
+    entry->generation       = (entry->generation + 1) & (0xFFFFFFFFU >> FILE_HANDLE_INDEX_BITS);
+    entry->generation       = (0 == entry->generation) ? 1 : entry->generation;
+}
+
+/// Find a free entry or create one, must hold registry lock
+static file_entry_t* file_registry_slot(file_registry_t *reg, u32 *pIdx)
+{
+    for (u32 i = 0; i < reg->count; i++)
+    {
+        if (0 == reg->entries[i]->refCount)
+        {
+            *pIdx = i;
+            return reg->entries[i];
+        }
+    }
+
+    if (reg->count > FILE_HANDLE_INDEX_MASK)
+    {
+        return NULL;
+    }
+
+    if (reg->count % REQ_LIST_BUFSIZE == 0)
+    {
+        file_entry_t **newEntries = (file_entry_t **)realloc(reg->entries,
+                                                             sizeof(file_entry_t *) * (reg->count + REQ_LIST_BUFSIZE));
+        if (NULL == newEntries)
+        {
+            return NULL;
+        }
+        reg->entries = newEntries;
+    }
+
+    file_entry_t *entry = (file_entry_t *)calloc(1, sizeof(file_entry_t));
+    if (entry != NULL)
+    {
+        entry->fd                   = -1;
+        entry->directFd             = -1;
+        entry->generation           = 1;
+        *pIdx                       = reg->count;
+        reg->entries[reg->count++]  = entry;
+    }
+
+    return entry;
+}
+
+/// Open and stat fn once, write direction opens read-write and creates the file
+ret_t file_registry_open(file_registry_t                *reg,
+                         const char8                    *fn,
+                         async_file_access_direction_t   direction,
+                         u32                            *pHandle)
+{
+    ret_t res = (!reg->isInitialized) ? RET_NO_INIT
+              : (NULL == fn || NULL == pHandle || direction < 0 || direction >= ASYNC_FILE_ACCESS_MAX) ? RET_BAD_VALUE
+              : RET_OK;
+    s32   fd  = -1;
+    u32   idx = 0;
+
+    if (RET_OK == res)
+    {
+        u32 retry_times = 0;
+
+        do {
+            fd = (ASYNC_FILE_ACCESS_READ == direction) ? open(fn, O_RDONLY | O_CLOEXEC, 0666)
+                                                       : open(fn, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        }
+        while (fd < 0 && EINTR == errno && retry_times++ < MAX_RETRY_TIMES);
+
+        if (fd < 0)
+        {
+            res = -errno;
+            printf("Error: file [%s] open fail! error: %d - %s.\n", fn, errno, strerror(errno));
+        }
+    }
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(reg->lock));
+
+        file_entry_t *entry = file_registry_slot(reg, &idx);
+
+        if (NULL == entry)
+        {
+            res = RET_NO_MEMORY;
+            printf("Error: fail to register file [%s]! res = %d.\n", fn, res);
+            close(fd);
+        }
+        else
+        {
+            strncpy(entry->fn, fn, MAX_FILE_NAME_LEN - 1);
+            entry->fn[MAX_FILE_NAME_LEN - 1]    = '\0';
+            entry->fd                           = fd;
+            entry->direction                    = direction;
+            entry->refCount                     = 1;
+            entry->isOpen                       = TRUE;
+            fstat(fd, &(entry->fsb));
+            *pHandle = (entry->generation << FILE_HANDLE_INDEX_BITS) | idx;
+        }
+
+        pthread_mutex_unlock(&(reg->lock));
+    }
+
+    return res;
+}
+
+/// Drop registration, fd closes once the last request using it is done
+ret_t file_registry_close(file_registry_t *reg, u32 handle)
+{
+    ret_t res = RET_OK;
+
+    pthread_mutex_lock(&(reg->lock));
+
+    file_entry_t *entry = file_registry_entry(reg, handle);
+
+    if (NULL == entry || !entry->isOpen)
+    {
+        res = RET_NAME_NOT_FOUND;
+        printf("Error: file handle %u is not registered! res = %d.\n", handle, res);
+    }
+    else
+    {
+        entry->isOpen = FALSE;
+        file_registry_unref(entry);
+    }
+
+    pthread_mutex_unlock(&(reg->lock));
+
+    return res;
+}
+
+/// Take a reference for a request, RET_NAME_NOT_FOUND if handle is stale or closed
+ret_t file_registry_get(file_registry_t                *reg,
+                        u32                             handle,
+                        async_file_access_direction_t   direction,
+                        s32                            *pFd,
+                        struct stat                    *pFsb)
+{
+    ret_t res = RET_OK;
+
+    pthread_mutex_lock(&(reg->lock));
+
+    file_entry_t *entry = file_registry_entry(reg, handle);
+
+    if (NULL == entry || !entry->isOpen)
+    {
+        res = RET_NAME_NOT_FOUND;
+        printf("Error: file handle %u is not registered! res = %d.\n", handle, res);
+    }
+    else if (ASYNC_FILE_ACCESS_WRITE == direction && ASYNC_FILE_ACCESS_READ == entry->direction)
+    {
+        res = RET_PERMISSION_DENIED;
+        printf("Error: file [%s] is registered read only! res = %d.\n", entry->fn, res);
+    }
+    else
+    {
+        entry->refCount++;
+        *pFd    = entry->fd;
+        *pFsb   = entry->fsb;
+    }
+
+    pthread_mutex_unlock(&(reg->lock));
+
+    return res;
+}
+
+/// Done with fd: drop reference of a registered file, or close fd of an unregistered one
+void file_registry_close_fd(file_registry_t *reg, u32 handle, s32 fd)
+{
+    if (ASYNC_FILE_HANDLE_NONE == handle)
+    {
+        close(fd);
+        return;
+    }
+
+    pthread_mutex_lock(&(reg->lock));
+
+    file_entry_t *entry = file_registry_entry(reg, handle);
+    if (entry != NULL)
+    {
+        file_registry_unref(entry);
+    }
+
+    pthread_mutex_unlock(&(reg->lock));
+}
+
+/// Grow file to at least length bytes, never shrinks
+ret_t file_registry_extend(file_registry_t *reg, u32 handle, u64 length)
+{
+    ret_t res = RET_OK;
+
+    pthread_mutex_lock(&(reg->lock));
+
+    file_entry_t *entry = file_registry_entry(reg, handle);
+
+    if (NULL == entry)
+    {
+        res = RET_NAME_NOT_FOUND;
+    }
+    else if ((u64)entry->fsb.st_size < length)
+    {
+        if (ftruncate(entry->fd, (off_t)length) != 0)
+        {
+            res = -errno;
+            printf("Error: file [%s] extend fail! error: %d - %s.\n", entry->fn, errno, strerror(errno));
+        }
+        else
+        {
+            entry->fsb.st_size = (off_t)length;
+        }
+    }
+
+    pthread_mutex_unlock(&(reg->lock));
+
+    return res;
+}
+
+/// O_DIRECT descriptor of a registered file, -1 if filesystem rejects it
+s32 file_registry_direct_fd(file_registry_t *reg, u32 handle)
+{
+    s32 fd = -1;
+
+    pthread_mutex_lock(&(reg->lock));
+
+    file_entry_t *entry = file_registry_entry(reg, handle);
+
+    if (entry != NULL && !entry->isDirectTried)
+    {
+        /// Shared fd must keep its flags, direct IO gets a descriptor of its own
+        entry->isDirectTried = TRUE;
+        entry->directFd      = open(entry->fn, (ASYNC_FILE_ACCESS_READ == entry->direction ? O_RDONLY : O_RDWR)
+                                               | O_DIRECT | O_CLOEXEC);
+    }
+    fd = (entry != NULL) ? entry->directFd : -1;
+
+    pthread_mutex_unlock(&(reg->lock));
+
+    return fd;
+}
@@ -0,0 +1,83 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : file_registry.h
+ * Description  : Per-accessor table of files opened and stat'd once, shared by any
+                  number of ranged requests through generation-checked handles.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __FILE_REGISTRY_H__
+#define __FILE_REGISTRY_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FILE_HANDLE_INDEX_BITS          16                      /// low bits entry index, high bits generation
+#define FILE_HANDLE_INDEX_MASK          ((1U << FILE_HANDLE_INDEX_BITS) - 1)
+
+/// struct define a registered file
+typedef struct __file_entry
+{
+    char8                           fn[MAX_FILE_NAME_LEN];  /// file name, reopened for O_DIRECT
+    s32                             fd;                     /// shared file descriptor
+    s32                             directFd;               /// O_DIRECT descriptor, opened on first use
+    struct stat                     fsb;                    /// file state block
+    async_file_access_direction_t   direction;              /// write entries are opened read-write
+    u32                             generation;             /// bumped when entry is freed
+    u32                             refCount;               /// registration plus requests holding fd
+    bool                            isOpen;                 /// registered and not closed by caller
+    bool                            isDirectTried;          /// O_DIRECT open already attempted
+
+} file_entry_t;
+
+/// struct define a file registry
+typedef struct __file_registry
+{
+    file_entry_t                  **entries;                /// entries, never moved once created
+    u32                             count;                  /// entries created
+    pthread_mutex_t                 lock;                   /// registry lock
+    bool                            isInitialized;          /// whether registry is initialized
+
+} file_registry_t;
+
+/// Initialize an empty registry
+ret_t file_registry_init(file_registry_t *reg);
+
+/// Open and stat fn once, write direction opens read-write and creates the file
+ret_t file_registry_open(file_registry_t                *reg,
+                         const char8                    *fn,
+                         async_file_access_direction_t   direction,
+                         u32                            *pHandle);
+
+/// Drop registration, fd closes once the last request using it is done
+ret_t file_registry_close(file_registry_t *reg, u32 handle);
+
+/// Take a reference for a request, RET_NAME_NOT_FOUND if handle is stale or closed
+ret_t file_registry_get(file_registry_t                *reg,
+                        u32                             handle,
+                        async_file_access_direction_t   direction,
+                        s32                            *pFd,
+                        struct stat                    *pFsb);
+
+/// Done with fd: drop reference of a registered file, or close fd of an unregistered one
+void file_registry_close_fd(file_registry_t *reg, u32 handle, s32 fd);
+
+/// Grow file to at least length bytes, never shrinks
+ret_t file_registry_extend(file_registry_t *reg, u32 handle, u64 length);
+
+/// O_DIRECT descriptor of a registered file, -1 if filesystem rejects it
+s32 file_registry_direct_fd(file_registry_t *reg, u32 handle);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __FILE_REGISTRY_H__ */
@@ -0,0 +1,371 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : group_commit.c
+ * Description  : Gather durable writes of a file completing close in time and flush
+                  them with one fdatasync/fsync, releasing all their waiters together.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "group_commit.h"
+#include "io_trace.h"
+
+static u64 group_commit_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Flush fd to stable storage, FULL also flushes metadata. Return 0 or -errno
+static s64 group_commit_flush(s32 fd, async_file_durability_t level)
+{
+    s64 res = 0;
+
+    IO_TRACE(IO_TRACE_FLUSH_BEGIN, IO_TRACE_NO_ACCESSOR, (u32)fd);
+    res = ((ASYNC_FILE_DURABLE_FULL == level) ? fsync(fd) : fdatasync(fd)) < 0 ? -errno : 0;
+    IO_TRACE(IO_TRACE_FLUSH_END, IO_TRACE_NO_ACCESSOR, (u32)fd);
+
+    if (res < 0)
+    {
+        printf("Error: durable write flush fail! error: %d - %s.\n", (s32)-res, strerror((s32)-res));
+    }
+
+    return res;
+}
+
+/// Release members of a flushed group, a member may be reused once its callback returns
+static void group_commit_release(group_commit_node_t *pHead, s64 result)
+{
+    while (NULL != pHead)
+    {
+        group_commit_node_t *pNode = pHead;
+
+        pHead = pHead->pNext;
+        pNode->callback(pNode->arg, (result < 0) ? result : pNode->result);
+    }
+}
+
+/// Find the group of a file, else a free slot to open one in, must hold groups lock. NULL if all are busy
+static group_commit_group_t *group_commit_find_group(group_commit_t *pCommit, u64 dev, u64 ino)
+{
+    group_commit_group_t *pFree = NULL;
+
+    for (u32 i = 0; i < GROUP_COMMIT_GROUPS; i++)
+    {
+        group_commit_group_t *pGroup = &(pCommit->groups[i]);
+
+        if (pGroup->isUsed && pGroup->dev == dev && pGroup->ino == ino)
+        {
+            return pGroup;
+        }
+        if (!pGroup->isUsed && NULL == pFree)
+        {
+            pFree = pGroup;
+        }
+    }
+
+    return pFree;
+}
+
+/// Open a group in a free slot, it owns fd and closes it after the flush. Must hold groups lock
+static void group_commit_open_group(group_commit_t *pCommit, group_commit_group_t *pGroup, s32 fd, u64 dev, u64 ino)
+{
+    pGroup->fd              = fd;
+    pGroup->dev             = dev;
+    pGroup->ino             = ino;
+    pGroup->level           = ASYNC_FILE_DURABLE_NONE;
+    pGroup->pHead           = NULL;
+    pGroup->pTail           = NULL;
+    pGroup->writebackStart  = 0;
+    pGroup->writebackEnd    = 0;
+    pGroup->deadlineNs      = group_commit_now_ns() + pCommit->windowNs;
+    pGroup->isBarrier       = FALSE;
+    pGroup->isUsed          = TRUE;
+}
+
+/// Append a write to its group and its range to the pending writeback, must hold groups lock
+static void group_commit_add(group_commit_t *pCommit, group_commit_group_t *pGroup, group_commit_node_t *pNode)
+{
+    bool isIdle = (pGroup->writebackEnd <= pGroup->writebackStart);
+
+    if (NULL == pGroup->pHead)
+    {
+        pGroup->pHead = pNode;
+    }
+    else
+    {
+        pGroup->pTail->pNext = pNode;
+    }
+    pGroup->pTail       = pNode;
+    pGroup->level       = (pNode->level > pGroup->level) ? pNode->level : pGroup->level;
+    pGroup->isBarrier   = pGroup->isBarrier || pNode->isBarrier;
+
+    pGroup->writebackStart  = (isIdle || pNode->offset < pGroup->writebackStart) ? pNode->offset
+                                                                                 : pGroup->writebackStart;
+    pGroup->writebackEnd    = (isIdle || pNode->offset + pNode->size > pGroup->writebackEnd)
+                              ? pNode->offset + pNode->size : pGroup->writebackEnd;
+
+    /// Flush thread sleeps until the earliest deadline, only new writeback or a barrier wakes it
+    if (isIdle || pNode->isBarrier)
+    {
+        pthread_cond_signal(&(pCommit->changed));
+    }
+}
+
+/// Move writes waiting for a group into one where a slot is free, must hold groups lock
+static void group_commit_place_overflow(group_commit_t *pCommit)
+{
+    group_commit_node_t **ppNode = &(pCommit->pOverflowHead);
+
+    pCommit->pOverflowTail = NULL;
+    while (NULL != *ppNode)
+    {
+        group_commit_node_t    *pNode   = *ppNode;
+        group_commit_group_t   *pGroup  = group_commit_find_group(pCommit, pNode->dev, pNode->ino);
+
+        if (NULL == pGroup)
+        {
+            pCommit->pOverflowTail  = pNode;
+            ppNode                  = &(pNode->pNext);
+            continue;
+        }
+
+        /// A new group takes over the dup of the write, a joined one has its own
+        *ppNode = pNode->pNext;
+        if (pGroup->isUsed)
+        {
+            close(pNode->fd);
+        }
+        else
+        {
+            group_commit_open_group(pCommit, pGroup, pNode->fd, pNode->dev, pNode->ino);
+        }
+        pNode->fd       = -1;
+        pNode->pNext    = NULL;
+        group_commit_add(pCommit, pGroup, pNode);
+    }
+}
+
+/// Flush thread function, start writeback of joined writes and commit each group when its window
+/// ends or a barrier joined it. Only this thread waits on the device
+static void *group_commit_thread(void *arg)
+{
+    group_commit_t *pCommit = (group_commit_t *)arg;
+
+    pthread_mutex_lock(&(pCommit->lock));
+    while (true)
+    {
+        group_commit_group_t   *pReady      = NULL;
+        group_commit_group_t   *pWriteback  = NULL;
+        u64                     earliest    = UINT64_MAX;
+        u64                     now         = group_commit_now_ns();
+
+        group_commit_place_overflow(pCommit);
+
+        for (u32 i = 0; i < GROUP_COMMIT_GROUPS && NULL == pReady; i++)
+        {
+            group_commit_group_t *pGroup = &(pCommit->groups[i]);
+
+            if (pGroup->isUsed && (pGroup->isBarrier || pGroup->deadlineNs <= now))
+            {
+                pReady = pGroup;
+            }
+            else if (pGroup->isUsed)
+            {
+                earliest    = (pGroup->deadlineNs < earliest) ? pGroup->deadlineNs : earliest;
+                pWriteback  = (NULL == pWriteback && pGroup->writebackEnd > pGroup->writebackStart)
+                              ? pGroup : pWriteback;
+            }
+        }
+
+        if (NULL != pReady)
+        {
+            /// Slot is free again while flushing, writes completing meanwhile open the next group
+            group_commit_node_t        *pHead   = pReady->pHead;
+            s32                         fd      = pReady->fd;
+            async_file_durability_t     level   = pReady->level;
+            s64                         result  = 0;
+
+            memset(pReady, 0, sizeof(group_commit_group_t));
+            pthread_mutex_unlock(&(pCommit->lock));
+
+            result = group_commit_flush(fd, level);
+            close(fd);
+            group_commit_release(pHead, result);
+
+            pthread_mutex_lock(&(pCommit->lock));
+        }
+        else if (NULL != pWriteback)
+        {
+            /// Start writeback now, the window is not idle time for the device. Group fd is only
+            /// closed by this thread so it stays valid unlocked
+            s32 fd      = pWriteback->fd;
+            u64 start   = pWriteback->writebackStart;
+            u64 end     = pWriteback->writebackEnd;
+
+            pWriteback->writebackStart  = 0;
+            pWriteback->writebackEnd    = 0;
+            pthread_mutex_unlock(&(pCommit->lock));
+
+            sync_file_range(fd, (off64_t)start, (off64_t)(end - start), SYNC_FILE_RANGE_WRITE);
+
+            pthread_mutex_lock(&(pCommit->lock));
+        }
+        else if (UINT64_MAX == earliest)
+        {
+            pthread_cond_wait(&(pCommit->changed), &(pCommit->lock));
+        }
+        else
+        {
+            struct timespec deadline =
+            {
+                .tv_sec     = earliest / 1000000000,
+                .tv_nsec    = earliest % 1000000000,
+            };
+            pthread_cond_timedwait(&(pCommit->changed), &(pCommit->lock), &deadline);
+        }
+    }
+    pthread_mutex_unlock(&(pCommit->lock));
+
+    pthread_exit(NULL);
+}
+
+/// Initialize group commit once, flush thread starts with the first durable write
+void group_commit_init(group_commit_t *pCommit)
+{
+    if (!pCommit->isInitialized)
+    {
+        pthread_condattr_t attr;
+
+        memset(pCommit, 0, sizeof(group_commit_t));
+        pCommit->windowNs = (u64)GROUP_COMMIT_DEFAULT_WINDOW_US * 1000;
+
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_mutex_init(&(pCommit->lock), NULL);
+        pthread_cond_init(&(pCommit->changed), &attr);
+        pthread_condattr_destroy(&attr);
+
+        pCommit->isInitialized = TRUE;
+    }
+}
+
+/// Take commit window from accessor config, zero takes default
+void group_commit_config_init(group_commit_t *pCommit, const async_file_accessor_config_t *pConfig)
+{
+    u32 windowUs = (NULL != pConfig) ? pConfig->commitWindowUs : 0;
+
+    windowUs = (0 == windowUs) ? GROUP_COMMIT_DEFAULT_WINDOW_US
+             : (windowUs > GROUP_COMMIT_MAX_WINDOW_US) ? GROUP_COMMIT_MAX_WINDOW_US : windowUs;
+
+    pthread_mutex_lock(&(pCommit->lock));
+    pCommit->windowNs = (u64)windowUs * 1000;
+    pthread_mutex_unlock(&(pCommit->lock));
+}
+
+/// Whether request is a write that must be flushed before it completes
+bool group_commit_is_durable(const async_file_access_request_info_t *pInfo)
+{
+    return ASYNC_FILE_ACCESS_WRITE == pInfo->direction && ASYNC_FILE_DURABLE_NONE != pInfo->durability;
+}
+
+/// Queue a finished write on the group of its file, callback runs once the group is flushed.
+/// Never blocks on the device: writeback and flush run on the flush thread, a write finding
+/// no free group waits for one there. fd must stay open for the call only. Only when the flush
+/// thread cannot start or fd cannot be duplicated is the write flushed in place before return
+void group_commit_join(group_commit_t                         *pCommit,
+                       group_commit_node_t                    *pNode,
+                       s32                                     fd,
+                       const struct stat                      *pFsb,
+                       u64                                     offset,
+                       u64                                     size,
+                       const async_file_access_request_info_t *pInfo,
+                       group_commit_done_func                  callback,
+                       void                                   *arg,
+                       s64                                     result)
+{
+    group_commit_group_t   *pGroup      = NULL;
+    s32                     ownFd       = -1;
+
+    pNode->pNext        = NULL;
+    pNode->callback     = callback;
+    pNode->arg          = arg;
+    pNode->result       = result;
+    pNode->offset       = offset;
+    pNode->size         = size;
+    pNode->dev          = (u64)pFsb->st_dev;
+    pNode->ino          = (u64)pFsb->st_ino;
+    pNode->fd           = -1;
+    pNode->level        = pInfo->durability;
+    pNode->isBarrier    = pInfo->isBarrier;
+
+    pthread_mutex_lock(&(pCommit->lock));
+
+    /// Flush thread is started lazily, accessors never asked for durability do not pay for it
+    if (!pCommit->isStarted)
+    {
+        s32 res = pthread_create(&(pCommit->thread), NULL, group_commit_thread, pCommit);
+
+        pCommit->isStarted = (0 == res);
+        if (!pCommit->isStarted)
+        {
+            printf("Error: group commit thread create fail, flushing in place! error: %d - %s.\n", res, strerror(res));
+        }
+    }
+
+    pGroup = pCommit->isStarted ? group_commit_find_group(pCommit, pNode->dev, pNode->ino) : NULL;
+
+    /// A new group or a write waiting for one owns a dup, the flush does not depend on when
+    /// members close their fds
+    if (pCommit->isStarted && (NULL == pGroup || !pGroup->isUsed))
+    {
+        ownFd = dup(fd);
+        if (ownFd < 0)
+        {
+            printf("Error: fail to dup fd of group commit! error: %d - %s.\n", errno, strerror(errno));
+        }
+    }
+
+    if (NULL != pGroup && (pGroup->isUsed || ownFd >= 0))
+    {
+        if (!pGroup->isUsed)
+        {
+            group_commit_open_group(pCommit, pGroup, ownFd, pNode->dev, pNode->ino);
+        }
+        group_commit_add(pCommit, pGroup, pNode);
+    }
+    else if (ownFd >= 0)
+    {
+        /// All groups are busy, the write waits on the flush thread for one instead of
+        /// holding its caller, often a completion thread, behind a device flush
+        pNode->fd = ownFd;
+        if (NULL == pCommit->pOverflowHead)
+        {
+            pCommit->pOverflowHead = pNode;
+            pthread_cond_signal(&(pCommit->changed));
+        }
+        else
+        {
+            pCommit->pOverflowTail->pNext = pNode;
+        }
+        pCommit->pOverflowTail = pNode;
+    }
+    else
+    {
+        pGroup = NULL;
+    }
+
+    pthread_mutex_unlock(&(pCommit->lock));
+
+    if (NULL == pGroup && ownFd < 0)
+    {
+        group_commit_release(pNode, group_commit_flush(fd, pInfo->durability));
+    }
+}
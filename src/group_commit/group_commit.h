@@ -0,0 +1,108 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : group_commit.h
+ * Description  : Gather durable writes of a file completing close in time and flush
+                  them with one fdatasync/fsync, releasing all their waiters together.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __GROUP_COMMIT_H__
+#define __GROUP_COMMIT_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GROUP_COMMIT_GROUPS             32                      /// files with a flush pending at once
+#define GROUP_COMMIT_DEFAULT_WINDOW_US  2000                    /// how long a group waits for more writes
+#define GROUP_COMMIT_MAX_WINDOW_US      1000000                 /// upper bound of configured window
+
+/// Called on flush thread once the write is durable, result is its I/O result or -errno of the flush
+typedef void (*group_commit_done_func)(void *arg, s64 result);
+
+/// struct define a write waiting for its group flush, embedded in the request
+typedef struct __group_commit_node
+{
+    struct __group_commit_node     *pNext;                  /// next write of the group or overflow
+    group_commit_done_func          callback;               /// completes the request
+    void                           *arg;                    /// callback argument
+    s64                             result;                 /// I/O result of the write
+    u64                             offset;                 /// file offset of the write
+    u64                             size;                   /// bytes of the write
+    u64                             dev;                    /// device of the file
+    u64                             ino;                    /// inode of the file
+    s32                             fd;                     /// overflow: own dup of the write fd until it gets a group
+    async_file_durability_t         level;                  /// durability the write asked for
+    bool                            isBarrier;              /// write asked its group to flush now
+
+} group_commit_node_t;
+
+/// struct define the pending flush of one file
+typedef struct __group_commit_group
+{
+    u64                             dev;                    /// device of the file
+    u64                             ino;                    /// inode of the file
+    s32                             fd;                     /// own dup of a member fd, closed after flush
+    async_file_durability_t         level;                  /// strongest durability of the members
+    group_commit_node_t            *pHead;                  /// members in join order
+    group_commit_node_t            *pTail;                  /// last member
+    u64                             writebackStart;         /// range of members whose writeback is not started yet
+    u64                             writebackEnd;           /// empty when not above writebackStart
+    u64                             deadlineNs;             /// CLOCK_MONOTONIC time the group is flushed
+    bool                            isBarrier;              /// a barrier joined, flush without waiting
+    bool                            isUsed;                 /// slot holds a group
+
+} group_commit_group_t;
+
+/// struct define per accessor group commit stage
+typedef struct __group_commit
+{
+    group_commit_group_t            groups[GROUP_COMMIT_GROUPS];
+    group_commit_node_t            *pOverflowHead;          /// writes waiting for a free group, in join order
+    group_commit_node_t            *pOverflowTail;          /// last waiting write
+    u64                             windowNs;               /// how long a group waits for more writes
+    pthread_t                       thread;                 /// flush thread, started by first durable write
+    pthread_mutex_t                 lock;                   /// groups lock
+    pthread_cond_t                  changed;                /// group, writeback, overflow or barrier added
+    bool                            isStarted;              /// whether flush thread runs
+    bool                            isInitialized;          /// whether lock is set up
+
+} group_commit_t;
+
+
+/// Initialize group commit once, flush thread starts with the first durable write
+void group_commit_init(group_commit_t *pCommit);
+
+/// Take commit window from accessor config, zero takes default
+void group_commit_config_init(group_commit_t *pCommit, const async_file_accessor_config_t *pConfig);
+
+/// Whether request is a write that must be flushed before it completes
+bool group_commit_is_durable(const async_file_access_request_info_t *pInfo);
+
+/// Queue a finished write on the group of its file, callback runs once the group is flushed.
+/// Never blocks on the device: writeback and flush run on the flush thread, a write finding
+/// no free group waits for one there. fd must stay open for the call only. Only when the flush
+/// thread cannot start or fd cannot be duplicated is the write flushed in place before return
+void group_commit_join(group_commit_t                         *pCommit,
+                       group_commit_node_t                    *pNode,
+                       s32                                     fd,
+                       const struct stat                      *pFsb,
+                       u64                                     offset,
+                       u64                                     size,
+                       const async_file_access_request_info_t *pInfo,
+                       group_commit_done_func                  callback,
+                       void                                   *arg,
+                       s64                                     result);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __GROUP_COMMIT_H__ */
@@ -0,0 +1,152 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : io_scheduler.c
+ * Description  : Order a batch of requests by file and offset and merge contiguous
+                  ranges into one vectored I/O that completes back into its members.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "io_scheduler.h"
+
+/// Fill merge settings from accessor config, zero or missing fields take defaults
+void io_sched_config_init(io_sched_config_t *pSchedConfig, const async_file_accessor_config_t *pConfig)
+{
+    pSchedConfig->window    = (NULL != pConfig && pConfig->mergeWindow > 0) ? pConfig->mergeWindow
+                                                                            : IO_SCHED_DEFAULT_WINDOW;
+    pSchedConfig->window    = (pSchedConfig->window > IO_SCHED_MAX_WINDOW) ? IO_SCHED_MAX_WINDOW
+                                                                           : pSchedConfig->window;
+    pSchedConfig->gap       = (NULL != pConfig) ? pConfig->mergeGap : 0;
+}
+
+/// Order by priority rank, device, inode, offset, then batch position
+static s32 io_sched_compare(const void *pLeft, const void *pRight)
+{
+    const io_sched_entry_t *l = (const io_sched_entry_t *)pLeft;
+    const io_sched_entry_t *r = (const io_sched_entry_t *)pRight;
+
+    return (l->rank != r->rank)     ? ((l->rank < r->rank) ? -1 : 1)
+         : (l->dev != r->dev)       ? ((l->dev < r->dev) ? -1 : 1)
+         : (l->ino != r->ino)       ? ((l->ino < r->ino) ? -1 : 1)
+         : (l->offset != r->offset) ? ((l->offset < r->offset) ? -1 : 1)
+         : (l->index < r->index)    ? -1 : (l->index > r->index);
+}
+
+/// Sort entries by priority rank, device, inode and offset, batch order breaks ties
+void io_sched_sort(io_sched_entry_t *pEntries, u32 count)
+{
+    qsort(pEntries, count, sizeof(io_sched_entry_t), io_sched_compare);
+}
+
+/// Count of sorted entries from pEntries[0] that one merged I/O can carry, 1 if none merge
+u32 io_sched_run(const io_sched_config_t *pSchedConfig, const io_sched_entry_t *pEntries, u32 count)
+{
+    u64 start       = pEntries[0].offset;
+    u64 end         = start + pEntries[0].size;
+    u32 segments    = 1;
+    u32 run         = 1;
+
+    for (; pEntries[0].isMergeable && run < count; run++)
+    {
+        const io_sched_entry_t *pNext = &(pEntries[run]);
+
+        /// Overlapping ranges keep their own I/O, a hole costs one scratch segment
+        u64 gap     = (pNext->offset >= end) ? pNext->offset - end : 0;
+        u32 needed  = (gap > 0) ? 2 : 1;
+
+        if (!pNext->isMergeable || pNext->rank != pEntries[0].rank              ||
+            pNext->dev != pEntries[0].dev || pNext->ino != pEntries[0].ino      ||
+            pNext->direction != pEntries[0].direction                           ||
+            pNext->offset < end                                                 ||
+            (gap > 0 && (ASYNC_FILE_ACCESS_READ != pNext->direction || gap > pSchedConfig->gap)) ||
+            pNext->offset + pNext->size - start > pSchedConfig->window          ||
+            segments + needed > ASYNC_FILE_MAX_IOVEC)
+        {
+            break;
+        }
+
+        end         = pNext->offset + pNext->size;
+        segments   += needed;
+    }
+
+    return run;
+}
+
+/// Build member table and segments of a merged I/O over run, holes of reads land in scratch
+ret_t io_sched_merge(const io_sched_entry_t *pRun, u32 count, io_merge_t *pMerge, io_vector_t *pVector)
+{
+    ret_t           res     = RET_OK;
+    u64             maxGap  = 0;
+    u64             end     = pRun[0].offset;
+    u32             n       = 0;
+    struct iovec    iov[ASYNC_FILE_MAX_IOVEC];
+
+    for (u32 i = 1; i < count; i++)
+    {
+        u64 gap = pRun[i].offset - (pRun[i - 1].offset + pRun[i - 1].size);
+        maxGap  = (gap > maxGap) ? gap : maxGap;
+    }
+
+    memset(pMerge, 0, sizeof(io_merge_t));
+    pMerge->ppMembers   = (async_file_access_request_t **)calloc(count, sizeof(async_file_access_request_t *));
+    pMerge->scratch     = (maxGap > 0) ? malloc(maxGap) : NULL;
+    if (NULL == pMerge->ppMembers || (maxGap > 0 && NULL == pMerge->scratch))
+    {
+        res = RET_NO_MEMORY;
+        printf("Error: merged request alloc fail! res = %d.\n", res);
+    }
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        if (pRun[i].offset > end)
+        {
+            iov[n].iov_base = pMerge->scratch;
+            iov[n].iov_len  = pRun[i].offset - end;
+            n++;
+        }
+        iov[n].iov_base         = pRun[i].buf;
+        iov[n].iov_len          = pRun[i].size;
+        n++;
+        end                     = pRun[i].offset + pRun[i].size;
+        pMerge->ppMembers[i]    = (async_file_access_request_t *)pRun[i].pRequest;
+    }
+
+    res = (RET_OK == res) ? io_vector_import(pVector, iov, n, end - pRun[0].offset) : res;
+
+    if (RET_OK == res)
+    {
+        pMerge->count   = count;
+        pMerge->pending = count;
+    }
+    else
+    {
+        io_merge_reset(pMerge);
+    }
+
+    return res;
+}
+
+/// Part of a merged I/O result that belongs to a member
+s64 io_sched_share(s64 result, u64 carrierOffset, u64 memberOffset, u64 memberSize)
+{
+    s64 done = result - (s64)(memberOffset - carrierOffset);
+
+    return (result < 0) ? result : (done < 0) ? 0 : (done > (s64)memberSize) ? (s64)memberSize : done;
+}
+
+/// Drop one member, TRUE for the last one, carrier may go back to pool then
+bool io_merge_member_done(io_merge_t *pMerge)
+{
+    return __atomic_sub_fetch(&(pMerge->pending), 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+/// Free member table and scratch buffers
+void io_merge_reset(io_merge_t *pMerge)
+{
+    free(pMerge->ppMembers);
+    free(pMerge->scratch);
+    free(pMerge->bounce);
+    memset(pMerge, 0, sizeof(io_merge_t));
+}
@@ -0,0 +1,89 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : io_scheduler.h
+ * Description  : Order a batch of requests by file and offset and merge contiguous
+                  ranges into one vectored I/O that completes back into its members.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __IO_SCHEDULER_H__
+#define __IO_SCHEDULER_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+#include "io_vector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IO_SCHED_DEFAULT_WINDOW         (512ULL << 10)          /// max span of one merged I/O
+#define IO_SCHED_MAX_WINDOW             (1ULL << 30)            /// one read/write syscall moves at most ~2 GiB
+
+/// struct define how a batch is merged
+typedef struct __io_sched_config
+{
+    u64                             window;                 /// max span of one merged I/O
+    u64                             gap;                    /// max hole between merged reads
+
+} io_sched_config_t;
+
+/// struct define one batch entry as the scheduler sees it
+typedef struct __io_sched_entry
+{
+    void                           *pRequest;               /// backend request
+    void                           *buf;                    /// contiguous data buffer
+    u64                             dev;                    /// device of the file
+    u64                             ino;                    /// inode of the file
+    u64                             offset;                 /// file offset
+    u64                             size;                   /// data length
+    u32                             direction;              /// read or write
+    u32                             index;                  /// position in batch, keeps order stable
+    u32                             rank;                   /// priority rank, lower is submitted first
+    bool                            isMergeable;            /// plain single buffer request
+
+} io_sched_entry_t;
+
+/// struct define merge state, on a merged request it tracks members, on a member its carrier
+typedef struct __io_merge
+{
+    async_file_access_request_t    *pCarrier;               /// merged request of a member, NULL otherwise
+    async_file_access_request_t   **ppMembers;              /// requests carried, sorted by offset
+    u32                             count;                  /// member count, 0 if not a merged request
+    u32                             pending;                /// members not released yet
+    void                           *scratch;                /// sink of holes between merged reads
+    void                           *bounce;                 /// contiguous copy for backends without vectored I/O
+
+} io_merge_t;
+
+
+/// Fill merge settings from accessor config, zero or missing fields take defaults
+void io_sched_config_init(io_sched_config_t *pSchedConfig, const async_file_accessor_config_t *pConfig);
+
+/// Sort entries by priority rank, device, inode and offset, batch order breaks ties
+void io_sched_sort(io_sched_entry_t *pEntries, u32 count);
+
+/// Count of sorted entries from pEntries[0] that one merged I/O can carry, 1 if none merge
+u32 io_sched_run(const io_sched_config_t *pSchedConfig, const io_sched_entry_t *pEntries, u32 count);
+
+/// Build member table and segments of a merged I/O over run, holes of reads land in scratch
+ret_t io_sched_merge(const io_sched_entry_t *pRun, u32 count, io_merge_t *pMerge, io_vector_t *pVector);
+
+/// Part of a merged I/O result that belongs to a member
+s64 io_sched_share(s64 result, u64 carrierOffset, u64 memberOffset, u64 memberSize);
+
+/// Drop one member, TRUE for the last one, carrier may go back to pool then
+bool io_merge_member_done(io_merge_t *pMerge);
+
+/// Free member table and scratch buffers
+void io_merge_reset(io_merge_t *pMerge);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __IO_SCHEDULER_H__ */
@@ -0,0 +1,326 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : io_stats.c
+ * Description  : Per accessor op, byte and latency counters of each direction, kept in
+                  per thread shards so recording takes no lock.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "io_stats.h"
+
+static __thread u32 t_ioStatsShard      = 0;    /// shard index + 1 of calling thread, 0 until it records
+static u32          s_ioStatsNextShard  = 0;    /// threads are dealt shards round robin
+
+static u64 io_stats_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Time from one stamp to a later one, 0 when the first is missing or clocks were read out of order
+static u64 io_stats_span(u64 fromNs, u64 toNs)
+{
+    return (0 != fromNs && toNs > fromNs) ? toNs - fromNs : 0;
+}
+
+/// Histogram bucket of a latency, ns below 8 get one bucket each, then 8 per power of 2
+static u32 io_stats_bucket(u64 latencyNs)
+{
+    u32 log     = (latencyNs < 8) ? 0 : 63 - __builtin_clzll(latencyNs);
+    u32 bucket  = (latencyNs < 8) ? (u32)latencyNs : (log - 2) * 8 + (u32)((latencyNs >> (log - 3)) & 7);
+
+    return (bucket < IO_STATS_BUCKETS) ? bucket : IO_STATS_BUCKETS - 1;
+}
+
+/// Upper bound in ns of a histogram bucket
+static u64 io_stats_bucket_ns(u32 bucket)
+{
+    u32 log = bucket / 8 + 2;
+
+    return (bucket < 8) ? bucket : ((u64)(9 + bucket % 8) << (log - 3)) - 1;
+}
+
+/// Shard of calling thread, allocated on its first record. NULL when out of memory, the sample is dropped
+static io_stats_shard_t *io_stats_shard(io_stats_t *pStats)
+{
+    io_stats_shard_t  **ppSlot  = NULL;
+    io_stats_shard_t   *pShard  = NULL;
+    io_stats_shard_t   *pNew    = NULL;
+
+    if (0 == t_ioStatsShard)
+    {
+        t_ioStatsShard = __atomic_fetch_add(&s_ioStatsNextShard, 1, __ATOMIC_RELAXED) % IO_STATS_SHARDS + 1;
+    }
+
+    ppSlot = &(pStats->pShards[t_ioStatsShard - 1]);
+    pShard = __atomic_load_n(ppSlot, __ATOMIC_ACQUIRE);
+    if (NULL == pShard && 0 == posix_memalign((void **)&pNew, 64, sizeof(io_stats_shard_t)))
+    {
+        memset(pNew, 0, sizeof(io_stats_shard_t));
+
+        /// Threads dealt the same slot race to fill it, losers use the winner's
+        if (__atomic_compare_exchange_n(ppSlot, &pShard, pNew, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            pShard = pNew;
+        }
+        else
+        {
+            free(pNew);
+        }
+    }
+
+    return pShard;
+}
+
+/// Count one latency of a stage. Atomic only because threads past IO_STATS_SHARDS share a shard,
+/// the line is normally owned by the calling thread alone
+static void io_stats_add(io_stats_stage_t *pStage, u64 latencyNs)
+{
+    __atomic_add_fetch(&(pStage->count), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(pStage->totalNs), latencyNs, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(pStage->histogram[io_stats_bucket(latencyNs)]), 1, __ATOMIC_RELAXED);
+}
+
+/// Add up all shards into pSum, must hold stats lock
+static void io_stats_sum(io_stats_t *pStats, io_stats_shard_t *pSum)
+{
+    memset(pSum, 0, sizeof(io_stats_shard_t));
+
+    for (u32 s = 0; s < IO_STATS_SHARDS; s++)
+    {
+        io_stats_shard_t *pShard = __atomic_load_n(&(pStats->pShards[s]), __ATOMIC_ACQUIRE);
+        if (NULL == pShard)
+        {
+            continue;
+        }
+
+        for (u32 d = 0; d < ASYNC_FILE_ACCESS_MAX; d++)
+        {
+            io_stats_direction_t *pIn   = &(pShard->directions[d]);
+            io_stats_direction_t *pOut  = &(pSum->directions[d]);
+
+            pOut->ops       += __atomic_load_n(&(pIn->ops), __ATOMIC_RELAXED);
+            pOut->errors    += __atomic_load_n(&(pIn->errors), __ATOMIC_RELAXED);
+            pOut->bytes     += __atomic_load_n(&(pIn->bytes), __ATOMIC_RELAXED);
+            for (u32 t = 0; t < ASYNC_FILE_STAGE_MAX; t++)
+            {
+                pOut->stages[t].count   += __atomic_load_n(&(pIn->stages[t].count), __ATOMIC_RELAXED);
+                pOut->stages[t].totalNs += __atomic_load_n(&(pIn->stages[t].totalNs), __ATOMIC_RELAXED);
+                for (u32 b = 0; b < IO_STATS_BUCKETS; b++)
+                {
+                    pOut->stages[t].histogram[b] += __atomic_load_n(&(pIn->stages[t].histogram[b]), __ATOMIC_RELAXED);
+                }
+            }
+        }
+    }
+}
+
+/// Latency at rank of the count given as parts per thousand
+static u64 io_stats_percentile(const u64 *pHistogram, u64 count, u64 perMille)
+{
+    u64 target  = (count * perMille + 999) / 1000;
+    u64 seen    = 0;
+
+    for (u32 b = 0; b < IO_STATS_BUCKETS; b++)
+    {
+        seen += pHistogram[b];
+        if (seen >= target)
+        {
+            return io_stats_bucket_ns(b);
+        }
+    }
+
+    return io_stats_bucket_ns(IO_STATS_BUCKETS - 1);
+}
+
+/// Distribution of a stage since reset, base is NULL before the first reset
+static void io_stats_fill_stage(const io_stats_stage_t *pNow, const io_stats_stage_t *pBase,
+                                async_file_latency_stats_t *pOut)
+{
+    u64 histogram[IO_STATS_BUCKETS];
+    u64 count = 0;
+
+    /// Counters only grow, so each one is at least what it was at reset. Count is taken from the
+    /// histogram itself, records racing with the snapshot may be half in
+    for (u32 b = 0; b < IO_STATS_BUCKETS; b++)
+    {
+        histogram[b]    = pNow->histogram[b] - ((NULL != pBase) ? pBase->histogram[b] : 0);
+        count          += histogram[b];
+    }
+
+    memset(pOut, 0, sizeof(async_file_latency_stats_t));
+    if (0 == count)
+    {
+        return;
+    }
+
+    pOut->count     = count;
+    pOut->meanNs    = (pNow->totalNs - ((NULL != pBase) ? pBase->totalNs : 0)) / count;
+    pOut->p50Ns     = io_stats_percentile(histogram, count, 500);
+    pOut->p99Ns     = io_stats_percentile(histogram, count, 990);
+    pOut->p999Ns    = io_stats_percentile(histogram, count, 999);
+    pOut->maxNs     = io_stats_percentile(histogram, count, 1000);
+}
+
+/// Initialize empty statistics once
+void io_stats_init(io_stats_t *pStats)
+{
+    if (!pStats->isInitialized)
+    {
+        memset(pStats, 0, sizeof(io_stats_t));
+        pthread_mutex_init(&(pStats->lock), NULL);
+        pStats->resetNs         = io_stats_now_ns();
+        pStats->isInitialized   = TRUE;
+    }
+}
+
+/// Count a finished request timed at get, put and start of service, 0 for a stamp it never got.
+/// Return completion time, wait or reap return is timed from it
+u64 io_stats_record(io_stats_t                     *pStats,
+                    async_file_access_direction_t   direction,
+                    bool                            isSuccess,
+                    u64                             bytes,
+                    u64                             getNs,
+                    u64                             putNs,
+                    u64                             startNs)
+{
+    u64                     now     = io_stats_now_ns();
+    io_stats_shard_t       *pShard  = io_stats_shard(pStats);
+    io_stats_direction_t   *pDir    = NULL;
+
+    if (NULL == pShard || direction >= ASYNC_FILE_ACCESS_MAX)
+    {
+        return now;
+    }
+
+    /// Requests served on put, like cache hits, never waited for service
+    startNs = (0 == startNs) ? putNs : startNs;
+    pDir    = &(pShard->directions[direction]);
+
+    __atomic_add_fetch(&(pDir->ops), 1, __ATOMIC_RELAXED);
+    if (isSuccess)
+    {
+        __atomic_add_fetch(&(pDir->bytes), bytes, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_add_fetch(&(pDir->errors), 1, __ATOMIC_RELAXED);
+    }
+
+    if (0 != getNs)
+    {
+        io_stats_add(&(pDir->stages[ASYNC_FILE_STAGE_SETUP]), io_stats_span(getNs, putNs));
+    }
+    io_stats_add(&(pDir->stages[ASYNC_FILE_STAGE_QUEUE]), io_stats_span(putNs, startNs));
+    io_stats_add(&(pDir->stages[ASYNC_FILE_STAGE_SERVICE]), io_stats_span(startNs, now));
+    io_stats_add(&(pDir->stages[ASYNC_FILE_STAGE_TOTAL]), io_stats_span(putNs, now));
+
+    return now;
+}
+
+/// Time a wait or reap return of a request completed at *pDoneNs, only the first return of a
+/// completion counts so *pDoneNs is cleared
+void io_stats_wakeup(io_stats_t *pStats, async_file_access_direction_t direction, u64 *pDoneNs)
+{
+    u64                 doneNs  = __atomic_exchange_n(pDoneNs, 0, __ATOMIC_RELAXED);
+    io_stats_shard_t   *pShard  = NULL;
+
+    if (0 == doneNs || direction >= ASYNC_FILE_ACCESS_MAX)
+    {
+        return;
+    }
+
+    pShard = io_stats_shard(pStats);
+    if (NULL != pShard)
+    {
+        io_stats_add(&(pShard->directions[direction].stages[ASYNC_FILE_STAGE_WAKEUP]),
+                     io_stats_span(doneNs, io_stats_now_ns()));
+    }
+}
+
+/// Snapshot of counters since last reset, percentiles come from the histograms
+void io_stats_get(io_stats_t *pStats, async_file_stats_t *pOut)
+{
+    io_stats_shard_t   *pSum    = NULL;
+    u64                 now     = io_stats_now_ns();
+
+    memset(pOut, 0, sizeof(async_file_stats_t));
+    if (0 != posix_memalign((void **)&pSum, 64, sizeof(io_stats_shard_t)))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&(pStats->lock));
+    io_stats_sum(pStats, pSum);
+
+    pOut->elapsedNs = io_stats_span(pStats->resetNs, now);
+    for (u32 d = 0; d < ASYNC_FILE_ACCESS_MAX; d++)
+    {
+        io_stats_direction_t           *pNow    = &(pSum->directions[d]);
+        io_stats_direction_t           *pBase   = (NULL != pStats->pBase) ? &(pStats->pBase->directions[d]) : NULL;
+        async_file_direction_stats_t   *pDir    = &(pOut->directions[d]);
+
+        pDir->ops           = pNow->ops - ((NULL != pBase) ? pBase->ops : 0);
+        pDir->errors        = pNow->errors - ((NULL != pBase) ? pBase->errors : 0);
+        pDir->bytes         = pNow->bytes - ((NULL != pBase) ? pBase->bytes : 0);
+        pDir->bytesPerSec   = (pOut->elapsedNs > 0)
+                            ? (u64)((double)pDir->bytes * 1000000000.0 / (double)pOut->elapsedNs) : 0;
+
+        for (u32 t = 0; t < ASYNC_FILE_STAGE_MAX; t++)
+        {
+            io_stats_fill_stage(&(pNow->stages[t]), (NULL != pBase) ? &(pBase->stages[t]) : NULL, &(pDir->stages[t]));
+        }
+    }
+    pthread_mutex_unlock(&(pStats->lock));
+
+    free(pSum);
+}
+
+/// Start counters over, shards keep counting and snapshots subtract totals taken here
+void io_stats_reset(io_stats_t *pStats)
+{
+    io_stats_shard_t *pBase = NULL;
+
+    pthread_mutex_lock(&(pStats->lock));
+
+    /// Base is allocated once and kept, a failed allocation leaves counters running from the last reset
+    if (NULL == pStats->pBase && 0 == posix_memalign((void **)&pBase, 64, sizeof(io_stats_shard_t)))
+    {
+        pStats->pBase = pBase;
+    }
+
+    if (NULL != pStats->pBase)
+    {
+        io_stats_sum(pStats, pStats->pBase);
+        pStats->resetNs = io_stats_now_ns();
+    }
+
+    pthread_mutex_unlock(&(pStats->lock));
+}
+
+/// Counters of a direction since creation, resets do not apply. Lock free, for pollers computing rates
+void io_stats_get_totals(io_stats_t                     *pStats,
+                         async_file_access_direction_t   direction,
+                         u64                            *pOps,
+                         u64                            *pErrors,
+                         u64                            *pBytes)
+{
+    *pOps       = 0;
+    *pErrors    = 0;
+    *pBytes     = 0;
+
+    for (u32 s = 0; s < IO_STATS_SHARDS; s++)
+    {
+        io_stats_shard_t *pShard = __atomic_load_n(&(pStats->pShards[s]), __ATOMIC_ACQUIRE);
+        if (NULL != pShard)
+        {
+            *pOps      += __atomic_load_n(&(pShard->directions[direction].ops), __ATOMIC_RELAXED);
+            *pErrors   += __atomic_load_n(&(pShard->directions[direction].errors), __ATOMIC_RELAXED);
+            *pBytes    += __atomic_load_n(&(pShard->directions[direction].bytes), __ATOMIC_RELAXED);
+        }
+    }
+}
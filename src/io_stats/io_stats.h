@@ -0,0 +1,101 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : io_stats.h
+ * Description  : Per accessor op, byte and latency counters of each direction, kept in
+                  per thread shards so recording takes no lock.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __IO_STATS_H__
+#define __IO_STATS_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IO_STATS_SHARDS                 32                      /// counter sets, threads beyond this share them
+#define IO_STATS_BUCKETS                328                     /// latency histogram, 8 buckets per power of 2 up to 2^42 ns
+
+/// struct define latency counters of a stage
+typedef struct __io_stats_stage
+{
+    u64                             count;                  /// requests timed
+    u64                             totalNs;                /// summed latency
+    u64                             histogram[IO_STATS_BUCKETS];
+                                                            /// requests per latency bucket
+
+} io_stats_stage_t;
+
+/// struct define counters of a direction
+typedef struct __io_stats_direction
+{
+    u64                             ops;                    /// requests finished
+    u64                             errors;                 /// requests failed or canceled
+    u64                             bytes;                  /// data bytes of successful requests
+    io_stats_stage_t                stages[ASYNC_FILE_STAGE_MAX];
+                                                            /// latency per stage
+
+} io_stats_direction_t;
+
+/// struct define counter set threads record into, cache line aligned so shards never share a line
+typedef struct __io_stats_shard
+{
+    io_stats_direction_t            directions[ASYNC_FILE_ACCESS_MAX];
+
+} __attribute__((aligned(64))) io_stats_shard_t;
+
+/// struct define per accessor statistics
+typedef struct __io_stats
+{
+    io_stats_shard_t               *pShards[IO_STATS_SHARDS];
+                                                            /// allocated by first thread recording into it
+    io_stats_shard_t               *pBase;                  /// totals at last reset, NULL before any
+    u64                             resetNs;                /// CLOCK_MONOTONIC time of creation or last reset
+    pthread_mutex_t                 lock;                   /// serializes snapshots and resets, recording never takes it
+    bool                            isInitialized;          /// whether lock is set up
+
+} io_stats_t;
+
+
+/// Initialize empty statistics once
+void io_stats_init(io_stats_t *pStats);
+
+/// Count a finished request timed at get, put and start of service, 0 for a stamp it never got.
+/// Return completion time, wait or reap return is timed from it
+u64 io_stats_record(io_stats_t                     *pStats,
+                    async_file_access_direction_t   direction,
+                    bool                            isSuccess,
+                    u64                             bytes,
+                    u64                             getNs,
+                    u64                             putNs,
+                    u64                             startNs);
+
+/// Time a wait or reap return of a request completed at *pDoneNs, only the first return of a
+/// completion counts so *pDoneNs is cleared
+void io_stats_wakeup(io_stats_t *pStats, async_file_access_direction_t direction, u64 *pDoneNs);
+
+/// Snapshot of counters since last reset, percentiles come from the histograms
+void io_stats_get(io_stats_t *pStats, async_file_stats_t *pOut);
+
+/// Start counters over, shards keep counting and snapshots subtract totals taken here
+void io_stats_reset(io_stats_t *pStats);
+
+/// Counters of a direction since creation, resets do not apply. Lock free, for pollers computing rates
+void io_stats_get_totals(io_stats_t                     *pStats,
+                         async_file_access_direction_t   direction,
+                         u64                            *pOps,
+                         u64                            *pErrors,
+                         u64                            *pBytes);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __IO_STATS_H__ */
@@ -0,0 +1,384 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : io_trace.c
+ * Description  : Optional request lifecycle tracing, threads log binary events into
+                  their own rings and a dump writes them as Chrome trace_event JSON.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sys/syscall.h>
+#include "io_trace.h"
+
+/// Span a request event opens until the next event of the request
+static const char8 *s_traceSpans[IO_TRACE_WAKEUP] =
+{
+    "setup", "admit", "submit", "dispatched", "service", "commit", "completed",
+};
+
+/// Category of events of each accessor type, request handles are only unique within one
+static const char8 *s_traceAccessors[ASYNC_FILE_ACCESSOR_MAX] = { "aio", "mmap", "uring", "aio_native" };
+
+bool                            g_ioTraceEnabled    = FALSE;
+static io_trace_ring_t         *s_traceRings        = NULL;                     /// every ring made so far
+static u64                      s_traceGeneration   = 0;                        /// bumped by each start
+static u32                      s_traceEvents       = IO_TRACE_DEFAULT_EVENTS;  /// size of rings made from now on
+static u64                      s_traceStartTsc     = 0;                        /// tsc at start, dump converts from it
+static u64                      s_traceStartNs      = 0;                        /// CLOCK_MONOTONIC at start
+static pthread_mutex_t          s_traceLock         = PTHREAD_MUTEX_INITIALIZER;/// serializes start and dump
+static pthread_once_t           s_traceOnce         = PTHREAD_ONCE_INIT;
+static pthread_key_t            s_traceKey;                                     /// frees ring of an exiting thread
+static __thread io_trace_ring_t *t_traceRing        = NULL;
+static __thread s32             t_traceTid          = 0;
+
+static u64 io_trace_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Cheapest clock of the CPU, dump scales it by the clock rate seen since start
+static u64 io_trace_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return io_trace_now_ns();
+#endif
+}
+
+/// Thread exit destructor, ring stays in the registry with its events for the next new thread
+static void io_trace_thread_exit(void *arg)
+{
+    __atomic_store_n(&(((io_trace_ring_t *)arg)->isOwned), FALSE, __ATOMIC_RELEASE);
+}
+
+static void io_trace_key_init()
+{
+    pthread_key_create(&s_traceKey, io_trace_thread_exit);
+}
+
+/// Ring of calling thread on its first event. A ring left by an exited thread is taken over,
+/// short lived threads like aio notifiers would pile up rings otherwise
+static io_trace_ring_t *io_trace_ring_acquire()
+{
+    io_trace_ring_t    *pRing   = NULL;
+    u32                 events  = __atomic_load_n(&s_traceEvents, __ATOMIC_RELAXED);
+
+    pthread_once(&s_traceOnce, io_trace_key_init);
+
+    for (io_trace_ring_t *p = __atomic_load_n(&s_traceRings, __ATOMIC_ACQUIRE); NULL != p && NULL == pRing; p = p->pNext)
+    {
+        bool isOwned = FALSE;
+
+        if (!__atomic_load_n(&(p->isOwned), __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(&(p->isOwned), &isOwned, TRUE, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            pRing = p;
+        }
+    }
+
+    if (NULL == pRing)
+    {
+        pRing = (io_trace_ring_t *)malloc(sizeof(io_trace_ring_t) + sizeof(io_trace_event_t) * events);
+        if (NULL == pRing)
+        {
+            return NULL;
+        }
+
+        pRing->isOwned      = TRUE;
+        pRing->generation   = 0;
+        pRing->head         = 0;
+        pRing->mask         = events - 1;
+        pRing->pNext        = __atomic_load_n(&s_traceRings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&s_traceRings, &(pRing->pNext), pRing, TRUE, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+        {
+        }
+    }
+
+    pthread_setspecific(s_traceKey, pRing);
+    t_traceRing = pRing;
+    t_traceTid  = (s32)syscall(SYS_gettid);
+
+    return pRing;
+}
+
+/// Record an event into ring of calling thread, oldest events are overwritten once it is full
+void io_trace_record(io_trace_phase_t phase, u32 accessor, u32 id)
+{
+    io_trace_ring_t    *pRing       = (NULL != t_traceRing) ? t_traceRing : io_trace_ring_acquire();
+    u64                 generation  = __atomic_load_n(&s_traceGeneration, __ATOMIC_ACQUIRE);
+    io_trace_event_t   *pEvent      = NULL;
+
+    if (NULL == pRing)
+    {
+        return;
+    }
+
+    /// A new recording starts the ring over, only its owner moves head
+    if (pRing->generation != generation)
+    {
+        __atomic_store_n(&(pRing->head), 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&(pRing->generation), generation, __ATOMIC_RELEASE);
+    }
+
+    pEvent              = &(pRing->events[pRing->head & pRing->mask]);
+    pEvent->tsc         = io_trace_tsc();
+    pEvent->id          = id;
+    pEvent->tid         = t_traceTid;
+    pEvent->phase       = (u8)phase;
+    pEvent->accessor    = (u8)accessor;
+
+    /// Publishes the event, a dump reads up to head
+    __atomic_store_n(&(pRing->head), pRing->head + 1, __ATOMIC_RELEASE);
+}
+
+/// Drop recorded events and start recording, eventsPerThread is rounded up to a power of 2,
+/// 0 takes the default. Rings made before keep their size
+ret_t io_trace_start(u32 eventsPerThread)
+{
+    u32 events = (0 == eventsPerThread) ? IO_TRACE_DEFAULT_EVENTS : eventsPerThread;
+
+    if (events > IO_TRACE_MAX_EVENTS)
+    {
+        printf("Error: trace ring of %u events is over %u! res = %d.\n", events, IO_TRACE_MAX_EVENTS, RET_BAD_VALUE);
+        return RET_BAD_VALUE;
+    }
+    events = (events > 1) ? 1U << (32 - __builtin_clz(events - 1)) : 2;
+
+    pthread_mutex_lock(&s_traceLock);
+    __atomic_store_n(&s_traceEvents, events, __ATOMIC_RELAXED);
+    s_traceStartTsc = io_trace_tsc();
+    s_traceStartNs  = io_trace_now_ns();
+    __atomic_add_fetch(&s_traceGeneration, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_ioTraceEnabled, TRUE, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&s_traceLock);
+
+    return RET_OK;
+}
+
+/// Stop recording, events stay for io_trace_dump
+void io_trace_stop()
+{
+    __atomic_store_n(&g_ioTraceEnabled, FALSE, __ATOMIC_RELEASE);
+}
+
+/// Whether an event belongs to a request span or to a thread slice
+static bool io_trace_is_request(const io_trace_event_t *pEvent)
+{
+    return pEvent->phase <= IO_TRACE_WAKEUP;
+}
+
+/// Dump order: request events by request then time, thread events by thread then time
+static s32 io_trace_compare(const void *a, const void *b)
+{
+    const io_trace_event_t *pA = (const io_trace_event_t *)a;
+    const io_trace_event_t *pB = (const io_trace_event_t *)b;
+    u64                     keyA[3];
+    u64                     keyB[3];
+
+    keyA[0] = io_trace_is_request(pA) ? 0 : 1;
+    keyB[0] = io_trace_is_request(pB) ? 0 : 1;
+    keyA[1] = io_trace_is_request(pA) ? ((u64)pA->accessor << 32) | pA->id : (u64)(u32)pA->tid;
+    keyB[1] = io_trace_is_request(pB) ? ((u64)pB->accessor << 32) | pB->id : (u64)(u32)pB->tid;
+    keyA[2] = pA->tsc;
+    keyB[2] = pB->tsc;
+
+    for (u32 i = 0; i < 3; i++)
+    {
+        if (keyA[i] != keyB[i])
+        {
+            return (keyA[i] < keyB[i]) ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+/// Copy events of the current recording out of every ring, must hold trace lock. Return count
+static u64 io_trace_collect(u64 generation, io_trace_event_t **ppEvents)
+{
+    io_trace_ring_t    *pRings      = __atomic_load_n(&s_traceRings, __ATOMIC_ACQUIRE);
+    u64                 capacity    = 0;
+    u64                 count       = 0;
+
+    /// Rings are only ever pushed in front, the list from this head on stays the same
+    for (io_trace_ring_t *p = pRings; NULL != p; p = p->pNext)
+    {
+        capacity += p->mask + 1;
+    }
+
+    *ppEvents = (io_trace_event_t *)malloc(sizeof(io_trace_event_t) * ((capacity > 0) ? capacity : 1));
+    if (NULL == *ppEvents)
+    {
+        return 0;
+    }
+
+    for (io_trace_ring_t *p = pRings; NULL != p; p = p->pNext)
+    {
+        u64 size    = p->mask + 1;
+        u64 head    = 0;
+        u64 first   = 0;
+        u64 valid   = 0;
+
+        if (__atomic_load_n(&(p->generation), __ATOMIC_ACQUIRE) != generation)
+        {
+            continue;
+        }
+
+        head    = __atomic_load_n(&(p->head), __ATOMIC_ACQUIRE);
+        first   = (head > size) ? head - size : 0;
+        for (u64 i = first; i < head; i++)
+        {
+            (*ppEvents)[count + i - first] = p->events[i & p->mask];
+        }
+
+        /// Owner kept writing meanwhile, slots it reached since may be torn or newer, leave them out
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        valid = __atomic_load_n(&(p->head), __ATOMIC_RELAXED) + 1;
+        if (__atomic_load_n(&(p->generation), __ATOMIC_RELAXED) != generation)
+        {
+            continue;
+        }
+
+        valid = (valid > size) ? valid - size : 0;
+        valid = (valid < first) ? first : (valid > head) ? head : valid;
+        memmove(&((*ppEvents)[count]), &((*ppEvents)[count + valid - first]), sizeof(io_trace_event_t) * (head - valid));
+        count += head - valid;
+    }
+
+    return count;
+}
+
+/// Write one JSON event, separator first unless it is the first one
+static void io_trace_write_event(FILE *fp, bool *pIsFirst, const char8 *name, const char8 *cat, char8 ph,
+                                 u32 id, s32 tid, f64 ts, f64 dur)
+{
+    fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+            *pIsFirst ? "" : ",", name, cat, ph, (s32)getpid(), tid, ts);
+
+    if ('X' == ph)
+    {
+        fprintf(fp, ",\"dur\":%.3f", dur);
+    }
+
+    if ('b' == ph || 'e' == ph || 'n' == ph)
+    {
+        fprintf(fp, ",\"id\":\"0x%x\",\"args\":{\"request\":%u}}", id, id);
+    }
+    else
+    {
+        fprintf(fp, ",\"args\":{\"%s\":%u}}", (0 == strcmp(name, "flush")) ? "fd" : "request", id);
+    }
+
+    *pIsFirst = FALSE;
+}
+
+/// Write events of the current recording to path as Chrome trace_event JSON, which Perfetto
+/// loads as well. Safe while recording, events overwritten during the dump are left out
+ret_t io_trace_dump(const char8 *path)
+{
+    io_trace_event_t   *pEvents     = NULL;
+    u64                 count       = 0;
+    u64                 startTsc    = 0;
+    f64                 nsPerTick   = 1.0;
+    bool                isFirst     = TRUE;
+    FILE               *fp          = NULL;
+
+    if (NULL == path)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    pthread_mutex_lock(&s_traceLock);
+    if (0 == s_traceGeneration)
+    {
+        pthread_mutex_unlock(&s_traceLock);
+        printf("Error: trace dump before any trace start! res = %d.\n", RET_NO_INIT);
+        return RET_NO_INIT;
+    }
+
+    count       = io_trace_collect(s_traceGeneration, &pEvents);
+    startTsc    = s_traceStartTsc;
+    {
+        u64 ticks   = io_trace_tsc() - s_traceStartTsc;
+        u64 ns      = io_trace_now_ns() - s_traceStartNs;
+
+        nsPerTick   = (ticks > 0 && ns > 0) ? (f64)ns / (f64)ticks : 1.0;
+    }
+    pthread_mutex_unlock(&s_traceLock);
+
+    if (NULL == pEvents)
+    {
+        return RET_NO_MEMORY;
+    }
+
+    fp = fopen(path, "w");
+    if (NULL == fp)
+    {
+        printf("Error: trace file [%s] open fail! error: %d - %s.\n", path, errno, strerror(errno));
+        free(pEvents);
+        return RET_BAD_VALUE;
+    }
+
+    qsort(pEvents, count, sizeof(io_trace_event_t), io_trace_compare);
+
+    fprintf(fp, "{\"traceEvents\":[");
+    for (u64 i = 0; i < count; i++)
+    {
+        io_trace_event_t   *pEvent  = &(pEvents[i]);
+        io_trace_event_t   *pNext   = (i + 1 < count) ? &(pEvents[i + 1]) : NULL;
+        const char8        *cat     = (pEvent->accessor < ASYNC_FILE_ACCESSOR_MAX) ? s_traceAccessors[pEvent->accessor] : "io";
+        f64                 ts      = (pEvent->tsc > startTsc) ? (f64)(pEvent->tsc - startTsc) * nsPerTick / 1000.0 : 0.0;
+        f64                 nextTs  = (NULL != pNext && pNext->tsc > startTsc)
+                                    ? (f64)(pNext->tsc - startTsc) * nsPerTick / 1000.0 : ts;
+
+        if (io_trace_is_request(pEvent))
+        {
+            bool isChained = (NULL != pNext && io_trace_is_request(pNext) && pNext->accessor == pEvent->accessor &&
+                              pNext->id == pEvent->id && IO_TRACE_GET != pNext->phase);
+
+            /// Each event opens a span of its request that the next one closes, wakeup ends the chain
+            if (IO_TRACE_WAKEUP != pEvent->phase && isChained)
+            {
+                io_trace_write_event(fp, &isFirst, s_traceSpans[pEvent->phase], cat, 'b', pEvent->id, pEvent->tid, ts, 0);
+                io_trace_write_event(fp, &isFirst, s_traceSpans[pEvent->phase], cat, 'e', pEvent->id, pEvent->tid, nextTs, 0);
+            }
+            else if (IO_TRACE_WAKEUP != pEvent->phase)
+            {
+                io_trace_write_event(fp, &isFirst, s_traceSpans[pEvent->phase], cat, 'n', pEvent->id, pEvent->tid, ts, 0);
+            }
+        }
+        else
+        {
+            const char8    *name        = (pEvent->phase <= IO_TRACE_TASK_END) ? "task" : "flush";
+            bool            isBegin     = (IO_TRACE_TASK_BEGIN == pEvent->phase || IO_TRACE_FLUSH_BEGIN == pEvent->phase);
+            bool            isClosed    = (NULL != pNext && pNext->tid == pEvent->tid && pNext->phase == pEvent->phase + 1);
+
+            /// Slice of a thread from begin to its end, a lone end lost its begin to the ring
+            if (isBegin && isClosed)
+            {
+                io_trace_write_event(fp, &isFirst, name, cat, 'X', pEvent->id, pEvent->tid, ts, nextTs - ts);
+                i++;
+            }
+            else
+            {
+                io_trace_write_event(fp, &isFirst, name, cat, 'i', pEvent->id, pEvent->tid, ts, 0);
+            }
+        }
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+    fclose(fp);
+    free(pEvents);
+
+    return RET_OK;
+}
@@ -0,0 +1,116 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : io_trace.h
+ * Description  : Optional request lifecycle tracing, threads log binary events into
+                  their own rings and a dump writes them as Chrome trace_event JSON.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __IO_TRACE_H__
+#define __IO_TRACE_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+/// USDT probes when systemtap headers are around, perf and bpftrace attach to them while tracing is off
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define IO_TRACE_HAS_USDT               1
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IO_TRACE_DEFAULT_EVENTS         8192                    /// ring size of a thread, events
+#define IO_TRACE_MAX_EVENTS             (1 << 22)               /// largest ring a thread may get
+#define IO_TRACE_NO_ACCESSOR            0xff                    /// event not tied to an accessor, e.g. a flush
+
+/// Lifecycle point of a request, a request span runs from one of its events to its next one
+typedef enum __io_trace_phase
+{
+    IO_TRACE_GET                        = 0,                    /// getRequest returned it, span "setup"
+    IO_TRACE_PUT,                                               /// put called, span "admit"
+    IO_TRACE_ADMIT,                                             /// got in-flight room, span "submit"
+    IO_TRACE_DISPATCH,                                          /// handed to task queue or kernel, span "dispatched"
+    IO_TRACE_START,                                             /// worker took it up, span "service"
+    IO_TRACE_COMMIT,                                            /// joined group commit, span "commit"
+    IO_TRACE_COMPLETE,                                          /// finished, span "completed"
+    IO_TRACE_WAKEUP,                                            /// wait or reap returned it, ends its spans
+    IO_TRACE_TASK_BEGIN,                                        /// worker thread starts a task, thread slice
+    IO_TRACE_TASK_END,                                          /// worker thread ends a task
+    IO_TRACE_FLUSH_BEGIN,                                       /// flush thread enters fsync, id is the fd
+    IO_TRACE_FLUSH_END,                                         /// flush thread left fsync
+    IO_TRACE_PHASE_MAX,
+
+} io_trace_phase_t;
+
+/// struct define a recorded event, rings hold them by value
+typedef struct __io_trace_event
+{
+    u64                             tsc;                    /// time stamp counter, converted on dump
+    u32                             id;                     /// request handle, or fd of a flush
+    s32                             tid;                    /// kernel thread id of the recorder
+    u8                              phase;                  /// io_trace_phase_t
+    u8                              accessor;               /// async_file_accessor_type_t or IO_TRACE_NO_ACCESSOR
+
+} io_trace_event_t;
+
+/// struct define event ring of a thread, it outlives the thread and goes to the next new one
+typedef struct __io_trace_ring
+{
+    struct __io_trace_ring         *pNext;                  /// next ring of the registry
+    bool                            isOwned;                /// a live thread records into it
+    u64                             generation;             /// recording its events belong to
+    u64                             head;                   /// events written in that recording
+    u64                             mask;                   /// event index mask
+    io_trace_event_t                events[];               /// mask + 1 events
+
+} io_trace_ring_t;
+
+/// Whether events are recorded, read unlocked on every trace point
+extern bool g_ioTraceEnabled;
+
+#ifdef IO_TRACE_HAS_USDT
+#define IO_TRACE_PROBE(phase, accessor, id) DTRACE_PROBE3(async_file_accessor, request, phase, accessor, id)
+#else
+#define IO_TRACE_PROBE(phase, accessor, id) do {} while (0)
+#endif
+
+/// Trace point: a USDT probe always, a ring event while tracing is on
+#define IO_TRACE(phase, accessor, id)                                                       \
+    do                                                                                      \
+    {                                                                                       \
+        IO_TRACE_PROBE(phase, accessor, id);                                                \
+        if (__builtin_expect(__atomic_load_n(&g_ioTraceEnabled, __ATOMIC_RELAXED), 0))      \
+        {                                                                                   \
+            io_trace_record(phase, accessor, id);                                           \
+        }                                                                                   \
+    } while (0)
+
+
+/// Record an event into ring of calling thread, oldest events are overwritten once it is full
+void io_trace_record(io_trace_phase_t phase, u32 accessor, u32 id);
+
+/// Drop recorded events and start recording, eventsPerThread is rounded up to a power of 2,
+/// 0 takes the default. Rings made before keep their size
+ret_t io_trace_start(u32 eventsPerThread);
+
+/// Stop recording, events stay for io_trace_dump
+void io_trace_stop();
+
+/// Write events of the current recording to path as Chrome trace_event JSON, which Perfetto
+/// loads as well. Safe while recording, events overwritten during the dump are left out
+ret_t io_trace_dump(const char8 *path);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __IO_TRACE_H__ */
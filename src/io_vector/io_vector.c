@@ -0,0 +1,101 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : io_vector.c
+ * Description  : Scatter/gather segment list of a vectored request, one file range
+                  read into or written from several caller buffers.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "io_vector.h"
+
+/// Validate segments against request size and keep a copy of them
+ret_t io_vector_import(io_vector_t *pVector, const struct iovec *iov, u32 count, u64 size)
+{
+    ret_t   res     = (NULL == iov || 0 == count || count > ASYNC_FILE_MAX_IOVEC) ? RET_BAD_VALUE : RET_OK;
+    u64     total   = 0;
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        res     = (NULL == iov[i].iov_base || 0 == iov[i].iov_len) ? RET_BAD_VALUE : RET_OK;
+        total  += iov[i].iov_len;
+    }
+
+    if (RET_OK == res && total != size)
+    {
+        res = RET_BAD_VALUE;
+        printf("Error: segments cover %llu bytes, request has %llu! res = %d.\n",
+               (unsigned long long)total, (unsigned long long)size, res);
+    }
+    else if (RET_OK != res)
+    {
+        printf("Error: invalid segments, 1 to %d non empty buffers expected! res = %d.\n", ASYNC_FILE_MAX_IOVEC, res);
+    }
+
+    if (RET_OK == res)
+    {
+        struct iovec *copy = (struct iovec *)realloc(pVector->iov, sizeof(struct iovec) * count);
+
+        if (NULL == copy)
+        {
+            res = RET_NO_MEMORY;
+            printf("Error: segment table alloc fail! res = %d.\n", res);
+        }
+        else
+        {
+            memcpy(copy, iov, sizeof(struct iovec) * count);
+            pVector->iov    = copy;
+            pVector->count  = count;
+        }
+    }
+
+    return res;
+}
+
+/// Drop segments, request turns back into a plain one
+void io_vector_reset(io_vector_t *pVector)
+{
+    free(pVector->iov);
+    pVector->iov    = NULL;
+    pVector->count  = 0;
+}
+
+/// Whether every segment base and length is a multiple of align
+bool io_vector_is_aligned(const io_vector_t *pVector, u64 align)
+{
+    for (u32 i = 0; i < pVector->count; i++)
+    {
+        if ((uintptr_t)pVector->iov[i].iov_base % align != 0 || pVector->iov[i].iov_len % align != 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/// Scatter contiguous data into the segments
+void io_vector_scatter(const io_vector_t *pVector, const void *src)
+{
+    const char8 *pos = (const char8 *)src;
+
+    for (u32 i = 0; i < pVector->count; i++)
+    {
+        memcpy(pVector->iov[i].iov_base, pos, pVector->iov[i].iov_len);
+        pos += pVector->iov[i].iov_len;
+    }
+}
+
+/// Gather the segments into contiguous memory
+void io_vector_gather(const io_vector_t *pVector, void *dst)
+{
+    char8 *pos = (char8 *)dst;
+
+    for (u32 i = 0; i < pVector->count; i++)
+    {
+        memcpy(pos, pVector->iov[i].iov_base, pVector->iov[i].iov_len);
+        pos += pVector->iov[i].iov_len;
+    }
+}
@@ -0,0 +1,51 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : io_vector.h
+ * Description  : Scatter/gather segment list of a vectored request, one file range
+                  read into or written from several caller buffers.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __IO_VECTOR_H__
+#define __IO_VECTOR_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// struct define the segments of a vectored request, count 0 for a plain request
+typedef struct __io_vector
+{
+    struct iovec                   *iov;                    /// owned copy of caller segments
+    u32                             count;                  /// segment count
+
+} io_vector_t;
+
+
+/// Validate segments against request size and keep a copy of them
+ret_t io_vector_import(io_vector_t *pVector, const struct iovec *iov, u32 count, u64 size);
+
+/// Drop segments, request turns back into a plain one
+void io_vector_reset(io_vector_t *pVector);
+
+/// Whether every segment base and length is a multiple of align
+bool io_vector_is_aligned(const io_vector_t *pVector, u64 align);
+
+/// Scatter contiguous data into the segments
+void io_vector_scatter(const io_vector_t *pVector, const void *src);
+
+/// Gather the segments into contiguous memory
+void io_vector_gather(const io_vector_t *pVector, void *dst);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __IO_VECTOR_H__ */
@@ -0,0 +1,336 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : live_stats.c
+ * Description  : Publish live accessor counters into a named shared memory segment,
+                  inspectors attach and read them under a per slot seqlock.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include <sched.h>
+#include "live_stats.h"
+
+/// struct define an accessor the publisher polls
+typedef struct __live_stats_source
+{
+    live_stats_fill_func            fill;                   /// NULL until the accessor registers
+    void                           *arg;                    /// fill argument
+
+} live_stats_source_t;
+
+static live_stats_source_t      s_liveSources[ASYNC_FILE_ACCESSOR_MAX];
+static live_stats_segment_t    *s_liveSegment   = NULL;                     /// mapped segment while publishing
+static char8                    s_liveName[LIVE_STATS_NAME_MAX];            /// its name, unlinked on stop
+static u32                      s_liveInterval  = LIVE_STATS_DEFAULT_INTERVAL_MS;
+static bool                     s_liveIsRunning = FALSE;                    /// publisher thread should go on
+static pthread_t                s_liveThread;
+static pthread_mutex_t          s_liveLock      = PTHREAD_MUTEX_INITIALIZER;/// guards sources and publisher state
+static pthread_cond_t           s_liveStop      = PTHREAD_COND_INITIALIZER; /// wakes publisher to exit
+
+static u64 live_stats_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Rewrite a shared slot under its seqlock, the publisher thread is the only writer
+static void live_stats_write_slot(live_stats_slot_t *pShared, const live_stats_slot_t *pLocal)
+{
+    u32 sequence = pShared->sequence;
+
+    __atomic_store_n(&(pShared->sequence), sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy((u8 *)pShared + sizeof(u32), (const u8 *)pLocal + sizeof(u32), sizeof(live_stats_slot_t) - sizeof(u32));
+    __atomic_store_n(&(pShared->sequence), sequence + 2, __ATOMIC_RELEASE);
+}
+
+/// Poll every registered accessor into the segment, must hold live stats lock
+static void live_stats_publish()
+{
+    for (u32 type = 0; type < ASYNC_FILE_ACCESSOR_MAX; type++)
+    {
+        live_stats_slot_t slot;
+
+        if (NULL == s_liveSources[type].fill)
+        {
+            continue;
+        }
+
+        memset(&slot, 0, sizeof(live_stats_slot_t));
+        s_liveSources[type].fill(s_liveSources[type].arg, &slot);
+        slot.isActive   = TRUE;
+        slot.publishNs  = live_stats_now_ns();
+        live_stats_write_slot(&(s_liveSegment->slots[type]), &slot);
+    }
+}
+
+/// Publisher thread, refreshes the segment once per interval until stopped
+static void *live_stats_thread(void *arg)
+{
+    struct timespec deadline;
+
+    pthread_mutex_lock(&s_liveLock);
+    while (s_liveIsRunning)
+    {
+        live_stats_publish();
+
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec    += s_liveInterval / 1000;
+        deadline.tv_nsec   += (long)(s_liveInterval % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec    += 1;
+            deadline.tv_nsec   -= 1000000000;
+        }
+
+        while (s_liveIsRunning && pthread_cond_timedwait(&s_liveStop, &s_liveLock, &deadline) != ETIMEDOUT)
+        {
+        }
+    }
+    pthread_mutex_unlock(&s_liveLock);
+
+    return NULL;
+}
+
+/// Create the segment exclusively, one whose publisher exited is removed and created again
+static s32 live_stats_create(const char8 *name)
+{
+    s32 fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if (fd < 0 && EEXIST == errno)
+    {
+        const live_stats_segment_t *pOld    = NULL;
+        bool                        isStale = TRUE;
+
+        /// A segment of another layout or a publisher that is gone is not anyone's any more
+        if (RET_OK == live_stats_attach(name, &pOld))
+        {
+            isStale = !pOld->isPublishing || (kill(pOld->pid, 0) != 0 && ESRCH == errno);
+            live_stats_detach(pOld);
+        }
+
+        if (isStale)
+        {
+            shm_unlink(name);
+            fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        }
+        else
+        {
+            errno = EEXIST;
+        }
+    }
+
+    return fd;
+}
+
+/// Publish an accessor from now on, fill is called with arg once per period while publishing
+void live_stats_register(async_file_accessor_type_t type, live_stats_fill_func fill, void *arg)
+{
+    pthread_mutex_lock(&s_liveLock);
+    s_liveSources[type].fill    = fill;
+    s_liveSources[type].arg     = arg;
+    pthread_mutex_unlock(&s_liveLock);
+}
+
+/// Fill the counters every accessor keeps, backend specific ones are left to the caller
+void live_stats_fill_common(live_stats_slot_t      *pSlot,
+                            io_stats_t             *pStats,
+                            admission_t            *pAdmission,
+                            completion_queue_t     *pCompletions)
+{
+    for (u32 d = 0; d < ASYNC_FILE_ACCESS_MAX; d++)
+    {
+        io_stats_get_totals(pStats, (async_file_access_direction_t)d,
+                            &(pSlot->ops[d]), &(pSlot->errors[d]), &(pSlot->bytes[d]));
+    }
+
+    pSlot->inflight         = __atomic_load_n(&(pAdmission->requests), __ATOMIC_RELAXED);
+    pSlot->inflightBytes    = __atomic_load_n(&(pAdmission->bytes), __ATOMIC_RELAXED);
+    pSlot->inflightLimit    = __atomic_load_n(&(pAdmission->maxRequests), __ATOMIC_RELAXED);
+    pSlot->reapable         = __atomic_load_n(&(pCompletions->count), __ATOMIC_RELAXED);
+}
+
+/// Create segment name, NULL takes LIVE_STATS_NAME_PREFIX and pid, and publish into it every
+/// intervalMs, 0 takes the default. A segment left behind by an exited process is replaced
+ret_t live_stats_start(const char8 *name, u32 intervalMs)
+{
+    ret_t                   res         = RET_OK;
+    s32                     fd          = -1;
+    live_stats_segment_t   *pSegment    = NULL;
+    char8                   path[LIVE_STATS_NAME_MAX];
+
+    if (NULL == name)
+    {
+        snprintf(path, sizeof(path), "%s%d", LIVE_STATS_NAME_PREFIX, (s32)getpid());
+    }
+    else if ('/' != name[0] || strlen(name) >= sizeof(path) || NULL != strchr(name + 1, '/'))
+    {
+        printf("Error: live stats segment name [%s] must be one /name under %d chars! res = %d.\n",
+               name, LIVE_STATS_NAME_MAX, RET_BAD_VALUE);
+        return RET_BAD_VALUE;
+    }
+    else
+    {
+        strcpy(path, name);
+    }
+
+    pthread_mutex_lock(&s_liveLock);
+    if (NULL != s_liveSegment)
+    {
+        pthread_mutex_unlock(&s_liveLock);
+        printf("Error: live stats already published to [%s]! res = %d.\n", s_liveName, RET_ALREADY_EXISTS);
+        return RET_ALREADY_EXISTS;
+    }
+
+    fd = live_stats_create(path);
+    if (fd < 0 || ftruncate(fd, sizeof(live_stats_segment_t)) != 0 ||
+        MAP_FAILED == (pSegment = (live_stats_segment_t *)mmap(NULL, sizeof(live_stats_segment_t),
+                                                               PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)))
+    {
+        res = (EEXIST == errno) ? RET_ALREADY_EXISTS : -errno;
+        printf("Error: create live stats segment [%s] fail! error: %d - %s.\n", path, errno, strerror(errno));
+        pSegment = NULL;
+    }
+
+    if (RET_OK == res)
+    {
+        /// Segment is zero filled by ftruncate, magic goes last so inspectors never see half a header
+        pSegment->version       = LIVE_STATS_VERSION;
+        pSegment->size          = sizeof(live_stats_segment_t);
+        pSegment->slotCount     = ASYNC_FILE_ACCESSOR_MAX;
+        pSegment->pid           = (s32)getpid();
+        pSegment->intervalMs    = (0 == intervalMs) ? LIVE_STATS_DEFAULT_INTERVAL_MS
+                                : (intervalMs < LIVE_STATS_MIN_INTERVAL_MS) ? LIVE_STATS_MIN_INTERVAL_MS : intervalMs;
+        pSegment->isPublishing  = TRUE;
+        pSegment->startNs       = live_stats_now_ns();
+        __atomic_store_n(&(pSegment->magic), LIVE_STATS_MAGIC, __ATOMIC_RELEASE);
+
+        s_liveSegment   = pSegment;
+        s_liveInterval  = pSegment->intervalMs;
+        s_liveIsRunning = TRUE;
+        strcpy(s_liveName, path);
+
+        res = -pthread_create(&s_liveThread, NULL, live_stats_thread, NULL);
+        if (RET_OK != res)
+        {
+            printf("Error: start live stats publisher fail! res = %d.\n", res);
+            munmap(pSegment, sizeof(live_stats_segment_t));
+            shm_unlink(path);
+            s_liveSegment   = NULL;
+            s_liveIsRunning = FALSE;
+        }
+    }
+    else if (fd >= 0)
+    {
+        shm_unlink(path);
+    }
+    pthread_mutex_unlock(&s_liveLock);
+
+    /// Mapping keeps the segment, the descriptor is not needed any more
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return res;
+}
+
+/// Stop publishing and remove the segment, attached inspectors see isPublishing cleared
+void live_stats_stop()
+{
+    live_stats_segment_t *pSegment = NULL;
+
+    pthread_mutex_lock(&s_liveLock);
+    pSegment        = s_liveSegment;
+    s_liveIsRunning = FALSE;
+    pthread_cond_signal(&s_liveStop);
+    pthread_mutex_unlock(&s_liveLock);
+
+    if (NULL != pSegment)
+    {
+        pthread_join(s_liveThread, NULL);
+
+        pthread_mutex_lock(&s_liveLock);
+        __atomic_store_n(&(pSegment->isPublishing), FALSE, __ATOMIC_RELEASE);
+        munmap(pSegment, sizeof(live_stats_segment_t));
+        shm_unlink(s_liveName);
+        s_liveSegment = NULL;
+        pthread_mutex_unlock(&s_liveLock);
+    }
+}
+
+/// Map segment name read only for an inspector, RET_BAD_VALUE if it is not a segment of this layout
+ret_t live_stats_attach(const char8 *name, const live_stats_segment_t **ppSegment)
+{
+    ret_t                   res         = RET_OK;
+    s32                     fd          = shm_open(name, O_RDONLY, 0);
+    struct stat             st;
+    live_stats_segment_t   *pSegment    = NULL;
+
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        res = -errno;
+    }
+    else if (st.st_size < (off_t)sizeof(live_stats_segment_t))
+    {
+        res = RET_BAD_VALUE;
+    }
+    else if (MAP_FAILED == (pSegment = (live_stats_segment_t *)mmap(NULL, sizeof(live_stats_segment_t),
+                                                                    PROT_READ, MAP_SHARED, fd, 0)))
+    {
+        res         = -errno;
+        pSegment    = NULL;
+    }
+    else if (LIVE_STATS_MAGIC != __atomic_load_n(&(pSegment->magic), __ATOMIC_ACQUIRE) ||
+             LIVE_STATS_VERSION != pSegment->version                                    ||
+             sizeof(live_stats_segment_t) != pSegment->size                             ||
+             ASYNC_FILE_ACCESSOR_MAX != pSegment->slotCount)
+    {
+        res = RET_BAD_VALUE;
+        munmap(pSegment, sizeof(live_stats_segment_t));
+        pSegment = NULL;
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    *ppSegment = pSegment;
+
+    return res;
+}
+
+/// Unmap a segment from live_stats_attach
+void live_stats_detach(const live_stats_segment_t *pSegment)
+{
+    if (NULL != pSegment)
+    {
+        munmap((void *)pSegment, sizeof(live_stats_segment_t));
+    }
+}
+
+/// Consistent copy of a published slot, FALSE if the publisher kept it busy or died writing it
+bool live_stats_read_slot(const live_stats_slot_t *pShared, live_stats_slot_t *pOut)
+{
+    for (u32 i = 0; i < LIVE_STATS_READ_RETRIES; i++)
+    {
+        u32 sequence = __atomic_load_n(&(pShared->sequence), __ATOMIC_ACQUIRE);
+
+        if (0 == (sequence & 1))
+        {
+            memcpy(pOut, pShared, sizeof(live_stats_slot_t));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&(pShared->sequence), __ATOMIC_RELAXED) == sequence)
+            {
+                pOut->sequence = sequence;
+                return TRUE;
+            }
+        }
+        sched_yield();
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,108 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : live_stats.h
+ * Description  : Publish live accessor counters into a named shared memory segment,
+                  inspectors attach and read them under a per slot seqlock.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __LIVE_STATS_H__
+#define __LIVE_STATS_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+#include "admission.h"
+#include "completion_queue.h"
+#include "io_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIVE_STATS_MAGIC                0x4c534641U             /// "AFSL", first word of a segment
+#define LIVE_STATS_VERSION              1                       /// bumped whenever the segment layout changes
+#define LIVE_STATS_NAME_PREFIX          "/async_file_accessor." /// default segment name is prefix and pid
+#define LIVE_STATS_NAME_MAX             64                      /// segment name length with terminator
+#define LIVE_STATS_DEFAULT_INTERVAL_MS  500                     /// publish period when none is given
+#define LIVE_STATS_MIN_INTERVAL_MS      10                      /// shortest publish period
+#define LIVE_STATS_READ_RETRIES         64                      /// torn reads before a slot is given up
+
+/// struct define published counters of one accessor, every field is fixed width so 32 and 64 bit
+/// inspectors share the layout. Counters only grow, inspectors take rates from two reads
+typedef struct __live_stats_slot
+{
+    u32                             sequence;               /// seqlock, odd while publisher rewrites the slot
+    u32                             isActive;               /// accessor exists and is published
+    u64                             publishNs;              /// CLOCK_MONOTONIC time of last publish
+    u64                             ops[ASYNC_FILE_ACCESS_MAX];
+                                                            /// requests finished since creation
+    u64                             errors[ASYNC_FILE_ACCESS_MAX];
+                                                            /// requests failed or canceled since creation
+    u64                             bytes[ASYNC_FILE_ACCESS_MAX];
+                                                            /// data bytes of successful requests since creation
+    u64                             inflightBytes;          /// data bytes of requests in flight
+    u32                             inflight;               /// requests admitted and not finished, queue depth
+    u32                             inflightLimit;          /// requests allowed in flight, 0 is unlimited
+    u32                             reapable;               /// finished requests waiting for reapCompletions
+    u32                             queuedTasks;            /// MMAP: tasks waiting for a worker
+    u32                             aliveThreads;           /// MMAP: workers alive
+    u32                             busyThreads;            /// MMAP: workers running a task
+    u32                             idleThreads;            /// MMAP: workers waiting for a task
+    u64                             processedTasks;         /// MMAP: tasks done by current workers
+
+} __attribute__((aligned(64))) live_stats_slot_t;
+
+/// struct define shared memory segment, one slot per accessor type
+typedef struct __live_stats_segment
+{
+    u32                             magic;                  /// LIVE_STATS_MAGIC once header is written
+    u32                             version;                /// LIVE_STATS_VERSION of the publisher
+    u32                             size;                   /// bytes of the segment
+    u32                             slotCount;              /// slots that follow the header
+    s32                             pid;                    /// publishing process
+    u32                             intervalMs;             /// publish period
+    u32                             isPublishing;           /// cleared when publisher stops
+    u64                             startNs;                /// CLOCK_MONOTONIC time publishing started
+    live_stats_slot_t               slots[ASYNC_FILE_ACCESSOR_MAX];
+                                                            /// indexed by async_file_accessor_type_t
+
+} live_stats_segment_t;
+
+/// Fill current counters of an accessor into a slot, runs on the publisher thread
+typedef void (*live_stats_fill_func)(void *arg, live_stats_slot_t *pSlot);
+
+
+/// Publish an accessor from now on, fill is called with arg once per period while publishing
+void live_stats_register(async_file_accessor_type_t type, live_stats_fill_func fill, void *arg);
+
+/// Fill the counters every accessor keeps, backend specific ones are left to the caller
+void live_stats_fill_common(live_stats_slot_t      *pSlot,
+                            io_stats_t             *pStats,
+                            admission_t            *pAdmission,
+                            completion_queue_t     *pCompletions);
+
+/// Create segment name, NULL takes LIVE_STATS_NAME_PREFIX and pid, and publish into it every
+/// intervalMs, 0 takes the default. A segment left behind by an exited process is replaced
+ret_t live_stats_start(const char8 *name, u32 intervalMs);
+
+/// Stop publishing and remove the segment, attached inspectors see isPublishing cleared
+void live_stats_stop();
+
+/// Map segment name read only for an inspector, RET_BAD_VALUE if it is not a segment of this layout
+ret_t live_stats_attach(const char8 *name, const live_stats_segment_t **ppSegment);
+
+/// Unmap a segment from live_stats_attach
+void live_stats_detach(const live_stats_segment_t *pSegment);
+
+/// Consistent copy of a published slot, FALSE if the publisher kept it busy or died writing it
+bool live_stats_read_slot(const live_stats_slot_t *pShared, live_stats_slot_t *pOut);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __LIVE_STATS_H__ */
@@ -10,451 +10,1807 @@
 
 #include "mmap_file_accessor.h"
 #include "async_file_accessor.h"
+#include "completion_queue.h"
 #include "common_types.h"
 
-// static long long get_time_in_microseconds()
-// {
-//     struct timeval tv;
-//     gettimeofday(&tv, NULL);
-//     return ((long long)tv.tv_sec * 1000000) + tv.tv_usec;
-// }
-
-/// Timeout thread funtion
-static void *timeout_thread(void *args)
+/// Timer callback, cancel request still not finished when its deadline or wait timeout expires
+static void mmap_request_expire(void *arg)
 {
-    timeout_args_t *t_args = (timeout_args_t *)args;
-    struct timespec timeout =
+    mmap_request_t *pRequest = (mmap_request_t *)arg;
+
+    pthread_mutex_lock(&(pRequest->lock));
+    if (REQUEST_STAT_SUBMITTED == pRequest->status)
     {
-        .tv_sec     = t_args->timeout_ms / 1000,
-        .tv_nsec    = (t_args->timeout_ms % 1000) * 1000000,
-    };
+        pRequest->status = REQUEST_STAT_CANCEL;
+        pthread_cond_broadcast(&(pRequest->isFinished));
+    }
+    pthread_mutex_unlock(&(pRequest->lock));
+}
 
-    if (REQUEST_STAT_SUBMITTED == *(t_args->status))
+/// Close request fd, chunks only borrow the fd of their striped request
+static void mmap_request_close_fd(mmap_request_t *pRequest)
+{
+    if (pRequest->fd > 0 && NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
     {
-        nanosleep(&timeout, NULL);
+        file_registry_close_fd(&(pRequest->pAccessor->files), pRequest->parent.info.fileHandle, pRequest->fd);
     }
+    pRequest->fd = -1;
+}
 
-    pthread_mutex_lock(t_args->lock);
-    *(t_args->status) = (REQUEST_STAT_SUBMITTED == *(t_args->status)) ? REQUEST_STAT_CANCEL : *(t_args->status);
-    pthread_cond_signal(t_args->cond);
-    pthread_mutex_unlock(t_args->lock);
+/// Whether request or the striped request it is a chunk of was canceled
+static bool mmap_request_is_canceled(mmap_request_t *pRequest)
+{
+    mmap_request_t *pParent = (mmap_request_t *)pRequest->stripe.pParent;
 
-    pthread_exit(NULL);
+    return REQUEST_STAT_CANCEL == pRequest->status || (NULL != pParent && REQUEST_STAT_CANCEL == pParent->status);
 }
 
-/// Read request task process function
-static void *mmapRead(void *param)
+/// Write drops cached blocks it overlapped, even a failed one may have changed them; read caches what it copied.
+/// Runs before the request is published as done, caller may release it right after
+static void mmap_cache_complete(mmap_request_t *pRequest, bool isSuccess)
 {
-    mmap_request_t *pRequest    = (mmap_request_t *)param;
-    void           *mmapAddr    = NULL;
-    u32             retry_times = 0;
+    block_cache_t *pCache = &(pRequest->pAccessor->cache);
 
-    if (REQUEST_STAT_CANCEL == pRequest->status)
+    if (ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction)
     {
-        return NULL;
+        block_cache_invalidate(pCache, &(pRequest->fsb), pRequest->offset, pRequest->nbytes);
     }
-
-    // printf(" ------ Start mmapRead: [%s]\n", pRequest->parent.info.fn);
-
-    do {
-        mmapAddr = mmap(NULL, pRequest->nbytes, PROT_READ, MAP_PRIVATE, pRequest->fd, pRequest->offset);
+    else if (isSuccess && !mmap_request_is_canceled(pRequest) && !pRequest->isLease)
+    {
+        block_cache_fill(pCache, &(pRequest->fsb), pRequest->offset, pRequest->nbytes, pRequest->buf,
+                         pRequest->cacheEpoch);
     }
-    while (MAP_FAILED == mmapAddr && retry_times++ < MAX_RETRY_TIMES);
+}
 
-    if (mmapAddr != MAP_FAILED && memcpy(pRequest->buf, mmapAddr, pRequest->nbytes) != NULL)
+static void mmap_write_complete(mmap_request_t *pRequest, bool isSuccess);
+
+/// Called when a request task is done, update status and notify waiters.
+/// A chunk reports to its striped request instead, the last one finishes it.
+/// A merged read finishes each of its members
+static void mmap_request_finish(mmap_request_t *pRequest, bool isSuccess)
+{
+    mmap_request_t                 *pParent     = (mmap_request_t *)pRequest->stripe.pParent;
+    async_file_access_request_t   **ppMembers   = pRequest->merge.ppMembers;
+    u32                             memberCount = pRequest->merge.count;
+    u64                             size        = pRequest->parent.info.size;
+    admission_t                    *pAdmission  = NULL;
+    u64                             admitNs     = 0;
+    io_stats_t                     *pIoStats    = &(pRequest->pAccessor->ioStats);
+
+    if (NULL == pParent && 0 == memberCount)
     {
-        pthread_mutex_lock(&(pRequest->lock));
-        pRequest->status = (REQUEST_STAT_CANCEL == pRequest->status) ? pRequest->status : REQUEST_STAT_IOSUCCESS;
-        pthread_cond_signal(&(pRequest->isFinished));
-        pthread_mutex_unlock(&(pRequest->lock));
+        mmap_cache_complete(pRequest, isSuccess);
     }
-    else
+
+    pthread_mutex_lock(&(pRequest->lock));
+    pRequest->status = (REQUEST_STAT_CANCEL == pRequest->status) ? pRequest->status
+                     : isSuccess ? REQUEST_STAT_IOSUCCESS : REQUEST_STAT_IOFAIL;
+    pRequest->isInflight = FALSE;
+    if (NULL == pParent && 0 == memberCount)
     {
-        pthread_mutex_lock(&(pRequest->lock));
-        pRequest->status = (REQUEST_STAT_CANCEL == pRequest->status) ? pRequest->status : REQUEST_STAT_IOFAIL;
-        pthread_cond_signal(&(pRequest->isFinished));
-        pthread_mutex_unlock(&(pRequest->lock));
-        printf("Error: file [%s] read fail! error: %d - %s.\n", pRequest->parent.info.fn, errno, strerror(errno));
+        prio_stats_record(&(pRequest->pAccessor->prioStats), pRequest->parent.info.priority, pRequest->putNs);
+        pRequest->doneNs        = io_stats_record(pIoStats, pRequest->parent.info.direction,
+                                                  REQUEST_STAT_IOSUCCESS == pRequest->status, pRequest->nbytes,
+                                                  pRequest->getNs, pRequest->putNs, pRequest->startNs);
+        pRequest->getNs         = 0;
+        IO_TRACE(IO_TRACE_COMPLETE, pRequest->pAccessor->parent.type, pRequest->parent.handle);
+        pAdmission              = pRequest->isAdmitted ? &(pRequest->pAccessor->admission) : NULL;
+        admitNs                 = pRequest->admitNs;
+        pRequest->isAdmitted    = FALSE;
+        completion_queue_push(&(pRequest->pAccessor->completions), &(pRequest->parent));
     }
+    pthread_cond_broadcast(&(pRequest->isFinished));
+    pthread_mutex_unlock(&(pRequest->lock));
 
-    if (mmapAddr != MAP_FAILED)
+    /// Room is returned once the request is done with, capacity callback may put again
+    if (NULL != pAdmission)
     {
-        munmap(mmapAddr, pRequest->nbytes);
-        mmapAddr = NULL;
+        admission_release(pAdmission, 1, size, admitNs);
     }
 
-    if (pRequest->fd > 0)
+    if (NULL != pParent && stripe_group_chunk_done(&(pParent->stripe), isSuccess ? (s64)pRequest->nbytes : -EIO))
     {
-        close(pRequest->fd);
-        pRequest->fd = -1;
+        /// Chunks filled slices of the write mapping, it goes away with the striped request
+        if (ASYNC_FILE_ACCESS_WRITE == pParent->parent.info.direction && NULL != pParent->mapAddr)
+        {
+            munmap(pParent->mapAddr, pParent->mapLen);
+            pParent->mapAddr    = NULL;
+            pParent->buf        = NULL;
+            mmap_write_complete(pParent, stripe_group_result(&(pParent->stripe)) >= 0);
+        }
+        else
+        {
+            mmap_request_close_fd(pParent);
+            mmap_request_finish(pParent, stripe_group_result(&(pParent->stripe)) >= 0);
+        }
     }
 
-    // printf(" ------ Done mmapRead: [%s]\n", pRequest->parent.info.fn);
+    /// Merged read is not touched again, the last member released returns it to pool
+    for (u32 i = 0; i < memberCount; i++)
+    {
+        mmap_request_t *pMember = (mmap_request_t *)ppMembers[i];
 
-    return NULL;
+        if (isSuccess)
+        {
+            readahead_release(pMember->fd, pMember->offset, pMember->nbytes, pMember->parent.info.hint);
+        }
+        mmap_request_close_fd(pMember);
+        mmap_request_finish(pMember, isSuccess);
+    }
 }
 
-/// Write request task process function
-static void *mmapWrite(void *param)
+/// Stamp start of service on the originals a task serves, first chunk of a striped request starts it
+static void mmap_request_start(mmap_request_t *pRequest)
 {
-    mmap_request_t *pRequest    = (mmap_request_t *)param;
-
-    if (REQUEST_STAT_CANCEL == pRequest->status)
-    {
-        munmap(pRequest->buf, pRequest->nbytes);
-        pRequest->buf = NULL;
-        return NULL;
-    }
-
-    // printf(" ------ Start mmapWrite: [%s]\n", pRequest->parent.info.fn);
+    mmap_request_t *pParent = (mmap_request_t *)pRequest->stripe.pParent;
+    u64             now     = prio_class_now_ns();
+    u64             unset   = 0;
 
-    if (msync(pRequest->buf, pRequest->nbytes, MS_SYNC) != -1)
+    if (NULL != pParent)
     {
-        pthread_mutex_lock(&(pRequest->lock));
-        pRequest->status = (REQUEST_STAT_CANCEL == pRequest->status) ? pRequest->status : REQUEST_STAT_IOSUCCESS;
-        pthread_cond_signal(&(pRequest->isFinished));
-        pthread_mutex_unlock(&(pRequest->lock));
+        /// Only the chunk that starts the striped request traces it
+        if (__atomic_compare_exchange_n(&(pParent->startNs), &unset, now, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            IO_TRACE(IO_TRACE_START, ASYNC_FILE_ACCESSOR_MMAP, pParent->parent.handle);
+        }
     }
-    else
+    else if (0 == pRequest->merge.count)
     {
-        pthread_mutex_lock(&(pRequest->lock));
-        pRequest->status = (REQUEST_STAT_CANCEL == pRequest->status) ? pRequest->status : REQUEST_STAT_IOFAIL;
-        pthread_cond_signal(&(pRequest->isFinished));
-        pthread_mutex_unlock(&(pRequest->lock));
-        printf("Error: file [%s] write fail! error: %d - %s.\n", pRequest->parent.info.fn, errno, strerror(errno));
+        pRequest->startNs = now;
+        IO_TRACE(IO_TRACE_START, ASYNC_FILE_ACCESSOR_MMAP, pRequest->parent.handle);
     }
 
-    munmap(pRequest->buf, pRequest->nbytes);
-    pRequest->buf = NULL;
-
-    if (pRequest->fd > 0)
+    for (u32 i = 0; i < pRequest->merge.count; i++)
     {
-        close(pRequest->fd);
-        pRequest->fd = -1;
+        ((mmap_request_t *)pRequest->merge.ppMembers[i])->startNs = now;
+        IO_TRACE(IO_TRACE_START, ASYNC_FILE_ACCESSOR_MMAP, pRequest->merge.ppMembers[i]->handle);
     }
-
-    // printf(" ------ Done mmapWrite: [%s]\n", pRequest->parent.info.fn);
-
-    return NULL;
 }
 
-/// Worker thread funtion
-static void *worker_thread(void *arg)
+/// Read request task process function
+static void *mmapRead(void *param)
 {
-    thread_pool_t  *thread_pool = (thread_pool_t *)arg;
-    task_queue_t   *task_queue  = &(thread_pool->task_queue);
-    task_t         *request_task;
-    u32             idx;
+    mmap_request_t *pRequest    = (mmap_request_t *)param;
+    u32             handle      = pRequest->parent.handle;
+    void           *mmapAddr    = MAP_FAILED;
+    u32             retry_times = 0;
+    bool            isSuccess   = FALSE;
 
-    /// Acquire thread index
-    pthread_mutex_lock(&(thread_pool->info.lock));
-    idx = thread_pool->info.maxThreadIdx++;
-    thread_pool->info.aliveThreadNum++;
-    thread_pool->info.idleThreadNum++;
-    // printf("worker_thread[%d]: initialize done, start to process task.\n", idx);
-    // printf("-- Thread Pool State: aliveThreadNum[%d], busyThreadNum[%d], idleThreadNum[%d].\n",
-        //    thread_pool->info.aliveThreadNum, thread_pool->info.busyThreadNum, thread_pool->info.idleThreadNum);
-    pthread_mutex_unlock(&(thread_pool->info.lock));
+    /// mmap offset must be page aligned, map from the page holding offset
+    u64             delta       = pRequest->offset % (u64)sysconf(_SC_PAGESIZE);
+    s32             flags       = MAP_PRIVATE | ((pRequest->isLease && pRequest->isPopulate) ? MAP_POPULATE : 0);
 
-    while (true)
+    IO_TRACE(IO_TRACE_TASK_BEGIN, ASYNC_FILE_ACCESSOR_MMAP, handle);
+    mmap_request_start(pRequest);
+
+    if (!mmap_request_is_canceled(pRequest))
     {
-        /// Acquire request task
-        pthread_mutex_lock(&(task_queue->lock));
-        while (task_queue->todoCnt == 0)
+        // printf(" ------ Start mmapRead: [%s]\n", pRequest->parent.info.fn);
+
+        do {
+            mmapAddr = mmap(NULL, pRequest->nbytes + delta, PROT_READ, flags, pRequest->fd, pRequest->offset - delta);
+        }
+        while (MAP_FAILED == mmapAddr && retry_times++ < MAX_RETRY_TIMES);
+
+        if (mmapAddr != MAP_FAILED)
         {
-            pthread_cond_wait(&(task_queue->not_empty), &(task_queue->lock));
+            readahead_advise_mapping(mmapAddr, pRequest->nbytes + delta, pRequest->parent.info.hint);
         }
 
-        request_task = task_queue->request_queue[task_queue->head];
-        task_queue->head++;
-        task_queue->todoCnt--;
-        // printf("worker_thread[%d]: Acquire task success! Total[%d], Todo[%d], Processed[%d].\n",
-            //    idx, task_queue->totoalCnt, task_queue->todoCnt, task_queue->totoalCnt - task_queue->todoCnt);
-        pthread_mutex_unlock(&(task_queue->lock));
+        if (mmapAddr != MAP_FAILED && pRequest->isLease)
+        {
+            /// Lease keeps the mapping until releaseReadLease
+            pRequest->mapAddr   = mmapAddr;
+            pRequest->mapLen    = pRequest->nbytes + delta;
+            pRequest->buf       = (char8 *)mmapAddr + delta;
+            mmapAddr            = MAP_FAILED;
+            isSuccess           = TRUE;
+        }
+        else if (mmapAddr != MAP_FAILED && pRequest->iov.count > 0)
+        {
+            io_vector_scatter(&(pRequest->iov), (char8 *)mmapAddr + delta);
+            isSuccess = TRUE;
+        }
+        else
+        {
+            isSuccess = (mmapAddr != MAP_FAILED &&
+                         memcpy(pRequest->buf, (char8 *)mmapAddr + delta, pRequest->nbytes) != NULL);
+        }
 
-        /// If acquire sentinel task, thread exit.
-        if (!thread_pool->info.isRunning && request_task->is_sentinel)
+        if (!isSuccess)
         {
-            // printf("worker_thread[%d]: Acquire sentinel task, exit.\n", idx);
-            break;
+            printf("Error: file [%s] read fail! error: %d - %s.\n", pRequest->parent.info.fn, errno, strerror(errno));
         }
+    }
 
-        pthread_mutex_lock(&(thread_pool->info.lock));
-        thread_pool->info.busyThreadNum++;
-        thread_pool->info.idleThreadNum--;
-        // printf("-- Thread Pool State: aliveThreadNum[%d], busyThreadNum[%d], idleThreadNum[%d].\n",
-            // thread_pool->info.aliveThreadNum, thread_pool->info.busyThreadNum, thread_pool->info.idleThreadNum);
-        pthread_mutex_unlock(&(thread_pool->info.lock));
+    if (mmapAddr != MAP_FAILED)
+    {
+        munmap(mmapAddr, pRequest->nbytes + delta);
+        mmapAddr = NULL;
+    }
+
+    /// Copied out and unmapped, page cache may go. Merged read leaves it to each member
+    if (isSuccess && !pRequest->isLease && 0 == pRequest->merge.count)
+    {
+        readahead_release(pRequest->fd, pRequest->offset, pRequest->nbytes, pRequest->parent.info.hint);
+    }
 
-        (*(request_task->function))(request_task->argument);
+    mmap_request_close_fd(pRequest);
+    mmap_request_finish(pRequest, isSuccess);
 
-        pthread_mutex_lock(&(thread_pool->info.lock));
-        thread_pool->info.busyThreadNum--;
-        thread_pool->info.idleThreadNum++;
-        // printf("-- Thread Pool State: aliveThreadNum[%d], busyThreadNum[%d], idleThreadNum[%d].\n",
-            // thread_pool->info.aliveThreadNum, thread_pool->info.busyThreadNum, thread_pool->info.idleThreadNum);
-        pthread_mutex_unlock(&(thread_pool->info.lock));
+    // printf(" ------ Done mmapRead: [%s]\n", pRequest->parent.info.fn);
+
+    /// Request may be released already, only its handle is used
+    IO_TRACE(IO_TRACE_TASK_END, ASYNC_FILE_ACCESSOR_MMAP, handle);
+
+    return NULL;
+}
+
+/// Unmapped write is done, drop its pages if asked and finish it
+static void mmap_write_done(void *arg, s64 result)
+{
+    mmap_request_t *pRequest = (mmap_request_t *)arg;
+
+    /// Pages are clean once flushed, written back later otherwise
+    if (result >= 0)
+    {
+        readahead_release(pRequest->fd, pRequest->offset, pRequest->nbytes, pRequest->parent.info.hint);
     }
 
-    // printf("worker_thread[%d]: exit.\n", idx);
-    pthread_exit(NULL);
+    mmap_request_close_fd(pRequest);
+    mmap_request_finish(pRequest, result >= 0);
 }
 
-/// Submit request task to thread pool
-static ret_t thread_pool_submit(thread_pool_t *thread_pool, task_t *task)
+/// Complete an unmapped original write. A durable one joins the group commit of its file
+/// and is done from the flush thread once the group is flushed
+static void mmap_write_complete(mmap_request_t *pRequest, bool isSuccess)
 {
-    ret_t           res         = RET_OK;
-    task_queue_t   *task_queue  = &(thread_pool->task_queue);
+    if (isSuccess && group_commit_is_durable(&(pRequest->parent.info)) && !mmap_request_is_canceled(pRequest))
+    {
+        /// Traced before the call, a write that cannot be queued is flushed in place and completes right away
+        IO_TRACE(IO_TRACE_COMMIT, pRequest->pAccessor->parent.type, pRequest->parent.handle);
+        group_commit_join(&(pRequest->pAccessor->commits), &(pRequest->commit), pRequest->fd, &(pRequest->fsb),
+                          pRequest->offset, pRequest->nbytes, &(pRequest->parent.info),
+                          mmap_write_done, pRequest, (s64)pRequest->nbytes);
+    }
+    else
+    {
+        mmap_write_done(pRequest, isSuccess ? (s64)pRequest->nbytes : -EIO);
+    }
+}
+
+/// Write request task process function, caller filled the shared mapping so data is in page cache.
+/// Flushing it is left to group commit of durable writes, or to kernel writeback
+static void *mmapWrite(void *param)
+{
+    mmap_request_t *pRequest    = (mmap_request_t *)param;
+    u32             handle      = pRequest->parent.handle;
+    bool            isSuccess   = FALSE;
+
+    IO_TRACE(IO_TRACE_TASK_BEGIN, ASYNC_FILE_ACCESSOR_MMAP, handle);
+    mmap_request_start(pRequest);
 
-    if ((thread_pool->info.isRunning && !task->is_sentinel) ||
-        (!thread_pool->info.isRunning && task->is_sentinel))
+    if (!mmap_request_is_canceled(pRequest))
     {
-        pthread_mutex_lock(&(task_queue->lock));
+        // printf(" ------ Start mmapWrite: [%s]\n", pRequest->parent.info.fn);
 
-        if (task_queue->totoalCnt % REQ_LIST_BUFSIZE == 0)
+        /// Vectored write has no mapping yet, map its range here and gather segments into it
+        if (pRequest->iov.count > 0)
         {
-            u32 newListBufSize = ((task_queue->totoalCnt + REQ_LIST_BUFSIZE) / REQ_LIST_BUFSIZE)
-                                    * REQ_LIST_BUFSIZE * sizeof(task_t *);
-            task_t **new_queue = (task_t **)realloc(task_queue->request_queue, newListBufSize);
+            u64     delta       = pRequest->offset % (u64)sysconf(_SC_PAGESIZE);
+            void   *mmapAddr    = mmap(NULL, pRequest->nbytes + delta, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED, pRequest->fd, pRequest->offset - delta);
 
-            if (NULL == new_queue)
-            {
-                res = RET_NO_MEMORY;
-                printf("Error: fail to realloc request list! res = %d.\n", res);
-            }
-            else
+            if (MAP_FAILED != mmapAddr)
             {
-                task_queue->request_queue = new_queue;
+                pRequest->mapAddr   = mmapAddr;
+                pRequest->mapLen    = pRequest->nbytes + delta;
+                io_vector_gather(&(pRequest->iov), (char8 *)mmapAddr + delta);
             }
         }
 
-        task_queue->request_queue[task_queue->tail] = task;
-        task_queue->tail++;
-        task_queue->todoCnt++;
-        task_queue->totoalCnt++;
+        /// Chunk filled a slice of its striped request's mapping
+        isSuccess = (NULL != pRequest->mapAddr || NULL != pRequest->stripe.pParent);
+        if (!isSuccess)
+        {
+            printf("Error: file [%s] write fail! error: %d - %s.\n", pRequest->parent.info.fn, errno, strerror(errno));
+        }
+    }
 
-        // printf("Task submit success! Total[%d], Todo[%d], Processed[%d].\n",
-        //     task_queue->totoalCnt, task_queue->todoCnt, task_queue->totoalCnt - task_queue->todoCnt);
-        pthread_cond_signal(&(task_queue->not_empty));
-        pthread_mutex_unlock(&(task_queue->lock));
+    if (NULL != pRequest->mapAddr)
+    {
+        munmap(pRequest->mapAddr, pRequest->mapLen);
+        pRequest->mapAddr   = NULL;
+    }
+    pRequest->buf = NULL;
+
+    /// Chunks leave flush and page release to their striped request
+    if (NULL != pRequest->stripe.pParent)
+    {
+        mmap_request_close_fd(pRequest);
+        mmap_request_finish(pRequest, isSuccess);
     }
-    else if(!thread_pool->info.isRunning && !task->is_sentinel)
+    else
     {
-        res = RET_ALREADY_EXISTS;
-        printf("Warning: thread pool is closing, task rejected!\n");
+        mmap_write_complete(pRequest, isSuccess);
     }
 
-    return res;
+    // printf(" ------ Done mmapWrite: [%s]\n", pRequest->parent.info.fn);
+
+    /// Request may be released already, only its handle is used
+    IO_TRACE(IO_TRACE_TASK_END, ASYNC_FILE_ACCESSOR_MMAP, handle);
+
+    return NULL;
 }
 
-/// Ckeck whether mmap request valid
-static ret_t mmap_check_request_valid(mmap_request_t *pRequest)
+/// Try to claim a free slot and store task, FALSE if ring is full
+static bool task_ring_try_push(task_ring_t *task_ring, const task_t *task)
 {
-    ret_t res = RET_OK;
+    u64 pos = __atomic_load_n(&(task_ring->enqueuePos), __ATOMIC_RELAXED);
 
-    if (NULL == pRequest)
+    while (true)
     {
-        res = RET_BAD_VALUE;
-        printf("Error: invalid request detected: empty request! res = %d.\n", res);
+        task_slot_t *slot = &(task_ring->slots[pos & task_ring->mask]);
+        s64          diff = (s64)__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) - (s64)pos;
+
+        if (0 == diff)
+        {
+            if (__atomic_compare_exchange_n(&(task_ring->enqueuePos), &pos, pos + 1,
+                                            TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                slot->task = *task;
+                __atomic_store_n(&(slot->seq), pos + 1, __ATOMIC_RELEASE);
+                return TRUE;
+            }
+        }
+        else if (diff < 0)
+        {
+            return FALSE;
+        }
+        else
+        {
+            pos = __atomic_load_n(&(task_ring->enqueuePos), __ATOMIC_RELAXED);
+        }
     }
+}
 
-    else if (RET_OK == res && !pRequest->isValid)
+/// Try to claim a filled slot and load task, FALSE if ring is empty
+static bool task_ring_try_pop(task_ring_t *task_ring, task_t *task)
+{
+    u64 pos = __atomic_load_n(&(task_ring->dequeuePos), __ATOMIC_RELAXED);
+
+    while (true)
     {
-        async_file_access_request_info_t *pCreateInfo = &(pRequest->parent.info);
+        task_slot_t *slot = &(task_ring->slots[pos & task_ring->mask]);
+        s64          diff = (s64)__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) - (s64)(pos + 1);
 
-        if (NULL == pCreateInfo || pCreateInfo->size <= 0||
-            (pCreateInfo->direction < 0 || pCreateInfo->direction >= ASYNC_FILE_ACCESS_MAX))
+        if (0 == diff)
         {
-            res = RET_BAD_VALUE;
-            printf("Error: invalid request detected: invalid info! res = %d.\n", res);
+            if (__atomic_compare_exchange_n(&(task_ring->dequeuePos), &pos, pos + 1,
+                                            TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                *task = slot->task;
+                __atomic_store_n(&(slot->seq), pos + task_ring->mask + 1, __ATOMIC_RELEASE);
+                return TRUE;
+            }
+        }
+        else if (diff < 0)
+        {
+            return FALSE;
         }
         else
         {
-        //     s32 fd = pCreateInfo->direction == ASYNC_FILE_ACCESS_READ
-        //                  ? open((char8 *)(pCreateInfo->fn), O_RDONLY, 0666)
-        //                  : open((char8 *)(pCreateInfo->fn), O_WRONLY | O_CREAT, 0666);
-        //     if (fd < 0)
-        //     {
-        //         res = RET_BAD_VALUE;
-        //         printf("Error: invalid request detected: file [%s] not exist! res = %d.\n",
-        //                pCreateInfo->fn, res);
-        //     }
-        //     else
-        //     {
-        //         close(fd);
-                pRequest->isValid = TRUE;
-        //     }
+            pos = __atomic_load_n(&(task_ring->dequeuePos), __ATOMIC_RELAXED);
         }
     }
-
-    return res;
 }
 
-/// Get mmap request
-static ret_t mmap_get_request(async_file_accessor_t            *thiz,
-                              async_file_access_request_t     **pAsyncRequest,
-                              async_file_access_request_info_t *pCreateInfo)
+/// Try to store task in the ring of its class, FALSE if that ring is full
+static bool task_queue_try_push(task_queue_t *task_queue, const task_t *task)
 {
-    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
-    mmap_request_t      **pRequest      = (mmap_request_t **)pAsyncRequest;
+    return task_ring_try_push(&(task_queue->rings[prio_class_rank(task->priority)]), task);
+}
 
-    ret_t   res         = RET_OK;
-    u32     retry_times = 0;
-    *pRequest = (mmap_request_t *)malloc(sizeof(mmap_request_t));
-    memset(*pRequest, 0, sizeof(mmap_request_t));
+/// Try to load a task, the rank of this turn first and then by rank so none idles while a ring has work.
+/// FALSE if every ring is empty
+static bool task_queue_try_pop(task_queue_t *task_queue, task_t *task)
+{
+    u32 first = prio_class_turn(__atomic_fetch_add(&(task_queue->popTurn), 1, __ATOMIC_RELAXED));
 
-    (*pRequest)->parent.info.direction  = pCreateInfo->direction;
-    (*pRequest)->parent.info.size       = pCreateInfo->size;
-    (*pRequest)->parent.info.offset     = pCreateInfo->offset;
-    memcpy((*pRequest)->parent.info.fn, pCreateInfo->fn, MAX_FILE_NAME_LEN);
-    res = mmap_check_request_valid(*pRequest);
+    if (task_ring_try_pop(&(task_queue->rings[first]), task))
+    {
+        return TRUE;
+    }
 
-    if (RET_OK == res)
+    for (u32 i = 0; i < PRIO_CLASS_RANKS; i++)
     {
-        do {
-            (*pRequest)->fd = pCreateInfo->direction == ASYNC_FILE_ACCESS_READ
-                              ? open((char8 *)(pCreateInfo->fn), O_RDONLY, 0666)
-                              : open((char8 *)(pCreateInfo->fn), O_RDWR | O_CREAT | O_TRUNC, 0666);
+        if (i != first && task_ring_try_pop(&(task_queue->rings[i]), task))
+        {
+            return TRUE;
         }
-        while ((*pRequest)->fd==-1 && retry_times++ < MAX_RETRY_TIMES);
+    }
 
-        if ((*pRequest)->fd >= 0)
+    return FALSE;
+}
+
+/// Whether every ring is empty, a racy hint for sizing decisions
+static bool task_queue_is_empty(task_queue_t *task_queue)
+{
+    for (u32 i = 0; i < PRIO_CLASS_RANKS; i++)
+    {
+        if (__atomic_load_n(&(task_queue->rings[i].enqueuePos), __ATOMIC_RELAXED) !=
+            __atomic_load_n(&(task_queue->rings[i].dequeuePos), __ATOMIC_RELAXED))
         {
-            (*pRequest)->buf            = NULL;
-            (*pRequest)->isAlloced      = FALSE;
-            (*pRequest)->status         = REQUEST_STAT_INIT;
-            (*pRequest)->nbytes         = pCreateInfo->size;
-            (*pRequest)->offset         = lseek((*pRequest)->fd, pCreateInfo->offset, SEEK_CUR);
+            return FALSE;
+        }
+    }
 
-            if ((*pRequest)->parent.info.direction == ASYNC_FILE_ACCESS_WRITE)
-            {
-                ftruncate((*pRequest)->fd, (*pRequest)->nbytes);
-            }
-            fstat((*pRequest)->fd, &(*pRequest)->fsb);
-            pthread_mutex_init(&((*pRequest)->lock), NULL);
-            pthread_cond_init(&((*pRequest)->isFinished), NULL);
+    return TRUE;
+}
+
+/// Wake sleepers on cond if any registered, pairs with the fence in task_queue_sleep
+static void task_queue_wake(task_queue_t *task_queue, u32 *waiters, pthread_cond_t *cond, u32 count)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiters, __ATOMIC_RELAXED) > 0)
+    {
+        pthread_mutex_lock(&(task_queue->lock));
+        if (1 == count)
+        {
+            pthread_cond_signal(cond);
         }
         else
         {
-            res = RET_BAD_VALUE;
-            printf("Error: file [%s] open fail! error: %d - %s.\n",
-                   (*pRequest)->parent.info.fn, errno, strerror(errno));
+            pthread_cond_broadcast(cond);
         }
+        pthread_mutex_unlock(&(task_queue->lock));
     }
+}
 
-    // printf("file = %s: fd = %d, req_addr = %p.\n", (*pRequest)->parent.info.fn, (*pRequest)->fd, (*pRequest));
+/// Register as sleeper, retry once and sleep on cond until woken or deadline if still failing.
+/// Return retry result
+static bool task_queue_sleep(task_queue_t          *task_queue,
+                             u32                   *waiters,
+                             pthread_cond_t        *cond,
+                             bool                 (*retry)(task_queue_t *, void *),
+                             void                  *arg,
+                             const struct timespec *deadline)
+{
+    bool isDone;
 
-    return res;
+    pthread_mutex_lock(&(task_queue->lock));
+    __atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    /// Waker holds the lock to signal, so a state change after this retry cannot be missed
+    isDone = retry(task_queue, arg);
+    if (!isDone && NULL != deadline)
+    {
+        pthread_cond_timedwait(cond, &(task_queue->lock), deadline);
+    }
+    else if (!isDone)
+    {
+        pthread_cond_wait(cond, &(task_queue->lock));
+    }
+
+    __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&(task_queue->lock));
+
+    return isDone;
 }
 
-/// Alloc mmap write request buffer
-static ret_t mmap_request_alloc_write_buffer(async_file_accessor_t       *thiz,
-                                             async_file_access_request_t *pAsyncRequest,
-                                             void                       **buffer)
+static bool task_queue_retry_push(task_queue_t *task_queue, void *arg)
 {
-    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
-    mmap_request_t       *pRequest      = (mmap_request_t *)pAsyncRequest;
+    return task_queue_try_push(task_queue, (const task_t *)arg);
+}
 
-    u32     retry_times = 0;
-    ret_t   res         = mmap_check_request_valid(pRequest);
+/// Push task, sleep while queue is full
+static void task_queue_push(task_queue_t *task_queue, const task_t *task)
+{
+    bool isPushed = task_queue_try_push(task_queue, task);
 
-    if (pRequest->nbytes <= 0)
+    while (!isPushed)
     {
-        res = RET_BAD_VALUE;
-        pRequest->status = REQUEST_STAT_IOFAIL;
-        printf("Error: invalid malloc buffer size! res = %d.\n", res);
+        isPushed = task_queue_sleep(task_queue, &(task_queue->fullWaiters), &(task_queue->not_full),
+                                    task_queue_retry_push, (void *)task, NULL);
+        isPushed = isPushed || task_queue_try_push(task_queue, task);
     }
+}
+
+/// Owner pushes task at bottom, FALSE if deque is full
+static bool task_deque_push(task_deque_t *deque, const task_t *task)
+{
+    s64 bottom  = __atomic_load_n(&(deque->bottom), __ATOMIC_RELAXED);
+    s64 top     = __atomic_load_n(&(deque->top), __ATOMIC_ACQUIRE);
+
+    if (bottom - top >= WORKER_DEQUE_DEPTH)
+    {
+        return FALSE;
+    }
+
+    deque->slots[bottom & (WORKER_DEQUE_DEPTH - 1)] = *task;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&(deque->bottom), bottom + 1, __ATOMIC_RELAXED);
+
+    return TRUE;
+}
+
+/// Owner pops newest task at bottom, races thieves only for the last one
+static bool task_deque_pop(task_deque_t *deque, task_t *task)
+{
+    bool isPopped   = FALSE;
+    s64  bottom     = __atomic_load_n(&(deque->bottom), __ATOMIC_RELAXED) - 1;
+
+    __atomic_store_n(&(deque->bottom), bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    s64 top = __atomic_load_n(&(deque->top), __ATOMIC_RELAXED);
+
+    if (top <= bottom)
+    {
+        *task       = deque->slots[bottom & (WORKER_DEQUE_DEPTH - 1)];
+        isPopped    = TRUE;
+        if (top == bottom)
+        {
+            isPopped = __atomic_compare_exchange_n(&(deque->top), &top, top + 1,
+                                                   FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+            __atomic_store_n(&(deque->bottom), bottom + 1, __ATOMIC_RELAXED);
+        }
+    }
+    else
+    {
+        __atomic_store_n(&(deque->bottom), bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return isPopped;
+}
+
+/// Thief takes oldest task at top, FALSE if empty or another thief won
+static bool task_deque_steal(task_deque_t *deque, task_t *task)
+{
+    s64 top = __atomic_load_n(&(deque->top), __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    s64 bottom = __atomic_load_n(&(deque->bottom), __ATOMIC_ACQUIRE);
+
+    if (top < bottom)
+    {
+        /// Owner never overwrites slot[top] before top moves, a lost CAS just drops the copy
+        *task = deque->slots[top & (WORKER_DEQUE_DEPTH - 1)];
+        return __atomic_compare_exchange_n(&(deque->top), &top, top + 1,
+                                           FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    }
+
+    return FALSE;
+}
+
+/// Pool and index of current thread if it is a worker, chained submissions stay local
+static __thread thread_pool_t  *t_threadPool    = NULL;
+static __thread u32             t_workerIdx     = 0;
+
+/// Find next task for current worker: own deque first, then shared queue, then steal from peers.
+/// Once the pool stops and nothing is left, a sentinel task tells the worker to exit
+static bool worker_find_task(task_queue_t *task_queue, void *arg)
+{
+    thread_pool_t  *thread_pool = t_threadPool;
+    task_t         *task        = (task_t *)arg;
+
+    if (task_deque_pop(&(thread_pool->deques[t_workerIdx]), task))
+    {
+        return TRUE;
+    }
+
+    if (task_queue_try_pop(task_queue, task))
+    {
+        task_queue_wake(task_queue, &(task_queue->fullWaiters), &(task_queue->not_full), 1);
+        return TRUE;
+    }
+
+    for (u32 i = 1; i < thread_pool->info.maxThreadNum; i++)
+    {
+        if (task_deque_steal(&(thread_pool->deques[(t_workerIdx + i) % thread_pool->info.maxThreadNum]), task))
+        {
+            return TRUE;
+        }
+    }
+
+    task->is_sentinel = !__atomic_load_n(&(thread_pool->info.isRunning), __ATOMIC_SEQ_CST);
+
+    return task->is_sentinel;
+}
+
+/// Wait for next task. A sentinel is returned when the pool stops or the worker idles for idleTimeoutMs
+static void worker_wait_task(thread_pool_t *thread_pool, task_t *task)
+{
+    task_queue_t   *task_queue = &(thread_pool->task_queue);
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec  += thread_pool->info.idleTimeoutMs / 1000;
+    deadline.tv_nsec += (thread_pool->info.idleTimeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    bool isFound = worker_find_task(task_queue, task);
+    while (!isFound)
+    {
+        struct timespec now;
+
+        isFound = task_queue_sleep(task_queue, &(task_queue->idleWaiters), &(task_queue->not_empty),
+                                   worker_find_task, task, &deadline);
+        isFound = isFound || worker_find_task(task_queue, task);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (!isFound && (now.tv_sec > deadline.tv_sec ||
+                         (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)))
+        {
+            task->is_sentinel   = TRUE;
+            isFound             = TRUE;
+        }
+    }
+}
+
+/// Sum per-worker statistics into thread pool information
+static void thread_pool_update_info(thread_pool_t *thread_pool)
+{
+    u32 busyThreadNum   = 0;
+    u64 processedCnt    = 0;
+
+    /// Slots are summed under the lock, pollers may come in while the pool is stopped and slots are gone
+    pthread_mutex_lock(&(thread_pool->info.lock));
+    if (NULL == thread_pool->workers)
+    {
+        pthread_mutex_unlock(&(thread_pool->info.lock));
+        return;
+    }
+
+    for (u32 i = 0; i < thread_pool->info.maxThreadNum; i++)
+    {
+        busyThreadNum  += __atomic_load_n(&(thread_pool->workers[i].isBusy), __ATOMIC_RELAXED) ? 1 : 0;
+        processedCnt   += __atomic_load_n(&(thread_pool->workers[i].processedCnt), __ATOMIC_RELAXED);
+    }
+
+    thread_pool->info.busyThreadNum = busyThreadNum;
+    thread_pool->info.idleThreadNum = thread_pool->info.aliveThreadNum - busyThreadNum;
+    thread_pool->info.processedCnt  = processedCnt;
+    pthread_mutex_unlock(&(thread_pool->info.lock));
+}
+
+/// Leave the pool if it is stopping or above its minimum size, the slot is free for a new worker
+static bool thread_pool_retire(thread_pool_t *thread_pool, worker_stat_t *stat)
+{
+    bool isRetired;
+
+    pthread_mutex_lock(&(thread_pool->info.lock));
+    isRetired = !thread_pool->info.isRunning || thread_pool->info.aliveThreadNum > thread_pool->info.minThreadNum;
+    if (isRetired)
+    {
+        thread_pool->info.aliveThreadNum--;
+        stat->isAlive = FALSE;
+        pthread_cond_broadcast(&(thread_pool->info.changed));
+        // printf("-- Thread Pool State: worker[%d] exit, aliveThreadNum[%d].\n",
+        //        stat->idx, thread_pool->info.aliveThreadNum);
+    }
+    pthread_mutex_unlock(&(thread_pool->info.lock));
+
+    return isRetired;
+}
+
+/// Worker thread funtion
+static void *worker_thread(void *arg)
+{
+    worker_stat_t          *stat        = (worker_stat_t *)arg;
+    thread_pool_t          *thread_pool = stat->pOwner;
+    task_t                  request_task;
+    async_file_priority_t   priority    = ASYNC_FILE_PRIO_NORMAL;
+
+    t_threadPool    = thread_pool;
+    t_workerIdx     = stat->idx;
+    // printf("worker_thread[%d]: initialize done, start to process task.\n", stat->idx);
+
+    while (true)
+    {
+        /// Acquire request task, sleep until own deque, shared queue or a peer deque has one
+        worker_wait_task(thread_pool, &request_task);
+
+        /// Sentinel means stopping or idle too long, exit unless pool is at its minimum size
+        if (request_task.is_sentinel)
+        {
+            if (thread_pool_retire(thread_pool, stat))
+            {
+                break;
+            }
+            continue;
+        }
+
+        /// Page faults and writeback of the task are issued at its class, switched only on change
+        if (request_task.priority != priority)
+        {
+            priority = request_task.priority;
+            prio_class_set_thread(priority);
+        }
+
+        /// Only this worker writes its stat line, readers sum them in thread_pool_update_info
+        __atomic_store_n(&(stat->isBusy), TRUE, __ATOMIC_RELAXED);
+        (*(request_task.function))(request_task.argument);
+        __atomic_store_n(&(stat->isBusy), FALSE, __ATOMIC_RELAXED);
+        __atomic_store_n(&(stat->processedCnt), stat->processedCnt + 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_exit(NULL);
+}
+
+/// Start a detached worker in a free slot, must hold thread pool information lock
+static ret_t thread_pool_spawn_worker(thread_pool_t *thread_pool)
+{
+    ret_t           res     = RET_MAX_USERS;
+    pthread_attr_t  attr;
+    pthread_t       thread;
+
+    for (u32 i = 0; RET_MAX_USERS == res && i < thread_pool->info.maxThreadNum; i++)
+    {
+        worker_stat_t *stat = &(thread_pool->workers[i]);
+        if (!stat->isAlive)
+        {
+            stat->pOwner    = thread_pool;
+            stat->idx       = i;
+            stat->isAlive   = TRUE;
+
+            pthread_attr_init(&attr);
+            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+            res = (pthread_create(&thread, &attr, worker_thread, stat) == 0) ? RET_OK : RET_NO_MEMORY;
+            pthread_attr_destroy(&attr);
+
+            if (RET_OK == res)
+            {
+                thread_pool->info.aliveThreadNum++;
+                thread_pool->info.maxThreadIdx++;
+            }
+            else
+            {
+                stat->isAlive = FALSE;
+                printf("Error: worker thread create fail! res = %d.\n", res);
+            }
+        }
+    }
+
+    return res;
+}
+
+/// Add a worker when every alive worker is busy and tasks are still queued
+static void thread_pool_try_grow(thread_pool_t *thread_pool)
+{
+    task_queue_t *task_queue = &(thread_pool->task_queue);
+
+    /// Cheap unlocked checks first, the decision is repeated under the lock
+    if (__atomic_load_n(&(task_queue->idleWaiters), __ATOMIC_RELAXED) > 0                 ||
+        task_queue_is_empty(task_queue)                                                    ||
+        __atomic_load_n(&(thread_pool->info.aliveThreadNum), __ATOMIC_RELAXED) >= thread_pool->info.maxThreadNum)
+    {
+        return;
+    }
+
+    thread_pool_update_info(thread_pool);
+
+    pthread_mutex_lock(&(thread_pool->info.lock));
+    if (thread_pool->info.isRunning                                             &&
+        thread_pool->info.busyThreadNum >= thread_pool->info.aliveThreadNum     &&
+        thread_pool->info.aliveThreadNum < thread_pool->info.maxThreadNum)
+    {
+        thread_pool_spawn_worker(thread_pool);
+        // printf("-- Thread Pool State: grow, aliveThreadNum[%d].\n", thread_pool->info.aliveThreadNum);
+    }
+    pthread_mutex_unlock(&(thread_pool->info.lock));
+}
+
+/// Submit a batch of request tasks to thread pool, tasks are copied into the ring
+static ret_t thread_pool_submit_batch(thread_pool_t *thread_pool, const task_t *tasks, u32 count)
+{
+    ret_t           res         = RET_OK;
+    task_queue_t   *task_queue  = &(thread_pool->task_queue);
+
+    if (thread_pool->info.isRunning)
+    {
+        task_deque_t *deque = (t_threadPool == thread_pool) ? &(thread_pool->deques[t_workerIdx]) : NULL;
+
+        for (u32 i = 0; i < count; i++)
+        {
+            /// Worker submissions go to its own deque first, idle peers steal them
+            bool isQueued = (NULL != deque && task_deque_push(deque, &(tasks[i]))) ||
+                            task_queue_try_push(task_queue, &(tasks[i]));
+
+            if (!isQueued && NULL != deque)
+            {
+                /// Worker must not sleep on a full queue only workers drain, run task inline
+                (*(tasks[i].function))(tasks[i].argument);
+            }
+            else if (!isQueued)
+            {
+                /// Queue full, wake workers before sleeping for room
+                task_queue_wake(task_queue, &(task_queue->idleWaiters), &(task_queue->not_empty), i + 1);
+                thread_pool_try_grow(thread_pool);
+                task_queue_push(task_queue, &(tasks[i]));
+            }
+        }
+
+        // printf("Task submit success! count[%d].\n", count);
+        task_queue_wake(task_queue, &(task_queue->idleWaiters), &(task_queue->not_empty), count);
+        thread_pool_try_grow(thread_pool);
+    }
+    else
+    {
+        res = RET_ALREADY_EXISTS;
+        printf("Warning: thread pool is closing, task rejected!\n");
+    }
+
+    return res;
+}
+
+// Stop thread pool, wait until every worker drained the queues and exited
+static void thread_pool_deinit(thread_pool_t *thread_pool)
+{
+    task_queue_t   *task_queue  = &(thread_pool->task_queue);
+    worker_stat_t  *workers     = NULL;
+    task_deque_t   *deques      = NULL;
+
+    __atomic_store_n(&(thread_pool->info.isRunning), FALSE, __ATOMIC_SEQ_CST);
+    task_queue_wake(task_queue, &(task_queue->idleWaiters), &(task_queue->not_empty), 0);
+
+    pthread_mutex_lock(&(thread_pool->info.lock));
+    while (thread_pool->info.aliveThreadNum > 0)
+    {
+        pthread_cond_wait(&(thread_pool->info.changed), &(thread_pool->info.lock));
+    }
+    pthread_mutex_unlock(&(thread_pool->info.lock));
+
+    thread_pool_update_info(thread_pool);
+    // printf("-- Thread Pool State: aliveThreadNum[%d], busyThreadNum[%d], idleThreadNum[%d], processed[%llu].\n",
+    //        thread_pool->info.aliveThreadNum, thread_pool->info.busyThreadNum,
+    //        thread_pool->info.idleThreadNum, thread_pool->info.processedCnt);
+
+    for (u32 i = 0; i < PRIO_CLASS_RANKS; i++)
+    {
+        free(thread_pool->task_queue.rings[i].slots);
+        thread_pool->task_queue.rings[i].slots = NULL;
+    }
+
+    /// Pollers read worker slots under the info lock, take them away under it before freeing
+    pthread_mutex_lock(&(thread_pool->info.lock));
+    workers                 = thread_pool->workers;
+    deques                  = thread_pool->deques;
+    thread_pool->workers    = NULL;
+    thread_pool->deques     = NULL;
+    pthread_mutex_unlock(&(thread_pool->info.lock));
+
+    free(workers);
+    free(deques);
+    thread_pool->info.isInitialized = FALSE;
+}
+
+/// Ckeck whether mmap request valid
+static ret_t mmap_check_request_valid(mmap_request_t *pRequest)
+{
+    ret_t res = RET_OK;
+
+    if (NULL == pRequest)
+    {
+        res = RET_BAD_VALUE;
+        printf("Error: invalid request detected: empty request! res = %d.\n", res);
+    }
+
+    else if (REQUEST_HANDLE_NONE == __atomic_load_n(&(pRequest->parent.handle), __ATOMIC_ACQUIRE))
+    {
+        res = RET_DEAD_OBJECT;
+        printf("Error: invalid request detected: request already released! res = %d.\n", res);
+    }
+
+    else if (RET_OK == res && !pRequest->isValid)
+    {
+        async_file_access_request_info_t *pCreateInfo = &(pRequest->parent.info);
+
+        if (NULL == pCreateInfo || pCreateInfo->size <= 0||
+            (pCreateInfo->direction < 0 || pCreateInfo->direction >= ASYNC_FILE_ACCESS_MAX) ||
+            (pCreateInfo->hint < 0 || pCreateInfo->hint >= ASYNC_FILE_HINT_MAX) ||
+            (pCreateInfo->durability < 0 || pCreateInfo->durability >= ASYNC_FILE_DURABLE_MAX) ||
+            (pCreateInfo->priority < 0 || pCreateInfo->priority >= ASYNC_FILE_PRIO_MAX))
+        {
+            res = RET_BAD_VALUE;
+            printf("Error: invalid request detected: invalid info! res = %d.\n", res);
+        }
+        else
+        {
+        //     s32 fd = pCreateInfo->direction == ASYNC_FILE_ACCESS_READ
+        //                  ? open((char8 *)(pCreateInfo->fn), O_RDONLY, 0666)
+        //                  : open((char8 *)(pCreateInfo->fn), O_WRONLY | O_CREAT, 0666);
+        //     if (fd < 0)
+        //     {
+        //         res = RET_BAD_VALUE;
+        //         printf("Error: invalid request detected: file [%s] not exist! res = %d.\n",
+        //                pCreateInfo->fn, res);
+        //     }
+        //     else
+        //     {
+        //         close(fd);
+                pRequest->isValid = TRUE;
+        //     }
+        }
+    }
+
+    return res;
+}
+
+/// One-time mmap request slot setup, locks live as long as the pool
+static void mmap_request_slot_init(async_file_access_request_t *pAsyncRequest)
+{
+    mmap_request_t *pRequest = (mmap_request_t *)pAsyncRequest;
+
+    pRequest->fd = -1;
+    pthread_mutex_init(&(pRequest->lock), NULL);
+    pthread_cond_init(&(pRequest->isFinished), NULL);
+}
+
+/// Get mmap request from accessor request pool
+static ret_t mmap_get_request(async_file_accessor_t            *thiz,
+                              async_file_access_request_t     **pAsyncRequest,
+                              async_file_access_request_info_t *pCreateInfo)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+    mmap_request_t      **pRequest      = (mmap_request_t **)pAsyncRequest;
+    u64                   getNs         = prio_class_now_ns();
+
+    u32     retry_times = 0;
+    ret_t   res         = request_pool_acquire(&(pMmapAccessor->requests), pAsyncRequest);
+    if (RET_OK != res)
+    {
+        *pRequest = NULL;
+        return res;
+    }
+
+    /// Slot is recycled, reset everything validation and workers read
+    (*pRequest)->fd                     = -1;
+    (*pRequest)->mapAddr                = NULL;
+    (*pRequest)->mapLen                 = 0;
+    (*pRequest)->isValid                = FALSE;
+    (*pRequest)->isLease                = FALSE;
+    (*pRequest)->isPopulate             = FALSE;
+    (*pRequest)->isInflight             = FALSE;
+    (*pRequest)->cacheEpoch             = BLOCK_CACHE_NO_FILL;
+    memset(&((*pRequest)->stripe), 0, sizeof(stripe_group_t));
+    memset(&((*pRequest)->merge), 0, sizeof(io_merge_t));
+
+    (*pRequest)->pAccessor              = pMmapAccessor;
+    (*pRequest)->parent.info.direction  = pCreateInfo->direction;
+    (*pRequest)->parent.info.size       = pCreateInfo->size;
+    (*pRequest)->parent.info.offset     = pCreateInfo->offset;
+    (*pRequest)->parent.info.deadline_ms= pCreateInfo->deadline_ms;
+    (*pRequest)->parent.info.fileHandle = pCreateInfo->fileHandle;
+    (*pRequest)->parent.info.hint       = pCreateInfo->hint;
+    (*pRequest)->parent.info.durability = pCreateInfo->durability;
+    (*pRequest)->parent.info.isBarrier  = pCreateInfo->isBarrier;
+    (*pRequest)->parent.info.priority   = pCreateInfo->priority;
+    memcpy((*pRequest)->parent.info.fn, pCreateInfo->fn, MAX_FILE_NAME_LEN);
+    res = mmap_check_request_valid(*pRequest);
+
+    if (RET_OK == res && ASYNC_FILE_HANDLE_NONE != pCreateInfo->fileHandle)
+    {
+        res = file_registry_get(&(pMmapAccessor->files), pCreateInfo->fileHandle, pCreateInfo->direction,
+                                &((*pRequest)->fd), &((*pRequest)->fsb));
+
+        /// Ranged write into a shared file, only ever grow it to cover the mapping
+        if (RET_OK == res && ASYNC_FILE_ACCESS_WRITE == pCreateInfo->direction)
+        {
+            res = file_registry_extend(&(pMmapAccessor->files), pCreateInfo->fileHandle,
+                                       (u64)pCreateInfo->offset + pCreateInfo->size);
+        }
+    }
+    else if (RET_OK == res)
+    {
+        do {
+            (*pRequest)->fd = pCreateInfo->direction == ASYNC_FILE_ACCESS_READ
+                              ? open((char8 *)(pCreateInfo->fn), O_RDONLY, 0666)
+                              : open((char8 *)(pCreateInfo->fn), O_RDWR | O_CREAT | O_TRUNC, 0666);
+        }
+        while ((*pRequest)->fd==-1 && retry_times++ < MAX_RETRY_TIMES);
+
+        if ((*pRequest)->fd >= 0)
+        {
+            fstat((*pRequest)->fd, &(*pRequest)->fsb);
+            if ((*pRequest)->parent.info.direction == ASYNC_FILE_ACCESS_WRITE)
+            {
+                /// Named write truncated the file, nothing cached of it holds anymore
+                ftruncate((*pRequest)->fd, (off_t)(pCreateInfo->offset + pCreateInfo->size));
+                block_cache_invalidate(&(pMmapAccessor->cache), &((*pRequest)->fsb), 0, UINT64_MAX);
+                fstat((*pRequest)->fd, &(*pRequest)->fsb);
+            }
+        }
+        else
+        {
+            res = RET_BAD_VALUE;
+            printf("Error: file [%s] open fail! error: %d - %s.\n",
+                   (*pRequest)->parent.info.fn, errno, strerror(errno));
+        }
+    }
+
+    if (RET_OK == res)
+    {
+        (*pRequest)->buf            = NULL;
+        (*pRequest)->isAlloced      = FALSE;
+        (*pRequest)->status         = REQUEST_STAT_INIT;
+        (*pRequest)->nbytes         = pCreateInfo->size;
+        (*pRequest)->offset         = pCreateInfo->offset;
+        (*pRequest)->getNs          = getNs;
+        IO_TRACE(IO_TRACE_GET, thiz->type, (*pRequest)->parent.handle);
+    }
+    else
+    {
+        if ((*pRequest)->fd >= 0)
+        {
+            file_registry_close_fd(&(pMmapAccessor->files), pCreateInfo->fileHandle, (*pRequest)->fd);
+        }
+        request_pool_release(&(pMmapAccessor->requests), &((*pRequest)->parent));
+        *pRequest = NULL;
+    }
+
+    // printf("file = %s: fd = %d, req_addr = %p.\n", (*pRequest)->parent.info.fn, (*pRequest)->fd, (*pRequest));
+
+    return res;
+}
+
+/// Alloc mmap write request buffer
+static ret_t mmap_request_alloc_write_buffer(async_file_accessor_t       *thiz,
+                                             async_file_access_request_t *pAsyncRequest,
+                                             void                       **buffer)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+    mmap_request_t       *pRequest      = (mmap_request_t *)pAsyncRequest;
+
+    u32     retry_times = 0;
+    ret_t   res         = mmap_check_request_valid(pRequest);
+
+    if (pRequest->nbytes <= 0)
+    {
+        res = RET_BAD_VALUE;
+        pRequest->status = REQUEST_STAT_IOFAIL;
+        printf("Error: invalid malloc buffer size! res = %d.\n", res);
+    }
+
+    if (RET_OK == res)
+    {
+        /// mmap offset must be page aligned, map from the page holding offset
+        u64 delta = pRequest->offset % (u64)sysconf(_SC_PAGESIZE);
+
+        do {
+            (*buffer) = mmap(NULL, pRequest->nbytes + delta, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, pRequest->fd, pRequest->offset - delta);
+        }
+        while (MAP_FAILED == (*buffer) && retry_times++ < MAX_RETRY_TIMES);
+
+        if (MAP_FAILED != (*buffer))
+        {
+            io_vector_reset(&(pRequest->iov));
+            readahead_advise_mapping(*buffer, pRequest->nbytes + delta, pRequest->parent.info.hint);
+            pRequest->mapAddr   = *buffer;
+            pRequest->mapLen    = pRequest->nbytes + delta;
+            (*buffer)           = (char8 *)(*buffer) + delta;
+            pRequest->buf       = *buffer;
+            pRequest->isAlloced = TRUE;
+            // printf("file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
+        }
+        else
+        {
+            res = RET_BAD_VALUE;
+            pRequest->status = REQUEST_STAT_IOFAIL;
+            // printf("file = %s: fd = %d, req_addr = %p.\n", pRequest->parent.info.fn, pRequest->fd, pRequest);
+            printf("Error: file [%s] write buffer alloc fail! error: %d - %s.\n",
+                    pRequest->parent.info.fn, errno, strerror(errno));
+        }
+    }
+
+    return res;
+}
+
+/// Import mmap read only request buffer
+static ret_t mmap_request_import_read_buffer(async_file_accessor_t       *thiz,
+                                             async_file_access_request_t *pAsyncRequest,
+                                             void                        *buffer)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+    mmap_request_t       *pRequest      = (mmap_request_t *)pAsyncRequest;
+
+    u32     retry_times = 0;
+    ret_t   res         = mmap_check_request_valid(pRequest);
+
+    if (NULL == buffer)
+    {
+        res = RET_BAD_VALUE;
+        pRequest->status = REQUEST_STAT_IOFAIL;
+        printf("Error: invalid import buffer empty! res = %d.\n", res);
+    }
+
+    if (RET_OK == res)
+    {
+        io_vector_reset(&(pRequest->iov));
+        pRequest->buf = buffer;
+        // printf("file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
+    }
+
+    return res;
+}
+
+/// Import segments of a vectored mmap request, worker copies between them and the mapping
+static ret_t mmap_request_import_iovec(async_file_accessor_t       *thiz,
+                                       async_file_access_request_t *pAsyncRequest,
+                                       const struct iovec          *iov,
+                                       u32                          iovcnt)
+{
+    mmap_request_t *pRequest = (mmap_request_t *)pAsyncRequest;
+
+    ret_t res = mmap_check_request_valid(pRequest);
+
+    if (RET_OK == res && (TRUE == pRequest->isAlloced || pRequest->isLease))
+    {
+        res = RET_INVALID_OPERATION;
+        printf("Error: request [%s] already owns a mapping! res = %d.\n", pRequest->parent.info.fn, res);
+    }
+
+    if (RET_OK == res)
+    {
+        res = io_vector_import(&(pRequest->iov), iov, iovcnt, pRequest->nbytes);
+    }
+
+    if (RET_OK == res)
+    {
+        pRequest->buf = NULL;
+    }
+
+    return res;
+}
+
+/// Lease mmap read request, data stays in a read-only private mapping instead of a copy
+static ret_t mmap_request_lease_read_buffer(async_file_accessor_t       *thiz,
+                                            async_file_access_request_t *pAsyncRequest,
+                                            bool                         isPopulate)
+{
+    mmap_request_t *pRequest = (mmap_request_t *)pAsyncRequest;
+
+    ret_t res = mmap_check_request_valid(pRequest);
+
+    if (RET_OK == res && ASYNC_FILE_ACCESS_READ != pRequest->parent.info.direction)
+    {
+        res = RET_BAD_VALUE;
+        printf("Error: only read request can be leased! res = %d.\n", res);
+    }
+
+    if (RET_OK == res)
+    {
+        io_vector_reset(&(pRequest->iov));
+        pRequest->buf           = NULL;
+        pRequest->isLease       = TRUE;
+        pRequest->isPopulate    = isPopulate;
+    }
+
+    return res;
+}
+
+/// Get read-only data of a finished leased mmap request
+static ret_t mmap_get_read_lease(async_file_accessor_t       *thiz,
+                                 async_file_access_request_t *pAsyncRequest,
+                                 const void                 **buffer)
+{
+    mmap_request_t *pRequest = (mmap_request_t *)pAsyncRequest;
+
+    ret_t res = mmap_check_request_valid(pRequest);
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(pRequest->lock));
+        if (!pRequest->isLease || NULL == pRequest->mapAddr || REQUEST_STAT_IOSUCCESS != pRequest->status)
+        {
+            res = RET_INVALID_OPERATION;
+            printf("Error: request has no read lease! res = %d.\n", res);
+        }
+        else
+        {
+            *buffer = pRequest->buf;
+        }
+        pthread_mutex_unlock(&(pRequest->lock));
+    }
+
+    return res;
+}
+
+/// Unmap lease of an mmap request, data from getReadLease is invalid afterwards
+static ret_t mmap_release_read_lease(async_file_accessor_t       *thiz,
+                                     async_file_access_request_t *pAsyncRequest)
+{
+    mmap_request_t *pRequest = (mmap_request_t *)pAsyncRequest;
+
+    ret_t res = mmap_check_request_valid(pRequest);
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(pRequest->lock));
+        if (!pRequest->isLease || NULL == pRequest->mapAddr)
+        {
+            res = RET_INVALID_OPERATION;
+            printf("Error: request has no read lease! res = %d.\n", res);
+        }
+        else
+        {
+            munmap(pRequest->mapAddr, pRequest->mapLen);
+            pRequest->mapAddr = NULL;
+            pRequest->buf       = NULL;
+        }
+        pthread_mutex_unlock(&(pRequest->lock));
+    }
+
+    return res;
+}
+
+/// Return chunk slots of a striped request to pool, chunks must be finished
+static void mmap_unstripe_request(mmap_file_accessor_t *pMmapAccessor, mmap_request_t *pRequest)
+{
+    for (u32 i = 0; i < pRequest->stripe.count; i++)
+    {
+        if (NULL != pRequest->stripe.ppChunks[i])
+        {
+            request_pool_release(&(pMmapAccessor->requests), pRequest->stripe.ppChunks[i]);
+        }
+    }
+    stripe_group_reset(&(pRequest->stripe));
+}
+
+/// Split a request above stripe threshold into chunks, they share its fd and buffer and own nothing.
+/// Leased reads stay whole, their data must be one mapping, and so do vectored requests
+static ret_t mmap_stripe_request(mmap_file_accessor_t *pMmapAccessor, mmap_request_t *pRequest)
+{
+    u64     chunkSize   = 0;
+    u32     count       = (pRequest->isLease || pRequest->iov.count > 0)
+                          ? 1 : stripe_plan(&(pMmapAccessor->stripeConfig), pRequest->nbytes, &chunkSize);
+    ret_t   res         = RET_OK;
+
+    mmap_unstripe_request(pMmapAccessor, pRequest);
+    res = (count > 1) ? stripe_group_init(&(pRequest->stripe), count) : RET_OK;
+
+    for (u32 i = 0; RET_OK == res && i < pRequest->stripe.count; i++)
+    {
+        mmap_request_t *pChunk  = NULL;
+        u64             delta   = (u64)i * chunkSize;
+
+        res = request_pool_acquire(&(pMmapAccessor->requests), (async_file_access_request_t **)&pChunk);
+        if (RET_OK == res)
+        {
+            pChunk->parent.info             = pRequest->parent.info;
+            pChunk->parent.info.size        = (pRequest->nbytes - delta < chunkSize) ? pRequest->nbytes - delta
+                                                                                     : chunkSize;
+            pChunk->parent.info.offset      = pRequest->offset + delta;
+            pChunk->parent.info.deadline_ms = 0;
+            pChunk->pAccessor               = pMmapAccessor;
+            pChunk->fd                      = pRequest->fd;
+            pChunk->buf                     = (char8 *)pRequest->buf + delta;
+            pChunk->nbytes                  = pChunk->parent.info.size;
+            pChunk->offset                  = pChunk->parent.info.offset;
+            pChunk->mapAddr                 = NULL;
+            pChunk->mapLen                  = 0;
+            pChunk->isValid                 = TRUE;
+            pChunk->isAlloced               = FALSE;
+            pChunk->isLease                 = FALSE;
+            pChunk->isPopulate              = FALSE;
+            pChunk->isInflight              = FALSE;
+            pChunk->status                  = REQUEST_STAT_INIT;
+            memset(&(pChunk->stripe), 0, sizeof(stripe_group_t));
+            pChunk->stripe.pParent          = &(pRequest->parent);
+            pRequest->stripe.ppChunks[i]    = &(pChunk->parent);
+        }
+    }
+
+    if (RET_OK != res)
+    {
+        mmap_unstripe_request(pMmapAccessor, pRequest);
+    }
+
+    return res;
+}
+
+/// Return a merged read and its segments to pool, it borrowed fd and buffers of its members
+static void mmap_drop_merged_request(mmap_file_accessor_t *pMmapAccessor, mmap_request_t *pCarrier)
+{
+    io_vector_reset(&(pCarrier->iov));
+    io_merge_reset(&(pCarrier->merge));
+    pCarrier->fd = -1;
+    request_pool_release(&(pMmapAccessor->requests), &(pCarrier->parent));
+}
+
+/// Detach a released member from its merged read, the last one drops it
+static void mmap_unmerge_request(mmap_file_accessor_t *pMmapAccessor, mmap_request_t *pRequest)
+{
+    mmap_request_t *pCarrier = (mmap_request_t *)pRequest->merge.pCarrier;
+
+    pRequest->merge.pCarrier = NULL;
+    if (NULL != pCarrier && io_merge_member_done(&(pCarrier->merge)))
+    {
+        mmap_drop_merged_request(pMmapAccessor, pCarrier);
+    }
+}
+
+/// Carry a run of contiguous reads in one task over one mapping, members stay in flight until it is done
+static ret_t mmap_merge_requests(mmap_file_accessor_t   *pMmapAccessor,
+                                 const io_sched_entry_t *pRun,
+                                 u32                     count,
+                                 mmap_request_t        **ppCarrier)
+{
+    mmap_request_t *pFirst      = (mmap_request_t *)pRun[0].pRequest;
+    mmap_request_t *pCarrier    = NULL;
+
+    ret_t res = request_pool_acquire(&(pMmapAccessor->requests), (async_file_access_request_t **)&pCarrier);
+
+    if (RET_OK == res)
+    {
+        pCarrier->parent.info               = pFirst->parent.info;
+        pCarrier->parent.info.deadline_ms   = 0;
+        pCarrier->pAccessor                 = pMmapAccessor;
+        pCarrier->fd                        = pFirst->fd;
+        pCarrier->buf                       = NULL;
+        pCarrier->nbytes                    = pRun[count - 1].offset + pRun[count - 1].size - pFirst->offset;
+        pCarrier->offset                    = pFirst->offset;
+        pCarrier->parent.info.size          = pCarrier->nbytes;
+        pCarrier->mapAddr                   = NULL;
+        pCarrier->mapLen                    = 0;
+        pCarrier->isValid                   = TRUE;
+        pCarrier->isAlloced                 = FALSE;
+        pCarrier->isLease                   = FALSE;
+        pCarrier->isPopulate                = FALSE;
+        pCarrier->isInflight                = FALSE;
+        pCarrier->status                    = REQUEST_STAT_INIT;
+        memset(&(pCarrier->stripe), 0, sizeof(stripe_group_t));
+
+        res = io_sched_merge(pRun, count, &(pCarrier->merge), &(pCarrier->iov));
+        if (RET_OK != res)
+        {
+            mmap_drop_merged_request(pMmapAccessor, pCarrier);
+        }
+    }
+
+    if (RET_OK == res)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            mmap_request_t *pMember = (mmap_request_t *)pRun[i].pRequest;
+
+            pMember->merge.pCarrier = &(pCarrier->parent);
+            pMember->status         = REQUEST_STAT_SUBMITTED;
+            pMember->isInflight     = TRUE;
+        }
+        *ppCarrier = pCarrier;
+    }
+
+    return res;
+}
+
+/// Order entries by file and offset and replace contiguous reads with merged ones.
+/// Caller's request table is never reordered, a new entry table is made instead
+static void mmap_schedule_requests(mmap_file_accessor_t   *pMmapAccessor,
+                                   mmap_request_t        **ppRequests,
+                                   mmap_request_t       ***pppEntries,
+                                   u32                    *pEntryCount)
+{
+    u32                 count       = *pEntryCount;
+    mmap_request_t    **ppEntries   = *pppEntries;
+    mmap_request_t    **ppOrdered   = (ppEntries == ppRequests)
+                                      ? (mmap_request_t **)malloc(sizeof(mmap_request_t *) * count) : ppEntries;
+    io_sched_entry_t   *pSched      = (io_sched_entry_t *)malloc(sizeof(io_sched_entry_t) * count);
+    u32                 n           = 0;
+
+    /// Ordering is only an optimization, batch goes out as is without memory for it
+    if (NULL == ppOrdered || NULL == pSched)
+    {
+        if (ppOrdered != ppEntries)
+        {
+            free(ppOrdered);
+        }
+        free(pSched);
+        return;
+    }
+
+    for (u32 i = 0; i < count; i++)
+    {
+        mmap_request_t *pRequest = ppEntries[i];
+
+        /// Writes already sit in their own shared mapping, only reads gain from one mapping over many
+        pSched[i].pRequest      = pRequest;
+        pSched[i].buf           = pRequest->buf;
+        pSched[i].dev           = (u64)pRequest->fsb.st_dev;
+        pSched[i].ino           = (u64)pRequest->fsb.st_ino;
+        pSched[i].offset        = pRequest->offset;
+        pSched[i].size          = pRequest->nbytes;
+        pSched[i].direction     = pRequest->parent.info.direction;
+        pSched[i].index         = i;
+        pSched[i].rank          = prio_class_rank(pRequest->parent.info.priority);
+        pSched[i].isMergeable   = (ASYNC_FILE_ACCESS_READ == pRequest->parent.info.direction && !pRequest->isLease &&
+                                   NULL != pRequest->buf && 0 == pRequest->iov.count &&
+                                   0 == pRequest->stripe.count && NULL == pRequest->stripe.pParent);
+    }
+
+    io_sched_sort(pSched, count);
+
+    for (u32 i = 0, run = 1; i < count; i += run)
+    {
+        mmap_request_t *pCarrier = NULL;
+
+        run = io_sched_run(&(pMmapAccessor->schedConfig), &(pSched[i]), count - i);
+        if (run > 1 && RET_OK == mmap_merge_requests(pMmapAccessor, &(pSched[i]), run, &pCarrier))
+        {
+            ppOrdered[n++] = pCarrier;
+            continue;
+        }
+
+        for (u32 j = 0; j < run; j++)
+        {
+            ppOrdered[n++] = (mmap_request_t *)pSched[i + j].pRequest;
+        }
+    }
+
+    free(pSched);
+    *pppEntries     = ppOrdered;
+    *pEntryCount    = n;
+}
+
+/// Stripe requests above threshold, their chunks become tasks in place of them, then order and merge.
+/// *pppEntries is ppRequests itself when nothing changed, else a table the caller frees
+static ret_t mmap_expand_requests(mmap_file_accessor_t   *pMmapAccessor,
+                                  mmap_request_t        **ppRequests,
+                                  u32                     count,
+                                  mmap_request_t       ***pppEntries,
+                                  u32                    *pEntryCount)
+{
+    ret_t               res         = RET_OK;
+    u32                 entryCount  = 0;
+    mmap_request_t    **ppEntries   = NULL;
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        /// Request put again lets go of the merged read that carried its previous run
+        mmap_unmerge_request(pMmapAccessor, ppRequests[i]);
+        res = mmap_stripe_request(pMmapAccessor, ppRequests[i]);
+        entryCount += (ppRequests[i]->stripe.count > 0) ? ppRequests[i]->stripe.count : 1;
+    }
+
+    *pppEntries     = ppRequests;
+    *pEntryCount    = count;
+
+    if (RET_OK == res && entryCount != count)
+    {
+        ppEntries   = (mmap_request_t **)malloc(sizeof(mmap_request_t *) * entryCount);
+        res         = (NULL == ppEntries) ? RET_NO_MEMORY : RET_OK;
+    }
+
+    if (NULL != ppEntries)
+    {
+        for (u32 i = 0, n = 0; i < count; i++)
+        {
+            mmap_request_t *pRequest = ppRequests[i];
+
+            if (0 == pRequest->stripe.count)
+            {
+                ppEntries[n++] = pRequest;
+                continue;
+            }
+
+            /// Striped request stays in flight until its last chunk finishes it
+            pRequest->status        = REQUEST_STAT_SUBMITTED;
+            pRequest->isInflight    = TRUE;
+            for (u32 j = 0; j < pRequest->stripe.count; j++)
+            {
+                ppEntries[n++] = (mmap_request_t *)pRequest->stripe.ppChunks[j];
+            }
+        }
+
+        *pppEntries     = ppEntries;
+        *pEntryCount    = entryCount;
+    }
+
+    if (RET_OK == res && *pEntryCount > 1)
+    {
+        mmap_schedule_requests(pMmapAccessor, ppRequests, pppEntries, pEntryCount);
+    }
+
+    return res;
+}
+
+/// Serve a read from block cache, or drop blocks a write overlaps. TRUE if read was served,
+/// it then completes in caller's thread without a task
+static bool mmap_cache_request(mmap_file_accessor_t *pMmapAccessor, mmap_request_t *pRequest, bool canServe)
+{
+    block_cache_t  *pCache  = &(pMmapAccessor->cache);
+    bool            isHit   = FALSE;
+
+    pRequest->cacheEpoch = BLOCK_CACHE_NO_FILL;
+    if (ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction)
+    {
+        block_cache_invalidate(pCache, &(pRequest->fsb), pRequest->offset, pRequest->nbytes);
+    }
+    else if (NULL != pRequest->buf && !pRequest->isLease)
+    {
+        /// Vectored and leased reads go to backend and are not cached
+        pRequest->cacheEpoch    = block_cache_epoch(pCache, &(pRequest->fsb));
+        isHit                   = canServe && block_cache_read(pCache, &(pRequest->fsb), pRequest->offset,
+                                                               pRequest->nbytes, pRequest->buf);
+    }
+
+    if (isHit)
+    {
+        pRequest->cacheEpoch    = BLOCK_CACHE_NO_FILL;
+        pRequest->status        = REQUEST_STAT_SUBMITTED;
+        pRequest->isInflight    = TRUE;
+        mmap_request_close_fd(pRequest);
+        mmap_request_finish(pRequest, TRUE);
+    }
+
+    return isHit;
+}
+
+/// Pass a batch through block cache, requests it served are left out.
+/// *pppMisses is ppRequests itself when none was served, else a table the caller frees
+static void mmap_cache_requests(mmap_file_accessor_t   *pMmapAccessor,
+                                mmap_request_t        **ppRequests,
+                                u32                     count,
+                                mmap_request_t       ***pppMisses,
+                                u32                    *pMissCount)
+{
+    mmap_request_t    **ppMisses    = ppRequests;
+    u32                 missCount   = 0;
+
+    if (!block_cache_is_enabled(&(pMmapAccessor->cache)))
+    {
+        *pppMisses  = ppRequests;
+        *pMissCount = count;
+        return;
+    }
+
+    /// Caller's table is never reordered, without room for another one the batch only invalidates
+    if (count > 1)
+    {
+        ppMisses = (mmap_request_t **)malloc(sizeof(mmap_request_t *) * count);
+    }
+
+    for (u32 i = 0; i < count; i++)
+    {
+        if (!mmap_cache_request(pMmapAccessor, ppRequests[i], NULL != ppMisses) && NULL != ppMisses)
+        {
+            ppMisses[missCount++] = ppRequests[i];
+        }
+    }
+
+    if (NULL == ppMisses)
+    {
+        ppMisses    = ppRequests;
+        missCount   = count;
+    }
+    else if (ppMisses != ppRequests && (0 == missCount || missCount == count))
+    {
+        free(ppMisses);
+        ppMisses    = ppRequests;
+    }
+
+    *pppMisses  = ppMisses;
+    *pMissCount = missCount;
+}
+
+/// Feed reads to sequential stream detection, other hints map to madvise on the task's mapping
+static void mmap_hint_request(mmap_file_accessor_t *pMmapAccessor, mmap_request_t *pRequest)
+{
+    if (ASYNC_FILE_ACCESS_READ == pRequest->parent.info.direction)
+    {
+        readahead_observe(&(pMmapAccessor->readahead), pRequest->fd, &(pRequest->fsb),
+                          pRequest->offset, pRequest->nbytes, pRequest->parent.info.hint);
+    }
+}
+
+/// Hold in-flight room for a batch, it waits or is refused as a whole
+static ret_t mmap_admit_requests(mmap_file_accessor_t *pMmapAccessor, mmap_request_t **ppRequests, u32 count)
+{
+    u64     bytes   = 0;
+    ret_t   res     = RET_OK;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        bytes += ppRequests[i]->parent.info.size;
+    }
+
+    res = admission_acquire(&(pMmapAccessor->admission), count, bytes);
+    for (u64 i = 0, now = prio_class_now_ns(); RET_OK == res && i < count; i++)
+    {
+        ppRequests[i]->isAdmitted   = TRUE;
+        ppRequests[i]->admitNs      = now;
+        IO_TRACE(IO_TRACE_ADMIT, pMmapAccessor->parent.type, ppRequests[i]->parent.handle);
+    }
+
+    return res;
+}
+
+/// Give back room of requests that never went out, they will not finish to return it
+static void mmap_unadmit_requests(mmap_file_accessor_t *pMmapAccessor, mmap_request_t **ppRequests, u32 count)
+{
+    u32 admitted    = 0;
+    u64 bytes       = 0;
 
-    if (RET_OK == res)
+    for (u32 i = 0; i < count; i++)
     {
-        do {
-            (*buffer) = mmap(NULL, pRequest->nbytes, PROT_READ | PROT_WRITE,
-                                MAP_SHARED, pRequest->fd, pRequest->offset);
-        }
-        while (MAP_FAILED == (*buffer) && retry_times++ < MAX_RETRY_TIMES);
-
-        if (MAP_FAILED != (*buffer))
-        {
-            pRequest->buf       = *buffer;
-            pRequest->isAlloced = TRUE;
-            // printf("file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
-        }
-        else
+        if (ppRequests[i]->isAdmitted)
         {
-            res = RET_BAD_VALUE;
-            pRequest->status = REQUEST_STAT_IOFAIL;
-            // printf("file = %s: fd = %d, req_addr = %p.\n", pRequest->parent.info.fn, pRequest->fd, pRequest);
-            printf("Error: file [%s] write buffer alloc fail! error: %d - %s.\n",
-                    pRequest->parent.info.fn, errno, strerror(errno));
+            ppRequests[i]->isAdmitted   = FALSE;
+            bytes                      += ppRequests[i]->parent.info.size;
+            admitted++;
         }
     }
 
-    return res;
+    if (admitted > 0)
+    {
+        admission_release(&(pMmapAccessor->admission), admitted, bytes, 0);
+    }
 }
 
-/// Import mmap read only request buffer
-static ret_t mmap_request_import_read_buffer(async_file_accessor_t       *thiz,
-                                             async_file_access_request_t *pAsyncRequest,
-                                             void                        *buffer)
+/// Put a batch of mmap requests, pushed into the lock-free task ring with one wakeup for the batch
+static ret_t mmap_put_requests(async_file_accessor_t        *thiz,
+                               async_file_access_request_t **pAsyncRequests,
+                               u32                           count)
 {
-    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
-    mmap_request_t       *pRequest      = (mmap_request_t *)pAsyncRequest;
+    mmap_file_accessor_t   *pMmapAccessor   = (mmap_file_accessor_t *)thiz;
+    mmap_request_t        **ppBatch         = (mmap_request_t **)pAsyncRequests;
+    mmap_request_t        **ppRequests      = ppBatch;
+    mmap_request_t        **ppEntries       = ppBatch;
+    u32                     entryCount      = count;
+    task_t                  localTasks[MMAP_PUT_LOCAL_TASKS];
+    task_t                 *pRequestTasks   = localTasks;
 
-    u32     retry_times = 0;
-    ret_t   res         = mmap_check_request_valid(pRequest);
+    ret_t res = (NULL == ppBatch || 0 == count) ? RET_BAD_VALUE : RET_OK;
 
-    if (NULL == buffer)
+    for (u32 i = 0; RET_OK == res && i < count; i++)
     {
-        res = RET_BAD_VALUE;
-        pRequest->status = REQUEST_STAT_IOFAIL;
-        printf("Error: invalid import buffer empty! res = %d.\n", res);
+        res = mmap_check_request_valid(ppBatch[i]);
+    }
+
+    /// Latency of a class counts from here, cache hits included
+    for (u64 i = 0, now = prio_class_now_ns(); RET_OK == res && i < count; i++)
+    {
+        ppBatch[i]->putNs   = now;
+        ppBatch[i]->startNs = 0;
+        ppBatch[i]->doneNs  = 0;
+        IO_TRACE(IO_TRACE_PUT, thiz->type, ppBatch[i]->parent.handle);
     }
 
+    /// Backpressure, hits hold room too as they finish through the same path
     if (RET_OK == res)
     {
-        pRequest->buf = buffer;
-        // printf("file = %s: req_addr = %p, buf_addr = %p.\n", pRequest->parent.info.fn, pRequest, pRequest->buf);
+        res = mmap_admit_requests(pMmapAccessor, ppBatch, count);
     }
 
-    return res;
-}
+    /// Cache hits are done already, only misses go on
+    if (RET_OK == res)
+    {
+        mmap_cache_requests(pMmapAccessor, ppBatch, count, &ppRequests, &count);
+        ppEntries   = ppRequests;
+        entryCount  = count;
+    }
 
-/// Put mmap request
-static ret_t mmap_put_request(async_file_accessor_t       *thiz,
-                              async_file_access_request_t *pAsyncRequest)
-{
-    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
-    mmap_request_t       *pRequest      = (mmap_request_t *)pAsyncRequest;
+    if (0 == count)
+    {
+        return res;
+    }
 
-    ret_t res = mmap_check_request_valid(pRequest);
+    /// Before submission, a finished request may have closed its fd
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        mmap_hint_request(pMmapAccessor, ppRequests[i]);
+    }
+
+    if (RET_OK == res)
+    {
+        res = mmap_expand_requests(pMmapAccessor, ppRequests, count, &ppEntries, &entryCount);
+        if (RET_OK != res)
+        {
+            mmap_unadmit_requests(pMmapAccessor, ppRequests, count);
+        }
+    }
+
+    /// Small batches, single puts included, stage tasks on stack
+    if (RET_OK == res && entryCount > MMAP_PUT_LOCAL_TASKS)
+    {
+        pRequestTasks = (task_t *)malloc(sizeof(task_t) * entryCount);
+        res = (NULL == pRequestTasks) ? RET_NO_MEMORY : RET_OK;
+        if (RET_OK != res)
+        {
+            mmap_unadmit_requests(pMmapAccessor, ppRequests, count);
+        }
+    }
 
     if (RET_OK == res)
     {
-        task_t *pRequestTask        = (task_t *)malloc(sizeof(task_t));
-        pRequestTask->is_sentinel   = false;
-        pRequestTask->argument      = pRequest;
-        pRequestTask->function      = ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction
-                                      ? mmapWrite : mmapRead;
+        for (u32 i = 0; i < entryCount; i++)
+        {
+            pRequestTasks[i].is_sentinel    = false;
+            pRequestTasks[i].priority       = ppEntries[i]->parent.info.priority;
+            pRequestTasks[i].argument       = ppEntries[i];
+            pRequestTasks[i].function       = ASYNC_FILE_ACCESS_WRITE == ppEntries[i]->parent.info.direction
+                                              ? mmapWrite : mmapRead;
+
+            /// Mark submitted first so a fast worker cannot be overwritten
+            ppEntries[i]->status            = REQUEST_STAT_SUBMITTED;
+            ppEntries[i]->isInflight        = TRUE;
+        }
+
+        /// Armed while the requests are still ours, a worker may finish them and another thread
+        /// release and reuse their slots as soon as they are pushed
+        for (u32 i = 0; i < count; i++)
+        {
+            if (ppRequests[i]->parent.info.deadline_ms > 0)
+            {
+                timer_service_arm(&(pMmapAccessor->timers), &(ppRequests[i]->deadline),
+                                  ppRequests[i]->parent.info.deadline_ms, mmap_request_expire, ppRequests[i]);
+            }
+        }
 
-        res = thread_pool_submit(&(pMmapAccessor->distributor), pRequestTask);
+        /// Traced before the push, a fast worker would start them first otherwise
+        for (u32 i = 0; i < count; i++)
+        {
+            IO_TRACE(IO_TRACE_DISPATCH, thiz->type, ppRequests[i]->parent.handle);
+        }
+
+        res = thread_pool_submit_batch(&(pMmapAccessor->distributor), pRequestTasks, entryCount);
         if (res != RET_OK)
         {
-            if (TRUE == pRequest->isAlloced)
+            for (u32 i = 0; i < entryCount; i++)
             {
-                munmap(pRequest->buf, pRequest->nbytes);
+                ppEntries[i]->status        = REQUEST_STAT_CANCEL;
+                ppEntries[i]->isInflight    = FALSE;
             }
-            pRequest->status = REQUEST_STAT_CANCEL;
+
+            /// No task was queued, striped requests never hear from their chunks
+            for (u32 i = 0; i < count; i++)
+            {
+                if (TRUE == ppRequests[i]->isAlloced)
+                {
+                    munmap(ppRequests[i]->mapAddr, ppRequests[i]->mapLen);
+                    ppRequests[i]->mapAddr  = NULL;
+                    ppRequests[i]->buf      = NULL;
+                }
+                ppRequests[i]->status       = REQUEST_STAT_CANCEL;
+                ppRequests[i]->isInflight   = FALSE;
+                timer_service_cancel(&(pMmapAccessor->timers), &(ppRequests[i]->deadline));
+            }
+            mmap_unadmit_requests(pMmapAccessor, ppRequests, count);
             printf("Error: request submit fail! Canceled. error: %d.\n", res);
         }
-        else
+
+        /// Ring holds task copies
+        if (pRequestTasks != localTasks)
         {
-            pRequest->status = REQUEST_STAT_SUBMITTED;
+            free(pRequestTasks);
         }
     }
 
+    if (ppEntries != ppRequests)
+    {
+        free(ppEntries);
+    }
+
+    if (ppRequests != ppBatch)
+    {
+        free(ppRequests);
+    }
+
     return res;
 }
 
+/// Put mmap request
+static ret_t mmap_put_request(async_file_accessor_t       *thiz,
+                              async_file_access_request_t *pAsyncRequest)
+{
+    return mmap_put_requests(thiz, &pAsyncRequest, 1);
+}
+
 /// Wait for an mmap request process finish
 static ret_t mmap_wait_request(async_file_accessor_t       *thiz,
                                async_file_access_request_t *pAsyncRequest,
@@ -474,35 +1830,37 @@ static ret_t mmap_wait_request(async_file_accessor_t       *thiz,
     }
     else if (REQUEST_STAT_SUBMITTED == pRequest->status)
     {
+        /// Timeout shares the deadline timer, whichever expires first cancels the request
         if (timeout_ms > 0)
         {
-            pthread_t timeoutThread;
-            timeout_args_t t_args =
-            {
-                .timeout_ms = timeout_ms,
-                .status     = &(pRequest->status),
-                .lock       = &(pRequest->lock),
-                .cond       = &(pRequest->isFinished),
-            };
-            pthread_create(&timeoutThread, NULL, timeout_thread, (void*)&t_args);
-            pthread_mutex_lock(&(pRequest->lock));
-            while (REQUEST_STAT_SUBMITTED == pRequest->status)
-            {
-                pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
-            }
-            pthread_mutex_unlock(&(pRequest->lock));
-            pthread_cancel(timeoutThread);
-            pthread_join(timeoutThread, NULL);
+            timer_service_arm(&(pMmapAccessor->timers), &(pRequest->deadline),
+                              timeout_ms, mmap_request_expire, pRequest);
         }
-        else
+
+        pthread_mutex_lock(&(pRequest->lock));
+        while (REQUEST_STAT_SUBMITTED == pRequest->status)
         {
-            while (REQUEST_STAT_SUBMITTED == pRequest->status)
-            {
-                pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
-            }
+            pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
+        }
+        pthread_mutex_unlock(&(pRequest->lock));
+
+        /// Timer already fired if it is no longer armed
+        if (timeout_ms > 0 &&
+            timer_service_cancel(&(pMmapAccessor->timers), &(pRequest->deadline)) != RET_OK &&
+            REQUEST_STAT_CANCEL == pRequest->status)
+        {
+            res = RET_TIMED_OUT;
         }
     }
 
+    if (RET_INVALID_OPERATION != res)
+    {
+        io_stats_wakeup(&(pMmapAccessor->ioStats), pRequest->parent.info.direction, &(pRequest->doneNs));
+        IO_TRACE(IO_TRACE_WAKEUP, thiz->type, pRequest->parent.handle);
+        /// Waited requests are not reaped too, else callers that never reap pile them up
+        completion_queue_remove(&(pMmapAccessor->completions), &(pRequest->parent));
+    }
+
     return res;
 }
 
@@ -546,32 +1904,28 @@ static ret_t mmap_cancel_request(async_file_accessor_t       *thiz,
 /// Wait for all mmap request finish, after this func release all requests
 static ret_t mmap_wait_all_requests(async_file_accessor_t *thiz)
 {
-    mmap_file_accessor_t   *pMmapAccessor   = (mmap_file_accessor_t *)thiz;
-    task_t                **ppRequestQueue  = pMmapAccessor->distributor.task_queue.request_queue;
-    u32                     totoalCnt       = pMmapAccessor->distributor.task_queue.totoalCnt;
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
 
     ret_t res = RET_OK;
 
-    if (NULL == pMmapAccessor || NULL == ppRequestQueue || 0 == totoalCnt)
+    if (NULL == pMmapAccessor || 0 == request_pool_count(&(pMmapAccessor->requests)))
     {
         printf("Empty mmap accessor, no need to wait.\n");
     }
     else
     {
-        for (int i = 0; i < totoalCnt; i++)
+        for (u32 i = 0; i < request_pool_count(&(pMmapAccessor->requests)); i++)
         {
-            // long long start_time = get_time_in_microseconds();
-            mmap_request_t *pRequest = (mmap_request_t *)(ppRequestQueue[i]->argument);
-
-            pthread_mutex_lock(&(pRequest->lock));
-            while (REQUEST_STAT_SUBMITTED == pRequest->status)
+            mmap_request_t *pRequest = (mmap_request_t *)request_pool_get(&(pMmapAccessor->requests), i);
+            if (pRequest)
             {
-                pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
+                pthread_mutex_lock(&(pRequest->lock));
+                while (REQUEST_STAT_SUBMITTED == pRequest->status)
+                {
+                    pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
+                }
+                pthread_mutex_unlock(&(pRequest->lock));
             }
-            pthread_mutex_unlock(&(pRequest->lock));
-            // long long end_time     = get_time_in_microseconds();
-            // double elapsed_time    = (double)(end_time - start_time) / 1000;
-            // printf("\n -- wait [%s] time consumption: %f ms.\n\n", pRequest->parent.info.fn, elapsed_time);
         }
     }
 
@@ -581,72 +1935,290 @@ static ret_t mmap_wait_all_requests(async_file_accessor_t *thiz)
 /// Cancel all mmap request, after this func release all requests
 static ret_t mmap_cancel_all_requests(async_file_accessor_t *thiz)
 {
-    mmap_file_accessor_t   *pMmapAccessor   = (mmap_file_accessor_t *)thiz;
-    task_t                **ppRequestQueue  = pMmapAccessor->distributor.task_queue.request_queue;
-    u32                     totoalCnt       = pMmapAccessor->distributor.task_queue.totoalCnt;
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
 
     ret_t res = RET_OK;
 
-    if (NULL == pMmapAccessor || NULL == ppRequestQueue || 0 == totoalCnt)
+    if (NULL == pMmapAccessor || 0 == request_pool_count(&(pMmapAccessor->requests)))
     {
         printf("Empty mmap accessor, no need to cancel.\n");
     }
     else
     {
-        for (int i = 0; i < totoalCnt; i++)
+        for (u32 i = 0; i < request_pool_count(&(pMmapAccessor->requests)); i++)
         {
-            mmap_request_t *pRequest = (mmap_request_t *)(ppRequestQueue[i]->argument);
-
-            pthread_mutex_lock(&(pRequest->lock));
-            pRequest->status = (REQUEST_STAT_SUBMITTED == pRequest->status) ? REQUEST_STAT_CANCEL : pRequest->status;
-            pthread_cond_signal(&(pRequest->isFinished));
-            pthread_mutex_unlock(&(pRequest->lock));
+            mmap_request_t *pRequest = (mmap_request_t *)request_pool_get(&(pMmapAccessor->requests), i);
+            if (pRequest)
+            {
+                pthread_mutex_lock(&(pRequest->lock));
+                pRequest->status = (REQUEST_STAT_SUBMITTED == pRequest->status) ? REQUEST_STAT_CANCEL : pRequest->status;
+                pthread_cond_signal(&(pRequest->isFinished));
+                pthread_mutex_unlock(&(pRequest->lock));
+            }
         }
     }
 
     return res;
 }
 
+/// Unmap lease or write mapping, close fd, free segments and return slot and chunks to pool, no worker may own request.
+/// Last member released also returns its merged read
+static void mmap_recycle_request(mmap_file_accessor_t *pMmapAccessor, mmap_request_t *pRequest)
+{
+    pthread_mutex_lock(&(pRequest->lock));
+    if (pRequest->mapAddr != NULL)
+    {
+        munmap(pRequest->mapAddr, pRequest->mapLen);
+        pRequest->mapAddr = NULL;
+    }
+    pRequest->buf = NULL;
+    mmap_request_close_fd(pRequest);
+    io_vector_reset(&(pRequest->iov));
+    pthread_mutex_unlock(&(pRequest->lock));
+
+    mmap_unmerge_request(pMmapAccessor, pRequest);
+    mmap_unstripe_request(pMmapAccessor, pRequest);
+    request_pool_release(&(pMmapAccessor->requests), &(pRequest->parent));
+}
+
+/// Release a finished or never put mmap request back to pool
+static ret_t mmap_release_request(async_file_accessor_t       *thiz,
+                                  async_file_access_request_t *pAsyncRequest)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+    mmap_request_t       *pRequest      = (mmap_request_t *)pAsyncRequest;
+
+    ret_t res = (NULL == pRequest) ? RET_BAD_VALUE : RET_OK;
+
+    if (RET_OK == res && REQUEST_HANDLE_NONE == __atomic_load_n(&(pRequest->parent.handle), __ATOMIC_ACQUIRE))
+    {
+        res = RET_DEAD_OBJECT;
+        printf("Error: request already released! res = %d.\n", res);
+    }
+
+    /// Canceled requests may still sit in a queue, worker touches them once more
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(pRequest->lock));
+        res = pRequest->isInflight ? RET_BUSY : RET_OK;
+        pthread_mutex_unlock(&(pRequest->lock));
+    }
+
+    if (RET_OK == res)
+    {
+        timer_service_cancel(&(pMmapAccessor->timers), &(pRequest->deadline));
+        mmap_recycle_request(pMmapAccessor, pRequest);
+    }
+    else if (RET_BUSY == res)
+    {
+        printf("Error: cannot release a request still in flight! res = %d.\n", res);
+    }
+
+    return res;
+}
+
+/// Register a file once for many mmap requests
+static ret_t mmap_open_file(async_file_accessor_t        *thiz,
+                            const char8                  *fn,
+                            async_file_access_direction_t direction,
+                            u32                          *pFileHandle)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    return file_registry_open(&(pMmapAccessor->files), fn, direction, pFileHandle);
+}
+
+/// Unregister an mmap file
+static ret_t mmap_close_file(async_file_accessor_t *thiz, u32 fileHandle)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    return file_registry_close(&(pMmapAccessor->files), fileHandle);
+}
+
+/// Resolve mmap request handle
+static ret_t mmap_lookup_request(async_file_accessor_t        *thiz,
+                                 u32                           handle,
+                                 async_file_access_request_t **pAsyncRequest)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    return request_pool_lookup(&(pMmapAccessor->requests), handle, pAsyncRequest);
+}
+
 // Cancel all MMAP operations and release resources
 static ret_t mmap_release_all_resources(async_file_accessor_t *thiz)
 {
-    mmap_file_accessor_t   *pMmapAccessor   = (mmap_file_accessor_t *)thiz;
-    task_t                **ppRequestQueue  = pMmapAccessor->distributor.task_queue.request_queue;
-    u32                     totoalCnt       = pMmapAccessor->distributor.task_queue.totoalCnt;
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
 
     ret_t res = RET_OK;
 
-    if (NULL == pMmapAccessor || NULL == ppRequestQueue || 0 == totoalCnt)
+    /// Workers drain queued tasks before exiting, next Get_Instance recreates the pool
+    if (NULL != pMmapAccessor && pMmapAccessor->distributor.info.isInitialized)
+    {
+        thread_pool_deinit(&(pMmapAccessor->distributor));
+    }
+
+    if (NULL == pMmapAccessor || 0 == request_pool_count(&(pMmapAccessor->requests)))
     {
         printf("Empty mmap accessor, no need to release.\n");
     }
     else
     {
-        pMmapAccessor->distributor.info.isRunning = FALSE;
-        for (int i = 0; i < THREAD_POOL_SIZE; i++)
+        /// Workers are gone, every request left queued was skipped or done
+        for (u32 i = 0; i < request_pool_count(&(pMmapAccessor->requests)); i++)
         {
-            task_t *pSentinelTask       = (task_t *)malloc(sizeof(task_t));
-            pSentinelTask->is_sentinel  = true;
-            pSentinelTask->argument     = NULL;
-            pSentinelTask->function     = NULL;
-            res = thread_pool_submit(&(pMmapAccessor->distributor), pSentinelTask);
-        }
+            mmap_request_t *pRequest = (mmap_request_t *)request_pool_get(&(pMmapAccessor->requests), i);
 
-        for (int i = 0; i < THREAD_POOL_SIZE; i++)
-        {
-            pthread_join(pMmapAccessor->distributor.thread_pool[i], NULL);
-            pMmapAccessor->distributor.info.idleThreadNum--;
-            pMmapAccessor->distributor.info.aliveThreadNum--;
-            // printf("-- Thread Pool State: aliveThreadNum[%d], busyThreadNum[%d], idleThreadNum[%d].\n",
-            //        pMmapAccessor->distributor.info.aliveThreadNum,
-            //        pMmapAccessor->distributor.info.busyThreadNum,
-            //        pMmapAccessor->distributor.info.idleThreadNum);
+            /// Chunks go back to pool with their striped request, merged reads with their last member
+            if (pRequest && NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
+            {
+                timer_service_cancel(&(pMmapAccessor->timers), &(pRequest->deadline));
+                mmap_recycle_request(pMmapAccessor, pRequest);
+            }
         }
+        completion_queue_reset(&(pMmapAccessor->completions));
+    }
+
+    return res;
+}
+
+/// Reap finished mmap requests in one batch
+static ret_t mmap_reap_completions(async_file_accessor_t        *thiz,
+                                   async_file_access_request_t **pAsyncRequests,
+                                   u32                           max,
+                                   s32                           timeout_ms)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    ret_t res = completion_queue_reap(&(pMmapAccessor->completions), pAsyncRequests, max, timeout_ms);
+
+    for (s32 i = 0; i < res; i++)
+    {
+        mmap_request_t *pRequest = (mmap_request_t *)pAsyncRequests[i];
+        io_stats_wakeup(&(pMmapAccessor->ioStats), pRequest->parent.info.direction, &(pRequest->doneNs));
+        IO_TRACE(IO_TRACE_WAKEUP, thiz->type, pRequest->parent.handle);
     }
 
     return res;
 }
 
+/// Get eventfd readable while mmap completions are pending
+static s32 mmap_get_event_fd(async_file_accessor_t *thiz)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    return pMmapAccessor->completions.eventFd;
+}
+
+/// Snapshot of mmap block cache counters
+static ret_t mmap_get_cache_stats(async_file_accessor_t *thiz, async_file_cache_stats_t *pStats)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    block_cache_get_stats(&(pMmapAccessor->cache), pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of mmap latency counters of a priority class
+static ret_t mmap_get_prio_stats(async_file_accessor_t   *thiz,
+                                 async_file_priority_t    priority,
+                                 async_file_prio_stats_t *pStats)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    if (NULL == pStats || priority < 0 || priority >= ASYNC_FILE_PRIO_MAX)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    prio_stats_get(&(pMmapAccessor->prioStats), priority, pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of mmap adaptive depth controller
+static ret_t mmap_get_depth_stats(async_file_accessor_t    *thiz,
+                                  async_file_depth_stats_t *pStats)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    admission_get_depth_stats(&(pMmapAccessor->admission), pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of mmap op, byte and latency counters
+static ret_t mmap_get_stats(async_file_accessor_t *thiz, async_file_stats_t *pStats)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    io_stats_get(&(pMmapAccessor->ioStats), pStats);
+
+    return RET_OK;
+}
+
+/// Start mmap op, byte and latency counters over
+static ret_t mmap_reset_stats(async_file_accessor_t *thiz)
+{
+    mmap_file_accessor_t *pMmapAccessor = (mmap_file_accessor_t *)thiz;
+
+    io_stats_reset(&(pMmapAccessor->ioStats));
+
+    return RET_OK;
+}
+
+/// Publish mmap counters and thread pool load, runs on live stats publisher thread
+static void mmap_live_stats_fill(void *arg, live_stats_slot_t *pSlot)
+{
+    mmap_file_accessor_t   *pMmapAccessor   = (mmap_file_accessor_t *)arg;
+    thread_pool_t          *thread_pool     = &(pMmapAccessor->distributor);
+
+    live_stats_fill_common(pSlot, &(pMmapAccessor->ioStats), &(pMmapAccessor->admission),
+                           &(pMmapAccessor->completions));
+
+    for (u32 i = 0; i < PRIO_CLASS_RANKS; i++)
+    {
+        task_ring_t    *task_ring   = &(thread_pool->task_queue.rings[i]);
+        u64             dequeuePos  = __atomic_load_n(&(task_ring->dequeuePos), __ATOMIC_RELAXED);
+        u64             enqueuePos  = __atomic_load_n(&(task_ring->enqueuePos), __ATOMIC_RELAXED);
+
+        pSlot->queuedTasks += (enqueuePos > dequeuePos) ? (u32)(enqueuePos - dequeuePos) : 0;
+    }
+
+    /// Worker slots and deques are only read under the info lock, a stopping pool takes them away under it
+    thread_pool_update_info(thread_pool);
+    pthread_mutex_lock(&(thread_pool->info.lock));
+    for (u32 i = 0; NULL != thread_pool->deques && i < thread_pool->info.maxThreadNum; i++)
+    {
+        s64 queued = __atomic_load_n(&(thread_pool->deques[i].bottom), __ATOMIC_RELAXED) -
+                     __atomic_load_n(&(thread_pool->deques[i].top), __ATOMIC_RELAXED);
+
+        pSlot->queuedTasks += (queued > 0) ? (u32)queued : 0;
+    }
+    pSlot->aliveThreads     = thread_pool->info.aliveThreadNum;
+    pSlot->busyThreads      = thread_pool->info.busyThreadNum;
+    pSlot->idleThreads      = thread_pool->info.idleThreadNum;
+    pSlot->processedTasks   = thread_pool->info.processedCnt;
+    pthread_mutex_unlock(&(thread_pool->info.lock));
+}
+
 /// Singleton static mmap accessor
 static mmap_file_accessor_t g_mmapFileAccessor =
 {
@@ -658,11 +2230,27 @@ static mmap_file_accessor_t g_mmapFileAccessor =
         .allocWriteBuf      = mmap_request_alloc_write_buffer,
         .importReadBuf      = mmap_request_import_read_buffer,
         .putRequest         = mmap_put_request,
+        .putRequests        = mmap_put_requests,
         .waitRequest        = mmap_wait_request,
         .cancelRequest      = mmap_cancel_request,
         .waitAll            = mmap_wait_all_requests,
         .cancelAll          = mmap_cancel_all_requests,
         .releaseAll         = mmap_release_all_resources,
+        .reapCompletions    = mmap_reap_completions,
+        .getEventFd         = mmap_get_event_fd,
+        .leaseReadBuf       = mmap_request_lease_read_buffer,
+        .getReadLease       = mmap_get_read_lease,
+        .releaseReadLease   = mmap_release_read_lease,
+        .releaseRequest     = mmap_release_request,
+        .lookupRequest      = mmap_lookup_request,
+        .openFile           = mmap_open_file,
+        .closeFile          = mmap_close_file,
+        .importIovec        = mmap_request_import_iovec,
+        .getCacheStats      = mmap_get_cache_stats,
+        .getPrioStats       = mmap_get_prio_stats,
+        .getDepthStats      = mmap_get_depth_stats,
+        .getStats           = mmap_get_stats,
+        .resetStats         = mmap_reset_stats,
     },
 
     .distributor =
@@ -678,45 +2266,114 @@ static mmap_file_accessor_t g_mmapFileAccessor =
         },
         .task_queue =
         {
-            .request_queue  = NULL,
-            .head           = 0,
-            .tail           = 0,
-            .todoCnt        = 0,
-            .totoalCnt      = 0,
+            .popTurn        = 0,
+            .idleWaiters    = 0,
+            .fullWaiters    = 0,
         },
     },
 };
 
-// Initiaize thread pool
-void thread_pool_init(thread_pool_t *thread_pool)
+// Initiaize thread pool locks, once per process since detached workers may still be leaving them
+static void thread_pool_init_locks(thread_pool_t *thread_pool)
 {
-    /// Initialize mutex and cond
-    thread_pool->info.isRunning = TRUE;
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
     pthread_mutex_init(&(thread_pool->info.lock), NULL);
+    pthread_cond_init(&(thread_pool->info.changed), NULL);
     pthread_mutex_init(&(thread_pool->task_queue.lock), NULL);
-    pthread_cond_init(&(thread_pool->task_queue.not_empty), NULL);
-    // printf("-- Thread Pool Init State: aliveThreadNum[%d], busyThreadNum[%d], idleThreadNum[%d].\n",
-    //        thread_pool->info.aliveThreadNum, thread_pool->info.busyThreadNum, thread_pool->info.idleThreadNum);
-
-    /// Initialize request task queue
-    thread_pool->task_queue.request_queue = (task_t **)malloc(sizeof(task_t *) * REQ_LIST_BUFSIZE);
+    pthread_cond_init(&(thread_pool->task_queue.not_empty), &attr);
+    pthread_cond_init(&(thread_pool->task_queue.not_full), NULL);
+    pthread_condattr_destroy(&attr);
+}
 
-    /// Create threads in thread pool
-    for (int i = 0; i < THREAD_POOL_SIZE; i++)
+// Initiaize thread pool with config, zero or missing fields take defaults
+void thread_pool_init(thread_pool_t *thread_pool, const async_file_accessor_config_t *pConfig)
+{
+    thread_pool_info_t *info    = &(thread_pool->info);
+    u32                 cpuNum  = (u32)sysconf(_SC_NPROCESSORS_ONLN);
+    worker_stat_t      *workers = NULL;
+    task_deque_t       *deques  = NULL;
+
+    info->minThreadNum  = (NULL != pConfig && pConfig->minThreads > 0) ? pConfig->minThreads
+                                                                       : THREAD_POOL_DEFAULT_MIN_SIZE;
+    info->maxThreadNum  = (NULL != pConfig && pConfig->maxThreads > 0) ? pConfig->maxThreads : 2 * cpuNum;
+    info->idleTimeoutMs = (NULL != pConfig && pConfig->idleTimeoutMs > 0) ? pConfig->idleTimeoutMs
+                                                                          : THREAD_POOL_DEFAULT_IDLE_MS;
+    info->maxThreadNum  = (info->maxThreadNum > THREAD_POOL_MAX_SIZE) ? THREAD_POOL_MAX_SIZE : info->maxThreadNum;
+    info->minThreadNum  = (info->minThreadNum > info->maxThreadNum) ? info->maxThreadNum : info->minThreadNum;
+    info->maxThreadNum  = (info->maxThreadNum < info->minThreadNum) ? info->minThreadNum : info->maxThreadNum;
+    // printf("-- Thread Pool Init State: minThreadNum[%d], maxThreadNum[%d], idleTimeoutMs[%d].\n",
+    //        info->minThreadNum, info->maxThreadNum, info->idleTimeoutMs);
+
+    /// Initialize worker slots and their local deques, pollers only see them once they are cleared
+    posix_memalign((void **)&workers, CACHE_LINE_SIZE, sizeof(worker_stat_t) * info->maxThreadNum);
+    posix_memalign((void **)&deques, CACHE_LINE_SIZE, sizeof(task_deque_t) * info->maxThreadNum);
+    memset(workers, 0, sizeof(worker_stat_t) * info->maxThreadNum);
+    memset(deques, 0, sizeof(task_deque_t) * info->maxThreadNum);
+    pthread_mutex_lock(&(info->lock));
+    thread_pool->workers    = workers;
+    thread_pool->deques     = deques;
+    pthread_mutex_unlock(&(info->lock));
+
+    /// Initialize request task rings, slot seq starts at its index for the first lap
+    for (u32 r = 0; r < PRIO_CLASS_RANKS; r++)
     {
-        // printf("thread_pool_init: Create thread: %d.\n", i);
-        pthread_create(&(thread_pool->thread_pool[i]), NULL, worker_thread, thread_pool);
+        task_ring_t *task_ring = &(thread_pool->task_queue.rings[r]);
+
+        task_ring->slots        = (task_slot_t *)malloc(sizeof(task_slot_t) * TASK_QUEUE_DEPTH);
+        task_ring->mask         = TASK_QUEUE_DEPTH - 1;
+        task_ring->enqueuePos   = 0;
+        task_ring->dequeuePos   = 0;
+        for (u64 i = 0; i < TASK_QUEUE_DEPTH; i++)
+        {
+            task_ring->slots[i].seq = i;
+        }
     }
+    thread_pool->task_queue.popTurn     = 0;
 
-    thread_pool->info.isRunning = TRUE;
+    /// Create minimum workers, more are added under load by thread_pool_try_grow
+    info->isRunning = TRUE;
+    pthread_mutex_lock(&(info->lock));
+    for (u32 i = 0; i < info->minThreadNum; i++)
+    {
+        thread_pool_spawn_worker(thread_pool);
+    }
+    pthread_mutex_unlock(&(info->lock));
 }
 
-/// Acqiure single static mmap accessor
-mmap_file_accessor_t* MMAP_File_Accessor_Get_Instance()
+/// Acqiure single static mmap accessor, pConfig sizes the pool when it is (re)created, NULL for defaults
+mmap_file_accessor_t* MMAP_File_Accessor_Get_Instance(const async_file_accessor_config_t *pConfig)
 {
+    if (!g_mmapFileAccessor.completions.isInitialized || NULL != pConfig)
+    {
+        stripe_config_init(&(g_mmapFileAccessor.stripeConfig), pConfig);
+        io_sched_config_init(&(g_mmapFileAccessor.schedConfig), pConfig);
+        readahead_tracker_init(&(g_mmapFileAccessor.readahead));
+        block_cache_init(&(g_mmapFileAccessor.cache));
+        group_commit_init(&(g_mmapFileAccessor.commits));
+        admission_init(&(g_mmapFileAccessor.admission));
+        io_stats_init(&(g_mmapFileAccessor.ioStats));
+        readahead_config_init(&(g_mmapFileAccessor.readahead), pConfig);
+        block_cache_config_init(&(g_mmapFileAccessor.cache), pConfig);
+        group_commit_config_init(&(g_mmapFileAccessor.commits), pConfig);
+        admission_config_init(&(g_mmapFileAccessor.admission), pConfig);
+    }
+
+    if (!g_mmapFileAccessor.completions.isInitialized)
+    {
+        request_pool_init(&(g_mmapFileAccessor.requests), sizeof(mmap_request_t), mmap_request_slot_init);
+        file_registry_init(&(g_mmapFileAccessor.files));
+        thread_pool_init_locks(&(g_mmapFileAccessor.distributor));
+        completion_queue_init(&(g_mmapFileAccessor.completions));
+        timer_service_init(&(g_mmapFileAccessor.timers));
+        live_stats_register(ASYNC_FILE_ACCESSOR_MMAP, mmap_live_stats_fill, &g_mmapFileAccessor);
+    }
+
     if (!g_mmapFileAccessor.distributor.info.isInitialized)
     {
-        thread_pool_init(&(g_mmapFileAccessor.distributor));
+        thread_pool_init(&(g_mmapFileAccessor.distributor), pConfig);
         g_mmapFileAccessor.distributor.info.isInitialized = TRUE;
     }
 
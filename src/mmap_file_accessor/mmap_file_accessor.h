@@ -13,26 +13,65 @@
 
 #include "common_types.h"
 #include "async_file_accessor.h"
+#include "completion_queue.h"
+#include "timer_service.h"
+#include "request_pool.h"
+#include "file_registry.h"
+#include "stripe_group.h"
+#include "io_vector.h"
+#include "io_scheduler.h"
+#include "readahead.h"
+#include "block_cache.h"
+#include "group_commit.h"
+#include "prio_class.h"
+#include "admission.h"
+#include "io_stats.h"
+#include "io_trace.h"
+#include "live_stats.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define THREAD_POOL_SIZE 5
+#define THREAD_POOL_DEFAULT_MIN_SIZE    2                       /// workers kept alive while idle
+#define THREAD_POOL_DEFAULT_IDLE_MS     10000                   /// idle time before extra workers exit
+#define THREAD_POOL_MAX_SIZE            256                     /// upper bound of configured workers
+#define TASK_QUEUE_DEPTH                4096                    /// task ring slots, power of 2
+#define WORKER_DEQUE_DEPTH              256                     /// worker local deque slots, power of 2
+#define CACHE_LINE_SIZE                 64
+#define MMAP_PUT_LOCAL_TASKS            16                      /// batch size put without a heap task array
 
 /// mmap request struct (inherited from __async_file_access_request)
 typedef struct __mmap_request
 {
     async_file_access_request_t     parent;
 
+    struct __mmap_file_accessor    *pAccessor;              /// accessor owns this request
     s32                             fd;                     /// file descriptor
     struct stat                     fsb;                    /// file state block
     void                           *buf;                    /// data buffer
-    u32                             nbytes;                 /// data length
-    u32                             offset;                 /// file operate offset
+    u64                             nbytes;                 /// data length
+    u64                             offset;                 /// file operate offset
+    timer_node_t                    deadline;               /// deadline or wait timeout timer
+    stripe_group_t                  stripe;                 /// chunks of a striped request, or parent of a chunk
+    io_vector_t                     iov;                    /// segments of a vectored request
+    io_merge_t                      merge;                  /// members of a merged read, or carrier of a member
+    u64                             cacheEpoch;             /// write epoch at put, read fills cache unless NO_FILL
+    group_commit_node_t             commit;                 /// durable write waiting for its group flush
+    u64                             putNs;                  /// put time, latency of its class counts from it
+    bool                            isAdmitted;             /// holds in-flight room until it finishes
+    u64                             admitNs;                /// admission time, depth controller measures from it
+    u64                             getNs;                  /// getRequest time, setup stage counts from it
+    u64                             startNs;                /// start of service, 0 until backend takes it up
+    u64                             doneNs;                 /// completion time until a wait or reap returns it
+    void                           *mapAddr;                /// page aligned lease or write mapping, NULL if none
+    size_t                          mapLen;                 /// mapping length
 
     bool                            isValid;                /// check whether request valid
     bool                            isAlloced;              /// whether buffer is alloced by mmap
+    bool                            isLease;                /// read leaves data mapped instead of copying
+    bool                            isPopulate;             /// pre-fault lease mapping with MAP_POPULATE
+    bool                            isInflight;             /// task queued or running, worker owns request
     request_stat_t                  status;                 /// request status
     pthread_mutex_t                 lock;                   /// accessDone status lock
     pthread_cond_t                  isFinished;             /// request done or timeout
@@ -44,41 +83,94 @@ typedef struct __task
 {
     void                           *(*function)(void *);    /// pointer to task function
     void                           *argument;               /// pointer to task arguments
+    async_file_priority_t           priority;               /// class of the request, picks its ring
     bool                            is_sentinel;            /// whether current task is sentinel
 
 } task_t;
 
-/// struct define a task queue
+/// struct define a task ring slot, seq tells which lap of producers or consumers owns it
+typedef struct __task_slot
+{
+    u64                             seq;                    /// slot sequence number
+    task_t                          task;                   /// task stored by value
+
+} task_slot_t;
+
+/// struct define a lock-free bounded MPMC task ring, slots are reused lap after lap
+typedef struct __task_ring
+{
+    task_slot_t                    *slots;                  /// ring of TASK_QUEUE_DEPTH slots
+    u64                             mask;                   /// slot index mask
+    u64                             enqueuePos __attribute__((aligned(CACHE_LINE_SIZE)));
+                                                            /// next position producers claim
+    u64                             dequeuePos __attribute__((aligned(CACHE_LINE_SIZE)));
+                                                            /// next position consumers claim
+
+} task_ring_t;
+
+/// struct define the shared task queue, one ring per priority rank popped in weighted turns
 typedef struct __task_queue
 {
-    task_t                        **request_queue;          /// pointer to task queue
-    u32                             head;                   /// index of oldest unexecuted task
-    u32                             tail;                   /// index if latest task
-    u32                             todoCnt;                /// count of all unexecutd tasks
-    u32                             totoalCnt;              /// count of all tasks
-    pthread_mutex_t                 lock;                   /// task queue lock
+    task_ring_t                     rings[PRIO_CLASS_RANKS];
+                                                            /// task rings, rank 0 holds HIGH tasks
+    u64                             popTurn __attribute__((aligned(CACHE_LINE_SIZE)));
+                                                            /// pops so far, picks the rank served first
+    u32                             idleWaiters __attribute__((aligned(CACHE_LINE_SIZE)));
+                                                            /// workers sleeping on empty queue
+    u32                             fullWaiters;            /// producers sleeping on full queue
+    pthread_mutex_t                 lock;                   /// sleep lock, only taken when empty or full
     pthread_cond_t                  not_empty;              /// task queue not empty condition
+    pthread_cond_t                  not_full;               /// task queue not full condition
 
 } task_queue_t;
 
+/// struct define a worker-owned Chase-Lev deque, owner works at bottom and thieves steal at top
+typedef struct __task_deque
+{
+    s64                             top __attribute__((aligned(CACHE_LINE_SIZE)));
+                                                            /// next index thieves steal from
+    s64                             bottom __attribute__((aligned(CACHE_LINE_SIZE)));
+                                                            /// next index owner pushes to
+    task_t                          slots[WORKER_DEQUE_DEPTH];
+                                                            /// tasks stored by value
+
+} task_deque_t;
+
+/// struct define per-worker slot statistics, one cache line each so workers never share a line
+typedef struct __worker_stat
+{
+    struct __thread_pool           *pOwner;                 /// thread pool owns this slot
+    u32                             idx;                    /// slot index, also index of its deque
+    u64                             processedCnt;           /// count of tasks done in this slot
+    bool                            isBusy;                 /// whether worker is running a task
+    bool                            isAlive;                /// whether a worker occupies this slot
+
+} __attribute__((aligned(CACHE_LINE_SIZE))) worker_stat_t;
+
 /// struct define a thread pool information
 typedef struct __thread_pool_info
 {
-    u32                             maxThreadIdx;           /// max thread index
-    u32                             busyThreadNum;          /// count of busy threads
-    u32                             idleThreadNum;          /// count of idle threads
+    u32                             maxThreadIdx;           /// count of workers started so far
+    u32                             busyThreadNum;          /// count of busy threads, summed from workers
+    u32                             idleThreadNum;          /// count of idle threads, summed from workers
     u32                             aliveThreadNum;         /// count of alive threads
+    u32                             minThreadNum;           /// pool never shrinks below this
+    u32                             maxThreadNum;           /// pool never grows above this
+    u32                             idleTimeoutMs;          /// idle time before a worker above min exits
+    u64                             processedCnt;           /// count of tasks done by all workers
     bool                            isInitialized;          /// whether thread pool is initialized
     bool                            isRunning;              /// whether thread pool is running
     pthread_mutex_t                 lock;                   /// thread pool infomation lock
+    pthread_cond_t                  changed;                /// a worker exited
 
 } thread_pool_info_t;
 
 /// struct define a thread pool
 typedef struct __thread_pool
 {
-    pthread_t                       thread_pool[THREAD_POOL_SIZE];
-    task_queue_t                    task_queue;             /// thread pool task queue
+    worker_stat_t                  *workers;                /// maxThreadNum worker slots
+    task_deque_t                   *deques;                 /// maxThreadNum worker local task deques
+    task_queue_t                    task_queue;             /// shared queue for tasks from outside the pool
     thread_pool_info_t              info;                   /// thread pool information
 
 } thread_pool_t;
@@ -89,21 +181,24 @@ typedef struct __mmap_file_accessor
     async_file_accessor_t           parent;
 
     thread_pool_t                   distributor;            /// distributor to process mmap requests
+    request_pool_t                  requests;               /// preinitialized request slots
+    file_registry_t                 files;                  /// files opened once through openFile
+    stripe_config_t                 stripeConfig;           /// when requests are split into chunks
+    io_sched_config_t               schedConfig;            /// how batched reads are merged
+    readahead_tracker_t             readahead;              /// sequential read streams prefetched ahead
+    block_cache_t                   cache;                  /// blocks of repeated reads, off unless configured
+    group_commit_t                  commits;                /// shared flushes of durable writes
+    prio_stats_t                    prioStats;              /// completion latency of each priority class
+    admission_t                     admission;              /// in-flight limits, backpressure on put
+    io_stats_t                      ioStats;                /// op, byte and latency counters per direction
+    completion_queue_t              completions;            /// finished requests waiting to be reaped
+    timer_service_t                 timers;                 /// request deadline and wait timeout timers
 
 } mmap_file_accessor_t;
 
-/// Struct define timeout params
-typedef struct __timeout_args
-{
-    u32                             timeout_ms;             /// timeout millisecond
-    request_stat_t                 *status;                 /// pointer to request status
-    pthread_mutex_t                *lock;                   /// pointer to status lock
-    pthread_cond_t                 *cond;                   /// pointer to status condition
-
-} timeout_args_t;
-
-/// Acqiure single static mmap accessor
-mmap_file_accessor_t* MMAP_File_Accessor_Get_Instance();
+/// Acqiure single static mmap accessor, pConfig sizes the pool when it is (re)created, NULL for defaults.
+/// Stripe, merge, readahead, cache and commit settings are updated on every call with a config
+mmap_file_accessor_t* MMAP_File_Accessor_Get_Instance(const async_file_accessor_config_t *pConfig);
 
 
 #ifdef __cplusplus
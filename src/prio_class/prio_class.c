@@ -0,0 +1,90 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : prio_class.c
+ * Description  : Map request priority classes to queue ranks and kernel I/O priorities,
+                  and keep per-class completion latency statistics.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include <sys/syscall.h>
+#include "prio_class.h"
+
+/// ioprio_set encoding, see linux/ioprio.h. Best effort class only, real time needs privileges
+#define PRIO_CLASS_IOPRIO_CLASS_SHIFT   13
+#define PRIO_CLASS_IOPRIO_CLASS_BE      2
+#define PRIO_CLASS_IOPRIO_WHO_PROCESS   1
+#define PRIO_CLASS_IOPRIO_BE(level)     ((PRIO_CLASS_IOPRIO_CLASS_BE << PRIO_CLASS_IOPRIO_CLASS_SHIFT) | (level))
+
+/// Rank leading each turn: HIGH leads 5 of 8 pops, NORMAL 2 and LOW 1
+static const u8 s_prioTurns[PRIO_CLASS_TURNS] = { 0, 1, 0, 2, 0, 1, 0, 0 };
+
+/// Queue rank of a priority, HIGH is rank 0
+u32 prio_class_rank(async_file_priority_t priority)
+{
+    return (ASYNC_FILE_PRIO_HIGH == priority) ? 0 : (ASYNC_FILE_PRIO_LOW == priority) ? 2 : 1;
+}
+
+/// Rank a queue pop looks at first on its turn, every rank leads some turns so none starves
+u32 prio_class_turn(u64 turn)
+{
+    return s_prioTurns[turn % PRIO_CLASS_TURNS];
+}
+
+/// Block layer I/O priority of a class for ioprio_set and io_uring, 0 keeps the submitter's
+u16 prio_class_ioprio(async_file_priority_t priority)
+{
+    return (ASYNC_FILE_PRIO_HIGH == priority) ? PRIO_CLASS_IOPRIO_BE(0)
+         : (ASYNC_FILE_PRIO_LOW == priority)  ? PRIO_CLASS_IOPRIO_BE(7) : 0;
+}
+
+/// POSIX aio_reqprio of a class, it can only lower priority so only LOW gets one
+s32 prio_class_reqprio(async_file_priority_t priority)
+{
+    long delta = sysconf(_SC_AIO_PRIO_DELTA_MAX);
+
+    return (ASYNC_FILE_PRIO_LOW == priority && delta > 0) ? (s32)delta : 0;
+}
+
+/// Run calling thread's I/O at the priority of a class, NORMAL restores the default
+void prio_class_set_thread(async_file_priority_t priority)
+{
+    /// Who 0 is the calling thread, failure leaves it at its previous priority
+    syscall(SYS_ioprio_set, PRIO_CLASS_IOPRIO_WHO_PROCESS, 0, (s32)prio_class_ioprio(priority));
+}
+
+/// CLOCK_MONOTONIC time a request is put at, latency is measured from it
+u64 prio_class_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Count a finished request of a class put at putNs
+void prio_stats_record(prio_stats_t *pStats, async_file_priority_t priority, u64 putNs)
+{
+    async_file_prio_stats_t    *pClass  = &(pStats->classes[priority]);
+    u64                         now     = prio_class_now_ns();
+    u64                         latency = (now > putNs) ? now - putNs : 0;
+    u64                         maxNs   = __atomic_load_n(&(pClass->maxNs), __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&(pClass->completed), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(pClass->totalNs), latency, __ATOMIC_RELAXED);
+    while (latency > maxNs &&
+           !__atomic_compare_exchange_n(&(pClass->maxNs), &maxNs, latency, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+/// Snapshot of the counters of a class
+void prio_stats_get(prio_stats_t *pStats, async_file_priority_t priority, async_file_prio_stats_t *pOut)
+{
+    async_file_prio_stats_t *pClass = &(pStats->classes[priority]);
+
+    pOut->completed = __atomic_load_n(&(pClass->completed), __ATOMIC_RELAXED);
+    pOut->totalNs   = __atomic_load_n(&(pClass->totalNs), __ATOMIC_RELAXED);
+    pOut->maxNs     = __atomic_load_n(&(pClass->maxNs), __ATOMIC_RELAXED);
+}
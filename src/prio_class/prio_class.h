@@ -0,0 +1,63 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : prio_class.h
+ * Description  : Map request priority classes to queue ranks and kernel I/O priorities,
+                  and keep per-class completion latency statistics.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __PRIO_CLASS_H__
+#define __PRIO_CLASS_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PRIO_CLASS_RANKS                ASYNC_FILE_PRIO_MAX     /// queue levels, rank 0 is served first
+#define PRIO_CLASS_TURNS                8                       /// length of the weighted turn table
+
+/// struct define per accessor latency statistics of each class
+typedef struct __prio_stats
+{
+    async_file_prio_stats_t         classes[ASYNC_FILE_PRIO_MAX];
+                                                            /// counters, updated atomically
+
+} prio_stats_t;
+
+
+/// Queue rank of a priority, HIGH is rank 0
+u32 prio_class_rank(async_file_priority_t priority);
+
+/// Rank a queue pop looks at first on its turn, every rank leads some turns so none starves
+u32 prio_class_turn(u64 turn);
+
+/// Block layer I/O priority of a class for ioprio_set and io_uring, 0 keeps the submitter's
+u16 prio_class_ioprio(async_file_priority_t priority);
+
+/// POSIX aio_reqprio of a class, it can only lower priority so only LOW gets one
+s32 prio_class_reqprio(async_file_priority_t priority);
+
+/// Run calling thread's I/O at the priority of a class, NORMAL restores the default
+void prio_class_set_thread(async_file_priority_t priority);
+
+/// CLOCK_MONOTONIC time a request is put at, latency is measured from it
+u64 prio_class_now_ns();
+
+/// Count a finished request of a class put at putNs
+void prio_stats_record(prio_stats_t *pStats, async_file_priority_t priority, u64 putNs);
+
+/// Snapshot of the counters of a class
+void prio_stats_get(prio_stats_t *pStats, async_file_priority_t priority, async_file_prio_stats_t *pOut);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __PRIO_CLASS_H__ */
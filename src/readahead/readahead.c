@@ -0,0 +1,155 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : readahead.c
+ * Description  : Detect sequential read streams per file and prefetch ahead of them,
+                  and map request access hints to fadvise/madvise advice.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "readahead.h"
+
+/// Initialize an empty tracker once
+void readahead_tracker_init(readahead_tracker_t *pTracker)
+{
+    if (!pTracker->isInitialized)
+    {
+        memset(pTracker->streams, 0, sizeof(pTracker->streams));
+        pTracker->maxWindow     = READAHEAD_DEFAULT_MAX_WINDOW;
+        pTracker->clock         = 0;
+        pthread_mutex_init(&(pTracker->lock), NULL);
+        pTracker->isInitialized = TRUE;
+    }
+}
+
+/// Take prefetch window from accessor config, zero takes default, ASYNC_FILE_READAHEAD_OFF turns detection off
+void readahead_config_init(readahead_tracker_t *pTracker, const async_file_accessor_config_t *pConfig)
+{
+    u64 maxWindow = (NULL != pConfig && pConfig->readaheadMax > 0) ? pConfig->readaheadMax
+                                                                    : READAHEAD_DEFAULT_MAX_WINDOW;
+
+    maxWindow = (maxWindow > READAHEAD_MAX_WINDOW) ? READAHEAD_MAX_WINDOW : maxWindow;
+    maxWindow = (ASYNC_FILE_READAHEAD_OFF == maxWindow) ? 0 : maxWindow;
+
+    pthread_mutex_lock(&(pTracker->lock));
+    pTracker->maxWindow = maxWindow;
+    pthread_mutex_unlock(&(pTracker->lock));
+}
+
+/// Stream a read at offset continues, else the least recently used slot with the stream reset
+static readahead_stream_t *readahead_find_stream(readahead_tracker_t *pTracker, const struct stat *pFsb, u64 offset)
+{
+    readahead_stream_t *pVictim = &(pTracker->streams[0]);
+
+    for (u32 i = 0; i < READAHEAD_STREAMS; i++)
+    {
+        readahead_stream_t *pStream = &(pTracker->streams[i]);
+
+        if (0 != pStream->lastUse && offset == pStream->next &&
+            (u64)pFsb->st_dev == pStream->dev && (u64)pFsb->st_ino == pStream->ino)
+        {
+            return pStream;
+        }
+        pVictim = (pStream->lastUse < pVictim->lastUse) ? pStream : pVictim;
+    }
+
+    memset(pVictim, 0, sizeof(readahead_stream_t));
+    pVictim->dev    = (u64)pFsb->st_dev;
+    pVictim->ino    = (u64)pFsb->st_ino;
+    pVictim->ahead  = offset;
+
+    return pVictim;
+}
+
+/// Record a read about to be put, prefetch ahead through fd if it continues a stream.
+/// fd must stay open for the call only, request must not be submitted yet
+void readahead_observe(readahead_tracker_t        *pTracker,
+                       s32                         fd,
+                       const struct stat          *pFsb,
+                       u64                         offset,
+                       u64                         size,
+                       async_file_access_hint_t    hint)
+{
+    u64 start   = 0;
+    u64 length  = 0;
+    u64 end     = offset + size;
+    u64 eof     = (u64)pFsb->st_size;
+
+    if (fd < 0 || 0 == size || ASYNC_FILE_HINT_RANDOM == hint || 0 == pTracker->maxWindow)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&(pTracker->lock));
+
+    readahead_stream_t *pStream = readahead_find_stream(pTracker, pFsb, offset);
+
+    if (0 == pStream->hits)
+    {
+        pStream->window = (size * 2 > READAHEAD_MIN_WINDOW) ? size * 2 : READAHEAD_MIN_WINDOW;
+    }
+    pStream->window     = (pStream->window > pTracker->maxWindow) ? pTracker->maxWindow : pStream->window;
+    pStream->hits      += 1;
+    pStream->next       = end;
+    pStream->ahead      = (pStream->ahead > end) ? pStream->ahead : end;
+    pStream->lastUse    = (0 == ++pTracker->clock) ? ++pTracker->clock : pTracker->clock;
+
+    /// Refill once the reader has used up half of what was prefetched, window grows on every refill
+    if ((pStream->hits >= READAHEAD_TRIGGER || ASYNC_FILE_HINT_SEQUENTIAL == hint) &&
+        pStream->ahead < eof && pStream->ahead - end < pStream->window / 2)
+    {
+        start           = pStream->ahead;
+        length          = ((end + pStream->window < eof) ? end + pStream->window : eof) - start;
+        pStream->ahead  = start + length;
+        pStream->window = (pStream->window * 2 < pTracker->maxWindow) ? pStream->window * 2 : pTracker->maxWindow;
+    }
+
+    pthread_mutex_unlock(&(pTracker->lock));
+
+    /// Only queues page cache reads, a failure just means no prefetch
+    if (length > 0)
+    {
+        readahead(fd, (off64_t)start, (size_t)length);
+    }
+}
+
+/// Advise the range before its I/O: SEQUENTIAL, RANDOM and WILLNEED through posix_fadvise
+void readahead_advise(s32 fd, u64 offset, u64 size, async_file_access_hint_t hint)
+{
+    s32 advice = (ASYNC_FILE_HINT_SEQUENTIAL == hint) ? POSIX_FADV_SEQUENTIAL
+               : (ASYNC_FILE_HINT_RANDOM == hint)     ? POSIX_FADV_RANDOM
+               : (ASYNC_FILE_HINT_WILLNEED == hint)   ? POSIX_FADV_WILLNEED : -1;
+
+    if (fd >= 0 && advice >= 0)
+    {
+        posix_fadvise(fd, (off_t)offset, (off_t)size, advice);
+    }
+}
+
+/// Advise a mapping before it is touched: SEQUENTIAL, RANDOM and WILLNEED through madvise
+void readahead_advise_mapping(void *addr, size_t length, async_file_access_hint_t hint)
+{
+    s32 advice = (ASYNC_FILE_HINT_SEQUENTIAL == hint) ? MADV_SEQUENTIAL
+               : (ASYNC_FILE_HINT_RANDOM == hint)     ? MADV_RANDOM
+               : (ASYNC_FILE_HINT_WILLNEED == hint)   ? MADV_WILLNEED : -1;
+
+    if (NULL != addr && advice >= 0)
+    {
+        madvise(addr, length, advice);
+    }
+}
+
+/// Drop the range from page cache after its I/O succeeded if hint is DONTNEED
+void readahead_release(s32 fd, u64 offset, u64 size, async_file_access_hint_t hint)
+{
+    if (fd >= 0 && ASYNC_FILE_HINT_DONTNEED == hint)
+    {
+        posix_fadvise(fd, (off_t)offset, (off_t)size, POSIX_FADV_DONTNEED);
+    }
+}
@@ -0,0 +1,82 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : readahead.h
+ * Description  : Detect sequential read streams per file and prefetch ahead of them,
+                  and map request access hints to fadvise/madvise advice.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __READAHEAD_H__
+#define __READAHEAD_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define READAHEAD_STREAMS               16                      /// streams tracked at once, least recent is replaced
+#define READAHEAD_TRIGGER               2                       /// back to back reads that make a stream
+#define READAHEAD_MIN_WINDOW            (128ULL << 10)          /// first prefetch of a new stream
+#define READAHEAD_DEFAULT_MAX_WINDOW    (2ULL << 20)            /// largest prefetch ahead of a stream
+#define READAHEAD_MAX_WINDOW            (1ULL << 30)            /// upper bound of configured window
+
+/// struct define one sequential read stream
+typedef struct __readahead_stream
+{
+    u64                             dev;                    /// device of the file
+    u64                             ino;                    /// inode of the file
+    u64                             next;                   /// offset a sequential read continues at
+    u64                             ahead;                  /// end of range already prefetched
+    u64                             window;                 /// next prefetch size, doubles up to max
+    u32                             hits;                   /// back to back reads seen
+    u32                             lastUse;                /// tracker clock of last read, 0 if slot unused
+
+} readahead_stream_t;
+
+/// struct define per accessor stream tracker
+typedef struct __readahead_tracker
+{
+    readahead_stream_t              streams[READAHEAD_STREAMS];
+    u64                             maxWindow;              /// largest prefetch, 0 when detection is off
+    u32                             clock;                  /// bumped on every read observed
+    pthread_mutex_t                 lock;                   /// streams lock
+    bool                            isInitialized;          /// whether lock is set up
+
+} readahead_tracker_t;
+
+
+/// Initialize an empty tracker once
+void readahead_tracker_init(readahead_tracker_t *pTracker);
+
+/// Take prefetch window from accessor config, zero takes default, ASYNC_FILE_READAHEAD_OFF turns detection off
+void readahead_config_init(readahead_tracker_t *pTracker, const async_file_accessor_config_t *pConfig);
+
+/// Record a read about to be put, prefetch ahead through fd if it continues a stream.
+/// fd must stay open for the call only, request must not be submitted yet
+void readahead_observe(readahead_tracker_t        *pTracker,
+                       s32                         fd,
+                       const struct stat          *pFsb,
+                       u64                         offset,
+                       u64                         size,
+                       async_file_access_hint_t    hint);
+
+/// Advise the range before its I/O: SEQUENTIAL, RANDOM and WILLNEED through posix_fadvise
+void readahead_advise(s32 fd, u64 offset, u64 size, async_file_access_hint_t hint);
+
+/// Advise a mapping before it is touched: SEQUENTIAL, RANDOM and WILLNEED through madvise
+void readahead_advise_mapping(void *addr, size_t length, async_file_access_hint_t hint);
+
+/// Drop the range from page cache after its I/O succeeded if hint is DONTNEED
+void readahead_release(s32 fd, u64 offset, u64 size, async_file_access_hint_t hint);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __READAHEAD_H__ */
@@ -0,0 +1,184 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : request_pool.c
+ * Description  : Per-accessor pool of preinitialized request slots, handed out with
+                  generation-checked handles and recycled instead of freed.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "request_pool.h"
+
+static async_file_access_request_t* request_pool_slot(request_pool_t *pool, u32 idx)
+{
+    request_chunk_t *chunk = __atomic_load_n(&(pool->chunks[idx / REQUEST_POOL_CHUNK]), __ATOMIC_ACQUIRE);
+
+    return (async_file_access_request_t *)(chunk->objects + (idx % REQUEST_POOL_CHUNK) * pool->objSize);
+}
+
+/// Initialize an empty pool of objSize requests
+ret_t request_pool_init(request_pool_t *pool, size_t objSize, request_pool_slot_init_func slotInit)
+{
+    memset(pool->chunks, 0, sizeof(pool->chunks));
+    pool->objSize       = objSize;
+    pool->slotInit      = slotInit;
+    pool->count         = 0;
+    pool->freeHead      = 0;
+    pthread_mutex_init(&(pool->lock), NULL);
+    pool->isInitialized = TRUE;
+
+    return RET_OK;
+}
+
+/// Add one chunk of slots and chain them to free list, must hold pool lock
+static ret_t request_pool_grow(request_pool_t *pool)
+{
+    ret_t            res    = RET_OK;
+    u32              base   = pool->count;
+    request_chunk_t *chunk  = NULL;
+
+    if (base / REQUEST_POOL_CHUNK >= REQUEST_POOL_MAX_CHUNKS)
+    {
+        res = RET_MAX_USERS;
+        printf("Error: request pool exhausted! res = %d.\n", res);
+    }
+    else
+    {
+        chunk = (request_chunk_t *)calloc(1, sizeof(request_chunk_t));
+        res   = (NULL == chunk) ? RET_NO_MEMORY : RET_OK;
+    }
+
+    if (RET_OK == res)
+    {
+        chunk->objects = (char8 *)calloc(REQUEST_POOL_CHUNK, pool->objSize);
+        if (NULL == chunk->objects)
+        {
+            free(chunk);
+            res = RET_NO_MEMORY;
+        }
+    }
+
+    if (RET_OK == res)
+    {
+        for (u32 i = 0; i < REQUEST_POOL_CHUNK; i++)
+        {
+            chunk->generation[i]    = 1;
+            chunk->nextFree[i]      = base + i + 1;
+            pool->slotInit((async_file_access_request_t *)(chunk->objects + i * pool->objSize));
+        }
+
+        __atomic_store_n(&(pool->chunks[base / REQUEST_POOL_CHUNK]), chunk, __ATOMIC_RELEASE);
+        __atomic_store_n(&(pool->count), base + REQUEST_POOL_CHUNK, __ATOMIC_RELEASE);
+        pool->freeHead = base;
+    }
+    else if (RET_NO_MEMORY == res)
+    {
+        printf("Error: fail to grow request pool! res = %d.\n", res);
+    }
+
+    return res;
+}
+
+/// Take a free slot, growing by one chunk if needed; slot handle is set, other fields are stale
+ret_t request_pool_acquire(request_pool_t *pool, async_file_access_request_t **ppRequest)
+{
+    ret_t res = pool->isInitialized ? RET_OK : RET_NO_INIT;
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(pool->lock));
+
+        if (pool->freeHead >= pool->count)
+        {
+            res = request_pool_grow(pool);
+        }
+
+        if (RET_OK == res)
+        {
+            u32              idx    = pool->freeHead;
+            request_chunk_t *chunk  = pool->chunks[idx / REQUEST_POOL_CHUNK];
+
+            pool->freeHead  = chunk->nextFree[idx % REQUEST_POOL_CHUNK];
+            *ppRequest      = request_pool_slot(pool, idx);
+            __atomic_store_n(&((*ppRequest)->handle),
+                             (chunk->generation[idx % REQUEST_POOL_CHUNK] << REQUEST_HANDLE_INDEX_BITS) | idx,
+                             __ATOMIC_RELEASE);
+        }
+
+        pthread_mutex_unlock(&(pool->lock));
+    }
+
+    return res;
+}
+
+/// Return a slot, its handle turns REQUEST_HANDLE_NONE and old handles go stale
+void request_pool_release(request_pool_t *pool, async_file_access_request_t *pRequest)
+{
+    u32 handle = __atomic_load_n(&(pRequest->handle), __ATOMIC_ACQUIRE);
+
+    if (REQUEST_HANDLE_NONE == handle)
+    {
+        return;
+    }
+
+    u32              idx    = handle & REQUEST_HANDLE_INDEX_MASK;
+    request_chunk_t *chunk  = pool->chunks[idx / REQUEST_POOL_CHUNK];
+    u32             *pGen   = &(chunk->generation[idx % REQUEST_POOL_CHUNK]);
+
+    pthread_mutex_lock(&(pool->lock));
+
+    /// Generation is never 0 so a live handle never equals REQUEST_HANDLE_NONE
+    *pGen = (*pGen + 1) & (0xFFFFFFFFU >> REQUEST_HANDLE_INDEX_BITS);
+    *pGen = (0 == *pGen) ? 1 : *pGen;
+    __atomic_store_n(&(pRequest->handle), REQUEST_HANDLE_NONE, __ATOMIC_RELEASE);
+
+    chunk->nextFree[idx % REQUEST_POOL_CHUNK]   = pool->freeHead;
+    pool->freeHead                              = idx;
+
+    pthread_mutex_unlock(&(pool->lock));
+}
+
+/// Resolve handle in O(1), RET_NAME_NOT_FOUND if slot was released since
+ret_t request_pool_lookup(request_pool_t *pool, u32 handle, async_file_access_request_t **ppRequest)
+{
+    u32   idx = handle & REQUEST_HANDLE_INDEX_MASK;
+    ret_t res = (NULL == ppRequest) ? RET_BAD_VALUE : RET_OK;
+
+    if (RET_OK == res &&
+        (REQUEST_HANDLE_NONE == handle || idx >= __atomic_load_n(&(pool->count), __ATOMIC_ACQUIRE)))
+    {
+        res = RET_NAME_NOT_FOUND;
+    }
+
+    if (RET_OK == res)
+    {
+        async_file_access_request_t *pRequest = request_pool_slot(pool, idx);
+
+        if (__atomic_load_n(&(pRequest->handle), __ATOMIC_ACQUIRE) != handle)
+        {
+            res = RET_NAME_NOT_FOUND;
+        }
+        else
+        {
+            *ppRequest = pRequest;
+        }
+    }
+
+    return res;
+}
+
+/// Count of slots created, upper bound for request_pool_get
+u32 request_pool_count(request_pool_t *pool)
+{
+    return __atomic_load_n(&(pool->count), __ATOMIC_ACQUIRE);
+}
+
+/// Get slot idx if it holds a live request, else NULL
+async_file_access_request_t* request_pool_get(request_pool_t *pool, u32 idx)
+{
+    async_file_access_request_t *pRequest = request_pool_slot(pool, idx);
+
+    return (REQUEST_HANDLE_NONE != __atomic_load_n(&(pRequest->handle), __ATOMIC_ACQUIRE)) ? pRequest : NULL;
+}
@@ -0,0 +1,75 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : request_pool.h
+ * Description  : Per-accessor pool of preinitialized request slots, handed out with
+                  generation-checked handles and recycled instead of freed.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __REQUEST_POOL_H__
+#define __REQUEST_POOL_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REQUEST_POOL_CHUNK              64                      /// slots added per growth step
+#define REQUEST_POOL_MAX_CHUNKS         1024                    /// pool holds at most 65536 requests
+#define REQUEST_HANDLE_INDEX_BITS       16                      /// low bits slot index, high bits generation
+#define REQUEST_HANDLE_INDEX_MASK       ((1U << REQUEST_HANDLE_INDEX_BITS) - 1)
+
+/// One-time slot setup when a chunk is created (locks, conditions)
+typedef void (*request_pool_slot_init_func)(async_file_access_request_t *pRequest);
+
+/// struct define a chunk of request slots, never moved once created
+typedef struct __request_chunk
+{
+    char8                          *objects;                /// REQUEST_POOL_CHUNK backend requests
+    u32                             generation[REQUEST_POOL_CHUNK]; /// bumped on every release
+    u32                             nextFree[REQUEST_POOL_CHUNK];   /// free list link of slot
+
+} request_chunk_t;
+
+/// struct define a request pool
+typedef struct __request_pool
+{
+    request_chunk_t                *chunks[REQUEST_POOL_MAX_CHUNKS];
+    size_t                          objSize;                /// backend request struct size
+    request_pool_slot_init_func     slotInit;               /// one-time slot setup
+    u32                             count;                  /// slots created
+    u32                             freeHead;               /// first free slot, count if none
+    pthread_mutex_t                 lock;                   /// free list and growth lock
+    bool                            isInitialized;          /// whether request pool is initialized
+
+} request_pool_t;
+
+/// Initialize an empty pool of objSize requests
+ret_t request_pool_init(request_pool_t *pool, size_t objSize, request_pool_slot_init_func slotInit);
+
+/// Take a free slot, growing by one chunk if needed; slot handle is set, other fields are stale
+ret_t request_pool_acquire(request_pool_t *pool, async_file_access_request_t **ppRequest);
+
+/// Return a slot, its handle turns REQUEST_HANDLE_NONE and old handles go stale
+void request_pool_release(request_pool_t *pool, async_file_access_request_t *pRequest);
+
+/// Resolve handle in O(1), RET_NAME_NOT_FOUND if slot was released since
+ret_t request_pool_lookup(request_pool_t *pool, u32 handle, async_file_access_request_t **ppRequest);
+
+/// Count of slots created, upper bound for request_pool_get
+u32 request_pool_count(request_pool_t *pool);
+
+/// Get slot idx if it holds a live request, else NULL
+async_file_access_request_t* request_pool_get(request_pool_t *pool, u32 idx);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __REQUEST_POOL_H__ */
@@ -0,0 +1,98 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : stripe_group.c
+ * Description  : Split one large request into chunk sub-requests that run concurrently
+                  on the backend and complete together as their striped request.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "stripe_group.h"
+
+/// Fill stripe settings from accessor config, zero or missing fields take defaults
+void stripe_config_init(stripe_config_t *pStripeConfig, const async_file_accessor_config_t *pConfig)
+{
+    pStripeConfig->threshold    = (NULL != pConfig && pConfig->stripeThreshold > 0) ? pConfig->stripeThreshold
+                                                                                    : STRIPE_DEFAULT_THRESHOLD;
+    pStripeConfig->chunks       = (NULL != pConfig && pConfig->stripeChunks > 0) ? pConfig->stripeChunks
+                                                                                 : STRIPE_DEFAULT_CHUNKS;
+    pStripeConfig->chunks       = (pStripeConfig->chunks > STRIPE_MAX_CHUNKS) ? STRIPE_MAX_CHUNKS
+                                                                              : pStripeConfig->chunks;
+}
+
+/// Chunk count and size for a request of size bytes, 1 if it stays whole
+u32 stripe_plan(const stripe_config_t *pStripeConfig, u64 size, u64 *pChunkSize)
+{
+    u64 chunkSize   = size;
+    u32 count       = 1;
+
+    if ((size > pStripeConfig->threshold && pStripeConfig->chunks > 1) || size > STRIPE_MAX_CHUNK_SIZE)
+    {
+        chunkSize   = (size + pStripeConfig->chunks - 1) / pStripeConfig->chunks;
+        chunkSize   = (chunkSize > STRIPE_MAX_CHUNK_SIZE) ? STRIPE_MAX_CHUNK_SIZE : chunkSize;
+        chunkSize   = (chunkSize + STRIPE_CHUNK_ALIGN - 1) & ~((u64)STRIPE_CHUNK_ALIGN - 1);
+        count       = (u32)((size + chunkSize - 1) / chunkSize);
+    }
+
+    *pChunkSize = (count > 1) ? chunkSize : size;
+
+    return count;
+}
+
+/// Allocate chunk table of a striped request
+ret_t stripe_group_init(stripe_group_t *pGroup, u32 count)
+{
+    ret_t res = RET_OK;
+
+    pGroup->ppChunks = (async_file_access_request_t **)calloc(count, sizeof(async_file_access_request_t *));
+    if (NULL == pGroup->ppChunks)
+    {
+        res = RET_NO_MEMORY;
+        printf("Error: stripe chunk table alloc fail! res = %d.\n", res);
+    }
+
+    pGroup->count   = (RET_OK == res) ? count : 0;
+    pGroup->pending = pGroup->count;
+    pGroup->bytes   = 0;
+    pGroup->error   = 0;
+
+    return res;
+}
+
+/// Free chunk table
+void stripe_group_reset(stripe_group_t *pGroup)
+{
+    free(pGroup->ppChunks);
+    pGroup->ppChunks    = NULL;
+    pGroup->count       = 0;
+    pGroup->pending     = 0;
+    pGroup->bytes       = 0;
+    pGroup->error       = 0;
+}
+
+/// Account one finished chunk, TRUE for the last chunk
+bool stripe_group_chunk_done(stripe_group_t *pGroup, s64 result)
+{
+    if (result >= 0)
+    {
+        __atomic_add_fetch(&(pGroup->bytes), result, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        s64 none = 0;
+        __atomic_compare_exchange_n(&(pGroup->error), &none, result, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+
+    /// Release pairs with the acquire of the last chunk, it reads every chunk's result
+    return __atomic_sub_fetch(&(pGroup->pending), 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+/// Result of a finished striped request
+s64 stripe_group_result(const stripe_group_t *pGroup)
+{
+    s64 error = __atomic_load_n(&(pGroup->error), __ATOMIC_RELAXED);
+
+    return (error != 0) ? error : __atomic_load_n(&(pGroup->bytes), __ATOMIC_RELAXED);
+}
@@ -0,0 +1,72 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : stripe_group.h
+ * Description  : Split one large request into chunk sub-requests that run concurrently
+                  on the backend and complete together as their striped request.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __STRIPE_GROUP_H__
+#define __STRIPE_GROUP_H__
+
+#include "common_types.h"
+#include "async_file_accessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STRIPE_DEFAULT_THRESHOLD        (64ULL << 20)           /// requests larger than this are striped
+#define STRIPE_DEFAULT_CHUNKS           8                       /// chunks a striped request is split into
+#define STRIPE_MAX_CHUNKS               64                      /// upper bound of configured chunks
+#define STRIPE_MAX_CHUNK_SIZE           (1ULL << 30)            /// one read/write syscall moves at most ~2 GiB
+#define STRIPE_CHUNK_ALIGN              4096                    /// chunk boundaries keep page and O_DIRECT alignment
+
+/// struct define when and how requests are striped
+typedef struct __stripe_config
+{
+    u64                             threshold;              /// stripe requests larger than this
+    u32                             chunks;                 /// chunk count of a striped request
+
+} stripe_config_t;
+
+/// struct define striping state, on a striped request it tracks chunks, on a chunk its parent
+typedef struct __stripe_group
+{
+    async_file_access_request_t    *pParent;                /// striped request of a chunk, NULL otherwise
+    async_file_access_request_t   **ppChunks;               /// chunk sub-requests, NULL if not striped
+    u32                             count;                  /// chunk count
+    u32                             pending;                /// chunks not finished yet
+    s64                             bytes;                  /// bytes moved by finished chunks
+    s64                             error;                  /// first chunk error, 0 if none
+
+} stripe_group_t;
+
+/// Fill stripe settings from accessor config, zero or missing fields take defaults
+void stripe_config_init(stripe_config_t *pStripeConfig, const async_file_accessor_config_t *pConfig);
+
+/// Chunk count and size for a request of size bytes, 1 if it stays whole.
+/// Requests above STRIPE_MAX_CHUNK_SIZE are always striped
+u32 stripe_plan(const stripe_config_t *pStripeConfig, u64 size, u64 *pChunkSize);
+
+/// Allocate chunk table of a striped request, chunks are filled in by the backend
+ret_t stripe_group_init(stripe_group_t *pGroup, u32 count);
+
+/// Free chunk table, chunk slots must have been released already
+void stripe_group_reset(stripe_group_t *pGroup);
+
+/// Account one finished chunk, result is bytes moved or -errno. TRUE for the last chunk
+bool stripe_group_chunk_done(stripe_group_t *pGroup, s64 result);
+
+/// Result of a finished striped request: first chunk error or total bytes
+s64 stripe_group_result(const stripe_group_t *pGroup);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __STRIPE_GROUP_H__ */
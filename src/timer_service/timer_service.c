@@ -0,0 +1,223 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : timer_service.c
+ * Description  : Per-accessor timer thread driving request deadlines and wait timeouts
+                  from one min-heap, instead of one sleeping thread per timeout.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "timer_service.h"
+#include "async_file_accessor.h"
+
+static u64 timer_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Place node at heap index, keep its back reference in sync
+static void timer_heap_set(timer_service_t *ts, u32 idx, timer_node_t *node)
+{
+    ts->heap[idx]   = node;
+    node->heapPos   = idx + 1;
+}
+
+/// Move node at idx up or down until heap order holds, must hold service lock
+static void timer_heap_fix(timer_service_t *ts, u32 idx)
+{
+    timer_node_t *node = ts->heap[idx];
+
+    while (idx > 0 && ts->heap[(idx - 1) / 2]->expireNs > node->expireNs)
+    {
+        timer_heap_set(ts, idx, ts->heap[(idx - 1) / 2]);
+        idx = (idx - 1) / 2;
+    }
+
+    while (2 * idx + 1 < ts->count)
+    {
+        u32 child = 2 * idx + 1;
+        if (child + 1 < ts->count && ts->heap[child + 1]->expireNs < ts->heap[child]->expireNs)
+        {
+            child++;
+        }
+        if (ts->heap[child]->expireNs >= node->expireNs)
+        {
+            break;
+        }
+        timer_heap_set(ts, idx, ts->heap[child]);
+        idx = child;
+    }
+
+    timer_heap_set(ts, idx, node);
+}
+
+/// Remove an armed node from heap, must hold service lock
+static void timer_heap_remove(timer_service_t *ts, timer_node_t *node)
+{
+    u32 idx = node->heapPos - 1;
+
+    node->heapPos = 0;
+    ts->count--;
+    if (idx < ts->count)
+    {
+        ts->heap[idx] = ts->heap[ts->count];
+        timer_heap_fix(ts, idx);
+    }
+}
+
+/// Timer thread function
+static void *timer_thread(void *arg)
+{
+    timer_service_t *ts = (timer_service_t *)arg;
+
+    pthread_mutex_lock(&(ts->lock));
+    while (true)
+    {
+        if (0 == ts->count)
+        {
+            pthread_cond_wait(&(ts->changed), &(ts->lock));
+        }
+        else if (ts->heap[0]->expireNs > timer_now_ns())
+        {
+            struct timespec deadline =
+            {
+                .tv_sec     = ts->heap[0]->expireNs / 1000000000,
+                .tv_nsec    = ts->heap[0]->expireNs % 1000000000,
+            };
+            pthread_cond_timedwait(&(ts->changed), &(ts->lock), &deadline);
+        }
+        else
+        {
+            /// Callback runs unlocked so it may take its owner's locks, cancel waits on idle
+            timer_node_t *node = ts->heap[0];
+            timer_heap_remove(ts, node);
+            ts->running = node;
+            pthread_mutex_unlock(&(ts->lock));
+
+            node->callback(node->arg);
+
+            pthread_mutex_lock(&(ts->lock));
+            ts->running = NULL;
+            pthread_cond_broadcast(&(ts->idle));
+        }
+    }
+    pthread_mutex_unlock(&(ts->lock));
+
+    pthread_exit(NULL);
+}
+
+/// Initialize timer service and start its thread
+ret_t timer_service_init(timer_service_t *ts)
+{
+    ret_t               res = RET_OK;
+    pthread_condattr_t  attr;
+
+    ts->heap        = NULL;
+    ts->count       = 0;
+    ts->capacity    = 0;
+    ts->running     = NULL;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&(ts->lock), NULL);
+    pthread_cond_init(&(ts->changed), &attr);
+    pthread_cond_init(&(ts->idle), NULL);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&(ts->thread), NULL, timer_thread, ts) != 0)
+    {
+        res = RET_NO_INIT;
+        printf("Error: timer thread create fail! res = %d.\n", res);
+    }
+    ts->isInitialized = (RET_OK == res);
+
+    return res;
+}
+
+/// Arm timer to expire timeout_ms from now; an armed timer only moves to an earlier expire time
+ret_t timer_service_arm(timer_service_t    *ts,
+                        timer_node_t       *node,
+                        u32                 timeout_ms,
+                        timer_callback_func callback,
+                        void               *arg)
+{
+    ret_t   res         = ts->isInitialized ? RET_OK : RET_NO_INIT;
+    u64     expireNs    = timer_now_ns() + (u64)timeout_ms * 1000000;
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(ts->lock));
+
+        if (0 == node->heapPos && ts->count == ts->capacity)
+        {
+            timer_node_t **newHeap = (timer_node_t **)realloc(ts->heap,
+                                                              sizeof(timer_node_t *) * (ts->capacity + REQ_LIST_BUFSIZE));
+            if (NULL == newHeap)
+            {
+                res = RET_NO_MEMORY;
+                printf("Error: fail to grow timer heap! res = %d.\n", res);
+            }
+            else
+            {
+                ts->heap        = newHeap;
+                ts->capacity   += REQ_LIST_BUFSIZE;
+            }
+        }
+
+        if (RET_OK == res && (0 == node->heapPos || expireNs < node->expireNs))
+        {
+            node->expireNs  = expireNs;
+            node->callback  = callback;
+            node->arg       = arg;
+            if (0 == node->heapPos)
+            {
+                ts->heap[ts->count] = node;
+                ts->count++;
+            }
+            timer_heap_fix(ts, node->heapPos ? node->heapPos - 1 : ts->count - 1);
+
+            /// Only an earlier head changes how long the timer thread should sleep
+            if (ts->heap[0] == node)
+            {
+                pthread_cond_signal(&(ts->changed));
+            }
+        }
+
+        pthread_mutex_unlock(&(ts->lock));
+    }
+
+    return res;
+}
+
+/// Disarm timer and wait for its running callback. Return RET_NAME_NOT_FOUND if it was not armed
+ret_t timer_service_cancel(timer_service_t *ts, timer_node_t *node)
+{
+    ret_t res = ts->isInitialized ? RET_OK : RET_NO_INIT;
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(ts->lock));
+
+        if (node->heapPos > 0)
+        {
+            timer_heap_remove(ts, node);
+        }
+        else
+        {
+            res = RET_NAME_NOT_FOUND;
+        }
+
+        while (ts->running == node)
+        {
+            pthread_cond_wait(&(ts->idle), &(ts->lock));
+        }
+
+        pthread_mutex_unlock(&(ts->lock));
+    }
+
+    return res;
+}
@@ -0,0 +1,66 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : timer_service.h
+ * Description  : Per-accessor timer thread driving request deadlines and wait timeouts
+                  from one min-heap, instead of one sleeping thread per timeout.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __TIMER_SERVICE_H__
+#define __TIMER_SERVICE_H__
+
+#include "common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*timer_callback_func)(void *arg);
+
+/// struct define a timer, embedded in the object it expires (zeroed memory is a disarmed timer)
+typedef struct __timer_node
+{
+    u64                             expireNs;               /// CLOCK_MONOTONIC expire time
+    timer_callback_func             callback;               /// run on timer thread when expired
+    void                           *arg;                    /// callback argument
+    u32                             heapPos;                /// 1-based heap position, 0 if not armed
+
+} timer_node_t;
+
+/// struct define a timer service
+typedef struct __timer_service
+{
+    timer_node_t                  **heap;                   /// armed timers, min-heap on expire time
+    u32                             count;                  /// count of armed timers
+    u32                             capacity;               /// count of heap slots
+    timer_node_t                   *running;                /// timer whose callback is running
+    pthread_t                       thread;                 /// timer thread
+    pthread_mutex_t                 lock;                   /// timer service lock
+    pthread_cond_t                  changed;                /// earliest timer changed
+    pthread_cond_t                  idle;                   /// running callback returned
+    bool                            isInitialized;          /// whether timer thread is started
+
+} timer_service_t;
+
+/// Initialize timer service and start its thread
+ret_t timer_service_init(timer_service_t *ts);
+
+/// Arm timer to expire timeout_ms from now; an armed timer only moves to an earlier expire time
+ret_t timer_service_arm(timer_service_t    *ts,
+                        timer_node_t       *node,
+                        u32                 timeout_ms,
+                        timer_callback_func callback,
+                        void               *arg);
+
+/// Disarm timer and wait for its running callback. Return RET_NAME_NOT_FOUND if it was not armed
+ret_t timer_service_cancel(timer_service_t *ts, timer_node_t *node);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __TIMER_SERVICE_H__ */
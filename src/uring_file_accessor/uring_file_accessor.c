@@ -0,0 +1,1703 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : uring_file_accessor.c
+ * Description  : Implement abstract async file accessor interface by io_uring
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include "uring_file_accessor.h"
+#include "async_file_accessor.h"
+
+/// Raw io_uring syscalls, no liburing dependency
+static s32 sys_io_uring_setup(u32 entries, struct io_uring_params *p)
+{
+    return (s32)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static s32 sys_io_uring_enter(s32 fd, u32 to_submit, u32 min_complete, u32 flags)
+{
+    return (s32)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/// Setup io_uring instance and map its rings
+static ret_t uring_queue_init(uring_queue_t *ring)
+{
+    ret_t res = RET_OK;
+
+    memset(&(ring->params), 0, sizeof(ring->params));
+    ring->ringFd = sys_io_uring_setup(URING_QUEUE_DEPTH, &(ring->params));
+
+    if (ring->ringFd < 0)
+    {
+        res = -errno;
+        printf("Error: io_uring setup fail! error: %d - %s.\n", errno, strerror(errno));
+    }
+
+    if (RET_OK == res)
+    {
+        struct io_uring_params *p = &(ring->params);
+
+        ring->sqRingSize = p->sq_off.array + p->sq_entries * sizeof(u32);
+        ring->cqRingSize = p->cq_off.cqes  + p->cq_entries * sizeof(struct io_uring_cqe);
+        ring->sqesSize   = p->sq_entries * sizeof(struct io_uring_sqe);
+
+        if (p->features & IORING_FEAT_SINGLE_MMAP)
+        {
+            ring->sqRingSize = ring->cqRingSize > ring->sqRingSize ? ring->cqRingSize : ring->sqRingSize;
+            ring->cqRingSize = ring->sqRingSize;
+        }
+
+        ring->sqRingPtr = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring->ringFd, IORING_OFF_SQ_RING);
+        ring->cqRingPtr = (p->features & IORING_FEAT_SINGLE_MMAP)
+                          ? ring->sqRingPtr
+                          : mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring->ringFd, IORING_OFF_CQ_RING);
+        ring->sqes      = (struct io_uring_sqe *)mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+                                                      MAP_SHARED | MAP_POPULATE, ring->ringFd, IORING_OFF_SQES);
+
+        if (MAP_FAILED == ring->sqRingPtr || MAP_FAILED == ring->cqRingPtr || MAP_FAILED == (void *)ring->sqes)
+        {
+            res = RET_NO_MEMORY;
+            printf("Error: io_uring ring map fail! error: %d - %s.\n", errno, strerror(errno));
+            close(ring->ringFd);
+            ring->ringFd = -1;
+        }
+    }
+
+    if (RET_OK == res)
+    {
+        struct io_uring_params *p = &(ring->params);
+        u8 *sq = (u8 *)ring->sqRingPtr;
+        u8 *cq = (u8 *)ring->cqRingPtr;
+
+        ring->sqHead    = (u32 *)(sq + p->sq_off.head);
+        ring->sqTail    = (u32 *)(sq + p->sq_off.tail);
+        ring->sqMask    = (u32 *)(sq + p->sq_off.ring_mask);
+        ring->sqArray   = (u32 *)(sq + p->sq_off.array);
+        ring->cqHead    = (u32 *)(cq + p->cq_off.head);
+        ring->cqTail    = (u32 *)(cq + p->cq_off.tail);
+        ring->cqMask    = (u32 *)(cq + p->cq_off.ring_mask);
+        ring->cqes      = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+        ring->inflight  = 0;
+
+        pthread_mutex_init(&(ring->lock), NULL);
+        pthread_cond_init(&(ring->not_full), NULL);
+    }
+
+    return res;
+}
+
+/// Acquire a free submission entry, must hold ring lock
+static struct io_uring_sqe *uring_get_sqe(uring_queue_t *ring)
+{
+    struct io_uring_sqe *sqe  = NULL;
+    u32                  head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    u32                  tail = *(ring->sqTail);
+
+    if (tail - head < ring->params.sq_entries)
+    {
+        u32 idx                 = tail & *(ring->sqMask);
+        sqe                     = &(ring->sqes[idx]);
+        memset(sqe, 0, sizeof(*sqe));
+        ring->sqArray[idx]      = idx;
+        __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    return sqe;
+}
+
+/// Hand queued submission entries to kernel with one syscall, must hold ring lock.
+/// Entries kernel did not take are dropped from ring, pDone tells how many it took.
+/// -EAGAIN means kernel is short of resources, caller may retry once completions come back
+static ret_t uring_submit(uring_queue_t *ring, u32 count, u32 *pDone)
+{
+    ret_t   res     = RET_OK;
+    u32     done    = 0;
+
+    while (RET_OK == res && done < count)
+    {
+        s32 submitted = sys_io_uring_enter(ring->ringFd, count - done, 0, 0);
+
+        if (submitted < 0 && EINTR != errno)
+        {
+            res = -errno;
+            if (EAGAIN != errno)
+            {
+                printf("Error: io_uring submit fail! error: %d - %s.\n", errno, strerror(errno));
+            }
+        }
+        else if (submitted > 0)
+        {
+            ring->inflight += submitted;
+            done           += submitted;
+        }
+    }
+
+    /// Unsubmitted entries are the newest ones, left in ring a later enter would take them uncounted
+    __atomic_store_n(ring->sqTail, *(ring->sqTail) - (count - done), __ATOMIC_RELEASE);
+    *pDone = done;
+
+    return res;
+}
+
+/// Block until ring has room for count more completions, must hold ring lock
+static void uring_wait_room(uring_queue_t *ring, u32 count)
+{
+    while (ring->inflight + count > ring->params.cq_entries)
+    {
+        pthread_cond_wait(&(ring->not_full), &(ring->lock));
+    }
+}
+
+/// Close request fd, chunks only borrow the fd of their striped request
+static void uring_request_close_fd(uring_request_t *pRequest)
+{
+    if (pRequest->fd > 0 && NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
+    {
+        file_registry_close_fd(&(pRequest->pAccessor->files), pRequest->parent.info.fileHandle, pRequest->fd);
+    }
+    pRequest->fd = -1;
+}
+
+/// Write drops cached blocks it overlapped, even a failed one may have changed them; read caches what it got
+static void uring_cache_complete(uring_request_t *pRequest, s64 result)
+{
+    block_cache_t *pCache = &(pRequest->pAccessor->cache);
+
+    if (ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction)
+    {
+        block_cache_invalidate(pCache, &(pRequest->fsb), pRequest->offset, pRequest->nbytes);
+    }
+    else if (result > 0 && REQUEST_STAT_IOSUCCESS == pRequest->status)
+    {
+        block_cache_fill(pCache, &(pRequest->fsb), pRequest->offset, (u64)result, pRequest->buf, pRequest->cacheEpoch);
+    }
+}
+
+static void uring_request_complete(uring_request_t *pRequest, s64 result);
+
+/// Update status of a request whose I/O and flush are done and release resources.
+/// A chunk reports to its striped request instead, the last one completes it.
+/// A merged request completes each member with its part of the result
+static void uring_request_settle(uring_request_t *pRequest, s64 result)
+{
+    uring_request_t                *pParent     = (uring_request_t *)pRequest->stripe.pParent;
+    async_file_access_request_t   **ppMembers   = pRequest->merge.ppMembers;
+    u32                             memberCount = pRequest->merge.count;
+    u64                             size        = pRequest->parent.info.size;
+    admission_t                    *pAdmission  = NULL;
+    u64                             admitNs     = 0;
+    u64                             offset      = pRequest->offset;
+    io_stats_t                     *pIoStats    = &(pRequest->pAccessor->ioStats);
+
+    pthread_mutex_lock(&(pRequest->lock));
+
+    pRequest->result        = result;
+    pRequest->isInflight    = FALSE;
+
+    if (REQUEST_STAT_CANCEL != pRequest->status)
+    {
+        pRequest->status    = (result >= 0) ? REQUEST_STAT_IOSUCCESS : REQUEST_STAT_IOFAIL;
+    }
+
+    if (result < 0 && -ECANCELED != result && 0 == pRequest->stripe.count && 0 == memberCount)
+    {
+        printf("Error: file [%s] io_uring operation fail! error: %d - %s.\n",
+               pRequest->parent.info.fn, (s32)-result, strerror((s32)-result));
+    }
+
+    if (TRUE == pRequest->isAlloced && pRequest->buf != NULL)
+    {
+        buffer_pool_free(Buffer_Pool_Get_Instance(), pRequest->buf, pRequest->nbytes);
+        pRequest->buf = NULL;
+    }
+
+    if (NULL == pParent && 0 == memberCount)
+    {
+        uring_cache_complete(pRequest, result);
+    }
+
+    if (result >= 0 && NULL == pParent && 0 == memberCount)
+    {
+        readahead_release(pRequest->fd, pRequest->offset, pRequest->nbytes, pRequest->parent.info.hint);
+    }
+    uring_request_close_fd(pRequest);
+
+    if (NULL == pParent && 0 == memberCount)
+    {
+        prio_stats_record(&(pRequest->pAccessor->prioStats), pRequest->parent.info.priority, pRequest->putNs);
+        pRequest->doneNs        = io_stats_record(pIoStats, pRequest->parent.info.direction,
+                                                  REQUEST_STAT_IOSUCCESS == pRequest->status, (result > 0) ? result : 0,
+                                                  pRequest->getNs, pRequest->putNs, pRequest->startNs);
+        pRequest->getNs         = 0;
+        IO_TRACE(IO_TRACE_COMPLETE, pRequest->pAccessor->parent.type, pRequest->parent.handle);
+        pAdmission              = pRequest->isAdmitted ? &(pRequest->pAccessor->admission) : NULL;
+        admitNs                 = pRequest->admitNs;
+        pRequest->isAdmitted    = FALSE;
+        completion_queue_push(&(pRequest->pAccessor->completions), &(pRequest->parent));
+    }
+    pthread_cond_broadcast(&(pRequest->isFinished));
+    pthread_mutex_unlock(&(pRequest->lock));
+
+    /// Room is returned once the request is done with, capacity callback may put again
+    if (NULL != pAdmission)
+    {
+        admission_release(pAdmission, 1, size, admitNs);
+    }
+
+    if (NULL != pParent && stripe_group_chunk_done(&(pParent->stripe), result))
+    {
+        uring_request_complete(pParent, stripe_group_result(&(pParent->stripe)));
+    }
+
+    /// Merged request is not touched again, the last member released returns it to pool
+    for (u32 i = 0; i < memberCount; i++)
+    {
+        uring_request_t *pMember = (uring_request_t *)ppMembers[i];
+
+        uring_request_complete(pMember, io_sched_share(result, offset, pMember->offset, pMember->nbytes));
+    }
+}
+
+/// Group commit callback, durable write is on stable storage or its flush failed
+static void uring_request_committed(void *arg, s64 result)
+{
+    uring_request_settle((uring_request_t *)arg, result);
+}
+
+/// Called when a request cqe reaped. A durable write joins the group commit of its file
+/// and settles from the flush thread once the group is flushed
+static void uring_request_complete(uring_request_t *pRequest, s64 result)
+{
+    if (result >= 0 && group_commit_is_durable(&(pRequest->parent.info)) && REQUEST_STAT_CANCEL != pRequest->status &&
+        NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
+    {
+        /// Traced before the call, a write that cannot be queued is flushed in place and completes right away
+        IO_TRACE(IO_TRACE_COMMIT, pRequest->pAccessor->parent.type, pRequest->parent.handle);
+        group_commit_join(&(pRequest->pAccessor->commits), &(pRequest->commit), pRequest->fd, &(pRequest->fsb),
+                          pRequest->offset, pRequest->nbytes, &(pRequest->parent.info),
+                          uring_request_committed, pRequest, result);
+    }
+    else
+    {
+        uring_request_settle(pRequest, result);
+    }
+}
+
+/// Reaper thread funtion, drain completion ring and wake waiters
+static void *uring_reaper_thread(void *arg)
+{
+    uring_file_accessor_t  *pUringAccessor  = (uring_file_accessor_t *)arg;
+    uring_queue_t          *ring            = &(pUringAccessor->ring);
+    u32                     reaped          = 0;
+
+    while (true)
+    {
+        u32 head = *(ring->cqHead);
+        u32 tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+
+        if (head == tail)
+        {
+            if (sys_io_uring_enter(ring->ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            {
+                printf("Error: io_uring wait fail! error: %d - %s.\n", errno, strerror(errno));
+            }
+            continue;
+        }
+
+        for (; head != tail; head++)
+        {
+            struct io_uring_cqe *cqe = &(ring->cqes[head & *(ring->cqMask)]);
+
+            if (cqe->user_data != URING_CANCEL_USER_DATA)
+            {
+                uring_request_complete((uring_request_t *)(uintptr_t)cqe->user_data, cqe->res);
+            }
+        }
+
+        reaped = tail - *(ring->cqHead);
+        __atomic_store_n(ring->cqHead, tail, __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&(ring->lock));
+        ring->inflight -= reaped;
+        pthread_cond_broadcast(&(ring->not_full));
+        pthread_mutex_unlock(&(ring->lock));
+    }
+
+    pthread_exit(NULL);
+}
+
+/// Ckeck whether uring request valid
+static ret_t uring_check_request_valid(uring_request_t *pRequest)
+{
+    ret_t res = RET_OK;
+
+    if (NULL == pRequest)
+    {
+        res = RET_BAD_VALUE;
+        printf("Error: invalid request detected: empty request! res = %d.\n", res);
+    }
+
+    else if (REQUEST_HANDLE_NONE == __atomic_load_n(&(pRequest->parent.handle), __ATOMIC_ACQUIRE))
+    {
+        res = RET_DEAD_OBJECT;
+        printf("Error: invalid request detected: request already released! res = %d.\n", res);
+    }
+
+    else if (RET_OK == res && !pRequest->isValid)
+    {
+        async_file_access_request_info_t *pCreateInfo = &(pRequest->parent.info);
+
+        if (NULL == pCreateInfo || pCreateInfo->size <= 0||
+            (pCreateInfo->direction < 0 || pCreateInfo->direction >= ASYNC_FILE_ACCESS_MAX) ||
+            (pCreateInfo->hint < 0 || pCreateInfo->hint >= ASYNC_FILE_HINT_MAX) ||
+            (pCreateInfo->durability < 0 || pCreateInfo->durability >= ASYNC_FILE_DURABLE_MAX) ||
+            (pCreateInfo->priority < 0 || pCreateInfo->priority >= ASYNC_FILE_PRIO_MAX))
+        {
+            res = RET_BAD_VALUE;
+            printf("Error: invalid request detected: invalid info! res = %d.\n", res);
+        }
+        else
+        {
+            pRequest->isValid = TRUE;
+        }
+    }
+
+    return res;
+}
+
+/// One-time uring request slot setup, locks live as long as the pool
+static void uring_request_slot_init(async_file_access_request_t *pAsyncRequest)
+{
+    uring_request_t *pRequest = (uring_request_t *)pAsyncRequest;
+
+    pRequest->fd = -1;
+    pthread_mutex_init(&(pRequest->lock), NULL);
+    pthread_cond_init(&(pRequest->isFinished), NULL);
+}
+
+/// Get uring request from accessor request pool
+static ret_t uring_get_request(async_file_accessor_t            *thiz,
+                               async_file_access_request_t     **pAsyncRequest,
+                               async_file_access_request_info_t *pCreateInfo)
+{
+    uring_file_accessor_t  *pUringAccessor  = (uring_file_accessor_t *)thiz;
+    uring_request_t       **pRequest        = (uring_request_t **)pAsyncRequest;
+    u64                     getNs           = prio_class_now_ns();
+
+    u32     retry_times = 0;
+    ret_t   res         = request_pool_acquire(&(pUringAccessor->requests), pAsyncRequest);
+    if (RET_OK != res)
+    {
+        *pRequest = NULL;
+        return res;
+    }
+
+    /// Slot is recycled, reset everything validation reads
+    (*pRequest)->fd                     = -1;
+    (*pRequest)->isValid                = FALSE;
+    (*pRequest)->pAccessor              = pUringAccessor;
+    memset(&((*pRequest)->stripe), 0, sizeof(stripe_group_t));
+    memset(&((*pRequest)->merge), 0, sizeof(io_merge_t));
+
+    (*pRequest)->parent.info.direction  = pCreateInfo->direction;
+    (*pRequest)->parent.info.size       = pCreateInfo->size;
+    (*pRequest)->parent.info.offset     = pCreateInfo->offset;
+    (*pRequest)->parent.info.deadline_ms= pCreateInfo->deadline_ms;
+    (*pRequest)->parent.info.fileHandle = pCreateInfo->fileHandle;
+    (*pRequest)->parent.info.hint       = pCreateInfo->hint;
+    (*pRequest)->parent.info.durability = pCreateInfo->durability;
+    (*pRequest)->parent.info.isBarrier  = pCreateInfo->isBarrier;
+    (*pRequest)->parent.info.priority   = pCreateInfo->priority;
+    memcpy((*pRequest)->parent.info.fn, pCreateInfo->fn, MAX_FILE_NAME_LEN);
+    res = uring_check_request_valid(*pRequest);
+
+    if (RET_OK == res && ASYNC_FILE_HANDLE_NONE != pCreateInfo->fileHandle)
+    {
+        res = file_registry_get(&(pUringAccessor->files), pCreateInfo->fileHandle, pCreateInfo->direction,
+                                &((*pRequest)->fd), &((*pRequest)->fsb));
+    }
+    else if (RET_OK == res)
+    {
+        do {
+            (*pRequest)->fd = pCreateInfo->direction == ASYNC_FILE_ACCESS_READ
+                              ? open((char8 *)(pCreateInfo->fn), O_RDONLY, 0666)
+                              : open((char8 *)(pCreateInfo->fn), O_WRONLY | O_CREAT, 0666);
+        }
+        while ((*pRequest)->fd == -1 && retry_times++ < MAX_RETRY_TIMES);
+
+        if ((*pRequest)->fd >= 0)
+        {
+            fstat((*pRequest)->fd, &(*pRequest)->fsb);
+        }
+        else
+        {
+            res = RET_BAD_VALUE;
+            printf("Error: file [%s] open fail! error: %d - %s.\n",
+                   (*pRequest)->parent.info.fn, errno, strerror(errno));
+        }
+    }
+
+    if (RET_OK == res)
+    {
+        (*pRequest)->buf            = NULL;
+        (*pRequest)->isAlloced      = FALSE;
+        (*pRequest)->isInflight     = FALSE;
+        (*pRequest)->status         = REQUEST_STAT_INIT;
+        (*pRequest)->result         = 0;
+        (*pRequest)->cacheEpoch     = BLOCK_CACHE_NO_FILL;
+        (*pRequest)->nbytes         = pCreateInfo->size;
+        (*pRequest)->offset         = pCreateInfo->offset;
+        (*pRequest)->getNs          = getNs;
+        IO_TRACE(IO_TRACE_GET, thiz->type, (*pRequest)->parent.handle);
+    }
+    else
+    {
+        request_pool_release(&(pUringAccessor->requests), &((*pRequest)->parent));
+        *pRequest = NULL;
+    }
+
+    return res;
+}
+
+/// Alloc uring write request buffer
+static ret_t uring_request_alloc_write_buffer(async_file_accessor_t       *thiz,
+                                              async_file_access_request_t *pAsyncRequest,
+                                              void                       **buffer)
+{
+    uring_request_t *pRequest = (uring_request_t *)pAsyncRequest;
+
+    u32     retry_times = 0;
+    ret_t   res         = uring_check_request_valid(pRequest);
+
+    if (RET_OK == res)
+    {
+        do {
+            (*buffer) = buffer_pool_alloc(Buffer_Pool_Get_Instance(), pRequest->nbytes);
+        }
+        while (NULL == (*buffer) && retry_times++ < MAX_RETRY_TIMES);
+
+        if (NULL != (*buffer))
+        {
+            io_vector_reset(&(pRequest->iov));
+            pRequest->buf       = *buffer;
+            pRequest->isAlloced = TRUE;
+        }
+        else
+        {
+            res = RET_NO_MEMORY;
+            printf("Error: file [%s] write buffer alloc fail! res = %d.\n", pRequest->parent.info.fn, res);
+        }
+    }
+
+    return res;
+}
+
+/// Import uring read only request buffer
+static ret_t uring_request_import_read_buffer(async_file_accessor_t       *thiz,
+                                              async_file_access_request_t *pAsyncRequest,
+                                              void                        *buffer)
+{
+    uring_request_t *pRequest = (uring_request_t *)pAsyncRequest;
+
+    ret_t res = uring_check_request_valid(pRequest);
+
+    if (RET_OK == res && NULL == buffer)
+    {
+        res = RET_BAD_VALUE;
+        printf("Error: invalid import buffer empty! res = %d.\n", res);
+    }
+
+    if (RET_OK == res)
+    {
+        io_vector_reset(&(pRequest->iov));
+        pRequest->buf = buffer;
+    }
+
+    return res;
+}
+
+/// Import segments of a vectored uring request, it goes to kernel as one readv/writev
+static ret_t uring_request_import_iovec(async_file_accessor_t       *thiz,
+                                        async_file_access_request_t *pAsyncRequest,
+                                        const struct iovec          *iov,
+                                        u32                          iovcnt)
+{
+    uring_request_t *pRequest = (uring_request_t *)pAsyncRequest;
+
+    ret_t res = uring_check_request_valid(pRequest);
+
+    if (RET_OK == res && TRUE == pRequest->isAlloced)
+    {
+        res = RET_INVALID_OPERATION;
+        printf("Error: request [%s] already owns a write buffer! res = %d.\n", pRequest->parent.info.fn, res);
+    }
+
+    if (RET_OK == res)
+    {
+        res = io_vector_import(&(pRequest->iov), iov, iovcnt, pRequest->nbytes);
+    }
+
+    if (RET_OK == res)
+    {
+        pRequest->buf = NULL;
+    }
+
+    return res;
+}
+
+/// Fill a read/write submission entry for the request
+static void uring_prep_request(struct io_uring_sqe *sqe, uring_request_t *pRequest)
+{
+    bool isWrite = (ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction);
+
+    if (pRequest->iov.count > 0)
+    {
+        sqe->opcode = isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->addr   = (u64)(uintptr_t)pRequest->iov.iov;
+        sqe->len    = pRequest->iov.count;
+    }
+    else
+    {
+        sqe->opcode = isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->addr   = (u64)(uintptr_t)pRequest->buf;
+        sqe->len    = (u32)pRequest->nbytes;
+    }
+    sqe->fd         = pRequest->fd;
+    sqe->off        = pRequest->offset;
+    sqe->ioprio     = prio_class_ioprio(pRequest->parent.info.priority);
+    sqe->user_data  = (u64)(uintptr_t)pRequest;
+}
+
+static void uring_request_expire(void *arg);
+
+/// Arm request deadline before submission, the request itself stays tracked by its pool slot.
+/// Once in the kernel it may finish and be released and reused before put returns
+static ret_t uring_track_request(uring_file_accessor_t *pUringAccessor, uring_request_t *pRequest)
+{
+    if (pRequest->parent.info.deadline_ms > 0)
+    {
+        timer_service_arm(&(pUringAccessor->timers), &(pRequest->deadline),
+                          pRequest->parent.info.deadline_ms, uring_request_expire, pRequest);
+    }
+
+    return RET_OK;
+}
+
+/// Disarm deadline of a request the kernel never got, before it completes and may be released.
+/// Chunks and merged I/O leave deadlines to the requests they serve
+static void uring_untrack_request(uring_request_t *pRequest)
+{
+    if (pRequest->parent.info.deadline_ms > 0 && NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
+    {
+        timer_service_cancel(&(pRequest->pAccessor->timers), &(pRequest->deadline));
+    }
+}
+
+/// Queue requests into submission ring and enter kernel once per ring-full batch
+static ret_t uring_submit_requests(uring_queue_t *ring, uring_request_t **ppRequests, u32 count)
+{
+    ret_t   res         = RET_OK;
+    u32     submitted   = 0;
+
+    pthread_mutex_lock(&(ring->lock));
+
+    while (RET_OK == res && submitted < count)
+    {
+        u32 batch = count - submitted;
+        batch = (batch > ring->params.sq_entries) ? ring->params.sq_entries : batch;
+        uring_wait_room(ring, batch);
+
+        for (u32 i = 0; i < batch; i++)
+        {
+            uring_request_t *pRequest = ppRequests[submitted + i];
+
+            uring_prep_request(uring_get_sqe(ring), pRequest);
+            pRequest->status        = REQUEST_STAT_SUBMITTED;
+            pRequest->isInflight    = TRUE;
+        }
+
+        u32 done = 0;
+        res = uring_submit(ring, batch, &done);
+        submitted += done;
+
+        /// Short of kernel resources, requests left are prepared again once completions free some
+        if (-EAGAIN == res && ring->inflight > 0)
+        {
+            pthread_cond_wait(&(ring->not_full), &(ring->lock));
+            res = RET_OK;
+        }
+    }
+
+    pthread_mutex_unlock(&(ring->lock));
+
+    /// Requests kernel never accepted will not complete through the reaper
+    for (u32 i = submitted; i < count; i++)
+    {
+        uring_untrack_request(ppRequests[i]);
+        uring_request_complete(ppRequests[i], res);
+    }
+
+    return res;
+}
+
+/// Return chunk slots of a striped request to pool, chunks must be finished
+static void uring_unstripe_request(uring_file_accessor_t *pUringAccessor, uring_request_t *pRequest)
+{
+    for (u32 i = 0; i < pRequest->stripe.count; i++)
+    {
+        if (NULL != pRequest->stripe.ppChunks[i])
+        {
+            request_pool_release(&(pUringAccessor->requests), pRequest->stripe.ppChunks[i]);
+        }
+    }
+    stripe_group_reset(&(pRequest->stripe));
+}
+
+/// Split a request above stripe threshold into chunks, they share its fd and buffer and own nothing.
+/// Vectored requests stay whole, kernel walks their segments
+static ret_t uring_stripe_request(uring_file_accessor_t *pUringAccessor, uring_request_t *pRequest)
+{
+    u64     chunkSize   = 0;
+    u32     count       = (pRequest->iov.count > 0) ? 1 : stripe_plan(&(pUringAccessor->stripeConfig),
+                                                                      pRequest->nbytes, &chunkSize);
+    ret_t   res         = RET_OK;
+
+    uring_unstripe_request(pUringAccessor, pRequest);
+    res = (count > 1) ? stripe_group_init(&(pRequest->stripe), count) : RET_OK;
+
+    for (u32 i = 0; RET_OK == res && i < pRequest->stripe.count; i++)
+    {
+        uring_request_t    *pChunk  = NULL;
+        u64                 delta   = (u64)i * chunkSize;
+
+        res = request_pool_acquire(&(pUringAccessor->requests), (async_file_access_request_t **)&pChunk);
+        if (RET_OK == res)
+        {
+            pChunk->parent.info             = pRequest->parent.info;
+            pChunk->parent.info.size        = (pRequest->nbytes - delta < chunkSize) ? pRequest->nbytes - delta
+                                                                                     : chunkSize;
+            pChunk->parent.info.offset      = pRequest->offset + delta;
+            pChunk->parent.info.deadline_ms = 0;
+            pChunk->pAccessor               = pUringAccessor;
+            pChunk->fd                      = pRequest->fd;
+            pChunk->buf                     = (char8 *)pRequest->buf + delta;
+            pChunk->nbytes                  = pChunk->parent.info.size;
+            pChunk->offset                  = pChunk->parent.info.offset;
+            pChunk->result                  = 0;
+            pChunk->isValid                 = TRUE;
+            pChunk->isAlloced               = FALSE;
+            pChunk->isInflight              = FALSE;
+            pChunk->status                  = REQUEST_STAT_INIT;
+            memset(&(pChunk->stripe), 0, sizeof(stripe_group_t));
+            pChunk->stripe.pParent          = &(pRequest->parent);
+            pRequest->stripe.ppChunks[i]    = &(pChunk->parent);
+        }
+    }
+
+    if (RET_OK != res)
+    {
+        uring_unstripe_request(pUringAccessor, pRequest);
+    }
+
+    return res;
+}
+
+/// Return a merged request and its segments to pool, it borrowed fd and buffers of its members
+static void uring_drop_merged_request(uring_file_accessor_t *pUringAccessor, uring_request_t *pCarrier)
+{
+    io_vector_reset(&(pCarrier->iov));
+    io_merge_reset(&(pCarrier->merge));
+    pCarrier->fd = -1;
+    request_pool_release(&(pUringAccessor->requests), &(pCarrier->parent));
+}
+
+/// Detach a released member from its merged request, the last one drops it
+static void uring_unmerge_request(uring_file_accessor_t *pUringAccessor, uring_request_t *pRequest)
+{
+    uring_request_t *pCarrier = (uring_request_t *)pRequest->merge.pCarrier;
+
+    pRequest->merge.pCarrier = NULL;
+    if (NULL != pCarrier && io_merge_member_done(&(pCarrier->merge)))
+    {
+        uring_drop_merged_request(pUringAccessor, pCarrier);
+    }
+}
+
+/// Carry a run of contiguous requests in one vectored request, members stay in flight until it completes
+static ret_t uring_merge_requests(uring_file_accessor_t  *pUringAccessor,
+                                  const io_sched_entry_t *pRun,
+                                  u32                     count,
+                                  uring_request_t       **ppCarrier)
+{
+    uring_request_t    *pFirst      = (uring_request_t *)pRun[0].pRequest;
+    uring_request_t    *pCarrier    = NULL;
+
+    ret_t res = request_pool_acquire(&(pUringAccessor->requests), (async_file_access_request_t **)&pCarrier);
+
+    if (RET_OK == res)
+    {
+        pCarrier->parent.info               = pFirst->parent.info;
+        pCarrier->parent.info.deadline_ms   = 0;
+        pCarrier->pAccessor                 = pUringAccessor;
+        pCarrier->fd                        = pFirst->fd;
+        pCarrier->buf                       = NULL;
+        pCarrier->nbytes                    = pRun[count - 1].offset + pRun[count - 1].size - pFirst->offset;
+        pCarrier->offset                    = pFirst->offset;
+        pCarrier->parent.info.size          = pCarrier->nbytes;
+        pCarrier->result                    = 0;
+        pCarrier->isValid                   = TRUE;
+        pCarrier->isAlloced                 = FALSE;
+        pCarrier->isInflight                = FALSE;
+        pCarrier->status                    = REQUEST_STAT_INIT;
+        memset(&(pCarrier->stripe), 0, sizeof(stripe_group_t));
+
+        res = io_sched_merge(pRun, count, &(pCarrier->merge), &(pCarrier->iov));
+        if (RET_OK != res)
+        {
+            uring_drop_merged_request(pUringAccessor, pCarrier);
+        }
+    }
+
+    if (RET_OK == res)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            uring_request_t *pMember = (uring_request_t *)pRun[i].pRequest;
+
+            pMember->merge.pCarrier = &(pCarrier->parent);
+            pMember->status         = REQUEST_STAT_SUBMITTED;
+            pMember->isInflight     = TRUE;
+        }
+        *ppCarrier = pCarrier;
+    }
+
+    return res;
+}
+
+/// Order entries by file and offset and replace contiguous runs with merged requests.
+/// Caller's request table is never reordered, a new entry table is made instead
+static void uring_schedule_requests(uring_file_accessor_t  *pUringAccessor,
+                                    uring_request_t       **ppRequests,
+                                    uring_request_t      ***pppEntries,
+                                    u32                    *pEntryCount)
+{
+    u32                 count       = *pEntryCount;
+    uring_request_t   **ppEntries   = *pppEntries;
+    uring_request_t   **ppOrdered   = (ppEntries == ppRequests)
+                                      ? (uring_request_t **)malloc(sizeof(uring_request_t *) * count) : ppEntries;
+    io_sched_entry_t   *pSched      = (io_sched_entry_t *)malloc(sizeof(io_sched_entry_t) * count);
+    u32                 n           = 0;
+
+    /// Ordering is only an optimization, batch goes out as is without memory for it
+    if (NULL == ppOrdered || NULL == pSched)
+    {
+        if (ppOrdered != ppEntries)
+        {
+            free(ppOrdered);
+        }
+        free(pSched);
+        return;
+    }
+
+    for (u32 i = 0; i < count; i++)
+    {
+        uring_request_t *pRequest = ppEntries[i];
+
+        pSched[i].pRequest      = pRequest;
+        pSched[i].buf           = pRequest->buf;
+        pSched[i].dev           = (u64)pRequest->fsb.st_dev;
+        pSched[i].ino           = (u64)pRequest->fsb.st_ino;
+        pSched[i].offset        = pRequest->offset;
+        pSched[i].size          = pRequest->nbytes;
+        pSched[i].direction     = pRequest->parent.info.direction;
+        pSched[i].index         = i;
+        pSched[i].rank          = prio_class_rank(pRequest->parent.info.priority);
+        pSched[i].isMergeable   = (NULL != pRequest->buf && 0 == pRequest->iov.count &&
+                                   0 == pRequest->stripe.count && NULL == pRequest->stripe.pParent);
+    }
+
+    io_sched_sort(pSched, count);
+
+    for (u32 i = 0, run = 1; i < count; i += run)
+    {
+        uring_request_t *pCarrier = NULL;
+
+        run = io_sched_run(&(pUringAccessor->schedConfig), &(pSched[i]), count - i);
+        if (run > 1 && RET_OK == uring_merge_requests(pUringAccessor, &(pSched[i]), run, &pCarrier))
+        {
+            ppOrdered[n++] = pCarrier;
+            continue;
+        }
+
+        for (u32 j = 0; j < run; j++)
+        {
+            ppOrdered[n++] = (uring_request_t *)pSched[i + j].pRequest;
+        }
+    }
+
+    free(pSched);
+    *pppEntries     = ppOrdered;
+    *pEntryCount    = n;
+}
+
+/// Stripe requests above threshold, their chunks go to the ring in place of them, then order and merge.
+/// *pppEntries is ppRequests itself when nothing changed, else a table the caller frees
+static ret_t uring_expand_requests(uring_file_accessor_t  *pUringAccessor,
+                                   uring_request_t       **ppRequests,
+                                   u32                     count,
+                                   uring_request_t      ***pppEntries,
+                                   u32                    *pEntryCount)
+{
+    ret_t               res         = RET_OK;
+    u32                 entryCount  = 0;
+    uring_request_t   **ppEntries   = NULL;
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        /// Request put again lets go of the merged request that carried its previous run
+        uring_unmerge_request(pUringAccessor, ppRequests[i]);
+        res = uring_stripe_request(pUringAccessor, ppRequests[i]);
+        entryCount += (ppRequests[i]->stripe.count > 0) ? ppRequests[i]->stripe.count : 1;
+    }
+
+    *pppEntries     = ppRequests;
+    *pEntryCount    = count;
+
+    if (RET_OK == res && entryCount != count)
+    {
+        ppEntries   = (uring_request_t **)malloc(sizeof(uring_request_t *) * entryCount);
+        res         = (NULL == ppEntries) ? RET_NO_MEMORY : RET_OK;
+    }
+
+    if (NULL != ppEntries)
+    {
+        for (u32 i = 0, n = 0; i < count; i++)
+        {
+            uring_request_t *pRequest = ppRequests[i];
+
+            if (0 == pRequest->stripe.count)
+            {
+                ppEntries[n++] = pRequest;
+                continue;
+            }
+
+            /// Striped request stays in flight until its last chunk completes it
+            pRequest->status        = REQUEST_STAT_SUBMITTED;
+            pRequest->isInflight    = TRUE;
+            for (u32 j = 0; j < pRequest->stripe.count; j++)
+            {
+                ppEntries[n++] = (uring_request_t *)pRequest->stripe.ppChunks[j];
+            }
+        }
+
+        *pppEntries     = ppEntries;
+        *pEntryCount    = entryCount;
+    }
+
+    if (RET_OK == res && *pEntryCount > 1)
+    {
+        uring_schedule_requests(pUringAccessor, ppRequests, pppEntries, pEntryCount);
+    }
+
+    return res;
+}
+
+/// Ckeck whether uring request ready to be submitted
+static ret_t uring_check_request_ready(uring_request_t *pRequest)
+{
+    ret_t res = uring_check_request_valid(pRequest);
+
+    if (RET_OK == res && NULL == pRequest->buf && 0 == pRequest->iov.count)
+    {
+        res = RET_BAD_VALUE;
+        printf("Error: request [%s] has no buffer! res = %d.\n", pRequest->parent.info.fn, res);
+    }
+
+    return res;
+}
+
+/// Serve a read from block cache, or drop blocks a write overlaps. TRUE if read was served,
+/// it then completes in caller's thread without I/O
+static bool uring_cache_request(uring_file_accessor_t *pUringAccessor, uring_request_t *pRequest, bool canServe)
+{
+    block_cache_t  *pCache  = &(pUringAccessor->cache);
+    bool            isHit   = FALSE;
+
+    pRequest->cacheEpoch = BLOCK_CACHE_NO_FILL;
+    if (ASYNC_FILE_ACCESS_WRITE == pRequest->parent.info.direction)
+    {
+        block_cache_invalidate(pCache, &(pRequest->fsb), pRequest->offset, pRequest->nbytes);
+    }
+    else if (NULL != pRequest->buf)
+    {
+        /// Vectored reads go to backend and are not cached
+        pRequest->cacheEpoch    = block_cache_epoch(pCache, &(pRequest->fsb));
+        isHit                   = canServe && block_cache_read(pCache, &(pRequest->fsb), pRequest->offset,
+                                                               pRequest->nbytes, pRequest->buf);
+    }
+
+    if (isHit)
+    {
+        pRequest->cacheEpoch    = BLOCK_CACHE_NO_FILL;
+        pRequest->status        = REQUEST_STAT_SUBMITTED;
+        pRequest->isInflight    = TRUE;
+        uring_request_complete(pRequest, (s64)pRequest->nbytes);
+    }
+
+    return isHit;
+}
+
+/// Pass a batch through block cache, requests it served are left out.
+/// *pppMisses is ppRequests itself when none was served, else a table the caller frees
+static void uring_cache_requests(uring_file_accessor_t  *pUringAccessor,
+                                 uring_request_t       **ppRequests,
+                                 u32                     count,
+                                 uring_request_t      ***pppMisses,
+                                 u32                    *pMissCount)
+{
+    uring_request_t   **ppMisses    = ppRequests;
+    u32                 missCount   = 0;
+
+    if (!block_cache_is_enabled(&(pUringAccessor->cache)))
+    {
+        *pppMisses  = ppRequests;
+        *pMissCount = count;
+        return;
+    }
+
+    /// Caller's table is never reordered, without room for another one the batch only invalidates
+    if (count > 1)
+    {
+        ppMisses = (uring_request_t **)malloc(sizeof(uring_request_t *) * count);
+    }
+
+    for (u32 i = 0; i < count; i++)
+    {
+        if (!uring_cache_request(pUringAccessor, ppRequests[i], NULL != ppMisses) && NULL != ppMisses)
+        {
+            ppMisses[missCount++] = ppRequests[i];
+        }
+    }
+
+    if (NULL == ppMisses)
+    {
+        ppMisses    = ppRequests;
+        missCount   = count;
+    }
+    else if (ppMisses != ppRequests && (0 == missCount || missCount == count))
+    {
+        free(ppMisses);
+        ppMisses    = ppRequests;
+    }
+
+    *pppMisses  = ppMisses;
+    *pMissCount = missCount;
+}
+
+/// Advise kernel of request access hint, reads also feed sequential stream detection
+static void uring_hint_request(uring_file_accessor_t *pUringAccessor, uring_request_t *pRequest)
+{
+    async_file_access_hint_t hint = pRequest->parent.info.hint;
+
+    readahead_advise(pRequest->fd, pRequest->offset, pRequest->nbytes, hint);
+    if (ASYNC_FILE_ACCESS_READ == pRequest->parent.info.direction)
+    {
+        readahead_observe(&(pUringAccessor->readahead), pRequest->fd, &(pRequest->fsb),
+                          pRequest->offset, pRequest->nbytes, hint);
+    }
+}
+
+/// Hold in-flight room for a batch, it waits or is refused as a whole
+static ret_t uring_admit_requests(uring_file_accessor_t *pUringAccessor, uring_request_t **ppRequests, u32 count)
+{
+    u64     bytes   = 0;
+    ret_t   res     = RET_OK;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        bytes += ppRequests[i]->parent.info.size;
+    }
+
+    res = admission_acquire(&(pUringAccessor->admission), count, bytes);
+    for (u64 i = 0, now = prio_class_now_ns(); RET_OK == res && i < count; i++)
+    {
+        ppRequests[i]->isAdmitted   = TRUE;
+        ppRequests[i]->admitNs      = now;
+        IO_TRACE(IO_TRACE_ADMIT, pUringAccessor->parent.type, ppRequests[i]->parent.handle);
+    }
+
+    return res;
+}
+
+/// Give back room of requests that never went out, they will not finish to return it
+static void uring_unadmit_requests(uring_file_accessor_t *pUringAccessor, uring_request_t **ppRequests, u32 count)
+{
+    u32 admitted    = 0;
+    u64 bytes       = 0;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        if (ppRequests[i]->isAdmitted)
+        {
+            ppRequests[i]->isAdmitted   = FALSE;
+            bytes                      += ppRequests[i]->parent.info.size;
+            admitted++;
+        }
+    }
+
+    if (admitted > 0)
+    {
+        admission_release(&(pUringAccessor->admission), admitted, bytes, 0);
+    }
+}
+
+static ret_t uring_put_requests(async_file_accessor_t        *thiz,
+                                async_file_access_request_t **pAsyncRequests,
+                                u32                           count);
+
+/// Put uring request
+static ret_t uring_put_request(async_file_accessor_t       *thiz,
+                               async_file_access_request_t *pAsyncRequest)
+{
+    return uring_put_requests(thiz, &pAsyncRequest, 1);
+}
+
+/// Put a batch of uring requests, one io_uring_enter call for the whole batch
+static ret_t uring_put_requests(async_file_accessor_t        *thiz,
+                                async_file_access_request_t **pAsyncRequests,
+                                u32                           count)
+{
+    uring_file_accessor_t  *pUringAccessor  = (uring_file_accessor_t *)thiz;
+    uring_request_t       **ppBatch         = (uring_request_t **)pAsyncRequests;
+    uring_request_t       **ppRequests      = ppBatch;
+    uring_request_t       **ppEntries       = ppBatch;
+    u32                     entryCount      = count;
+
+    ret_t res = (NULL == ppBatch || 0 == count) ? RET_BAD_VALUE : RET_OK;
+
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        res = uring_check_request_ready(ppBatch[i]);
+    }
+
+    /// Latency of a class counts from here, cache hits included
+    for (u64 i = 0, now = prio_class_now_ns(); RET_OK == res && i < count; i++)
+    {
+        ppBatch[i]->putNs   = now;
+        ppBatch[i]->startNs = 0;
+        ppBatch[i]->doneNs  = 0;
+        IO_TRACE(IO_TRACE_PUT, thiz->type, ppBatch[i]->parent.handle);
+    }
+
+    /// Backpressure, hits hold room too as they finish through the same path
+    if (RET_OK == res)
+    {
+        res = uring_admit_requests(pUringAccessor, ppBatch, count);
+    }
+
+    /// Cache hits are done already, only misses go on
+    if (RET_OK == res)
+    {
+        uring_cache_requests(pUringAccessor, ppBatch, count, &ppRequests, &count);
+        ppEntries   = ppRequests;
+        entryCount  = count;
+    }
+
+    if (0 == count)
+    {
+        return res;
+    }
+
+    /// Before submission, a finished request may have closed its fd
+    for (u32 i = 0; RET_OK == res && i < count; i++)
+    {
+        uring_hint_request(pUringAccessor, ppRequests[i]);
+    }
+
+    if (RET_OK == res)
+    {
+        res = uring_expand_requests(pUringAccessor, ppRequests, count, &ppEntries, &entryCount);
+        if (RET_OK != res)
+        {
+            uring_unadmit_requests(pUringAccessor, ppRequests, count);
+        }
+    }
+
+    /// Service starts when the kernel gets the entries, queueing before it is ours
+    for (u64 i = 0, now = prio_class_now_ns(); RET_OK == res && i < count; i++)
+    {
+        ppRequests[i]->startNs = now;
+        IO_TRACE(IO_TRACE_DISPATCH, thiz->type, ppRequests[i]->parent.handle);
+        uring_track_request(pUringAccessor, ppRequests[i]);
+    }
+
+    if (RET_OK == res)
+    {
+        res = uring_submit_requests(&(pUringAccessor->ring), ppEntries, entryCount);
+    }
+
+    if (ppEntries != ppRequests)
+    {
+        free(ppEntries);
+    }
+
+    if (ppRequests != ppBatch)
+    {
+        free(ppRequests);
+    }
+
+    return res;
+}
+
+/// Wait for an uring request finish
+static ret_t uring_wait_request(async_file_accessor_t       *thiz,
+                                async_file_access_request_t *pAsyncRequest,
+                                u32                          timeout_ms)
+{
+    uring_request_t *pRequest = (uring_request_t *)pAsyncRequest;
+
+    ret_t res = uring_check_request_valid(pRequest);
+
+    if (RET_OK != res                           ||
+        pRequest->status <= REQUEST_STAT_INIT   ||
+        pRequest->status >= REQUEST_STAT_CANCEL)
+    {
+        res = RET_INVALID_OPERATION;
+        printf("Error: cannot wait an invalid or canceled request! res = %d.\n", res);
+    }
+    else
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec  += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        pthread_mutex_lock(&(pRequest->lock));
+        while (RET_OK == res && REQUEST_STAT_SUBMITTED == pRequest->status)
+        {
+            res = (timeout_ms > 0) ? -pthread_cond_timedwait(&(pRequest->isFinished), &(pRequest->lock), &deadline)
+                                   : -pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
+        }
+        res = (RET_OK == res && REQUEST_STAT_IOFAIL == pRequest->status) ? (ret_t)pRequest->result : res;
+        if (REQUEST_STAT_SUBMITTED != pRequest->status)
+        {
+            io_stats_wakeup(&(pRequest->pAccessor->ioStats), pRequest->parent.info.direction, &(pRequest->doneNs));
+            IO_TRACE(IO_TRACE_WAKEUP, thiz->type, pRequest->parent.handle);
+            /// Waited requests are not reaped too, else callers that never reap pile them up
+            completion_queue_remove(&(pRequest->pAccessor->completions), &(pRequest->parent));
+        }
+        pthread_mutex_unlock(&(pRequest->lock));
+    }
+
+    return res;
+}
+
+/// Ask kernel to abort an inflight request, must not hold request lock
+static ret_t uring_submit_cancel(uring_queue_t *ring, uring_request_t *pRequest)
+{
+    ret_t   res     = RET_OK;
+    u32     done    = 0;
+
+    pthread_mutex_lock(&(ring->lock));
+    uring_wait_room(ring, 1);
+
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    sqe->opcode     = IORING_OP_ASYNC_CANCEL;
+    sqe->fd         = -1;
+    sqe->addr       = (u64)(uintptr_t)pRequest;
+    sqe->user_data  = URING_CANCEL_USER_DATA;
+    res = uring_submit(ring, 1, &done);
+    pthread_mutex_unlock(&(ring->lock));
+
+    return res;
+}
+
+/// Mark an uring request canceled, return whether kernel should be asked to abort it
+static bool uring_mark_canceled(uring_request_t *pRequest)
+{
+    bool isCanceled = FALSE;
+
+    pthread_mutex_lock(&(pRequest->lock));
+    if (REQUEST_STAT_SUBMITTED == pRequest->status)
+    {
+        pRequest->status    = REQUEST_STAT_CANCEL;
+        isCanceled          = pRequest->isInflight;
+        pthread_cond_broadcast(&(pRequest->isFinished));
+    }
+    pthread_mutex_unlock(&(pRequest->lock));
+
+    return isCanceled;
+}
+
+/// Ask kernel to abort a request marked canceled, a striped request is aborted through its chunks.
+/// A merged member shares its I/O with others, it is only marked
+static ret_t uring_cancel_inflight(uring_queue_t *ring, uring_request_t *pRequest)
+{
+    ret_t res = RET_OK;
+
+    if (0 == pRequest->stripe.count && NULL == pRequest->merge.pCarrier)
+    {
+        res = uring_submit_cancel(ring, pRequest);
+    }
+
+    for (u32 i = 0; i < pRequest->stripe.count; i++)
+    {
+        uring_request_t *pChunk = (uring_request_t *)pRequest->stripe.ppChunks[i];
+
+        if (uring_mark_canceled(pChunk))
+        {
+            uring_submit_cancel(ring, pChunk);
+        }
+    }
+
+    return res;
+}
+
+/// Deadline timer callback, cancel request still not finished
+static void uring_request_expire(void *arg)
+{
+    uring_request_t *pRequest = (uring_request_t *)arg;
+
+    if (uring_mark_canceled(pRequest))
+    {
+        uring_cancel_inflight(&(pRequest->pAccessor->ring), pRequest);
+    }
+}
+
+/// Cancel an uring request
+static ret_t uring_cancel_request(async_file_accessor_t       *thiz,
+                                  async_file_access_request_t *pAsyncRequest)
+{
+    uring_file_accessor_t  *pUringAccessor  = (uring_file_accessor_t *)thiz;
+    uring_request_t        *pRequest        = (uring_request_t *)pAsyncRequest;
+
+    ret_t res = uring_check_request_valid(pRequest);
+
+    if (RET_OK != res                           ||
+        pRequest->status <= REQUEST_STAT_INIT   ||
+        pRequest->status >= REQUEST_STAT_CANCEL)
+    {
+        res = RET_INVALID_OPERATION;
+        printf("Error: cannot cancel an invalid request! res = %d.\n", res);
+    }
+
+    if (RET_OK == res)
+    {
+        if (uring_mark_canceled(pRequest))
+        {
+            res = uring_cancel_inflight(&(pUringAccessor->ring), pRequest);
+        }
+        else
+        {
+            printf("Warning: request finish, no need cancel! res = %d.\n", res);
+        }
+    }
+
+    return res;
+}
+
+/// Wait for all uring request finish
+static ret_t uring_wait_all_requests(async_file_accessor_t *thiz)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    ret_t res = RET_OK;
+
+    if (NULL == pUringAccessor || 0 == request_pool_count(&(pUringAccessor->requests)))
+    {
+        printf("Empty uring accessor, no need to wait.\n");
+    }
+    else
+    {
+        for (u32 i = 0; i < request_pool_count(&(pUringAccessor->requests)); i++)
+        {
+            uring_request_t *pRequest = (uring_request_t *)request_pool_get(&(pUringAccessor->requests), i);
+            if (pRequest)
+            {
+                pthread_mutex_lock(&(pRequest->lock));
+                while (REQUEST_STAT_SUBMITTED == pRequest->status)
+                {
+                    pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
+                }
+                res = (REQUEST_STAT_IOFAIL == pRequest->status) ? (ret_t)pRequest->result : res;
+                pthread_mutex_unlock(&(pRequest->lock));
+            }
+        }
+    }
+
+    return res;
+}
+
+/// Cancel all uring request
+static ret_t uring_cancel_all_requests(async_file_accessor_t *thiz)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    ret_t res = RET_OK;
+
+    if (NULL == pUringAccessor || 0 == request_pool_count(&(pUringAccessor->requests)))
+    {
+        printf("Empty uring accessor, no need to cancel.\n");
+    }
+    else
+    {
+        for (u32 i = 0; i < request_pool_count(&(pUringAccessor->requests)); i++)
+        {
+            uring_request_t *pRequest = (uring_request_t *)request_pool_get(&(pUringAccessor->requests), i);
+            if (pRequest && uring_mark_canceled(pRequest))
+            {
+                uring_cancel_inflight(&(pUringAccessor->ring), pRequest);
+            }
+        }
+    }
+
+    return res;
+}
+
+/// Close fd, free owned buffer and segments and return slot and chunks to pool, request must not be in flight.
+/// Last member released also returns its merged request
+static void uring_recycle_request(uring_file_accessor_t *pUringAccessor, uring_request_t *pRequest)
+{
+    pthread_mutex_lock(&(pRequest->lock));
+    uring_request_close_fd(pRequest);
+    if (TRUE == pRequest->isAlloced && pRequest->buf != NULL)
+    {
+        buffer_pool_free(Buffer_Pool_Get_Instance(), pRequest->buf, pRequest->nbytes);
+        pRequest->buf = NULL;
+    }
+    io_vector_reset(&(pRequest->iov));
+    pthread_mutex_unlock(&(pRequest->lock));
+
+    uring_unmerge_request(pUringAccessor, pRequest);
+    uring_unstripe_request(pUringAccessor, pRequest);
+    request_pool_release(&(pUringAccessor->requests), &(pRequest->parent));
+}
+
+/// Release a finished or never put uring request back to pool
+static ret_t uring_release_request(async_file_accessor_t       *thiz,
+                                   async_file_access_request_t *pAsyncRequest)
+{
+    uring_file_accessor_t  *pUringAccessor  = (uring_file_accessor_t *)thiz;
+    uring_request_t        *pRequest        = (uring_request_t *)pAsyncRequest;
+
+    ret_t res = (NULL == pRequest) ? RET_BAD_VALUE : RET_OK;
+
+    if (RET_OK == res && REQUEST_HANDLE_NONE == __atomic_load_n(&(pRequest->parent.handle), __ATOMIC_ACQUIRE))
+    {
+        res = RET_DEAD_OBJECT;
+        printf("Error: request already released! res = %d.\n", res);
+    }
+
+    if (RET_OK == res)
+    {
+        pthread_mutex_lock(&(pRequest->lock));
+        res = (REQUEST_STAT_SUBMITTED == pRequest->status || pRequest->isInflight) ? RET_BUSY : RET_OK;
+        pthread_mutex_unlock(&(pRequest->lock));
+    }
+
+    if (RET_OK == res)
+    {
+        timer_service_cancel(&(pUringAccessor->timers), &(pRequest->deadline));
+        uring_recycle_request(pUringAccessor, pRequest);
+    }
+    else if (RET_BUSY == res)
+    {
+        printf("Error: cannot release a request still in flight! res = %d.\n", res);
+    }
+
+    return res;
+}
+
+/// Register a file once for many uring requests
+static ret_t uring_open_file(async_file_accessor_t        *thiz,
+                             const char8                  *fn,
+                             async_file_access_direction_t direction,
+                             u32                          *pFileHandle)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    return file_registry_open(&(pUringAccessor->files), fn, direction, pFileHandle);
+}
+
+/// Unregister a uring file
+static ret_t uring_close_file(async_file_accessor_t *thiz, u32 fileHandle)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    return file_registry_close(&(pUringAccessor->files), fileHandle);
+}
+
+/// Resolve uring request handle
+static ret_t uring_lookup_request(async_file_accessor_t        *thiz,
+                                  u32                           handle,
+                                  async_file_access_request_t **pAsyncRequest)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    return request_pool_lookup(&(pUringAccessor->requests), handle, pAsyncRequest);
+}
+
+// Cancel all uring operations and release resources
+static ret_t uring_release_all_resources(async_file_accessor_t *thiz)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    ret_t res = RET_OK;
+
+    if (NULL == pUringAccessor || 0 == request_pool_count(&(pUringAccessor->requests)))
+    {
+        printf("Empty uring accessor, no need to release.\n");
+    }
+    else
+    {
+        uring_cancel_all_requests(thiz);
+
+        for (u32 i = 0; i < request_pool_count(&(pUringAccessor->requests)); i++)
+        {
+            uring_request_t *pRequest = (uring_request_t *)request_pool_get(&(pUringAccessor->requests), i);
+
+            /// Chunks go back to pool with their striped request, merged requests with their last member
+            if (pRequest && NULL == pRequest->stripe.pParent && 0 == pRequest->merge.count)
+            {
+                /// Timer thread must be done with request before it is freed
+                timer_service_cancel(&(pUringAccessor->timers), &(pRequest->deadline));
+
+                /// Kernel may still own the buffer until its cqe is reaped
+                pthread_mutex_lock(&(pRequest->lock));
+                while (pRequest->isInflight)
+                {
+                    pthread_cond_wait(&(pRequest->isFinished), &(pRequest->lock));
+                }
+                pthread_mutex_unlock(&(pRequest->lock));
+
+                uring_recycle_request(pUringAccessor, pRequest);
+            }
+        }
+        completion_queue_reset(&(pUringAccessor->completions));
+    }
+
+    return res;
+}
+
+/// Reap finished uring requests in one batch
+static ret_t uring_reap_completions(async_file_accessor_t        *thiz,
+                                    async_file_access_request_t **pAsyncRequests,
+                                    u32                           max,
+                                    s32                           timeout_ms)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    ret_t res = completion_queue_reap(&(pUringAccessor->completions), pAsyncRequests, max, timeout_ms);
+
+    for (s32 i = 0; i < res; i++)
+    {
+        uring_request_t *pRequest = (uring_request_t *)pAsyncRequests[i];
+        io_stats_wakeup(&(pUringAccessor->ioStats), pRequest->parent.info.direction, &(pRequest->doneNs));
+        IO_TRACE(IO_TRACE_WAKEUP, thiz->type, pRequest->parent.handle);
+    }
+
+    return res;
+}
+
+/// Get eventfd readable while uring completions are pending
+static s32 uring_get_event_fd(async_file_accessor_t *thiz)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    return pUringAccessor->completions.eventFd;
+}
+
+/// Read leases need a file mapping, uring reads always land in a request buffer
+static ret_t uring_request_lease_read_buffer(async_file_accessor_t       *thiz,
+                                           async_file_access_request_t *pAsyncRequest,
+                                           bool                         isPopulate)
+{
+    printf("Error: read lease is only supported by mmap accessor! res = %d.\n", RET_INVALID_OPERATION);
+    return RET_INVALID_OPERATION;
+}
+
+static ret_t uring_get_read_lease(async_file_accessor_t       *thiz,
+                               async_file_access_request_t *pAsyncRequest,
+                               const void                 **buffer)
+{
+    return RET_INVALID_OPERATION;
+}
+
+static ret_t uring_release_read_lease(async_file_accessor_t       *thiz,
+                                   async_file_access_request_t *pAsyncRequest)
+{
+    return RET_INVALID_OPERATION;
+}
+
+/// Snapshot of uring block cache counters
+static ret_t uring_get_cache_stats(async_file_accessor_t *thiz, async_file_cache_stats_t *pStats)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    block_cache_get_stats(&(pUringAccessor->cache), pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of uring latency counters of a priority class
+static ret_t uring_get_prio_stats(async_file_accessor_t   *thiz,
+                                  async_file_priority_t    priority,
+                                  async_file_prio_stats_t *pStats)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    if (NULL == pStats || priority < 0 || priority >= ASYNC_FILE_PRIO_MAX)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    prio_stats_get(&(pUringAccessor->prioStats), priority, pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of uring adaptive depth controller
+static ret_t uring_get_depth_stats(async_file_accessor_t    *thiz,
+                                   async_file_depth_stats_t *pStats)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    admission_get_depth_stats(&(pUringAccessor->admission), pStats);
+
+    return RET_OK;
+}
+
+/// Snapshot of uring op, byte and latency counters
+static ret_t uring_get_stats(async_file_accessor_t *thiz, async_file_stats_t *pStats)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    if (NULL == pStats)
+    {
+        return RET_BAD_VALUE;
+    }
+
+    io_stats_get(&(pUringAccessor->ioStats), pStats);
+
+    return RET_OK;
+}
+
+/// Start uring op, byte and latency counters over
+static ret_t uring_reset_stats(async_file_accessor_t *thiz)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)thiz;
+
+    io_stats_reset(&(pUringAccessor->ioStats));
+
+    return RET_OK;
+}
+
+/// Publish uring counters, runs on live stats publisher thread
+static void uring_live_stats_fill(void *arg, live_stats_slot_t *pSlot)
+{
+    uring_file_accessor_t *pUringAccessor = (uring_file_accessor_t *)arg;
+
+    live_stats_fill_common(pSlot, &(pUringAccessor->ioStats), &(pUringAccessor->admission),
+                           &(pUringAccessor->completions));
+}
+
+/// Singleton static uring accessor
+static uring_file_accessor_t g_uringFileAccessor =
+{
+    .parent =
+    {
+        .type               = ASYNC_FILE_ACCESSOR_URING,
+
+        .getRequest         = uring_get_request,
+        .allocWriteBuf      = uring_request_alloc_write_buffer,
+        .importReadBuf      = uring_request_import_read_buffer,
+        .putRequest         = uring_put_request,
+        .putRequests        = uring_put_requests,
+        .waitRequest        = uring_wait_request,
+        .cancelRequest      = uring_cancel_request,
+        .waitAll            = uring_wait_all_requests,
+        .cancelAll          = uring_cancel_all_requests,
+        .releaseAll         = uring_release_all_resources,
+        .reapCompletions    = uring_reap_completions,
+        .getEventFd         = uring_get_event_fd,
+        .leaseReadBuf       = uring_request_lease_read_buffer,
+        .getReadLease       = uring_get_read_lease,
+        .releaseReadLease   = uring_release_read_lease,
+        .releaseRequest     = uring_release_request,
+        .lookupRequest      = uring_lookup_request,
+        .openFile           = uring_open_file,
+        .closeFile          = uring_close_file,
+        .importIovec        = uring_request_import_iovec,
+        .getCacheStats      = uring_get_cache_stats,
+        .getPrioStats       = uring_get_prio_stats,
+        .getDepthStats      = uring_get_depth_stats,
+        .getStats           = uring_get_stats,
+        .resetStats         = uring_reset_stats,
+    },
+
+    .ring =
+    {
+        .ringFd             = -1,
+    },
+    .isInitialized          = false,
+};
+
+/// Acqiure single static uring accessor, NULL if kernel lacks io_uring
+uring_file_accessor_t* URING_File_Accessor_Get_Instance(const async_file_accessor_config_t *pConfig)
+{
+    if (!g_uringFileAccessor.isInitialized)
+    {
+        if (RET_OK == uring_queue_init(&(g_uringFileAccessor.ring)))
+        {
+            stripe_config_init(&(g_uringFileAccessor.stripeConfig), pConfig);
+            io_sched_config_init(&(g_uringFileAccessor.schedConfig), pConfig);
+            readahead_tracker_init(&(g_uringFileAccessor.readahead));
+            block_cache_init(&(g_uringFileAccessor.cache));
+            group_commit_init(&(g_uringFileAccessor.commits));
+            admission_init(&(g_uringFileAccessor.admission));
+            io_stats_init(&(g_uringFileAccessor.ioStats));
+            readahead_config_init(&(g_uringFileAccessor.readahead), pConfig);
+            block_cache_config_init(&(g_uringFileAccessor.cache), pConfig);
+            group_commit_config_init(&(g_uringFileAccessor.commits), pConfig);
+            admission_config_init(&(g_uringFileAccessor.admission), pConfig);
+            request_pool_init(&(g_uringFileAccessor.requests), sizeof(uring_request_t), uring_request_slot_init);
+            file_registry_init(&(g_uringFileAccessor.files));
+            completion_queue_init(&(g_uringFileAccessor.completions));
+            timer_service_init(&(g_uringFileAccessor.timers));
+            pthread_create(&(g_uringFileAccessor.ring.reaper), NULL, uring_reaper_thread, &g_uringFileAccessor);
+            live_stats_register(ASYNC_FILE_ACCESSOR_URING, uring_live_stats_fill, &g_uringFileAccessor);
+            g_uringFileAccessor.isInitialized = TRUE;
+        }
+    }
+    else if (NULL != pConfig)
+    {
+        stripe_config_init(&(g_uringFileAccessor.stripeConfig), pConfig);
+        io_sched_config_init(&(g_uringFileAccessor.schedConfig), pConfig);
+        readahead_config_init(&(g_uringFileAccessor.readahead), pConfig);
+        block_cache_config_init(&(g_uringFileAccessor.cache), pConfig);
+        group_commit_config_init(&(g_uringFileAccessor.commits), pConfig);
+        admission_config_init(&(g_uringFileAccessor.admission), pConfig);
+    }
+
+    return g_uringFileAccessor.isInitialized ? &g_uringFileAccessor : NULL;
+}
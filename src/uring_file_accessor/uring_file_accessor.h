@@ -0,0 +1,136 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : uring_file_accessor.h
+ * Description  : Implement abstract async file accessor interface by io_uring
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#ifndef __URING_FILE_ACCESSOR_H__
+#define __URING_FILE_ACCESSOR_H__
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include "common_types.h"
+#include "async_file_accessor.h"
+#include "completion_queue.h"
+#include "timer_service.h"
+#include "buffer_pool.h"
+#include "request_pool.h"
+#include "file_registry.h"
+#include "stripe_group.h"
+#include "io_vector.h"
+#include "io_scheduler.h"
+#include "readahead.h"
+#include "block_cache.h"
+#include "group_commit.h"
+#include "prio_class.h"
+#include "admission.h"
+#include "io_stats.h"
+#include "io_trace.h"
+#include "live_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define URING_QUEUE_DEPTH               256
+#define URING_CANCEL_USER_DATA          0ULL                    /// async cancel entries
+
+/// io_uring request struct (inherited from __async_file_access_request)
+typedef struct __uring_request
+{
+    async_file_access_request_t     parent;
+
+    struct __uring_file_accessor   *pAccessor;              /// accessor owns this request
+    s32                             fd;                     /// file descriptor
+    struct stat                     fsb;                    /// file state block
+    void                           *buf;                    /// data buffer
+    u64                             nbytes;                 /// data length
+    u64                             offset;                 /// file operate offset
+    s64                             result;                 /// cqe or summed chunk result, bytes done or -errno
+    timer_node_t                    deadline;               /// deadline timer, cancels request on expire
+    stripe_group_t                  stripe;                 /// chunks of a striped request, or parent of a chunk
+    io_vector_t                     iov;                    /// segments of a vectored request
+    io_merge_t                      merge;                  /// members of a merged request, or carrier of a member
+    u64                             cacheEpoch;             /// write epoch at put, read fills cache unless NO_FILL
+    group_commit_node_t             commit;                 /// durable write waiting for its group flush
+    u64                             putNs;                  /// put time, latency of its class counts from it
+    bool                            isAdmitted;             /// holds in-flight room until it finishes
+    u64                             admitNs;                /// admission time, depth controller measures from it
+    u64                             getNs;                  /// getRequest time, setup stage counts from it
+    u64                             startNs;                /// start of service, 0 until backend takes it up
+    u64                             doneNs;                 /// completion time until a wait or reap returns it
+
+    bool                            isValid;                /// check whether request valid
+    bool                            isAlloced;              /// whether buffer is alloced by uring
+    bool                            isInflight;             /// sqe owned by kernel, cqe not reaped
+    request_stat_t                  status;                 /// request status
+    pthread_mutex_t                 lock;                   /// status lock
+    pthread_cond_t                  isFinished;             /// request done or timeout
+
+} uring_request_t;
+
+/// struct define the mapped submission/completion rings of one io_uring instance
+typedef struct __uring_queue
+{
+    s32                             ringFd;                 /// io_uring instance fd
+    struct io_uring_params          params;                 /// params filled by io_uring_setup
+
+    void                           *sqRingPtr;              /// mapped submission ring
+    void                           *cqRingPtr;              /// mapped completion ring
+    struct io_uring_sqe            *sqes;                   /// mapped submission entries
+    u32                             sqRingSize;             /// submission ring map size
+    u32                             cqRingSize;             /// completion ring map size
+    u32                             sqesSize;               /// submission entries map size
+
+    u32                            *sqHead;                 /// submission ring head (kernel)
+    u32                            *sqTail;                 /// submission ring tail (user)
+    u32                            *sqMask;                 /// submission ring mask
+    u32                            *sqArray;                /// submission index array
+    u32                            *cqHead;                 /// completion ring head (user)
+    u32                            *cqTail;                 /// completion ring tail (kernel)
+    u32                            *cqMask;                 /// completion ring mask
+    struct io_uring_cqe            *cqes;                   /// completion entries
+
+    u32                             inflight;               /// submitted entries not reaped yet
+    pthread_mutex_t                 lock;                   /// submission side lock
+    pthread_cond_t                  not_full;               /// inflight below completion depth
+    pthread_t                       reaper;                 /// completion reaping thread
+
+} uring_queue_t;
+
+/// io_uring file accessor struct (inherited from __async_file_accessor)
+typedef struct __uring_file_accessor
+{
+    async_file_accessor_t           parent;
+
+    uring_queue_t                   ring;                   /// kernel submission/completion rings
+    request_pool_t                  requests;               /// preinitialized request slots
+    file_registry_t                 files;                  /// files opened once through openFile
+    stripe_config_t                 stripeConfig;           /// when requests are split into chunks
+    io_sched_config_t               schedConfig;            /// how batched requests are merged
+    readahead_tracker_t             readahead;              /// sequential read streams prefetched ahead
+    block_cache_t                   cache;                  /// blocks of repeated reads, off unless configured
+    group_commit_t                  commits;                /// shared flushes of durable writes
+    prio_stats_t                    prioStats;              /// completion latency of each priority class
+    admission_t                     admission;              /// in-flight limits, backpressure on put
+    io_stats_t                      ioStats;                /// op, byte and latency counters per direction
+    completion_queue_t              completions;            /// finished requests waiting to be reaped
+    timer_service_t                 timers;                 /// request deadline timers
+    bool                            isInitialized;          /// whether ring is set up
+
+} uring_file_accessor_t;
+
+
+/// Acqiure single static io_uring accessor, pConfig updates stripe, merge, readahead, cache and commit settings, NULL keeps them
+uring_file_accessor_t* URING_File_Accessor_Get_Instance(const async_file_accessor_config_t *pConfig);
+
+
+#ifdef __cplusplus
+}//extern "C" {
+#endif
+
+#endif /* __URING_FILE_ACCESSOR_H__ */
@@ -33,6 +33,7 @@ typedef struct
 
 static void parse_args(int argc, char *argv[]);
 static long long get_time_in_microseconds();
+static void print_io_stats(async_file_accessor_t *pFileAccessor);
 ret_t create_test_data_set(file_t ***file_set, u32 *count);
 ret_t async_read_one_picture_to_file(void **buffer, char8 *filename, u32 *length);
 ret_t async_write_one_picture_to_file(void *buffer, char8 *filename, u32 length);
@@ -67,7 +68,6 @@ int main(int argc, char *argv[])
                                               &(file_set[i]->size));
     }
 
-    sleep(5);
     res = g_en_async ? pFileAccessor->waitAll(pFileAccessor) : res;
     long long read_end_time     = get_time_in_microseconds();
     double elapsed_read_time    = (double)(read_end_time - read_start_time) / 1000;
@@ -87,19 +87,23 @@ int main(int argc, char *argv[])
                                                file_set[i]->size);
     }
 
-    sleep(5);
     res = g_en_async ? pFileAccessor->waitAll(pFileAccessor) : res;
     long long write_end_time = get_time_in_microseconds();
     double elapsed_write_time = (double)(write_end_time - write_start_time) / 1000;
     printf("\n -- Write %d pictures time consumption: %f ms.\n\n", fileCnt, elapsed_write_time);
 
+    if (g_en_async)
+    {
+        print_io_stats(pFileAccessor);
+    }
+
     printf("- Cancel and release all resource.\n");
     res = g_en_async ? pFileAccessor->cancelAll(pFileAccessor) : res;
     res = g_en_async ? pFileAccessor->releaseAll(pFileAccessor) : res;
 
     for (i = 0; i < fileCnt; i++)
     {
-        free(file_set[i]->buf);
+        Async_File_Buffer_Free(file_set[i]->buf, file_set[i]->size);
         file_set[i]->buf = NULL;
     }
 
@@ -110,18 +114,20 @@ static void parse_args(int argc, char *argv[])
 {
     if ((argc < 3)                                      ||
         (strcmp(argv[1], "0") && strcmp(argv[1], "1"))  ||
-        (strcmp(argv[2], "1") && strcmp(argv[2], "2")))
+        (strcmp(argv[2], "1") && strcmp(argv[2], "2") && strcmp(argv[2], "3") && strcmp(argv[2], "4")))
     {
         printf("Usage: %s <EN_ASYNC_IO> <ASYNC_METHOD_TYPE>\n\n"
                "       EN_ASYNC_IO = 0: disable async IO\n"
                "       EN_ASYNC_IO = 1: enable async IO\n\n"
                "       ASYNC_METHOD_TYPE = 1: use aio\n"
-               "       ASYNC_METHOD_TYPE = 2: use mmap\n\n", argv[0]);
+               "       ASYNC_METHOD_TYPE = 2: use mmap\n"
+               "       ASYNC_METHOD_TYPE = 3: use io_uring\n"
+               "       ASYNC_METHOD_TYPE = 4: use kernel native aio\n\n", argv[0]);
         exit(1);
     }
 
     g_en_async = strcmp(argv[1], "0") ? TRUE : FALSE;
-    g_async_method_type = strcmp(argv[2], "1") ? ASYNC_FILE_ACCESSOR_MMAP : ASYNC_FILE_ACCESSOR_AIO;
+    g_async_method_type = (async_file_accessor_type_t)(atoi(argv[2]) - 1);
 
     printf("- This is a test for async accessor.\n");
     if (!g_en_async)
@@ -135,6 +141,14 @@ static void parse_args(int argc, char *argv[])
         {
             printf("- ASYNC_FILE_ACCESSOR_MMAP.\n");
         }
+        else if (g_async_method_type == ASYNC_FILE_ACCESSOR_URING)
+        {
+            printf("- ASYNC_FILE_ACCESSOR_URING.\n");
+        }
+        else if (g_async_method_type == ASYNC_FILE_ACCESSOR_AIO_NATIVE)
+        {
+            printf("- ASYNC_FILE_ACCESSOR_AIO_NATIVE.\n");
+        }
         else
         {
             printf("- ASYNC_FILE_ACCESSOR_AIO.\n");
@@ -210,7 +224,7 @@ ret_t async_read_one_picture_to_file(void **buffer, char8 *filename, u32 *length
 
     if(RET_OK == res)
     {
-        (*buffer) = malloc(*length);
+        (*buffer) = Async_File_Buffer_Alloc(*length);
         res = pFileAccessor->importReadBuf(pFileAccessor, pNewRequest, (*buffer));
         res = pFileAccessor->putRequest(pFileAccessor, pNewRequest);
     }
@@ -270,7 +284,7 @@ ret_t sync_read_one_picture_to_file(void **buffer, char8 *filename, u32 *length)
     fstat(fd, &fsb);
     *length = fsb.st_size;
 
-    (*buffer) = malloc(*length);
+    (*buffer) = Async_File_Buffer_Alloc(*length);
     read(fd, *buffer, *length);
     // printf("read_picture: [%s], size: %d, buf_addr: %p / %p.\n", filename, *length, buffer, *buffer);
 
@@ -301,4 +315,34 @@ ret_t sync_write_one_picture_to_file(void *buffer, char8 *filename, u32 length)
     buf = NULL;
 
     return res;
+}
+
+/// Print accessor counters, bench_fio covers throughput and latency sweeps
+static void print_io_stats(async_file_accessor_t *pFileAccessor)
+{
+    static const char8     *directions[ASYNC_FILE_ACCESS_MAX]   = { "read", "write" };
+    static const char8     *stages[ASYNC_FILE_STAGE_MAX]        = { "setup", "queue", "service", "total", "wakeup" };
+    async_file_stats_t      stats;
+
+    if (RET_OK != pFileAccessor->getStats(pFileAccessor, &stats))
+    {
+        return;
+    }
+
+    for (u32 d = 0; d < ASYNC_FILE_ACCESS_MAX; d++)
+    {
+        printf(" -- %s: %llu ops, %llu errors, %llu bytes.\n", directions[d],
+               (unsigned long long)stats.directions[d].ops, (unsigned long long)stats.directions[d].errors,
+               (unsigned long long)stats.directions[d].bytes);
+
+        for (u32 t = 0; t < ASYNC_FILE_STAGE_MAX; t++)
+        {
+            async_file_latency_stats_t *pStage = &(stats.directions[d].stages[t]);
+
+            printf("    %-8s p50 %llu us, p99 %llu us, p999 %llu us, max %llu us.\n", stages[t],
+                   (unsigned long long)pStage->p50Ns / 1000, (unsigned long long)pStage->p99Ns / 1000,
+                   (unsigned long long)pStage->p999Ns / 1000, (unsigned long long)pStage->maxNs / 1000);
+        }
+    }
+    printf("\n");
 }
\ No newline at end of file
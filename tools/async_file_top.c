@@ -0,0 +1,281 @@
+/***************************************************************************************
+ * Project      : async_file_accessor
+ * File         : async_file_top.c
+ * Description  : Attach to the live stats segment of a running process and show per
+                  accessor rates, in flight depth and thread pool load, like iostat.
+ * Author       : Louis Liu
+ * Created Date : 2023-7-13
+ * Copyright (c) 2023, [Louis.Liu]
+ * All rights reserved.
+ ***************************************************************************************/
+
+#include <dirent.h>
+#include "live_stats.h"
+
+#define TOP_SHM_DIR                     "/dev/shm"
+#define TOP_DEFAULT_INTERVAL_MS         1000
+#define TOP_MB                          (1024.0 * 1024.0)
+
+static const char8 *g_typeName[ASYNC_FILE_ACCESSOR_MAX] =
+{
+    [ASYNC_FILE_ACCESSOR_AIO]           = "aio",
+    [ASYNC_FILE_ACCESSOR_MMAP]          = "mmap",
+    [ASYNC_FILE_ACCESSOR_URING]         = "io_uring",
+    [ASYNC_FILE_ACCESSOR_AIO_NATIVE]    = "aio_native",
+};
+
+/// struct define rates of an accessor between its last two publishes
+typedef struct __top_rates
+{
+    bool                            isValid;                /// two publishes seen
+    f64                             opsPerSec[ASYNC_FILE_ACCESS_MAX];
+    f64                             bytesPerSec[ASYNC_FILE_ACCESS_MAX];
+    f64                             errorsPerSec;
+
+} top_rates_t;
+
+static u64 get_time_in_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/// Whether the process that published a segment still runs
+static bool is_publisher_alive(const live_stats_segment_t *pSegment)
+{
+    return __atomic_load_n(&(pSegment->isPublishing), __ATOMIC_ACQUIRE) &&
+           (0 == kill(pSegment->pid, 0) || EPERM == errno);
+}
+
+/// Find the only live segment in /dev/shm, list them all when there are several
+static ret_t find_segment(char8 *name, u32 size)
+{
+    DIR            *pDir    = opendir(TOP_SHM_DIR);
+    struct dirent  *pEntry  = NULL;
+    u32             found   = 0;
+    u32             prefix  = strlen(LIVE_STATS_NAME_PREFIX) - 1;
+
+    if (NULL == pDir)
+    {
+        printf("Error: open %s fail! error: %d - %s.\n", TOP_SHM_DIR, errno, strerror(errno));
+        return -errno;
+    }
+
+    while (NULL != (pEntry = readdir(pDir)))
+    {
+        const live_stats_segment_t *pSegment = NULL;
+        char8                       path[LIVE_STATS_NAME_MAX];
+
+        if (strncmp(pEntry->d_name, LIVE_STATS_NAME_PREFIX + 1, prefix) != 0 ||
+            strlen(pEntry->d_name) + 2 > sizeof(path))
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/%s", pEntry->d_name);
+        if (RET_OK == live_stats_attach(path, &pSegment) && is_publisher_alive(pSegment))
+        {
+            if (1 == found)
+            {
+                printf("Several processes publish live stats, pick one:\n  %s\n", name);
+            }
+            if (found > 0)
+            {
+                printf("  %s\n", path);
+            }
+            else
+            {
+                snprintf(name, size, "%s", path);
+            }
+            found++;
+        }
+        live_stats_detach(pSegment);
+    }
+    closedir(pDir);
+
+    if (0 == found)
+    {
+        printf("Error: no process publishes live stats, see Async_File_Live_Stats_Start.\n");
+    }
+
+    return (1 == found) ? RET_OK : (0 == found) ? RET_NAME_NOT_FOUND : RET_BAD_VALUE;
+}
+
+/// Move rates forward when the publisher refreshed a slot since the last look
+static void update_rates(const live_stats_slot_t *pNow, live_stats_slot_t *pLast, top_rates_t *pRates)
+{
+    f64 seconds = 0;
+    u64 errors  = 0;
+
+    if (0 == pLast->publishNs || pNow->publishNs < pLast->publishNs)
+    {
+        *pLast = *pNow;
+        return;
+    }
+    if (pNow->publishNs == pLast->publishNs)
+    {
+        return;
+    }
+
+    seconds = (f64)(pNow->publishNs - pLast->publishNs) / 1000000000.0;
+    for (u32 d = 0; d < ASYNC_FILE_ACCESS_MAX; d++)
+    {
+        pRates->opsPerSec[d]    = (f64)(pNow->ops[d] - pLast->ops[d]) / seconds;
+        pRates->bytesPerSec[d]  = (f64)(pNow->bytes[d] - pLast->bytes[d]) / seconds;
+        errors                 += pNow->errors[d] - pLast->errors[d];
+    }
+    pRates->errorsPerSec    = (f64)errors / seconds;
+    pRates->isValid         = TRUE;
+    *pLast                  = *pNow;
+}
+
+/// Print one report of every published accessor
+static void print_report(const char8                *name,
+                         const live_stats_segment_t *pSegment,
+                         const live_stats_slot_t    *pSlots,
+                         const top_rates_t          *pRates,
+                         bool                        isTerminal)
+{
+    time_t      now     = time(NULL);
+    char8       clock[16];
+
+    strftime(clock, sizeof(clock), "%H:%M:%S", localtime(&now));
+    printf("%s%s  pid %d  publish %u ms  up %.1f s  %s\n\n", isTerminal ? "\033[H\033[2J" : "", name,
+           pSegment->pid, pSegment->intervalMs,
+           (f64)(get_time_in_nanoseconds() - pSegment->startNs) / 1000000000.0, clock);
+    printf("%-11s %9s %9s %9s %9s %7s %8s %6s %8s %6s %6s %5s %5s %5s\n",
+           "accessor", "r/s", "w/s", "rMB/s", "wMB/s", "err/s", "inflight", "limit", "inflMB",
+           "reap", "queued", "alive", "busy", "idle");
+
+    for (u32 type = 0; type < ASYNC_FILE_ACCESSOR_MAX; type++)
+    {
+        const live_stats_slot_t    *pSlot   = &(pSlots[type]);
+        const top_rates_t          *pRate   = &(pRates[type]);
+
+        if (!pSlot->isActive)
+        {
+            continue;
+        }
+
+        printf("%-11s ", g_typeName[type]);
+        if (pRate->isValid)
+        {
+            printf("%9.1f %9.1f %9.2f %9.2f %7.1f ", pRate->opsPerSec[ASYNC_FILE_ACCESS_READ],
+                   pRate->opsPerSec[ASYNC_FILE_ACCESS_WRITE], pRate->bytesPerSec[ASYNC_FILE_ACCESS_READ] / TOP_MB,
+                   pRate->bytesPerSec[ASYNC_FILE_ACCESS_WRITE] / TOP_MB, pRate->errorsPerSec);
+        }
+        else
+        {
+            printf("%9s %9s %9s %9s %7s ", "-", "-", "-", "-", "-");
+        }
+        printf("%8u %6u %8.2f %6u ", pSlot->inflight, pSlot->inflightLimit, (f64)pSlot->inflightBytes / TOP_MB,
+               pSlot->reapable);
+
+        /// Only the mmap accessor runs its own workers
+        if (ASYNC_FILE_ACCESSOR_MMAP == type)
+        {
+            printf("%6u %5u %5u %5u\n", pSlot->queuedTasks, pSlot->aliveThreads, pSlot->busyThreads,
+                   pSlot->idleThreads);
+        }
+        else
+        {
+            printf("%6s %5s %5s %5s\n", "-", "-", "-", "-");
+        }
+    }
+
+    if (!isTerminal)
+    {
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+static void print_usage(const char8 *program)
+{
+    printf("Usage: %s [-i INTERVAL_MS] [-n COUNT] [PID | /SEGMENT_NAME]\n", program);
+    printf("  Show live accessor rates of a process that called Async_File_Live_Stats_Start.\n");
+    printf("  Without a target the only publishing process is picked.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const live_stats_segment_t *pSegment    = NULL;
+    live_stats_slot_t           slots[ASYNC_FILE_ACCESSOR_MAX];
+    live_stats_slot_t           last[ASYNC_FILE_ACCESSOR_MAX];
+    top_rates_t                 rates[ASYNC_FILE_ACCESSOR_MAX];
+    char8                       name[LIVE_STATS_NAME_MAX];
+    u32                         intervalMs  = 0;
+    u32                         count       = 0;
+    bool                        isTerminal  = isatty(STDOUT_FILENO);
+    s32                         opt         = 0;
+    ret_t                       res         = RET_OK;
+
+    while ((opt = getopt(argc, argv, "i:n:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i':   intervalMs  = (u32)atoi(optarg);    break;
+            case 'n':   count       = (u32)atoi(optarg);    break;
+            default:    print_usage(argv[0]);               return 1;
+        }
+    }
+
+    if (optind < argc && '/' == argv[optind][0])
+    {
+        snprintf(name, sizeof(name), "%s", argv[optind]);
+    }
+    else if (optind < argc)
+    {
+        snprintf(name, sizeof(name), "%s%d", LIVE_STATS_NAME_PREFIX, atoi(argv[optind]));
+    }
+    else if (find_segment(name, sizeof(name)) != RET_OK)
+    {
+        return 1;
+    }
+
+    res = live_stats_attach(name, &pSegment);
+    if (RET_OK != res)
+    {
+        printf("Error: attach live stats segment [%s] fail! res = %d.\n", name, res);
+        return 1;
+    }
+
+    /// Refreshing faster than the publisher only repeats its numbers
+    intervalMs = (0 == intervalMs) ? TOP_DEFAULT_INTERVAL_MS : intervalMs;
+    intervalMs = (intervalMs < pSegment->intervalMs) ? pSegment->intervalMs : intervalMs;
+    memset(last, 0, sizeof(last));
+    memset(rates, 0, sizeof(rates));
+
+    for (u32 round = 0; 0 == count || round <= count; round++)
+    {
+        if (!is_publisher_alive(pSegment))
+        {
+            printf("Publisher of [%s] stopped.\n", name);
+            break;
+        }
+
+        for (u32 type = 0; type < ASYNC_FILE_ACCESSOR_MAX; type++)
+        {
+            if (!live_stats_read_slot(&(pSegment->slots[type]), &(slots[type])))
+            {
+                slots[type] = last[type];
+            }
+            update_rates(&(slots[type]), &(last[type]), &(rates[type]));
+        }
+
+        /// First look only sets the baseline, rates need a second one
+        if (round > 0)
+        {
+            print_report(name, pSegment, slots, rates, isTerminal);
+        }
+        if (0 == count || round < count)
+        {
+            usleep(intervalMs * 1000);
+        }
+    }
+
+    live_stats_detach(pSegment);
+
+    return 0;
+}